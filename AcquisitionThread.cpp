@@ -0,0 +1,156 @@
+#include "AcquisitionThread.h"
+#include <stdint.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#endif
+
+AcquisitionThread::AcquisitionThread()
+    : stopping(false), active(false), wake_read(-1), wake_write(-1), lateness_us(-1) {
+#if defined(__linux__)
+    wake_read = wake_write = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif !defined(_WIN32)
+    int fds[2];
+    if (pipe(fds) == 0) {
+        for (int fd : fds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        wake_read = fds[0];
+        wake_write = fds[1];
+    }
+#endif
+}
+
+AcquisitionThread::~AcquisitionThread() {
+    stop();
+#ifndef _WIN32
+    if (wake_read >= 0) {
+        close(wake_read);
+    }
+    if (wake_write >= 0 && wake_write != wake_read) {
+        close(wake_write);
+    }
+#endif
+}
+
+void AcquisitionThread::start(std::function<void()> body) {
+    stop();
+    active.store(true, std::memory_order_release);
+    worker = std::thread([this, body]() {
+        body();
+        active.store(false, std::memory_order_release);
+    });
+}
+
+void AcquisitionThread::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    stopping.store(true, std::memory_order_relaxed);
+    wake();
+    worker.join();
+    drain();
+    stopping.store(false, std::memory_order_relaxed);
+}
+
+void AcquisitionThread::wake() {
+#ifndef _WIN32
+    if (wake_write < 0) {
+        return;
+    }
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t r = write(wake_write, &one, sizeof(one));
+#else
+    char one = 1;
+    ssize_t r = write(wake_write, &one, sizeof(one));
+#endif
+    (void)r;    // переполнение неважно: дескриптор уже читаем
+#endif
+}
+
+void AcquisitionThread::drain() {
+#ifndef _WIN32
+    if (wake_read < 0) {
+        return;
+    }
+    uint64_t buf[8];
+    while (read(wake_read, buf, sizeof(buf)) > 0) {
+    }
+#endif
+}
+
+bool AcquisitionThread::pause(int timeout_ms) {
+#ifdef _WIN32
+    for (int waited = 0; waited < timeout_ms && !stop_requested(); waited += 50) {
+        Sleep(50);
+    }
+    return !stop_requested();
+#else
+    // Отрицательный дескриптор poll() пропускает: ждем только пробуждения
+    Wait w = WAIT_TIMEOUT;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (w == WAIT_TIMEOUT) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) {
+            break;
+        }
+        w = wait_readable(-1, (int)left);
+    }
+    return w != WAIT_STOP && !stop_requested();
+#endif
+}
+
+AcquisitionThread::Wait AcquisitionThread::wait_readable(int fd, int timeout_ms) {
+    if (stop_requested()) {
+        return WAIT_STOP;
+    }
+#ifdef _WIN32
+    (void)fd;
+    (void)timeout_ms;
+    return WAIT_READY;
+#else
+    struct pollfd fds[2];
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = wake_read;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    // Без дескриптора пробуждения остановка замечается по таймауту
+    int timeout = wake_read >= 0 ? timeout_ms : (timeout_ms < 50 ? timeout_ms : 50);
+    struct timespec before, after;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    int r = poll(fds, wake_read >= 0 ? 2 : 1, timeout);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    lateness_us = r == 0
+            ? (after.tv_sec - before.tv_sec) * 1000000 + (after.tv_nsec - before.tv_nsec) / 1000 - (int64_t)timeout * 1000
+            : -1;
+    if (r < 0) {
+        return errno == EINTR ? WAIT_TIMEOUT : WAIT_ERROR;
+    }
+    if (stop_requested() || fds[1].revents) {
+        return WAIT_STOP;
+    }
+    if (r == 0) {
+        return WAIT_TIMEOUT;
+    }
+    if (fds[0].revents & POLLIN) {
+        return WAIT_READY;
+    }
+    return WAIT_ERROR;     // POLLHUP / POLLERR / POLLNVAL без данных
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef ACQUISITIONTHREAD_H
+#define ACQUISITIONTHREAD_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// Поток чтения порта с управляемым временем жизни.
+//
+// start() запускает тело в собственном потоке, stop() просит его
+// завершиться, будит и дожидается (join), поэтому после stop() тело
+// гарантированно не выполняется и объект-владелец можно сбрасывать или
+// удалять. Тело ждет данных через wait_readable(): poll() на дескрипторе
+// порта и на дескрипторе пробуждения (eventfd в Linux, иначе pipe),
+// так что остановка не ждет таймаута чтения.
+//
+// В Windows дескриптора пробуждения нет: тело проверяет
+// stop_requested() между вызовами ReadFile с таймаутами порта (50 мс).
+class AcquisitionThread {
+public:
+    enum Wait {
+        WAIT_READY = 0,     // есть данные
+        WAIT_TIMEOUT,
+        WAIT_STOP,          // запрошена остановка
+        WAIT_ERROR          // ошибка или порт закрыт (устройство отключено)
+    };
+
+    AcquisitionThread();
+    ~AcquisitionThread();
+
+    // Предыдущий запуск останавливается
+    void start(std::function<void()> body);
+    void stop();
+
+    // Тело выполняется
+    bool running() const { return active.load(std::memory_order_acquire); }
+
+    // Для тела
+    bool stop_requested() const { return stopping.load(std::memory_order_relaxed); }
+    Wait wait_readable(int fd, int timeout_ms);
+    // После WAIT_TIMEOUT: насколько позже таймаута поток получил
+    // управление, мкс (-1 - не измерено)
+    int64_t timeout_lateness_us() const { return lateness_us; }
+    // Дескриптор, который становится читаемым при stop(); -1 - нет
+    int wake_fd() const { return wake_read; }
+    // Пауза, прерываемая остановкой; false - запрошена остановка
+    bool pause(int timeout_ms);
+
+private:
+    void wake();
+    void drain();
+
+    std::thread worker;
+    std::atomic<bool> stopping;
+    std::atomic<bool> active;
+    int wake_read;
+    int wake_write;
+    int64_t lateness_us;
+};
+
+#endif
@@ -0,0 +1,574 @@
+#include "AlarmRules.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// ========== Разбор правил ==========
+
+class AlarmRules::Parser {
+public:
+    Parser(const std::string& line, const std::unordered_map<std::string, std::vector<IdRange>>& groups)
+        : s(line), pos(0), groups(groups), depth(0), max_depth(0) {}
+
+    bool parse_rule(Rule& rule, std::string& error) {
+        rule.name = ident();
+        if (rule.name.empty() || !accept(":")) {
+            error = "ожидалось 'имя:'";
+            return false;
+        }
+
+        if (!parse_or(rule.code, error)) {
+            return false;
+        }
+        if (max_depth > MAX_STACK) {
+            error = "слишком сложное условие";
+            return false;
+        }
+
+        rule.consecutive = 1;
+        rule.hysteresis = 0.0f;
+        rule.limit_per_min = 0.0;
+
+        // Необязательные модификаторы в любом порядке
+        while (!at_end()) {
+            std::string word = ident();
+            if (word == "for") {
+                double n;
+                if (!number(n) || n < 1) {
+                    error = "после 'for' ожидалось число пакетов";
+                    return false;
+                }
+                rule.consecutive = (uint32_t)n;
+            } else if (word == "hyst") {
+                double h;
+                if (!number(h) || h < 0) {
+                    error = "после 'hyst' ожидалось неотрицательное число";
+                    return false;
+                }
+                rule.hysteresis = (float)h;
+            } else if (word == "limit") {
+                double n;
+                if (!number(n) || n <= 0 || !accept("/") || ident() != "min") {
+                    error = "ожидалось 'limit N/min'";
+                    return false;
+                }
+                rule.limit_per_min = n;
+            } else if (word == "on") {
+                if (!parse_selector(rule.selector, error)) {
+                    return false;
+                }
+            } else {
+                error = "неизвестный модификатор '" + word + "'";
+                return false;
+            }
+        }
+
+        // Константы удержания: порог сдвигается на гистерезис от зоны тревоги
+        for (size_t i = 0; i + 1 < rule.code.size(); i++) {
+            Instr& c = rule.code[i];
+            uint8_t cmp = rule.code[i + 1].op;
+            if (c.op != OP_CONST) continue;
+            if (cmp == OP_LT || cmp == OP_LE) c.hold_value = c.value + rule.hysteresis;
+            if (cmp == OP_GT || cmp == OP_GE) c.hold_value = c.value - rule.hysteresis;
+        }
+
+        return true;
+    }
+
+    // "group имя = id, id..id, ..."
+    bool parse_group(std::string& name, std::vector<IdRange>& ranges, std::string& error) {
+        if (ident() != "group") {
+            error = "ожидалось 'group'";
+            return false;
+        }
+        name = ident();
+        if (name.empty() || !accept("=")) {
+            error = "ожидалось 'group имя = ...'";
+            return false;
+        }
+        do {
+            IdRange r;
+            if (!parse_range(r)) {
+                error = "ожидался ID или диапазон ID";
+                return false;
+            }
+            ranges.push_back(r);
+        } while (accept(","));
+
+        if (!at_end()) {
+            error = "лишние символы после списка ID";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    void skip_ws() {
+        while (pos < s.size() && isspace((unsigned char)s[pos])) pos++;
+    }
+
+    bool at_end() {
+        skip_ws();
+        return pos >= s.size();
+    }
+
+    bool accept(const char* tok) {
+        skip_ws();
+        size_t n = strlen(tok);
+        if (s.compare(pos, n, tok) == 0) {
+            pos += n;
+            return true;
+        }
+        return false;
+    }
+
+    std::string ident() {
+        skip_ws();
+        size_t start = pos;
+        while (pos < s.size() && (isalnum((unsigned char)s[pos]) || s[pos] == '_')) pos++;
+        return s.substr(start, pos - start);
+    }
+
+    bool number(double& out) {
+        skip_ws();
+        const char* begin = s.c_str() + pos;
+        char* end = nullptr;
+        out = strtod(begin, &end);
+        if (end == begin) return false;
+        pos += end - begin;
+        return true;
+    }
+
+    bool parse_range(IdRange& r) {
+        skip_ws();
+        const char* begin = s.c_str() + pos;
+        char* end = nullptr;
+        unsigned long lo = strtoul(begin, &end, 0);
+        if (end == begin) return false;
+        pos += end - begin;
+        r.lo = r.hi = (uint32_t)lo;
+        if (accept("..")) {
+            begin = s.c_str() + pos;
+            unsigned long hi = strtoul(begin, &end, 0);
+            if (end == begin || hi < lo) return false;
+            pos += end - begin;
+            r.hi = (uint32_t)hi;
+        }
+        return true;
+    }
+
+    bool parse_selector(std::vector<IdRange>& out, std::string& error) {
+        std::string kind = ident();
+        if (!accept("=")) {
+            error = "ожидалось 'on id=...' или 'on group=...'";
+            return false;
+        }
+        if (kind == "id") {
+            do {
+                IdRange r;
+                if (!parse_range(r)) {
+                    error = "ожидался ID или диапазон ID";
+                    return false;
+                }
+                out.push_back(r);
+            } while (accept(","));
+            return true;
+        }
+        if (kind == "group") {
+            std::string name = ident();
+            auto it = groups.find(name);
+            if (it == groups.end()) {
+                error = "неизвестная группа '" + name + "'";
+                return false;
+            }
+            out.insert(out.end(), it->second.begin(), it->second.end());
+            return true;
+        }
+        error = "неизвестный селектор '" + kind + "'";
+        return false;
+    }
+
+    void append_op(std::vector<Instr>& code, uint8_t op, uint8_t field, float value, int stack_delta) {
+        Instr in;
+        in.op = op;
+        in.field = field;
+        in.value = value;
+        in.hold_value = value;
+        code.push_back(in);
+        depth += stack_delta;
+        if (depth > max_depth) max_depth = depth;
+    }
+
+    bool parse_or(std::vector<Instr>& code, std::string& error) {
+        if (!parse_and(code, error)) return false;
+        while (accept("||")) {
+            if (!parse_and(code, error)) return false;
+            append_op(code, OP_OR, 0, 0.0f, -1);
+        }
+        return true;
+    }
+
+    bool parse_and(std::vector<Instr>& code, std::string& error) {
+        if (!parse_cmp(code, error)) return false;
+        while (accept("&&")) {
+            if (!parse_cmp(code, error)) return false;
+            append_op(code, OP_AND, 0, 0.0f, -1);
+        }
+        return true;
+    }
+
+    static int field_index(const std::string& name) {
+        if (name == "pressure") return STAT_PRESSURE;
+        if (name == "temperature") return STAT_TEMPERATURE;
+        if (name == "voltage") return STAT_VOLTAGE;
+        if (name == "rssi") return STAT_RSSI;
+        return -1;
+    }
+
+    bool parse_cmp(std::vector<Instr>& code, std::string& error) {
+        if (accept("(")) {
+            if (!parse_or(code, error)) return false;
+            if (!accept(")")) {
+                error = "ожидалась ')'";
+                return false;
+            }
+            return true;
+        }
+
+        // Операнд: поле, rate(поле) или abs() от них
+        std::string name = ident();
+        bool absolute = false;
+        if (name == "abs") {
+            if (!accept("(")) {
+                error = "ожидалось 'abs(операнд)'";
+                return false;
+            }
+            name = ident();
+            absolute = true;
+        }
+        bool rate = false;
+        if (name == "rate") {
+            if (!accept("(")) {
+                error = "ожидалось 'rate(поле)'";
+                return false;
+            }
+            name = ident();
+            if (!accept(")")) {
+                error = "ожидалась ')'";
+                return false;
+            }
+            rate = true;
+        }
+        if (absolute && !accept(")")) {
+            error = "ожидалась ')'";
+            return false;
+        }
+        int field = field_index(name);
+        if (field < 0) {
+            error = "неизвестное поле '" + name + "'";
+            return false;
+        }
+        append_op(code, rate ? OP_RATE : OP_FIELD, (uint8_t)field, 0.0f, +1);
+        if (absolute) {
+            append_op(code, OP_ABS, 0, 0.0f, 0);
+        }
+
+        uint8_t op;
+        if (accept("<=")) op = OP_LE;
+        else if (accept(">=")) op = OP_GE;
+        else if (accept("==")) op = OP_EQ;
+        else if (accept("!=")) op = OP_NE;
+        else if (accept("<")) op = OP_LT;
+        else if (accept(">")) op = OP_GT;
+        else {
+            error = "ожидался оператор сравнения";
+            return false;
+        }
+
+        double value;
+        if (!number(value)) {
+            error = "ожидалось число";
+            return false;
+        }
+        // Для скорости допускается явная единица "/min"
+        if (rate) {
+            size_t save = pos;
+            if (!(accept("/") && ident() == "min")) pos = save;
+        }
+
+        append_op(code, OP_CONST, 0, (float)value, +1);
+        append_op(code, op, 0, 0.0f, -1);
+        return true;
+    }
+
+    const std::string& s;
+    size_t pos;
+    const std::unordered_map<std::string, std::vector<IdRange>>& groups;
+    int depth;
+    int max_depth;
+};
+
+// ========== Набор правил ==========
+
+AlarmRules::AlarmRules() : events(MAX_EVENTS, QUEUE_DROP_OLDEST) {
+    std::shared_ptr<const RuleSet> none = std::make_shared<RuleSet>();
+    for (Shard& sh : shards) {
+        sh.rules = none;
+    }
+}
+
+bool AlarmRules::parse(const std::string& text, std::string* error) {
+    std::unordered_map<std::string, std::vector<IdRange>> groups;
+    std::vector<Rule> parsed;
+
+    std::istringstream in(text);
+    std::string line;
+    int line_no = 0;
+
+    while (std::getline(in, line)) {
+        line_no++;
+
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::string err;
+        Parser parser(line, groups);
+
+        if (line.compare(line.find_first_not_of(" \t"), 6, "group ") == 0) {
+            std::string name;
+            std::vector<IdRange> ranges;
+            if (!parser.parse_group(name, ranges, err)) {
+                if (error) *error = "строка " + std::to_string(line_no) + ": " + err;
+                return false;
+            }
+            groups[name] = ranges;
+            continue;
+        }
+
+        Rule rule;
+        if (!parser.parse_rule(rule, err)) {
+            if (error) *error = "строка " + std::to_string(line_no) + ": " + err;
+            return false;
+        }
+        parsed.push_back(rule);
+    }
+
+    // Состояния устройств привязаны к номерам правил и сбрасываются
+    std::shared_ptr<const RuleSet> set = std::make_shared<RuleSet>(std::move(parsed));
+    for (Shard& sh : shards) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        sh.rules = set;
+        sh.devices.clear();
+    }
+    return true;
+}
+
+bool AlarmRules::load_file(const std::string& path, std::string* error) {
+    std::ifstream f(path);
+    if (!f) {
+        if (error) *error = "не удалось открыть " + path;
+        return false;
+    }
+    std::stringstream buf;
+    buf << f.rdbuf();
+    return parse(buf.str(), error);
+}
+
+bool AlarmRules::selected(const Rule& rule, uint32_t id) {
+    if (rule.selector.empty()) {
+        return true;
+    }
+    for (const IdRange& r : rule.selector) {
+        if (id >= r.lo && id <= r.hi) return true;
+    }
+    return false;
+}
+
+bool AlarmRules::run(const Rule& rule, bool hold, const float* values, const float* rates) const {
+    float stack[MAX_STACK];
+    int sp = 0;
+
+    for (const Instr& in : rule.code) {
+        switch (in.op) {
+            case OP_FIELD: stack[sp++] = values[in.field]; break;
+            case OP_RATE:  stack[sp++] = rates[in.field]; break;
+            case OP_ABS:   stack[sp - 1] = fabsf(stack[sp - 1]); break;
+            case OP_CONST: stack[sp++] = hold ? in.hold_value : in.value; break;
+            case OP_LT: sp--; stack[sp - 1] = stack[sp - 1] <  stack[sp]; break;
+            case OP_LE: sp--; stack[sp - 1] = stack[sp - 1] <= stack[sp]; break;
+            case OP_GT: sp--; stack[sp - 1] = stack[sp - 1] >  stack[sp]; break;
+            case OP_GE: sp--; stack[sp - 1] = stack[sp - 1] >= stack[sp]; break;
+            case OP_EQ: sp--; stack[sp - 1] = stack[sp - 1] == stack[sp]; break;
+            case OP_NE: sp--; stack[sp - 1] = stack[sp - 1] != stack[sp]; break;
+            case OP_AND: sp--; stack[sp - 1] = (stack[sp - 1] != 0.0f) && (stack[sp] != 0.0f); break;
+            case OP_OR:  sp--; stack[sp - 1] = (stack[sp - 1] != 0.0f) || (stack[sp] != 0.0f); break;
+        }
+    }
+
+    return sp > 0 && stack[0] != 0.0f;
+}
+
+bool AlarmRules::allow_event(const Rule& rule, RuleState& st, uint64_t now_us) {
+    if (rule.limit_per_min <= 0.0) {
+        return true;
+    }
+
+    // Корзина токенов устройства: limit_per_min событий в минуту
+    if (st.last_refill_us != 0 && now_us > st.last_refill_us) {
+        double tokens = st.tokens + (now_us - st.last_refill_us) * rule.limit_per_min / 60e6;
+        st.tokens = (float)(tokens > rule.limit_per_min ? rule.limit_per_min : tokens);
+    }
+    st.last_refill_us = now_us;
+
+    if (st.tokens >= 1.0f) {
+        st.tokens -= 1.0f;
+        return true;
+    }
+    return false;
+}
+
+void AlarmRules::push_event(const Rule& rule, uint32_t id, bool raised, const float* values, uint64_t now_us) {
+    AlarmEvent ev;
+    ev.rule = rule.name;
+    ev.id = id;
+    ev.raised = raised;
+    ev.time_us = now_us;
+    memcpy(ev.values, values, sizeof(ev.values));
+    events.push(ev, id);
+}
+
+void AlarmRules::evaluate(uint32_t id, const float values[STAT_FIELD_COUNT], uint64_t now_us) {
+    Shard& sh = shards[device_shard(id)];
+    std::lock_guard<std::mutex> lock(sh.mutex);
+    if (!sh.rules->empty()) {
+        evaluate_locked(sh, id, values, now_us);
+    }
+}
+
+void AlarmRules::evaluate(const uint32_t* ids, const float (*values)[STAT_FIELD_COUNT], const uint64_t* now_us,
+                          size_t count) {
+    size_t i = 0;
+    while (i < count) {
+        unsigned shard = device_shard(ids[i]);
+        Shard& sh = shards[shard];
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        do {
+            if (!sh.rules->empty()) {
+                evaluate_locked(sh, ids[i], values[i], now_us[i]);
+            }
+            i++;
+        } while (i < count && device_shard(ids[i]) == shard);
+    }
+}
+
+void AlarmRules::evaluate_locked(Shard& sh, uint32_t id, const float values[STAT_FIELD_COUNT], uint64_t now_us) {
+    const RuleSet& rules = *sh.rules;
+    DeviceState& dev = sh.devices[id];
+    bool first = dev.rules.empty();
+    if (first) {
+        dev.rules.resize(rules.size());
+        for (size_t i = 0; i < rules.size(); i++) {
+            RuleState& st = dev.rules[i];
+            st.streak = 0;
+            st.active = st.reported = false;
+            st.tokens = (float)rules[i].limit_per_min;
+            st.last_refill_us = 0;
+        }
+    }
+
+    // Скорость изменения полей в единицах в минуту
+    float rates[STAT_FIELD_COUNT] = {0};
+    if (!first && now_us > dev.prev_us) {
+        float minutes = (float)((now_us - dev.prev_us) / 60e6);
+        for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+            rates[f] = (values[f] - dev.prev[f]) / minutes;
+        }
+    }
+
+    for (size_t i = 0; i < rules.size(); i++) {
+        const Rule& rule = rules[i];
+        if (!selected(rule, id)) {
+            continue;
+        }
+
+        RuleState& st = dev.rules[i];
+        sh.evaluations++;
+
+        if (!st.active) {
+            if (run(rule, false, values, rates)) {
+                if (++st.streak >= rule.consecutive) {
+                    st.active = true;
+                    st.reported = allow_event(rule, st, now_us);
+                    if (st.reported) {
+                        push_event(rule, id, true, values, now_us);
+                    } else {
+                        sh.suppressed++;
+                    }
+                }
+            } else {
+                st.streak = 0;
+            }
+        } else if (!run(rule, true, values, rates)) {
+            st.active = false;
+            st.streak = 0;
+            // Снятие без события о срабатывании сбило бы журнал тревог
+            if (st.reported) {
+                st.reported = false;
+                push_event(rule, id, false, values, now_us);
+            }
+        }
+    }
+
+    memcpy(dev.prev, values, sizeof(dev.prev));
+    dev.prev_us = now_us;
+}
+
+std::vector<AlarmEvent> AlarmRules::take_events() {
+    std::vector<BoundedQueue<AlarmEvent>::Entry> taken;
+    std::vector<AlarmEvent> out;
+    events.take(taken);
+    out.reserve(taken.size());
+    for (BoundedQueue<AlarmEvent>::Entry& e : taken) {
+        out.push_back(std::move(e.value));
+    }
+    return out;
+}
+
+size_t AlarmRules::rule_count() const {
+    std::lock_guard<std::mutex> lock(shards[0].mutex);
+    return shards[0].rules->size();
+}
+
+uint64_t AlarmRules::evaluation_count() const {
+    uint64_t n = 0;
+    for (const Shard& sh : shards) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        n += sh.evaluations;
+    }
+    return n;
+}
+
+uint64_t AlarmRules::suppressed_count() const {
+    uint64_t n = 0;
+    for (const Shard& sh : shards) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        n += sh.suppressed;
+    }
+    return n;
+}
+
+void AlarmRules::clear_state() {
+    for (Shard& sh : shards) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        sh.devices.clear();
+        sh.evaluations = 0;
+        sh.suppressed = 0;
+    }
+    events.clear();
+}
@@ -0,0 +1,154 @@
+#ifndef ALARMRULES_H
+#define ALARMRULES_H
+
+#include "DeviceStats.h"
+#include "BoundedQueue.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+// Событие тревоги: срабатывание или снятие правила для устройства
+struct AlarmEvent {
+    std::string rule;
+    uint32_t id;
+    bool raised;
+    uint64_t time_us;
+    float values[STAT_FIELD_COUNT];
+};
+
+// Правила тревог. Каждая строка файла описывает одно правило:
+//
+//   low_pressure: pressure < 1.5 for 3
+//   low_battery:  voltage < 2.6 hyst 0.05 on group=north
+//   heating:      rate(temperature) > 10 limit 6/min on id=0x1A00..0x1AFF
+//   jump:         abs(rate(temperature)) > 10
+//   group north = 0x1A2B3C4D, 0x1A2B3C50..0x1A2B3C5F
+//
+// Условие - сравнения полей (pressure, temperature, voltage, rssi) или их
+// скорости изменения в единицах/мин, объединенные && и ||. rate() со
+// знаком: рост положителен, падение отрицательно; abs() - изменение в
+// любую сторону (или модуль поля).
+// for N   - тревога после N подряд пакетов с выполненным условием;
+// hyst H  - тревога снимается, только когда значение отойдет от порога на H;
+// limit N/min - не больше N срабатываний правила в минуту на устройство,
+//               остальные считаются подавленными: шумное устройство не
+//               забирает лимит у соседей. Снятие тревоги приходит, только
+//               если о ее срабатывании было событие, и лимитом не режется.
+//               При 100 тыс. устройств и limit 6/min правило может дать
+//               до 600 тыс. событий в минуту - их ограничивает очередь.
+// Правила разбираются один раз и компилируются в байткод стековой машины.
+//
+// События ждут GUI в очереди на MAX_EVENTS; если GUI их не забирает,
+// вытесняются самые старые (журнал тревог и так показывает последние).
+//
+// Состояние устройств разложено по DEVICE_SHARDS сегментам, как в
+// DeviceStats, со своим замком и своей ссылкой на набор правил: потоки
+// конвейера с разными сегментами проверяют правила одновременно.
+// parse() заменяет правила во всех сегментах по очереди.
+class AlarmRules {
+public:
+    static const size_t MAX_EVENTS = 4096;
+
+    AlarmRules();
+
+    // Заменяет набор правил; при ошибке старые правила остаются в силе
+    bool parse(const std::string& text, std::string* error);
+    bool load_file(const std::string& path, std::string* error);
+
+    // Поток чтения: проверка всех правил для декодированного пакета
+    void evaluate(uint32_t id, const float values[STAT_FIELD_COUNT], uint64_t now_us);
+    // Пачка пакетов; подряд идущие пакеты одного сегмента - под одной
+    // блокировкой
+    void evaluate(const uint32_t* ids, const float (*values)[STAT_FIELD_COUNT], const uint64_t* now_us,
+                  size_t count);
+
+    // Поток GUI: забирает накопленные события одной пачкой
+    std::vector<AlarmEvent> take_events();
+    // Очередь событий: потерянные при переполнении - dropped
+    QueueStats event_stats() const { return events.stats(); }
+
+    size_t rule_count() const;
+    uint64_t evaluation_count() const;
+    uint64_t suppressed_count() const;
+    void clear_state();
+
+private:
+    enum OpCode : uint8_t {
+        OP_FIELD,
+        OP_RATE,
+        OP_CONST,
+        OP_ABS,
+        OP_LT,
+        OP_LE,
+        OP_GT,
+        OP_GE,
+        OP_EQ,
+        OP_NE,
+        OP_AND,
+        OP_OR
+    };
+
+    struct Instr {
+        uint8_t op;
+        uint8_t field;
+        float value;        // константа для срабатывания
+        float hold_value;   // константа для удержания (с учетом гистерезиса)
+    };
+
+    struct IdRange {
+        uint32_t lo;
+        uint32_t hi;
+    };
+
+    struct Rule {
+        std::string name;
+        std::vector<Instr> code;
+        uint32_t consecutive;
+        float hysteresis;
+        std::vector<IdRange> selector;  // пусто - все устройства
+        double limit_per_min;           // 0 - без ограничения
+    };
+
+    // Состояние правила для одного устройства
+    struct RuleState {
+        uint32_t streak;
+        bool active;
+        bool reported;                  // событие о срабатывании ушло
+        float tokens;                   // корзина limit N/min
+        uint64_t last_refill_us;
+    };
+
+    struct DeviceState {
+        float prev[STAT_FIELD_COUNT];
+        uint64_t prev_us;
+        std::vector<RuleState> rules;
+    };
+
+    static const int MAX_STACK = 16;
+
+    typedef std::vector<Rule> RuleSet;
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::shared_ptr<const RuleSet> rules;
+        std::unordered_map<uint32_t, DeviceState> devices;
+        uint64_t evaluations = 0;
+        uint64_t suppressed = 0;
+    };
+
+    class Parser;
+
+    bool run(const Rule& rule, bool hold, const float* values, const float* rates) const;
+    static bool selected(const Rule& rule, uint32_t id);
+    static bool allow_event(const Rule& rule, RuleState& st, uint64_t now_us);
+    void push_event(const Rule& rule, uint32_t id, bool raised, const float* values, uint64_t now_us);
+    void evaluate_locked(Shard& sh, uint32_t id, const float values[STAT_FIELD_COUNT], uint64_t now_us);
+
+    Shard shards[DEVICE_SHARDS];
+    BoundedQueue<AlarmEvent> events;   // своя блокировка: GUI не ждет разбора правил
+};
+
+#endif
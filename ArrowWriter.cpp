@@ -0,0 +1,474 @@
+#include "ArrowWriter.h"
+#include <string.h>
+#include <memory>
+#include <algorithm>
+
+// ========== Минимальный построитель flatbuffers ==========
+//
+// Объекты описываются деревом узлов и сериализуются от корня к листьям:
+// таблица пишется раньше вложенных объектов, поэтому все смещения
+// (uoffset) направлены вперед, как того требует формат. Таблицу
+// предваряет ее vtable.
+
+namespace {
+
+struct FbNode;
+typedef std::shared_ptr<FbNode> FbRef;
+
+struct FbField {
+    int id;
+    int size;           // размер скаляра; 0 - смещение на вложенный объект
+    uint64_t value;
+    FbRef child;
+};
+
+struct FbNode {
+    enum Kind { TABLE, STRING, STRUCTS, TABLES } kind;
+    std::vector<FbField> fields;    // TABLE
+    std::string text;               // STRING
+    std::vector<uint8_t> raw;       // STRUCTS: элементы подряд
+    uint32_t count;                 // STRUCTS
+    std::vector<FbRef> items;       // TABLES
+
+    explicit FbNode(Kind k) : kind(k), count(0) {}
+
+    FbNode& scalar(int id, int size, uint64_t value) {
+        fields.push_back(FbField{id, size, value, FbRef()});
+        return *this;
+    }
+    FbNode& child(int id, const FbRef& node) {
+        fields.push_back(FbField{id, 0, 0, node});
+        return *this;
+    }
+};
+
+FbRef fb_table() {
+    return std::make_shared<FbNode>(FbNode::TABLE);
+}
+
+FbRef fb_string(const std::string& s) {
+    FbRef n = std::make_shared<FbNode>(FbNode::STRING);
+    n->text = s;
+    return n;
+}
+
+FbRef fb_structs(const void* data, size_t elem_size, uint32_t count) {
+    FbRef n = std::make_shared<FbNode>(FbNode::STRUCTS);
+    n->raw.assign((const uint8_t*)data, (const uint8_t*)data + elem_size * count);
+    n->count = count;
+    return n;
+}
+
+FbRef fb_tables(const std::vector<FbRef>& items) {
+    FbRef n = std::make_shared<FbNode>(FbNode::TABLES);
+    n->items = items;
+    return n;
+}
+
+class FbSerializer {
+public:
+    explicit FbSerializer(std::vector<uint8_t>& out) : buf(out) {}
+
+    void finish(const FbRef& root) {
+        buf.clear();
+        put_u32(0);
+        size_t root_pos = write(*root);
+        patch_u32(0, (uint32_t)root_pos);
+        pad_to(8, 0);
+    }
+
+private:
+    void pad_to(size_t align, size_t remainder) {
+        while (buf.size() % align != remainder) {
+            buf.push_back(0);
+        }
+    }
+
+    void put(const void* data, size_t size) {
+        buf.insert(buf.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+    }
+
+    void put_u32(uint32_t v) {
+        put(&v, 4);
+    }
+
+    void patch_u32(size_t pos, uint32_t v) {
+        memcpy(&buf[pos], &v, 4);
+    }
+
+    size_t write(const FbNode& node) {
+        switch (node.kind) {
+            case FbNode::STRING: {
+                pad_to(4, 0);
+                size_t pos = buf.size();
+                put_u32((uint32_t)node.text.size());
+                put(node.text.data(), node.text.size());
+                buf.push_back(0);
+                return pos;
+            }
+            case FbNode::STRUCTS: {
+                // Элементы (структуры Arrow) выравниваются по 8 байт
+                pad_to(8, 4);
+                size_t pos = buf.size();
+                put_u32(node.count);
+                put(node.raw.data(), node.raw.size());
+                return pos;
+            }
+            case FbNode::TABLES: {
+                pad_to(4, 0);
+                size_t pos = buf.size();
+                put_u32((uint32_t)node.items.size());
+                size_t slots = buf.size();
+                buf.resize(buf.size() + 4 * node.items.size(), 0);
+                for (size_t i = 0; i < node.items.size(); i++) {
+                    size_t item = write(*node.items[i]);
+                    size_t slot = slots + 4 * i;
+                    patch_u32(slot, (uint32_t)(item - slot));
+                }
+                return pos;
+            }
+            case FbNode::TABLE:
+            default:
+                return write_table(node);
+        }
+    }
+
+    size_t write_table(const FbNode& node) {
+        // Поля по убыванию размера: так каждое оказывается выровненным
+        std::vector<const FbField*> order;
+        int max_id = -1;
+        for (const FbField& f : node.fields) {
+            order.push_back(&f);
+            max_id = std::max(max_id, f.id);
+        }
+        std::stable_sort(order.begin(), order.end(), [](const FbField* a, const FbField* b) {
+            return (a->size ? a->size : 4) > (b->size ? b->size : 4);
+        });
+
+        std::vector<uint16_t> field_offsets((size_t)(max_id + 1), 0);
+        std::vector<size_t> inline_pos(node.fields.size());
+        size_t inline_size = 4;
+        for (const FbField* f : order) {
+            size_t size = f->size ? (size_t)f->size : 4;
+            inline_size = (inline_size + size - 1) / size * size;
+            field_offsets[(size_t)f->id] = (uint16_t)inline_size;
+            inline_pos[(size_t)(f - node.fields.data())] = inline_size;
+            inline_size += size;
+        }
+
+        // vtable
+        pad_to(2, 0);
+        size_t vtable_pos = buf.size();
+        uint16_t vtable_size = (uint16_t)(4 + 2 * field_offsets.size());
+        uint16_t table_size = (uint16_t)inline_size;
+        put(&vtable_size, 2);
+        put(&table_size, 2);
+        put(field_offsets.data(), 2 * field_offsets.size());
+
+        // Таблица
+        pad_to(8, 0);
+        size_t table_pos = buf.size();
+        int32_t soffset = (int32_t)(table_pos - vtable_pos);
+        put(&soffset, 4);
+        buf.resize(table_pos + inline_size, 0);
+
+        for (size_t i = 0; i < node.fields.size(); i++) {
+            const FbField& f = node.fields[i];
+            if (f.size) {
+                memcpy(&buf[table_pos + inline_pos[i]], &f.value, (size_t)f.size);
+            }
+        }
+
+        for (size_t i = 0; i < node.fields.size(); i++) {
+            const FbField& f = node.fields[i];
+            if (!f.size) {
+                size_t child = write(*f.child);
+                size_t at = table_pos + inline_pos[i];
+                patch_u32(at, (uint32_t)(child - at));
+            }
+        }
+
+        return table_pos;
+    }
+
+    std::vector<uint8_t>& buf;
+};
+
+// ========== Метаданные Arrow ==========
+
+// Значения из Schema.fbs / Message.fbs
+enum {
+    METADATA_V5 = 4,
+
+    HEADER_SCHEMA = 1,
+    HEADER_RECORD_BATCH = 3,
+
+    TYPE_INT = 2,
+    TYPE_FLOATING_POINT = 3,
+    TYPE_UTF8 = 5,
+    TYPE_TIMESTAMP = 10,
+
+    PRECISION_SINGLE = 1,
+    TIME_UNIT_MILLISECOND = 1
+};
+
+const int COLUMN_COUNT = 9;
+
+struct FieldNode {
+    int64_t length;
+    int64_t null_count;
+};
+
+struct BufferSpec {
+    int64_t offset;
+    int64_t length;
+};
+
+FbRef int_type(int bits, bool is_signed) {
+    FbRef t = fb_table();
+    t->scalar(0, 4, (uint64_t)bits).scalar(1, 1, is_signed ? 1 : 0);
+    return t;
+}
+
+FbRef field(const char* name, bool nullable, int type_id, const FbRef& type) {
+    FbRef f = fb_table();
+    f->child(0, fb_string(name))
+            .scalar(1, 1, nullable ? 1 : 0)
+            .scalar(2, 1, (uint64_t)type_id)
+            .child(3, type)
+            .child(5, fb_tables({}));
+    return f;
+}
+
+FbRef build_schema() {
+    FbRef timestamp = fb_table();
+    timestamp->scalar(0, 2, TIME_UNIT_MILLISECOND).child(1, fb_string("UTC"));
+
+    FbRef float32 = fb_table();
+    float32->scalar(0, 2, PRECISION_SINGLE);
+
+    std::vector<FbRef> fields = {
+            field("time", false, TYPE_TIMESTAMP, timestamp),
+            field("id", false, TYPE_INT, int_type(32, false)),
+            field("type", true, TYPE_INT, int_type(8, false)),
+            field("pressure_bar", false, TYPE_FLOATING_POINT, float32),
+            field("temperature_c", false, TYPE_INT, int_type(16, true)),
+            field("voltage_v", false, TYPE_FLOATING_POINT, float32),
+            field("fw_version", true, TYPE_INT, int_type(8, false)),
+            field("rssi", false, TYPE_INT, int_type(16, true)),
+            field("source", true, TYPE_UTF8, fb_table()),
+    };
+
+    FbRef schema = fb_table();
+    schema->scalar(0, 2, 0).child(1, fb_tables(fields));
+    return schema;
+}
+
+FbRef build_message(int header_type, const FbRef& header, int64_t body_length) {
+    FbRef m = fb_table();
+    m->scalar(0, 2, METADATA_V5)
+            .scalar(1, 1, (uint64_t)header_type)
+            .child(2, header)
+            .scalar(3, 8, (uint64_t)body_length);
+    return m;
+}
+
+const char ARROW_MAGIC[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+
+size_t padding8(size_t n) {
+    return (8 - n % 8) % 8;
+}
+
+} // namespace
+
+// ========== Запись файла ==========
+
+ArrowWriter::ArrowWriter() : file(nullptr), offset(0), row_count(0), failed(false) {
+}
+
+ArrowWriter::~ArrowWriter() {
+    close();
+}
+
+bool ArrowWriter::put(const void* data, size_t size) {
+    if (size && fwrite(data, 1, size, file) != size) {
+        failed = true;
+    }
+    offset += size;
+    return !failed;
+}
+
+bool ArrowWriter::put_padding(size_t size) {
+    static const uint8_t zeros[8] = {0};
+    return put(zeros, size);
+}
+
+bool ArrowWriter::write_message(const std::vector<uint8_t>& metadata, Block* block) {
+    // Сообщение: маркер продолжения, длина метаданных, метаданные
+    // (дополненные до 8 байт), затем тело
+    uint32_t continuation = 0xFFFFFFFFu;
+    int32_t length = (int32_t)(metadata.size() + padding8(metadata.size()));
+
+    if (block) {
+        block->offset = (int64_t)offset;
+        block->metadata_length = length + 8;
+        block->padding = 0;
+    }
+
+    put(&continuation, 4);
+    put(&length, 4);
+    put(metadata.data(), metadata.size());
+    return put_padding(padding8(metadata.size()));
+}
+
+bool ArrowWriter::open(const std::string& path, std::string* error) {
+    close();
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        if (error) *error = "не удалось создать " + path;
+        return false;
+    }
+
+    current_path = path;
+    offset = 0;
+    row_count = 0;
+    blocks.clear();
+    failed = false;
+
+    std::vector<uint8_t> metadata;
+    FbSerializer(metadata).finish(build_message(HEADER_SCHEMA, build_schema(), 0));
+
+    put(ARROW_MAGIC, sizeof(ARROW_MAGIC));
+    write_message(metadata, nullptr);
+
+    if (failed) {
+        if (error) *error = "ошибка записи " + path;
+        return false;
+    }
+    return true;
+}
+
+bool ArrowWriter::write_batch(const PacketColumns& c) {
+    size_t n = c.size();
+    if (!file || n == 0) {
+        return !failed;
+    }
+
+    // Маски валидности (бит на строку) нужны только при наличии null
+    size_t mask_bytes = (n + 7) / 8;
+    int64_t type_nulls = 0;
+    int64_t source_nulls = 0;
+    type_validity.assign(mask_bytes, 0);
+    source_validity.assign(mask_bytes, 0);
+    source_offsets.resize(n + 1);
+    source_data.clear();
+
+    for (size_t i = 0; i < n; i++) {
+        if (c.type[i]) {
+            type_validity[i >> 3] |= (uint8_t)(1u << (i & 7));
+        } else {
+            type_nulls++;
+        }
+
+        source_offsets[i] = (int32_t)source_data.size();
+        uint16_t s = c.source[i];
+        if (s != PacketColumns::NO_SOURCE && s < c.sources.size()) {
+            source_validity[i >> 3] |= (uint8_t)(1u << (i & 7));
+            source_data += c.sources[s];
+        } else {
+            source_nulls++;
+        }
+    }
+    source_offsets[n] = (int32_t)source_data.size();
+
+    // Буферы тела в порядке столбцов: маска валидности, значения
+    struct Piece {
+        const void* data;
+        size_t length;
+    };
+    const Piece pieces[] = {
+            {nullptr, 0}, {c.time_ms.data(), n * 8},
+            {nullptr, 0}, {c.id.data(), n * 4},
+            {type_validity.data(), type_nulls ? mask_bytes : 0}, {c.type.data(), n},
+            {nullptr, 0}, {c.pressure_bar.data(), n * 4},
+            {nullptr, 0}, {c.temperature_c.data(), n * 2},
+            {nullptr, 0}, {c.voltage_v.data(), n * 4},
+            {type_validity.data(), type_nulls ? mask_bytes : 0}, {c.fw_version.data(), n},
+            {nullptr, 0}, {c.rssi.data(), n * 2},
+            {source_validity.data(), source_nulls ? mask_bytes : 0},
+            {source_offsets.data(), (n + 1) * 4},
+            {source_data.data(), source_data.size()},
+    };
+    const size_t piece_count = sizeof(pieces) / sizeof(pieces[0]);
+
+    BufferSpec specs[piece_count];
+    int64_t body_length = 0;
+    for (size_t i = 0; i < piece_count; i++) {
+        specs[i].offset = body_length;
+        specs[i].length = (int64_t)pieces[i].length;
+        body_length += (int64_t)(pieces[i].length + padding8(pieces[i].length));
+    }
+
+    FieldNode nodes[COLUMN_COUNT];
+    for (int i = 0; i < COLUMN_COUNT; i++) {
+        nodes[i].length = (int64_t)n;
+        nodes[i].null_count = 0;
+    }
+    nodes[2].null_count = type_nulls;
+    nodes[6].null_count = type_nulls;
+    nodes[8].null_count = source_nulls;
+
+    FbRef batch = fb_table();
+    batch->scalar(0, 8, (uint64_t)n)
+            .child(1, fb_structs(nodes, sizeof(FieldNode), COLUMN_COUNT))
+            .child(2, fb_structs(specs, sizeof(BufferSpec), (uint32_t)piece_count));
+
+    std::vector<uint8_t> metadata;
+    FbSerializer(metadata).finish(build_message(HEADER_RECORD_BATCH, batch, body_length));
+
+    Block block;
+    write_message(metadata, &block);
+    block.body_length = body_length;
+
+    // Столбцы пишутся напрямую из PacketColumns
+    for (size_t i = 0; i < piece_count; i++) {
+        put(pieces[i].data, pieces[i].length);
+        put_padding(padding8(pieces[i].length));
+    }
+
+    blocks.push_back(block);
+    row_count += n;
+    return !failed;
+}
+
+bool ArrowWriter::close() {
+    if (!file) {
+        return !failed;
+    }
+
+    // Конец потока сообщений
+    uint32_t eos[2] = {0xFFFFFFFFu, 0};
+    put(eos, sizeof(eos));
+
+    // Оглавление: схема и расположение пачек
+    FbRef footer = fb_table();
+    footer->scalar(0, 2, METADATA_V5)
+            .child(1, build_schema())
+            .child(2, fb_structs(nullptr, sizeof(Block), 0))
+            .child(3, fb_structs(blocks.data(), sizeof(Block), (uint32_t)blocks.size()));
+
+    std::vector<uint8_t> metadata;
+    FbSerializer(metadata).finish(footer);
+
+    int32_t footer_length = (int32_t)metadata.size();
+    put(metadata.data(), metadata.size());
+    put(&footer_length, 4);
+    put(ARROW_MAGIC, 6);
+
+    if (fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+    return !failed;
+}
@@ -0,0 +1,66 @@
+#ifndef ARROWWRITER_H
+#define ARROWWRITER_H
+
+#include "PacketDecoder.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Запись декодированных кадров в файл Arrow IPC (формат Feather v2),
+// который напрямую читают pyarrow, pandas и DuckDB.
+//
+// Каждый вызов write_batch() дает одну пачку записей (record batch):
+// столбцы PacketColumns пишутся в тело сообщения как есть, без
+// преобразования и копирования, поэтому выгрузка упирается в диск.
+// Метаданные (flatbuffers) формируются вручную, без зависимости от
+// библиотеки Arrow. Сжатие не используется.
+//
+// Столбцы: time (timestamp[ms, UTC]), id (uint32), type (uint8),
+// pressure_bar (float32), temperature_c (int16), voltage_v (float32),
+// fw_version (uint8), rssi (int16), source (utf8). Для точек истории
+// type, fw_version и source пустые (null).
+class ArrowWriter {
+public:
+    static const size_t BATCH_ROWS = 64 * 1024;
+
+    ArrowWriter();
+    ~ArrowWriter();
+
+    bool open(const std::string& path, std::string* error);
+    bool write_batch(const PacketColumns& columns);
+    // Дописывает оглавление файла; без него файл не читается
+    bool close();
+
+    bool is_open() const { return file != nullptr; }
+    uint64_t rows() const { return row_count; }
+    uint64_t bytes() const { return offset; }
+    const std::string& path() const { return current_path; }
+
+private:
+    struct Block {
+        int64_t offset;
+        int32_t metadata_length;
+        int32_t padding;
+        int64_t body_length;
+    };
+
+    bool put(const void* data, size_t size);
+    bool put_padding(size_t size);
+    bool write_message(const std::vector<uint8_t>& metadata, Block* block);
+
+    FILE* file;
+    std::string current_path;
+    uint64_t offset;
+    uint64_t row_count;
+    std::vector<Block> blocks;
+    bool failed;
+
+    // Рабочие буферы пачки
+    std::vector<uint8_t> type_validity;
+    std::vector<uint8_t> source_validity;
+    std::vector<int32_t> source_offsets;
+    std::string source_data;
+};
+
+#endif
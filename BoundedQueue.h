@@ -0,0 +1,274 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Что делать, когда потребитель не успевает и очередь заполнена
+enum QueuePolicy {
+    QUEUE_BLOCK = 0,        // производитель ждет места: без потерь
+    QUEUE_DROP_OLDEST,      // вытесняется самый старый элемент
+    QUEUE_DROP_NEWEST,      // новый элемент отбрасывается
+    QUEUE_COALESCE          // элемент с тем же ключом заменяется новым
+};
+
+inline const char* queue_policy_name(QueuePolicy policy) {
+    switch (policy) {
+        case QUEUE_BLOCK: return "ожидание";
+        case QUEUE_DROP_OLDEST: return "вытеснение старых";
+        case QUEUE_DROP_NEWEST: return "отброс новых";
+        case QUEUE_COALESCE: return "слияние по устройству";
+    }
+    return "?";
+}
+
+// Счетчики очереди; читаются из любого потока
+struct QueueStats {
+    QueuePolicy policy;
+    size_t capacity;
+    size_t size;
+    size_t high_water;          // наибольшая длина с последнего clear()
+    uint64_t pushed;            // принято от производителя
+    uint64_t taken;             // отдано потребителю
+    uint64_t dropped;           // потеряно при переполнении
+    uint64_t coalesced;         // заменено более новым с тем же ключом
+    uint64_t blocked;           // ожиданий места производителем
+};
+
+// Ограниченная очередь между производителем (поток чтения, стадия
+// агрегатов) и потребителем, который может не успевать (GUI, запись на
+// диск). Память выделяется один раз на capacity элементов, потребитель
+// забирает все накопленное одной пачкой (take).
+//
+// При заполнении - по политике:
+//   BLOCK       - push ждет, пока потребитель заберет пачку; в закрытой
+//                 (close) очереди не ждет и теряет новый элемент;
+//   DROP_OLDEST - вытесняется голова очереди;
+//   DROP_NEWEST - новый элемент не принимается;
+//   COALESCE    - элемент с тем же ключом (ID устройства), еще не
+//                 забранный, заменяется новым на своем месте; новый ключ
+//                 при заполненной очереди вытесняет голову. merged у
+//                 элемента - сколько принятых элементов он представляет;
+//                 merged вытесненного элемента не теряется, а добавляется
+//                 к следующему элементу с тем же ключом, так что сумма
+//                 merged по ключу равна числу принятых с этим ключом.
+// Потери и слияния считаются в stats().
+template <typename T>
+class BoundedQueue {
+public:
+    struct Entry {
+        T value;
+        uint64_t key;
+        uint32_t merged;        // 1 + заменено слиянием
+    };
+
+    BoundedQueue(size_t capacity, QueuePolicy policy)
+        : ring(capacity ? capacity : 1), head(0), count(0), first_seq(0), queue_policy(policy),
+          closed(false), high_water(0), pushed(0), taken(0), dropped(0), coalesced(0), blocked(0) {
+    }
+
+    // Смена политики будит ждущих производителей
+    void set_policy(QueuePolicy policy) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue_policy = policy;
+            if (policy != QUEUE_COALESCE) {
+                keys.clear();
+                evicted.clear();
+            } else {
+                index_keys();
+            }
+        }
+        space.notify_all();
+    }
+    QueuePolicy policy() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue_policy;
+    }
+
+    // Производитель. false - элемент не принят (DROP_NEWEST или BLOCK
+    // в закрытой очереди при заполнении)
+    bool push(const T& value, uint64_t key = 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return push_locked(lock, value, key);
+    }
+
+    // Пачка под одной блокировкой; item_keys[i] - ключ values[i].
+    // Возвращает число принятых элементов
+    size_t push(const T* values, const uint64_t* item_keys, size_t n) {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t accepted = 0;
+        for (size_t i = 0; i < n; i++) {
+            accepted += push_locked(lock, values[i], item_keys[i]) ? 1 : 0;
+        }
+        return accepted;
+    }
+
+    // Потребитель: все накопленное по порядку поступления в out (out
+    // очищается); возвращает число элементов
+    size_t take(std::vector<Entry>& out) {
+        out.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            out.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                out.push_back(ring[(head + i) % ring.size()]);
+            }
+            first_seq += count;
+            head = count = 0;
+            keys.clear();
+            taken += out.size();
+        }
+        space.notify_all();
+        return out.size();
+    }
+
+    // Закрытая очередь не ждет потребителя: ждущие в push производители
+    // возвращаются, при BLOCK новые элементы сверх capacity теряются.
+    // Для остановки, когда потребитель может больше не забирать;
+    // open() - снова ждать
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        space.notify_all();
+    }
+    void open() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = false;
+    }
+
+    // Отбрасывает накопленное и сбрасывает счетчики
+    void clear() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            first_seq += count;
+            head = count = 0;
+            keys.clear();
+            evicted.clear();
+            high_water = 0;
+            pushed = taken = dropped = coalesced = blocked = 0;
+        }
+        space.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    QueueStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        QueueStats s;
+        s.policy = queue_policy;
+        s.capacity = ring.size();
+        s.size = count;
+        s.high_water = high_water;
+        s.pushed = pushed;
+        s.taken = taken;
+        s.dropped = dropped;
+        s.coalesced = coalesced;
+        s.blocked = blocked;
+        return s;
+    }
+
+private:
+    bool push_locked(std::unique_lock<std::mutex>& lock, const T& value, uint64_t key) {
+        pushed++;
+
+        if (queue_policy == QUEUE_COALESCE) {
+            auto it = keys.find(key);
+            if (it != keys.end()) {
+                Entry& e = ring[(head + (size_t)(it->second - first_seq)) % ring.size()];
+                e.value = value;
+                e.merged++;
+                coalesced++;
+                return true;
+            }
+        }
+
+        if (count == ring.size()) {
+            if (queue_policy == QUEUE_BLOCK && !closed) {
+                blocked++;
+                space.wait(lock, [this]() {
+                    return count < ring.size() || closed || queue_policy != QUEUE_BLOCK;
+                });
+            }
+            if (count == ring.size()) {
+                if (queue_policy == QUEUE_DROP_NEWEST || queue_policy == QUEUE_BLOCK) {
+                    dropped++;
+                    return false;
+                }
+                pop_front();
+                dropped++;
+            }
+        }
+
+        Entry& e = ring[(head + count) % ring.size()];
+        e.value = value;
+        e.key = key;
+        e.merged = 1;
+        if (queue_policy == QUEUE_COALESCE) {
+            keys[key] = first_seq + count;
+            auto it = evicted.find(key);
+            if (it != evicted.end()) {
+                e.merged += it->second;
+                evicted.erase(it);
+            }
+        }
+        count++;
+        if (count > high_water) {
+            high_water = count;
+        }
+        return true;
+    }
+
+    void pop_front() {
+        if (queue_policy == QUEUE_COALESCE) {
+            auto it = keys.find(ring[head].key);
+            if (it != keys.end() && it->second == first_seq) {
+                keys.erase(it);
+            }
+            evicted[ring[head].key] += ring[head].merged;
+        }
+        head = (head + 1) % ring.size();
+        count--;
+        first_seq++;
+    }
+
+    // Индекс ключей по уже лежащим элементам (переход на слияние)
+    void index_keys() {
+        keys.clear();
+        for (size_t i = 0; i < count; i++) {
+            keys[ring[(head + i) % ring.size()].key] = first_seq + i;
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::condition_variable space;
+    std::vector<Entry> ring;
+    size_t head;
+    size_t count;
+    uint64_t first_seq;         // номер элемента в голове
+    // Ключ -> номер элемента; только при QUEUE_COALESCE
+    std::unordered_map<uint64_t, uint64_t> keys;
+    // Ключ -> merged вытесненных элементов, еще не переданных потребителю;
+    // растет не больше числа различных ключей (устройств)
+    std::unordered_map<uint64_t, uint32_t> evicted;
+    QueuePolicy queue_policy;
+    bool closed;                // BLOCK не ждет
+
+    size_t high_water;
+    uint64_t pushed;
+    uint64_t taken;
+    uint64_t dropped;
+    uint64_t coalesced;
+    uint64_t blocked;
+};
+
+#endif
@@ -0,0 +1,625 @@
+#include "ByteSource.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+static void set_error(std::string* error, const std::string& text) {
+    if (error) *error = text;
+}
+
+static int read_fd(int fd, uint8_t* data, size_t size) {
+#ifdef _WIN32
+    int n = _read(fd, data, (unsigned)size);
+#else
+    ssize_t n = ::read(fd, data, size);
+#endif
+    return n < 0 ? -errno : (int)n;
+}
+
+// ---------------------------------------------------------------------------
+
+ByteSource::ByteSource(size_t buffer_size)
+    : buffer_(buffer_size), bytes_(0), reads_(0), max_read_(0), opens_(0), failures_(0),
+      open_(false), finished_(false) {
+}
+
+bool ByteSource::open(std::string* error) {
+    close();
+    if (!open_source(error)) {
+        failures_.store(failures_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+    opens_.store(opens_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    open_.store(true, std::memory_order_relaxed);
+    finished_.store(false, std::memory_order_relaxed);
+    return true;
+}
+
+void ByteSource::close() {
+    if (open_.load(std::memory_order_relaxed)) {
+        close_source();
+        open_.store(false, std::memory_order_relaxed);
+    }
+}
+
+int ByteSource::read(const uint8_t** data) {
+    *data = buffer_.data();
+    return completed(read_some(buffer_.data(), buffer_.size()), buffer_.data());
+}
+
+int ByteSource::completed(int result, uint8_t* data) {
+    if (result > 0) {
+        // Счетчики - по байтам линии, вместе со служебными
+        bytes_.store(bytes_.load(std::memory_order_relaxed) + (uint64_t)result, std::memory_order_relaxed);
+        reads_.store(reads_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if ((uint64_t)result > max_read_.load(std::memory_order_relaxed)) {
+            max_read_.store((uint64_t)result, std::memory_order_relaxed);
+        }
+        int bytes = filter(data, result);
+        return bytes > 0 ? bytes : SOURCE_IDLE;
+    }
+    if (result == -EAGAIN || result == -EINTR || result == -EWOULDBLOCK) {
+        return SOURCE_IDLE;
+    }
+
+    int status = result == 0 ? zero_read() : SOURCE_ERROR;
+    if (status == SOURCE_ERROR) {
+        failures_.store(failures_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    if (status != SOURCE_IDLE && !reconnects()) {
+        finished_.store(true, std::memory_order_relaxed);
+    }
+    return status;
+}
+
+SourceStats ByteSource::stats() const {
+    SourceStats s;
+    s.bytes = bytes_.load(std::memory_order_relaxed);
+    s.reads = reads_.load(std::memory_order_relaxed);
+    s.max_read = max_read_.load(std::memory_order_relaxed);
+    s.opens = opens_.load(std::memory_order_relaxed);
+    s.failures = failures_.load(std::memory_order_relaxed);
+    s.open = open_.load(std::memory_order_relaxed);
+    s.finished = finished_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void ByteSource::clear_stats() {
+    bytes_.store(0, std::memory_order_relaxed);
+    reads_.store(0, std::memory_order_relaxed);
+    max_read_.store(0, std::memory_order_relaxed);
+    opens_.store(0, std::memory_order_relaxed);
+    failures_.store(0, std::memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------
+
+SerialSource::SerialSource() : fd_(-1) {
+}
+
+std::string SerialSource::describe() const {
+    return port_.found_port_name().empty() ? std::string("COM-порт") : port_.found_port_name();
+}
+
+int SerialSource::fd() const {
+#ifdef _WIN32
+    return -1;      // HANDLE, а не дескриптор для poll()
+#else
+    return fd_;
+#endif
+}
+
+bool SerialSource::open_source(std::string* error) {
+    // Сначала тот же порт без перебора
+    fd_ = port_.reopen_port();
+    if (fd_ < 0) {
+        fd_ = port_.search_port();
+    }
+    if (fd_ < 0) {
+        set_error(error, "COM-порт не найден");
+        return false;
+    }
+    return true;
+}
+
+void SerialSource::close_source() {
+    port_.close_port();
+    fd_ = -1;
+}
+
+int SerialSource::read_some(uint8_t* data, size_t size) {
+#ifdef _WIN32
+    // ReadFile возвращается не позже таймаута порта (50 мс)
+    DWORD got = 0;
+    if (!ReadFile((HANDLE)fd_, data, (DWORD)size, &got, NULL)) {
+        return GetLastError() == ERROR_IO_PENDING ? -EAGAIN : -EIO;
+    }
+    return (int)got;
+#else
+    return read_fd(fd_, data, size);
+#endif
+}
+
+int SerialSource::zero_read() {
+#ifdef _WIN32
+    return SOURCE_IDLE;     // таймаут ReadFile
+#else
+    // VMIN=0: пустое чтение - таймаут VTIME, если порт не закрыт
+    struct pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR))) {
+        return SOURCE_END;
+    }
+    return SOURCE_IDLE;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+
+FileSource::FileSource(const std::string& path) : ByteSource(64 * 1024), path_(path), fd_(-1) {
+}
+
+bool FileSource::open_source(std::string* error) {
+    fd_ = ::open(path_.c_str(), O_RDONLY | O_BINARY | O_CLOEXEC);
+    if (fd_ < 0) {
+        set_error(error, path_ + ": " + strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void FileSource::close_source() {
+    ::close(fd_);
+    fd_ = -1;
+}
+
+int FileSource::read_some(uint8_t* data, size_t size) {
+    return read_fd(fd_, data, size);
+}
+
+// ---------------------------------------------------------------------------
+
+PipeSource::PipeSource(const std::string& path) : ByteSource(64 * 1024), path_(path), fd_(-1) {
+}
+
+bool PipeSource::open_source(std::string* error) {
+    if (path_ == "-") {
+        fd_ = 0;
+        return true;
+    }
+#ifdef _WIN32
+    fd_ = ::open(path_.c_str(), O_RDONLY | O_BINARY);
+#else
+    // Без O_NONBLOCK open() канала ждет писателя и не дает остановить
+    // поток чтения; дальше ожидание - в poll()
+    fd_ = ::open(path_.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ >= 0) {
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_NONBLOCK);
+    }
+#endif
+    if (fd_ < 0) {
+        set_error(error, path_ + ": " + strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void PipeSource::close_source() {
+    if (fd_ > 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+}
+
+int PipeSource::read_some(uint8_t* data, size_t size) {
+    return read_fd(fd_, data, size);
+}
+
+// ---------------------------------------------------------------------------
+
+SocketSource::SocketSource(SourceKind kind, const std::string& host, int port)
+    : ByteSource(64 * 1024), host_(host), port_(port), kind_(kind), fd_(-1), connect_timeout_ms_(3000) {
+}
+
+std::string SocketSource::describe() const {
+    if (kind_ == SOURCE_UNIX) {
+        return "unix:" + host_;
+    }
+    bool v6 = host_.find(':') != std::string::npos;
+    return "tcp://" + (v6 ? "[" + host_ + "]" : host_) + ":" + std::to_string(port_);
+}
+
+#ifndef _WIN32
+// Неблокирующий connect() с ожиданием не дольше timeout_ms
+static int connect_socket(int family, const struct sockaddr* addr, socklen_t len, int timeout_ms, int* err) {
+    int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        *err = errno;
+        return -1;
+    }
+    // До connect(): от размера буфера зависит масштаб окна TCP
+    int rcvbuf = SocketSource::SOCKET_RCVBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if (connect(fd, addr, len) != 0) {
+        if (errno != EINPROGRESS) {
+            *err = errno;
+            ::close(fd);
+            return -1;
+        }
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        int r = poll(&pfd, 1, timeout_ms);
+        int so_error = 0;
+        socklen_t so_len = sizeof(so_error);
+        if (r <= 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &so_len) != 0 || so_error) {
+            *err = r == 0 ? ETIMEDOUT : so_error ? so_error : errno;
+            ::close(fd);
+            return -1;
+        }
+    }
+
+    if (family != AF_UNIX) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+#ifdef TCP_KEEPIDLE
+        int idle = 10, interval = 5, count = 3;
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#endif
+    }
+    return fd;
+}
+#endif
+
+bool SocketSource::open_source(std::string* error) {
+#ifdef _WIN32
+    set_error(error, "сетевые источники пока есть только в Linux");
+    return false;
+#else
+    int err = 0;
+    if (kind_ == SOURCE_UNIX) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (host_.empty() || host_.size() >= sizeof(addr.sun_path)) {
+            set_error(error, "неверный путь UNIX-сокета: " + host_);
+            return false;
+        }
+        memcpy(addr.sun_path, host_.c_str(), host_.size());
+        fd_ = connect_socket(AF_UNIX, (const struct sockaddr*)&addr, sizeof(addr), connect_timeout_ms_, &err);
+    } else {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* list = nullptr;
+        int gai = getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &list);
+        if (gai != 0) {
+            set_error(error, host_ + ": " + gai_strerror(gai));
+            return false;
+        }
+        fd_ = -1;
+        for (struct addrinfo* ai = list; ai && fd_ < 0; ai = ai->ai_next) {
+            fd_ = connect_socket(ai->ai_family, ai->ai_addr, ai->ai_addrlen, connect_timeout_ms_, &err);
+        }
+        freeaddrinfo(list);
+    }
+    if (fd_ < 0) {
+        set_error(error, describe() + ": " + strerror(err));
+        return false;
+    }
+    return true;
+#endif
+}
+
+void SocketSource::close_source() {
+#ifndef _WIN32
+    ::close(fd_);
+#endif
+    fd_ = -1;
+}
+
+int SocketSource::read_some(uint8_t* data, size_t size) {
+    return read_fd(fd_, data, size);
+}
+
+// ---------------------------------------------------------------------------
+
+// Telnet (RFC 854) и COM-PORT-OPTION (RFC 2217)
+static const uint8_t TN_SE = 240;
+static const uint8_t TN_SB = 250;
+static const uint8_t TN_WILL = 251;
+static const uint8_t TN_WONT = 252;
+static const uint8_t TN_DO = 253;
+static const uint8_t TN_DONT = 254;
+static const uint8_t TN_IAC = 255;
+static const uint8_t OPT_BINARY = 0;
+static const uint8_t OPT_SGA = 3;
+static const uint8_t OPT_COM_PORT = 44;
+
+static const uint8_t CPO_SET_BAUDRATE = 1;
+static const uint8_t CPO_SET_DATASIZE = 2;
+static const uint8_t CPO_SET_PARITY = 3;
+static const uint8_t CPO_SET_STOPSIZE = 4;
+static const uint8_t CPO_SET_CONTROL = 5;
+static const uint8_t CPO_NOTIFY_LINESTATE = 6;
+static const uint8_t CPO_SET_LINESTATE_MASK = 10;
+static const uint8_t CPO_SERVER_OFFSET = 100;   // ответы сервера: команда + 100
+
+// Биты состояния линии: переполнение, четность, кадр
+static const uint8_t LINESTATE_ERRORS = 0x02 | 0x04 | 0x08;
+
+// Опции, которые клиент включает сам и принимает от сервера
+static bool supported_option(uint8_t option) {
+    return option == OPT_BINARY || option == OPT_SGA || option == OPT_COM_PORT;
+}
+
+Rfc2217Source::Rfc2217Source(const std::string& host, int port, uint32_t baud)
+    : SocketSource(SOURCE_RFC2217, host, port), baud_(baud), state_(TELNET_DATA), option_command_(0),
+      sent_will_(0), sent_do_(0), settings_sent_(false), remote_baud_(0), line_errors_(0) {
+}
+
+std::string Rfc2217Source::describe() const {
+    bool v6 = host_.find(':') != std::string::npos;
+    return "rfc2217://" + (v6 ? "[" + host_ + "]" : host_) + ":" + std::to_string(port_) +
+           "?baud=" + std::to_string(baud_);
+}
+
+bool Rfc2217Source::open_source(std::string* error) {
+    if (!SocketSource::open_source(error)) {
+        return false;
+    }
+    // Новое соединение - новое согласование
+    state_ = TELNET_DATA;
+    sb_.clear();
+    sent_will_ = sent_do_ = 0;
+    settings_sent_ = false;
+    remote_baud_.store(0, std::memory_order_relaxed);
+
+    send_option(TN_WILL, OPT_BINARY);
+    send_option(TN_DO, OPT_BINARY);
+    send_option(TN_DO, OPT_SGA);
+    send_option(TN_WILL, OPT_COM_PORT);
+    return true;
+}
+
+void Rfc2217Source::send_bytes(const uint8_t* data, size_t size) {
+#ifdef _WIN32
+    (void)data;
+    (void)size;
+#else
+    // Команды короткие и уходят в пустой буфер передачи; неблокирующий
+    // сокет их не задерживает
+    if (send(fd(), data, size, MSG_NOSIGNAL) < 0) {
+        return;     // разрыв заметит чтение
+    }
+#endif
+}
+
+void Rfc2217Source::send_option(uint8_t command, uint8_t option) {
+    if (option < 32) {
+        uint32_t bit = 1u << option;
+        if (command == TN_WILL) {
+            if (sent_will_ & bit) return;
+            sent_will_ |= bit;
+        } else if (command == TN_DO) {
+            if (sent_do_ & bit) return;
+            sent_do_ |= bit;
+        }
+    }
+    uint8_t out[3] = {TN_IAC, command, option};
+    send_bytes(out, sizeof(out));
+}
+
+void Rfc2217Source::send_com_port(uint8_t command, uint32_t value, int size) {
+    // IAC SB COM-PORT-OPTION команда значение IAC SE; 0xFF в значении
+    // удваивается
+    uint8_t out[16];
+    size_t n = 0;
+    out[n++] = TN_IAC;
+    out[n++] = TN_SB;
+    out[n++] = OPT_COM_PORT;
+    out[n++] = command;
+    for (int i = size - 1; i >= 0; i--) {
+        uint8_t b = (uint8_t)(value >> (8 * i));
+        out[n++] = b;
+        if (b == TN_IAC) {
+            out[n++] = TN_IAC;
+        }
+    }
+    out[n++] = TN_IAC;
+    out[n++] = TN_SE;
+    send_bytes(out, n);
+}
+
+void Rfc2217Source::handle_option(uint8_t command, uint8_t option) {
+    switch (command) {
+    case TN_DO:
+        if (!supported_option(option)) {
+            send_option(TN_WONT, option);
+            break;
+        }
+        send_option(TN_WILL, option);
+        if (option == OPT_COM_PORT && !settings_sent_) {
+            // Сервер согласен: линия 8N1 без управления потоком
+            settings_sent_ = true;
+            send_com_port(CPO_SET_BAUDRATE, baud_, 4);
+            send_com_port(CPO_SET_DATASIZE, 8, 1);
+            send_com_port(CPO_SET_PARITY, 1, 1);
+            send_com_port(CPO_SET_STOPSIZE, 1, 1);
+            send_com_port(CPO_SET_CONTROL, 1, 1);
+            send_com_port(CPO_SET_LINESTATE_MASK, LINESTATE_ERRORS, 1);
+        }
+        break;
+    case TN_WILL:
+        send_option(supported_option(option) ? TN_DO : TN_DONT, option);
+        break;
+    default:
+        break;      // WONT и DONT: опция просто не работает
+    }
+}
+
+void Rfc2217Source::handle_subnegotiation() {
+    if (sb_.size() < 2 || sb_[0] != OPT_COM_PORT) {
+        return;
+    }
+    uint8_t command = sb_[1];
+    if (command == CPO_SERVER_OFFSET + CPO_SET_BAUDRATE && sb_.size() >= 6) {
+        uint32_t baud = ((uint32_t)sb_[2] << 24) | ((uint32_t)sb_[3] << 16) | ((uint32_t)sb_[4] << 8) | sb_[5];
+        remote_baud_.store(baud, std::memory_order_relaxed);
+    } else if (command == CPO_SERVER_OFFSET + CPO_NOTIFY_LINESTATE && sb_.size() >= 3) {
+        if (sb_[2] & LINESTATE_ERRORS) {
+            line_errors_.store(line_errors_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+}
+
+int Rfc2217Source::filter(uint8_t* data, int bytes) {
+    // Сжатие на месте: запись никогда не обгоняет чтение. Состояние
+    // переходит через границы чтений
+    int out = 0;
+    for (int i = 0; i < bytes; i++) {
+        uint8_t b = data[i];
+        switch (state_) {
+        case TELNET_DATA:
+            if (b == TN_IAC) {
+                state_ = TELNET_IAC;
+            } else {
+                data[out++] = b;
+            }
+            break;
+        case TELNET_IAC:
+            if (b == TN_IAC) {
+                data[out++] = b;
+                state_ = TELNET_DATA;
+            } else if (b >= TN_WILL) {
+                option_command_ = b;
+                state_ = TELNET_OPTION;
+            } else if (b == TN_SB) {
+                sb_.clear();
+                state_ = TELNET_SB;
+            } else {
+                state_ = TELNET_DATA;   // NOP, GA и прочие команды без параметров
+            }
+            break;
+        case TELNET_OPTION:
+            handle_option(option_command_, b);
+            state_ = TELNET_DATA;
+            break;
+        case TELNET_SB:
+            if (b == TN_IAC) {
+                state_ = TELNET_SB_IAC;
+            } else if (sb_.size() < 64) {
+                sb_.push_back(b);
+            }
+            break;
+        case TELNET_SB_IAC:
+            if (b == TN_SE) {
+                handle_subnegotiation();
+                state_ = TELNET_DATA;
+            } else if (b == TN_IAC) {
+                if (sb_.size() < 64) {
+                    sb_.push_back(b);
+                }
+                state_ = TELNET_SB;
+            } else {
+                state_ = TELNET_DATA;
+            }
+            break;
+        }
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+
+static bool starts_with(const std::string& s, const char* prefix) {
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// "узел:порт" или "[IPv6]:порт"
+static bool parse_host_port(const std::string& text, std::string* host, int* port) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    *host = text.substr(0, colon);
+    char* end = nullptr;
+    long value = strtol(text.c_str() + colon + 1, &end, 10);
+    if (host->size() > 2 && host->front() == '[' && host->back() == ']') {
+        *host = host->substr(1, host->size() - 2);
+    }
+    if (host->empty() || !end || *end || value <= 0 || value > 65535) {
+        return false;
+    }
+    *port = (int)value;
+    return true;
+}
+
+std::unique_ptr<ByteSource> make_byte_source(const std::string& address, std::string* error) {
+    if (address == "-" || address == "stdin") {
+        return std::unique_ptr<ByteSource>(new PipeSource("-"));
+    }
+    if (starts_with(address, "file:") && address.size() > 5) {
+        return std::unique_ptr<ByteSource>(new FileSource(address.substr(5)));
+    }
+    if (starts_with(address, "pipe:") && address.size() > 5) {
+        return std::unique_ptr<ByteSource>(new PipeSource(address.substr(5)));
+    }
+    if (starts_with(address, "unix:") && address.size() > 5) {
+        return std::unique_ptr<ByteSource>(new SocketSource(SOURCE_UNIX, address.substr(5)));
+    }
+    if (starts_with(address, "tcp://") || starts_with(address, "rfc2217://")) {
+        bool rfc2217 = starts_with(address, "rfc2217://");
+        std::string rest = address.substr(rfc2217 ? 10 : 6);
+        long baud = 9600;
+        size_t query = rest.find('?');
+        if (query != std::string::npos) {
+            std::string params = rest.substr(query + 1);
+            rest = rest.substr(0, query);
+            char* end = nullptr;
+            if (!rfc2217 || !starts_with(params, "baud=") ||
+                (baud = strtol(params.c_str() + 5, &end, 10)) <= 0 || *end) {
+                set_error(error, "ожидается rfc2217://узел:порт?baud=скорость");
+                return nullptr;
+            }
+        }
+        std::string host;
+        int port = 0;
+        if (!parse_host_port(rest, &host, &port)) {
+            set_error(error, rfc2217 ? "ожидается rfc2217://узел:порт" : "ожидается tcp://узел:порт");
+            return nullptr;
+        }
+        if (rfc2217) {
+            return std::unique_ptr<ByteSource>(new Rfc2217Source(host, port, (uint32_t)baud));
+        }
+        return std::unique_ptr<ByteSource>(new SocketSource(SOURCE_TCP, host, port));
+    }
+    set_error(error, "неизвестный адрес источника: " + address);
+    return nullptr;
+}
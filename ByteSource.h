@@ -0,0 +1,273 @@
+#ifndef BYTESOURCE_H
+#define BYTESOURCE_H
+
+#include "ComPort.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Откуда поток чтения берет байты
+enum SourceKind {
+    SOURCE_SERIAL = 0,      // COM-порт / tty
+    SOURCE_FILE,            // файл с сырыми кадрами (повтор записи)
+    SOURCE_PIPE,            // stdin или именованный канал (симулятор)
+    SOURCE_TCP,             // TCP-клиент (сетевой шлюз)
+    SOURCE_UNIX,            // UNIX-сокет (локальный шлюз, симулятор)
+    SOURCE_RFC2217          // сервер последовательных портов по RFC 2217
+};
+
+// Результат ByteSource::read() и completed(), кроме числа байтов
+enum {
+    SOURCE_IDLE = 0,        // данных пока нет (таймаут, EAGAIN)
+    SOURCE_END = -1,        // конец данных или разрыв соединения
+    SOURCE_ERROR = -2       // ошибка чтения
+};
+
+// Счетчики источника. Пишет поток чтения, читает кто угодно.
+struct SourceStats {
+    uint64_t bytes;         // принято всего
+    uint64_t reads;         // чтений с данными
+    uint64_t max_read;      // наибольшая порция за одно чтение
+    uint64_t opens;         // успешных открытий (подключений)
+    uint64_t failures;      // неудачных открытий и ошибок чтения
+    bool open;
+    bool finished;          // источник кончился и переоткрываться не будет
+};
+
+// Источник байтов для разбора кадров.
+//
+// Данные не копируются: read() читает в собственный буфер источника и
+// отдает указатель на него, кадры собираются прямо из этого буфера до
+// следующего read(). Для io_uring буфер кольца другой, и о прочитанном
+// источнику сообщает completed(). Служебные байты протокола поверх
+// потока (Telnet у RFC 2217) вырезаются на месте в том же буфере.
+//
+// Ожидание - снаружи: fd() отдается poll()/io_uring потока чтения. В
+// Windows у COM-порта дескриптора нет (fd() == -1), и read() сам ждет не
+// дольше таймаута порта.
+//
+// open(), close() и read() вызывает только поток чтения; stats() -
+// любой поток.
+class ByteSource {
+public:
+    explicit ByteSource(size_t buffer_size = 4096);
+    virtual ~ByteSource() {}
+
+    virtual SourceKind kind() const = 0;
+    // Для статуса и экспорта: имя порта, путь или адрес
+    virtual std::string describe() const = 0;
+
+    // false - не открылся, причина в *error
+    bool open(std::string* error = nullptr);
+    void close();
+    virtual int fd() const = 0;
+
+    // > 0 - байты в *data, иначе SOURCE_IDLE / SOURCE_END / SOURCE_ERROR
+    int read(const uint8_t** data);
+    // Чтение сделано снаружи (io_uring): result - байты в data или -errno;
+    // возвращает то же, что read(), данные остаются в data
+    int completed(int result, uint8_t* data);
+
+    // Источник на месте (USB-адаптер не выдернут)
+    virtual bool present() { return true; }
+    // После конца данных или тишины подключаться заново (порт, сокет),
+    // а не заканчивать чтение (файл, stdin)
+    virtual bool reconnects() const { return true; }
+
+    // Только для COM-порта: см. ComPortBase::set_low_latency
+    virtual void set_low_latency(bool) {}
+    virtual bool low_latency_active() const { return false; }
+
+    uint8_t* buffer() { return buffer_.data(); }
+    size_t buffer_size() const { return buffer_.size(); }
+
+    SourceStats stats() const;
+    // Сброс счетчиков (не состояния открытия)
+    void clear_stats();
+
+protected:
+    virtual bool open_source(std::string* error) = 0;
+    virtual void close_source() = 0;
+    // Байты или -errno
+    virtual int read_some(uint8_t* data, size_t size) = 0;
+    // read() вернул 0: у tty это и таймаут VTIME, и отключение
+    virtual int zero_read() { return SOURCE_END; }
+    // Принятые байты до разбора кадров; возвращает, сколько осталось
+    // в начале data
+    virtual int filter(uint8_t* data, int bytes) { (void)data; return bytes; }
+
+private:
+    std::vector<uint8_t> buffer_;
+
+    // Один писатель: без RMW
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> reads_;
+    std::atomic<uint64_t> max_read_;
+    std::atomic<uint64_t> opens_;
+    std::atomic<uint64_t> failures_;
+    std::atomic<bool> open_;
+    std::atomic<bool> finished_;
+};
+
+// COM-порт: тот же порт без перебора, иначе поиск по системе
+class SerialSource : public ByteSource {
+public:
+    SerialSource();
+    ~SerialSource() override { close(); }
+
+    // Скорость и имя порта настраиваются до подключения
+    ComPortBase& port() { return port_; }
+
+    SourceKind kind() const override { return SOURCE_SERIAL; }
+    std::string describe() const override;
+    int fd() const override;
+    bool present() override { return port_.port_present(); }
+    void set_low_latency(bool enabled) override { port_.set_low_latency(enabled); }
+    bool low_latency_active() const override { return port_.low_latency_active(); }
+
+protected:
+    bool open_source(std::string* error) override;
+    void close_source() override;
+    int read_some(uint8_t* data, size_t size) override;
+    int zero_read() override;
+
+private:
+    ComPortBase port_;
+    int fd_;
+};
+
+// Файл с сырыми кадрами: читается с начала до конца как можно быстрее
+class FileSource : public ByteSource {
+public:
+    explicit FileSource(const std::string& path);
+    ~FileSource() override { close(); }
+
+    SourceKind kind() const override { return SOURCE_FILE; }
+    std::string describe() const override { return "file:" + path_; }
+    int fd() const override { return fd_; }
+    bool reconnects() const override { return false; }
+
+protected:
+    bool open_source(std::string* error) override;
+    void close_source() override;
+    int read_some(uint8_t* data, size_t size) override;
+
+private:
+    std::string path_;
+    int fd_;
+};
+
+// stdin (путь "-") или именованный канал; канал после ухода писателя
+// открывается заново и ждет следующего
+class PipeSource : public ByteSource {
+public:
+    explicit PipeSource(const std::string& path = "-");
+    ~PipeSource() override { close(); }
+
+    SourceKind kind() const override { return SOURCE_PIPE; }
+    std::string describe() const override { return path_ == "-" ? std::string("stdin") : "pipe:" + path_; }
+    int fd() const override { return fd_; }
+    bool reconnects() const override { return path_ != "-"; }
+
+protected:
+    bool open_source(std::string* error) override;
+    void close_source() override;
+    int read_some(uint8_t* data, size_t size) override;
+
+private:
+    std::string path_;
+    int fd_;
+};
+
+// Потоковый сокет: TCP-клиент или UNIX-сокет.
+//
+// Сокет неблокирующий: и connect(), и чтения только после готовности в
+// poll()/io_uring потока чтения, как у локальных портов. У TCP выключен
+// Nagle, приемный буфер увеличен (SOCKET_RCVBUF) до подключения, чтобы
+// окно сразу было большим, и включен keepalive: пропавший сервер
+// замечается, даже если тишина короче stall_timeout.
+class SocketSource : public ByteSource {
+public:
+    static const int SOCKET_RCVBUF = 1024 * 1024;
+
+    // TCP: host и port; UNIX: путь сокета в host, port не нужен
+    SocketSource(SourceKind kind, const std::string& host, int port = 0);
+    ~SocketSource() override { close(); }
+
+    SourceKind kind() const override { return kind_; }
+    std::string describe() const override;
+    int fd() const override { return fd_; }
+
+    // Ожидание соединения при open(), мс
+    void set_connect_timeout(int timeout_ms) { connect_timeout_ms_ = timeout_ms; }
+
+protected:
+    bool open_source(std::string* error) override;
+    void close_source() override;
+    int read_some(uint8_t* data, size_t size) override;
+
+    std::string host_;
+    int port_;
+
+private:
+    SourceKind kind_;
+    int fd_;
+    int connect_timeout_ms_;
+};
+
+// Порт за сервером последовательных портов (Moxa NPort и т.п.) по
+// RFC 2217: Telnet с опцией COM-PORT-OPTION.
+//
+// После подключения согласуются BINARY и SUPPRESS-GO-AHEAD, на DO
+// COM-PORT-OPTION сервер получает скорость, 8N1 без управления потоком
+// и маску уведомлений об ошибках линии. Команды Telnet вырезаются из
+// потока в filter(), IAC IAC становится одним байтом 0xFF.
+// Без согласия сервера на COM-PORT-OPTION порт читается как есть, с
+// настройками самого сервера.
+class Rfc2217Source : public SocketSource {
+public:
+    Rfc2217Source(const std::string& host, int port, uint32_t baud);
+    ~Rfc2217Source() override { close(); }
+
+    SourceKind kind() const override { return SOURCE_RFC2217; }
+    std::string describe() const override;
+
+    // Скорость, подтвержденная сервером; 0 - не подтверждена
+    uint32_t remote_baud() const { return remote_baud_.load(std::memory_order_relaxed); }
+    // Уведомления сервера о переполнении, ошибке четности или кадра
+    uint64_t line_errors() const { return line_errors_.load(std::memory_order_relaxed); }
+
+protected:
+    bool open_source(std::string* error) override;
+    int filter(uint8_t* data, int bytes) override;
+
+private:
+    enum TelnetState { TELNET_DATA, TELNET_IAC, TELNET_OPTION, TELNET_SB, TELNET_SB_IAC };
+
+    void send_bytes(const uint8_t* data, size_t size);
+    void send_option(uint8_t command, uint8_t option);
+    void send_com_port(uint8_t command, uint32_t value, int size);
+    void handle_option(uint8_t command, uint8_t option);
+    void handle_subnegotiation();
+
+    uint32_t baud_;
+    TelnetState state_;
+    uint8_t option_command_;
+    std::vector<uint8_t> sb_;
+    uint32_t sent_will_;        // биты опций, на которые уже ушло WILL
+    uint32_t sent_do_;          // ... и DO
+    bool settings_sent_;
+
+    std::atomic<uint32_t> remote_baud_;
+    std::atomic<uint64_t> line_errors_;
+};
+
+// Источник по адресу: "tcp://host:port", "rfc2217://host:port?baud=N",
+// "unix:/path", "file:/path", "pipe:/path" или "-" (stdin). nullptr -
+// адрес не разобран.
+std::unique_ptr<ByteSource> make_byte_source(const std::string& address, std::string* error = nullptr);
+
+#endif
@@ -0,0 +1,589 @@
+// Офлайн-разбор файла захвата кадров (ECP1 или сырой поток с порта).
+//
+// Файл отображается в память и делится на непрерывные части по границам
+// кадров, по одной на поток. Каждый поток разбирает свою часть тем же
+// декодером, что и поток чтения порта (PacketDecoder), и копит
+// статистику устройств в собственных структурах - общих данных между
+// потоками нет, поэтому время разбора падает почти линейно с числом ядер.
+// В конце части объединяются по порядку: интервал между последним
+// пакетом устройства в одной части и первым в следующей учитывается
+// при объединении. С --filter в статистику попадают только кадры,
+// подходящие под выражение PacketFilter; маска считается по столбцам
+// каждого блока сразу после разбора.
+//
+// Использование: CaptureAnalyzer [-j потоков] [--raw] [--csv] [--filter выражение] файл
+
+#include "CaptureFile.h"
+#include "PacketDecoder.h"
+#include "PacketFilter.h"
+#include "PacketHistograms.h"
+#include "DeviceStats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Кадров в одном блоке пакетного разбора
+static const size_t BLOCK_FRAMES = 4096;
+// Сколько кадров вперед подгружается с диска
+static const uint64_t PREFETCH_FRAMES = 256 * 1024;
+// Интервал короче этого считается повтором того же пакета
+// (ретрансляция), как в LossEstimator
+static const int64_t DUPLICATE_US = 200000;
+// Сколько интервалов нужно для оценки периода передачи
+static const uint64_t MIN_INTERVALS = 4;
+// Предел числа устройств в части, как в PacketHistograms: сырой поток,
+// записанный не с начала кадра, дает случайные ID
+static const size_t MAX_DEVICES = PacketHistograms::MAX_DEVICES;
+
+struct FieldAcc {
+    float min;
+    float max;
+    double sum;
+    double sum_sq;
+};
+
+struct DeviceAcc {
+    uint32_t id;
+    uint8_t type;           // последний известный тип (0xF0/0xF1), иначе 0
+    uint8_t fw_version;
+    uint64_t packets;
+    uint64_t duplicates;
+    uint64_t first_frame;
+    uint64_t last_frame;
+    int64_t first_us;
+    int64_t last_us;        // последний пакет, не считая повторов
+    int64_t last_seen_us;
+    // Период передачи: наименьший интервал без повторов и сумма
+    // интервалов не длиннее полутора наименьших (без пропусков)
+    int64_t min_interval_us;    // 0 - интервалов еще не было
+    double period_sum_us;
+    uint64_t period_count;
+    FieldAcc fields[STAT_FIELD_COUNT];
+    IntervalHistogram::Counts intervals;   // только для распределения
+    RssiHistogram::Counts rssi;
+};
+
+// Результат одной части файла. Выравнивание по кэш-линии: соседние
+// части принадлежат разным потокам.
+struct alignas(64) PartResult {
+    std::unordered_map<uint32_t, uint32_t> slots;
+    std::deque<DeviceAcc> devices;
+    uint64_t frames = 0;
+    uint64_t selected = 0;      // кадры, прошедшие фильтр
+    uint64_t overflow = 0;      // кадры сверх MAX_DEVICES устройств
+};
+
+template<class Histogram>
+static inline void count_value(typename Histogram::Counts& counts, uint64_t v) {
+    if (v > Histogram::MAX_VALUE) v = Histogram::MAX_VALUE;
+    counts.buckets[Histogram::bucket_index(v)]++;
+    counts.total++;
+}
+
+// Период оценивается, как в LossEstimator, от наименьшего интервала, но
+// без квантования гистограммы: это среднее интервалов рядом с
+// наименьшим. Интервал через пропуск - не меньше двух периодов и в
+// среднее не попадает. Если новый наименьший интервал короче прежнего
+// больше чем на четверть, прежние интервалы были кратными периоду и
+// сумма начинается заново.
+static inline void record_period(DeviceAcc& d, int64_t dt) {
+    if (d.min_interval_us == 0 || dt < d.min_interval_us) {
+        if (d.min_interval_us != 0 && dt * 4 < d.min_interval_us * 3) {
+            d.period_sum_us = 0.0;
+            d.period_count = 0;
+        }
+        d.min_interval_us = dt;
+    }
+    if (dt * 2 < d.min_interval_us * 3) {
+        d.period_sum_us += (double)dt;
+        d.period_count++;
+    }
+}
+
+static inline void record_interval(DeviceAcc& d, int64_t time_us) {
+    int64_t dt = time_us - d.last_us;
+    if (dt < DUPLICATE_US) {
+        d.duplicates++;
+        return;
+    }
+    count_value<IntervalHistogram>(d.intervals, (uint64_t)dt);
+    record_period(d, dt);
+    d.last_us = time_us;
+}
+
+static DeviceAcc* device_for(PartResult& part, uint32_t id, uint32_t& last_id, DeviceAcc*& last) {
+    // Датчики часто шлют пакеты сериями (повторы через репитеры)
+    if (last && last_id == id) {
+        return last;
+    }
+    auto it = part.slots.find(id);
+    if (it == part.slots.end()) {
+        if (part.devices.size() >= MAX_DEVICES) {
+            return nullptr;
+        }
+        it = part.slots.emplace(id, (uint32_t)part.devices.size()).first;
+        part.devices.emplace_back();
+        DeviceAcc& d = part.devices.back();
+        d.id = id;
+        d.type = 0;
+        d.fw_version = 0;
+        d.packets = 0;
+        d.duplicates = 0;
+        d.first_frame = d.last_frame = 0;
+        d.first_us = d.last_us = d.last_seen_us = 0;
+        d.min_interval_us = 0;
+        d.period_sum_us = 0.0;
+        d.period_count = 0;
+        for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+            d.fields[f].min = INFINITY;
+            d.fields[f].max = -INFINITY;
+            d.fields[f].sum = 0.0;
+            d.fields[f].sum_sq = 0.0;
+        }
+    }
+    last_id = id;
+    last = &part.devices[it->second];
+    return last;
+}
+
+static void analyze_part(const CaptureFile* capture, const PacketFilter* filter, uint64_t begin, uint64_t end,
+                         PartResult* part) {
+    bool timed = capture->format() == CAPTURE_RECORDS;
+    PacketColumns columns;
+    columns.reserve(BLOCK_FRAMES);
+    std::vector<int64_t> times(BLOCK_FRAMES, 0);
+    std::vector<uint8_t> mask(BLOCK_FRAMES, 1);
+    bool filtered = !filter->empty();
+
+    uint32_t last_id = 0;
+    DeviceAcc* last = nullptr;
+    uint64_t prefetched = begin;
+
+    for (uint64_t block = begin; block < end; block += BLOCK_FRAMES) {
+        if (block >= prefetched) {
+            capture->prefetch(block, std::min(PREFETCH_FRAMES, end - block));
+            prefetched = block + PREFETCH_FRAMES;
+        }
+
+        size_t n = (size_t)std::min<uint64_t>(BLOCK_FRAMES, end - block);
+        columns.clear();
+        decode_packets(capture->frame(block), capture->stride(), n, nullptr, PacketColumns::NO_SOURCE, columns);
+        if (filtered) {
+            size_t selected = filter->evaluate(columns, 0, n, mask.data());
+            part->selected += selected;
+            if (selected == 0) {
+                continue;
+            }
+        } else {
+            part->selected += n;
+        }
+        if (timed) {
+            for (size_t i = 0; i < n; i++) {
+                times[i] = capture->time_us(block + i);
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (!mask[i]) {
+                continue;
+            }
+            DeviceAcc* device = device_for(*part, columns.id[i], last_id, last);
+            if (!device) {
+                part->overflow++;
+                continue;
+            }
+            DeviceAcc& d = *device;
+            uint64_t frame = block + i;
+
+            // Те же поля, что и в статистике потока чтения (Enod::handle_packet)
+            float values[STAT_FIELD_COUNT];
+            values[STAT_PRESSURE] = columns.pressure_bar[i];
+            values[STAT_TEMPERATURE] = (float)columns.temperature_c[i];
+            values[STAT_VOLTAGE] = columns.voltage_v[i];
+            values[STAT_RSSI] = (float)columns.rssi[i];
+            for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+                FieldAcc& a = d.fields[f];
+                if (values[f] < a.min) a.min = values[f];
+                if (values[f] > a.max) a.max = values[f];
+                a.sum += values[f];
+                a.sum_sq += (double)values[f] * values[f];
+            }
+
+            int rssi = columns.rssi[i];
+            count_value<RssiHistogram>(d.rssi, rssi >= 0 ? 0 : (uint64_t)(-rssi));
+
+            uint8_t type = columns.type[i];
+            if (type == PACKET_TYPE_SENSOR || type == PACKET_TYPE_REPEATER) {
+                d.type = type;
+            }
+            d.fw_version = columns.fw_version[i];
+
+            if (d.packets == 0) {
+                d.first_frame = frame;
+                d.first_us = d.last_us = times[i];
+            } else if (timed) {
+                record_interval(d, times[i]);
+            }
+            d.last_frame = frame;
+            if (times[i] > d.last_seen_us) {
+                d.last_seen_us = times[i];
+            }
+            d.packets++;
+        }
+    }
+    part->frames = end - begin;
+}
+
+// Складывает оценки периода двух частей; та, чей наименьший интервал
+// заметно длиннее, видела только кратные периоду интервалы
+static void merge_period(DeviceAcc& into, const DeviceAcc& next) {
+    if (next.min_interval_us == 0) {
+        return;
+    }
+    if (into.min_interval_us != 0 && into.min_interval_us * 4 < next.min_interval_us * 3) {
+        return;
+    }
+    if (into.min_interval_us == 0 || next.min_interval_us * 4 < into.min_interval_us * 3) {
+        into.min_interval_us = next.min_interval_us;
+        into.period_sum_us = next.period_sum_us;
+        into.period_count = next.period_count;
+        return;
+    }
+    into.min_interval_us = std::min(into.min_interval_us, next.min_interval_us);
+    into.period_sum_us += next.period_sum_us;
+    into.period_count += next.period_count;
+}
+
+// Добавляет следующую по времени часть к накопленному результату
+static void merge_device(DeviceAcc& into, const DeviceAcc& next, bool timed) {
+    if (timed) {
+        // Первый пакет следующей части - интервал от последнего в этой
+        int64_t dt = next.first_us - into.last_us;
+        if (dt < DUPLICATE_US) {
+            into.duplicates++;
+        } else {
+            count_value<IntervalHistogram>(into.intervals, (uint64_t)dt);
+            record_period(into, dt);
+        }
+        merge_period(into, next);
+    }
+    into.intervals.merge(next.intervals);
+    into.rssi.merge(next.rssi);
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        FieldAcc& a = into.fields[f];
+        const FieldAcc& b = next.fields[f];
+        a.min = std::min(a.min, b.min);
+        a.max = std::max(a.max, b.max);
+        a.sum += b.sum;
+        a.sum_sq += b.sum_sq;
+    }
+    if (next.type) {
+        into.type = next.type;
+    }
+    into.fw_version = next.fw_version;
+    into.packets += next.packets;
+    into.duplicates += next.duplicates;
+    into.last_frame = next.last_frame;
+    into.last_us = next.last_us;
+    into.last_seen_us = std::max(into.last_seen_us, next.last_seen_us);
+}
+
+// ---------------------------------------------------------------------------
+// Вывод
+
+struct DeviceReport {
+    const DeviceAcc* device;
+    double period_s;        // 0 - не оценен
+    uint64_t expected;
+    uint64_t missed;
+    double loss_rate;
+};
+
+static DeviceReport make_report(const DeviceAcc& d, bool timed) {
+    DeviceReport r;
+    r.device = &d;
+    r.period_s = 0.0;
+    r.expected = 0;
+    r.missed = 0;
+    r.loss_rate = 0.0;
+    if (!timed || d.intervals.total < MIN_INTERVALS || d.period_count == 0) {
+        return r;
+    }
+
+    double period_us = d.period_sum_us / (double)d.period_count;
+    r.period_s = period_us / 1e6;
+    r.expected = (uint64_t)llround((double)(d.last_us - d.first_us) / period_us) + 1;
+    uint64_t unique = d.packets - d.duplicates;
+    r.missed = r.expected > unique ? r.expected - unique : 0;
+    r.loss_rate = (double)r.missed / (double)r.expected;
+    return r;
+}
+
+static double field_mean(const DeviceAcc& d, int f) {
+    return d.packets ? d.fields[f].sum / (double)d.packets : 0.0;
+}
+
+static double field_stddev(const DeviceAcc& d, int f) {
+    if (d.packets < 2) {
+        return 0.0;
+    }
+    double m = field_mean(d, f);
+    double var = (d.fields[f].sum_sq - m * d.fields[f].sum) / (double)(d.packets - 1);
+    return var > 0.0 ? sqrt(var) : 0.0;
+}
+
+// RSSI в гистограмме хранится по модулю: процентиль уровня p - это
+// процентиль модуля 100 - p
+static int rssi_percentile(const DeviceAcc& d, double p) {
+    return -(int)d.rssi.value_at_percentile(100.0 - p);
+}
+
+static std::string format_seen(const DeviceAcc& d, bool timed, bool first) {
+    char text[40];
+    if (!timed) {
+        snprintf(text, sizeof(text), "#%llu", (unsigned long long)(first ? d.first_frame : d.last_frame));
+        return text;
+    }
+    int64_t us = first ? d.first_us : d.last_seen_us;
+    time_t secs = (time_t)(us / 1000000);
+    struct tm tm_utc;
+#ifdef _WIN32
+    gmtime_s(&tm_utc, &secs);
+#else
+    gmtime_r(&secs, &tm_utc);
+#endif
+    size_t n = strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &tm_utc);
+    snprintf(text + n, sizeof(text) - n, ".%03dZ", (int)(us / 1000 % 1000));
+    return text;
+}
+
+static const char* type_name(uint8_t type) {
+    if (type == PACKET_TYPE_SENSOR) return "sensor";
+    if (type == PACKET_TYPE_REPEATER) return "repeater";
+    return "unknown";
+}
+
+static void print_csv(const std::vector<DeviceReport>& reports, bool timed) {
+    static const char* field_names[STAT_FIELD_COUNT] = {"pressure", "temperature", "voltage", "rssi"};
+
+    printf("id,type,fw_version,packets,duplicates,expected,missed,loss_rate,period_s,first_seen,last_seen");
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        printf(",%s_min,%s_mean,%s_max,%s_stddev", field_names[f], field_names[f], field_names[f], field_names[f]);
+    }
+    printf(",rssi_p10,rssi_p50,rssi_p90\n");
+
+    for (const DeviceReport& r : reports) {
+        const DeviceAcc& d = *r.device;
+        printf("0x%08X,%s,%u,%llu,%llu,", d.id, type_name(d.type), d.fw_version,
+               (unsigned long long)d.packets, (unsigned long long)d.duplicates);
+        if (r.period_s > 0.0) {
+            printf("%llu,%llu,%.4f,%.3f,", (unsigned long long)r.expected, (unsigned long long)r.missed,
+                   r.loss_rate, r.period_s);
+        } else {
+            printf(",,,,");
+        }
+        printf("%s,%s", format_seen(d, timed, true).c_str(), format_seen(d, timed, false).c_str());
+        for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+            printf(",%.3f,%.3f,%.3f,%.3f", d.fields[f].min, field_mean(d, f), d.fields[f].max,
+                   field_stddev(d, f));
+        }
+        printf(",%d,%d,%d\n", rssi_percentile(d, 10), rssi_percentile(d, 50), rssi_percentile(d, 90));
+    }
+}
+
+// Столбец заголовка: printf считает ширину в байтах, а не в символах
+static void print_header_column(const char* text, int width, bool left) {
+    int chars = 0;
+    for (const char* p = text; *p; p++) {
+        if (((uint8_t)*p & 0xC0) != 0x80) chars++;
+    }
+    int pad = width > chars ? width - chars : 0;
+    if (left) {
+        printf("%s%*s ", text, pad, "");
+    } else {
+        printf("%*s%s ", pad, "", text);
+    }
+}
+
+static void print_table(const std::vector<DeviceReport>& reports, bool timed) {
+    print_header_column("ID", 10, true);
+    print_header_column("Тип", 8, true);
+    print_header_column("Вер", 3, false);
+    print_header_column("Пакетов", 10, false);
+    print_header_column("Повторы", 8, false);
+    print_header_column("Потери", 7, false);
+    print_header_column("Период,с", 8, false);
+    print_header_column("Первый", 24, true);
+    print_header_column("Последний", 24, true);
+    print_header_column("Давление мин/ср/макс", 23, true);
+    print_header_column("Темп. мин/ср/макс", 17, true);
+    print_header_column("Напр. мин/ср/макс", 20, true);
+    printf("RSSI мин/p10/p50/p90/макс\n");
+
+    for (const DeviceReport& r : reports) {
+        const DeviceAcc& d = *r.device;
+        char loss[16], period[16], pressure[40], temperature[40], voltage[40];
+        if (r.period_s > 0.0) {
+            snprintf(loss, sizeof(loss), "%.1f%%", r.loss_rate * 100.0);
+            snprintf(period, sizeof(period), "%.1f", r.period_s);
+        } else {
+            snprintf(loss, sizeof(loss), "-");
+            snprintf(period, sizeof(period), "-");
+        }
+        snprintf(pressure, sizeof(pressure), "%.3f/%.3f/%.3f", d.fields[STAT_PRESSURE].min,
+                 field_mean(d, STAT_PRESSURE), d.fields[STAT_PRESSURE].max);
+        snprintf(temperature, sizeof(temperature), "%.0f/%.1f/%.0f", d.fields[STAT_TEMPERATURE].min,
+                 field_mean(d, STAT_TEMPERATURE), d.fields[STAT_TEMPERATURE].max);
+        snprintf(voltage, sizeof(voltage), "%.3f/%.3f/%.3f", d.fields[STAT_VOLTAGE].min,
+                 field_mean(d, STAT_VOLTAGE), d.fields[STAT_VOLTAGE].max);
+
+        printf("0x%08X %-8s %3u %10llu %8llu %7s %8s %-24s %-24s %-23s %-17s %-20s %.0f/%d/%d/%d/%.0f\n",
+               d.id, type_name(d.type), d.fw_version,
+               (unsigned long long)d.packets, (unsigned long long)d.duplicates, loss, period,
+               format_seen(d, timed, true).c_str(), format_seen(d, timed, false).c_str(),
+               pressure, temperature, voltage,
+               d.fields[STAT_RSSI].min, rssi_percentile(d, 10), rssi_percentile(d, 50),
+               rssi_percentile(d, 90), d.fields[STAT_RSSI].max);
+    }
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Использование: CaptureAnalyzer [-j потоков] [--raw] [--csv] [--filter выражение] файл\n"
+            "  -j N         число потоков разбора (по умолчанию - число ядер)\n"
+            "  --raw        читать файл как сырой поток кадров по %u байт\n"
+            "  --csv        вывод в CSV\n"
+            "  --filter E   учитывать только кадры, подходящие под выражение, например\n"
+            "               \"type==sensor && rssi>-80 && id in 0x1A00..0x1AFF\"\n",
+            (unsigned)PACKET_SIZE);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned threads = std::thread::hardware_concurrency();
+    bool raw = false;
+    bool csv = false;
+    std::string filter_text;
+    std::string path;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--raw") == 0) {
+            raw = true;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter_text = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage();
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path.empty()) {
+        usage();
+        return 2;
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    PacketFilter filter;
+    std::string error;
+    if (!filter.compile(filter_text, &error)) {
+        fprintf(stderr, "CaptureAnalyzer: фильтр: %s\n", error.c_str());
+        return 2;
+    }
+
+    CaptureFile capture;
+    if (!capture.open(path, raw, &error)) {
+        fprintf(stderr, "CaptureAnalyzer: %s\n", error.c_str());
+        return 1;
+    }
+    capture.advise_sequential();
+    bool timed = capture.format() == CAPTURE_RECORDS;
+
+    auto started = std::chrono::steady_clock::now();
+
+    // Части одинакового размера, кратного блоку; мелкий файл - один поток
+    uint64_t count = capture.count();
+    uint64_t parts = std::max<uint64_t>(1, std::min<uint64_t>(threads, count / BLOCK_FRAMES));
+    uint64_t part_frames = (count + parts - 1) / parts;
+    part_frames = (part_frames + BLOCK_FRAMES - 1) / BLOCK_FRAMES * BLOCK_FRAMES;
+
+    std::vector<PartResult> results(parts);
+    std::vector<std::thread> workers;
+    for (uint64_t p = 0; p < parts; p++) {
+        uint64_t begin = std::min(count, p * part_frames);
+        uint64_t end = std::min(count, begin + part_frames);
+        workers.emplace_back(analyze_part, &capture, &filter, begin, end, &results[p]);
+    }
+    for (std::thread& t : workers) {
+        t.join();
+    }
+
+    // Объединение частей по порядку файла
+    std::unordered_map<uint32_t, DeviceAcc*> merged;
+    std::vector<DeviceAcc*> order;
+    uint64_t overflow = 0;
+    uint64_t selected = 0;
+    for (PartResult& part : results) {
+        overflow += part.overflow;
+        selected += part.selected;
+        for (DeviceAcc& d : part.devices) {
+            auto it = merged.find(d.id);
+            if (it == merged.end()) {
+                merged.emplace(d.id, &d);
+                order.push_back(&d);
+            } else {
+                merge_device(*it->second, d, timed);
+            }
+        }
+    }
+
+    std::vector<DeviceReport> reports;
+    reports.reserve(order.size());
+    for (DeviceAcc* d : order) {
+        reports.push_back(make_report(*d, timed));
+    }
+    std::sort(reports.begin(), reports.end(), [](const DeviceReport& a, const DeviceReport& b) {
+        return a.device->id < b.device->id;
+    });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    if (csv) {
+        print_csv(reports, timed);
+    } else {
+        print_table(reports, timed);
+    }
+
+    fprintf(stderr, "%s: %s, кадров %llu, устройств %zu, потоков %llu, %.3f с (%.1f млн кадров/с, %.0f МБ/с)\n",
+            path.c_str(), timed ? "ECP1" : "сырой поток", (unsigned long long)count, reports.size(),
+            (unsigned long long)parts, elapsed, elapsed > 0 ? count / elapsed / 1e6 : 0.0,
+            elapsed > 0 ? capture.size() / elapsed / (1024.0 * 1024.0) : 0.0);
+    if (!filter.empty()) {
+        fprintf(stderr, "Фильтр \"%s\": отобрано кадров %llu (%.1f%%)\n", filter.text().c_str(),
+                (unsigned long long)selected, count ? 100.0 * selected / count : 0.0);
+    }
+    if (overflow) {
+        fprintf(stderr, "Слишком много разных ID (больше %zu): %llu кадров пропущено. "
+                        "Сырой поток записан не с начала кадра?\n",
+                MAX_DEVICES, (unsigned long long)overflow);
+    }
+    if (capture.tail_bytes()) {
+        fprintf(stderr, "Неполный кадр в конце файла: %llu байт пропущено\n",
+                (unsigned long long)capture.tail_bytes());
+    }
+    return 0;
+}
@@ -0,0 +1,306 @@
+#include "CaptureFile.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char CAPTURE_MAGIC[4] = {'E', 'C', 'P', '1'};
+static const uint32_t CAPTURE_VERSION = 1;
+static const size_t CAPTURE_HEADER_SIZE = 32;
+
+// ---------------------------------------------------------------------------
+// Чтение
+
+CaptureFile::CaptureFile()
+    : view(nullptr), view_size(0),
+#ifdef _WIN32
+      file_handle(nullptr), mapping_handle(nullptr),
+#endif
+      file_format(CAPTURE_RAW), first_frame(nullptr), frame_stride(PACKET_SIZE),
+      frame_count(0), tail(0), capture_start_ms(0) {
+}
+
+CaptureFile::~CaptureFile() {
+    close();
+}
+
+bool CaptureFile::open(const std::string& path, bool raw, std::string* error) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        if (error) *error = "не удалось открыть " + path;
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        if (error) *error = "пустой файл захвата";
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* p = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!p) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        if (error) *error = "не удалось отобразить " + path;
+        return false;
+    }
+    file_handle = file;
+    mapping_handle = mapping;
+    view = p;
+    view_size = (size_t)size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (error) *error = "не удалось открыть " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        if (error) *error = "пустой файл захвата";
+        return false;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        if (error) *error = "не удалось отобразить " + path;
+        return false;
+    }
+    view = p;
+    view_size = (size_t)st.st_size;
+#endif
+
+    const uint8_t* data = (const uint8_t*)view;
+    uint32_t version = 0, record_size = 0, frame_size = 0;
+    if (view_size >= CAPTURE_HEADER_SIZE) {
+        memcpy(&version, data + 4, 4);
+        memcpy(&record_size, data + 8, 4);
+        memcpy(&frame_size, data + 12, 4);
+    }
+
+    if (!raw && view_size >= CAPTURE_HEADER_SIZE && memcmp(data, CAPTURE_MAGIC, 4) == 0) {
+        if (version != CAPTURE_VERSION || record_size != sizeof(CaptureRecord) || frame_size != PACKET_SIZE) {
+            close();
+            if (error) *error = "неподдерживаемая версия файла захвата";
+            return false;
+        }
+        file_format = CAPTURE_RECORDS;
+        memcpy(&capture_start_ms, data + 16, 8);
+        frame_stride = sizeof(CaptureRecord);
+        first_frame = data + CAPTURE_HEADER_SIZE + offsetof(CaptureRecord, frame);
+        frame_count = (view_size - CAPTURE_HEADER_SIZE) / frame_stride;
+        tail = (view_size - CAPTURE_HEADER_SIZE) % frame_stride;
+    } else {
+        file_format = CAPTURE_RAW;
+        frame_stride = PACKET_SIZE;
+        first_frame = data;
+        frame_count = view_size / PACKET_SIZE;
+        tail = view_size % PACKET_SIZE;
+    }
+    return true;
+}
+
+void CaptureFile::close() {
+    if (view) {
+#ifdef _WIN32
+        UnmapViewOfFile(view);
+        CloseHandle((HANDLE)mapping_handle);
+        CloseHandle((HANDLE)file_handle);
+        mapping_handle = nullptr;
+        file_handle = nullptr;
+#else
+        munmap(view, view_size);
+#endif
+    }
+    view = nullptr;
+    view_size = 0;
+    file_format = CAPTURE_RAW;
+    first_frame = nullptr;
+    frame_stride = PACKET_SIZE;
+    frame_count = 0;
+    tail = 0;
+    capture_start_ms = 0;
+}
+
+int64_t CaptureFile::time_us(uint64_t i) const {
+    if (file_format != CAPTURE_RECORDS) {
+        return 0;
+    }
+    int64_t t;
+    memcpy(&t, frame(i) - offsetof(CaptureRecord, frame) + offsetof(CaptureRecord, time_us), sizeof(t));
+    return t;
+}
+
+void CaptureFile::advise_sequential() {
+#ifndef _WIN32
+    if (view) {
+        madvise(view, view_size, MADV_SEQUENTIAL);
+    }
+#endif
+}
+
+void CaptureFile::advise_random() {
+#ifndef _WIN32
+    if (view) {
+        madvise(view, view_size, MADV_RANDOM);
+    }
+#endif
+}
+
+void CaptureFile::prefetch(uint64_t first, uint64_t n) const {
+    advise_range(first, n, true);
+}
+
+void CaptureFile::release(uint64_t first, uint64_t n) const {
+    advise_range(first, n, false);
+}
+
+void CaptureFile::advise_range(uint64_t first, uint64_t n, bool need) const {
+#ifndef _WIN32
+    if (!view || first >= frame_count) {
+        return;
+    }
+    if (n > frame_count - first) {
+        n = frame_count - first;
+    }
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)frame(first);
+    uintptr_t end = (uintptr_t)frame(first + n);
+    if (need) {
+        // madvise требует адрес, выровненный по странице; view выровнен
+        begin &= ~(page - 1);
+    } else {
+        // Освобождаются только страницы целиком внутри диапазона
+        begin = (begin + page - 1) & ~(page - 1);
+        end &= ~(page - 1);
+        if (end <= begin) {
+            return;
+        }
+    }
+    madvise((void*)begin, end - begin, need ? MADV_WILLNEED : MADV_DONTNEED);
+#else
+    (void)first;
+    (void)n;
+    (void)need;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Запись
+
+CaptureWriter::CaptureWriter()
+    : active(false), file(nullptr), last_flush_us(0), frame_total(0), failed(false) {
+}
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+bool CaptureWriter::open(const std::string& path, int64_t start_ms, std::string* error) {
+    close();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        if (error) *error = "не удалось создать " + path;
+        return false;
+    }
+
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    uint32_t record_size = sizeof(CaptureRecord);
+    uint32_t frame_size = PACKET_SIZE;
+    memcpy(header, CAPTURE_MAGIC, 4);
+    memcpy(header + 4, &CAPTURE_VERSION, 4);
+    memcpy(header + 8, &record_size, 4);
+    memcpy(header + 12, &frame_size, 4);
+    memcpy(header + 16, &start_ms, 8);
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        fclose(file);
+        file = nullptr;
+        if (error) *error = "ошибка записи " + path;
+        return false;
+    }
+
+    current_path = path;
+    buffer.clear();
+    buffer.reserve(BUFFER_RECORDS);
+    last_flush_us = 0;
+    frame_total = 0;
+    failed = false;
+    active.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void CaptureWriter::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    active.store(false, std::memory_order_relaxed);
+    if (file) {
+        flush_locked();
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void CaptureWriter::append(const uint8_t* frame, int64_t time_us) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file || failed) {
+        return;
+    }
+
+    buffer.emplace_back();
+    CaptureRecord& r = buffer.back();
+    r.time_us = time_us;
+    memcpy(r.frame, frame, PACKET_SIZE);
+    memset(r.reserved, 0, sizeof(r.reserved));
+    frame_total++;
+
+    if (last_flush_us == 0) {
+        last_flush_us = time_us;
+    }
+    if (buffer.size() >= BUFFER_RECORDS || time_us - last_flush_us >= FLUSH_INTERVAL_US) {
+        flush_locked();
+        last_flush_us = time_us;
+    }
+}
+
+void CaptureWriter::flush_locked() {
+    if (!file || buffer.empty()) {
+        return;
+    }
+    if (!failed) {
+        failed = fwrite(buffer.data(), sizeof(CaptureRecord), buffer.size(), file) != buffer.size() ||
+                 fflush(file) != 0;
+    }
+    buffer.clear();
+}
+
+uint64_t CaptureWriter::frames() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return frame_total;
+}
+
+uint64_t CaptureWriter::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return frame_total ? CAPTURE_HEADER_SIZE + frame_total * sizeof(CaptureRecord) : 0;
+}
+
+std::string CaptureWriter::path() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current_path;
+}
+
+bool CaptureWriter::write_error() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
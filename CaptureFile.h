@@ -0,0 +1,123 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include "PacketDecoder.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Запись кадров в файле захвата. Фиксированный размер: граница кадра
+// вычисляется по номеру, поэтому файл можно делить на части и читать
+// с любого места без разбора.
+struct CaptureRecord {
+    int64_t time_us;            // время приема, мкс от 1970-01-01 UTC
+    uint8_t frame[PACKET_SIZE];
+    uint8_t reserved[6];
+};
+
+static_assert(sizeof(CaptureRecord) == 40, "CaptureRecord layout");
+
+enum CaptureFormat {
+    CAPTURE_RECORDS = 0,        // заголовок "ECP1" и массив CaptureRecord
+    CAPTURE_RAW                 // поток кадров по PACKET_SIZE байт без времени
+};
+
+// Файл захвата, отображенный в память (только чтение).
+//
+// Формат ECP1: заголовок CAPTURE_HEADER_SIZE байт ("ECP1", версия,
+// размер записи, размер кадра, время начала записи), затем записи
+// CaptureRecord. Число записей в заголовке не хранится: файл только
+// дописывается, и после аварийного завершения остается читаемым.
+// Файл без заголовка считается сырым потоком с порта.
+// Неполная запись в конце файла пропускается (tail_bytes).
+class CaptureFile {
+public:
+    CaptureFile();
+    ~CaptureFile();
+
+    // raw - читать файл как сырой поток, даже если похож на ECP1
+    bool open(const std::string& path, bool raw, std::string* error);
+    void close();
+
+    bool is_open() const { return view != nullptr; }
+    CaptureFormat format() const { return file_format; }
+    uint64_t count() const { return frame_count; }
+    // Шаг между кадрами в байтах
+    size_t stride() const { return frame_stride; }
+    // Первый кадр; i-й кадр - frames() + i * stride()
+    const uint8_t* frames() const { return first_frame; }
+    const uint8_t* frame(uint64_t i) const { return first_frame + i * frame_stride; }
+    // Время приема i-го кадра в мкс (0 для сырого потока)
+    int64_t time_us(uint64_t i) const;
+    int64_t start_ms() const { return capture_start_ms; }
+    uint64_t size() const { return view_size; }
+    uint64_t tail_bytes() const { return tail; }
+
+    // Подсказка ядру о порядке чтения: последовательный (разбор целиком)
+    // или произвольный (просмотр)
+    void advise_sequential();
+    void advise_random();
+    // Заранее подгружает кадры [first, first + n) с диска
+    void prefetch(uint64_t first, uint64_t n) const;
+    // Снимает с процесса страницы кадров [first, first + n) после
+    // однократного прохода; данные остаются в кэше ОС
+    void release(uint64_t first, uint64_t n) const;
+
+private:
+    void advise_range(uint64_t first, uint64_t n, bool need) const;
+
+    void* view;
+    size_t view_size;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+    CaptureFormat file_format;
+    const uint8_t* first_frame;
+    size_t frame_stride;
+    uint64_t frame_count;
+    uint64_t tail;
+    int64_t capture_start_ms;
+};
+
+// Запись кадров в файл ECP1. Вызывается из потока чтения порта;
+// открытие и закрытие - из потока GUI. Записи копятся в буфере и
+// сбрасываются на диск при заполнении и не реже раза в секунду.
+class CaptureWriter {
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool open(const std::string& path, int64_t start_ms, std::string* error);
+    void close();
+
+    bool is_open() const { return active.load(std::memory_order_relaxed); }
+    void append(const uint8_t* frame, int64_t time_us);
+
+    uint64_t frames() const;
+    uint64_t bytes() const;
+    std::string path() const;
+    // Была ошибка записи; дальнейшие кадры не пишутся
+    bool write_error() const;
+
+private:
+    static const size_t BUFFER_RECORDS = 16 * 1024;
+    static const int64_t FLUSH_INTERVAL_US = 1000000;
+
+    void flush_locked();
+
+    mutable std::mutex mutex;
+    std::atomic<bool> active;
+    FILE* file;
+    std::string current_path;
+    std::vector<CaptureRecord> buffer;
+    int64_t last_flush_us;
+    uint64_t frame_total;
+    bool failed;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "CaptureIndex.h"
+#include <algorithm>
+
+// Сколько кадров проходится между освобождениями страниц файла
+static const uint64_t RELEASE_FRAMES = 64 * CaptureIndex::BLOCK_FRAMES;
+
+CaptureIndex::CaptureIndex()
+    : capture(nullptr), stopping(false), finished(false), indexed_frames(0), truncated(false) {
+}
+
+CaptureIndex::~CaptureIndex() {
+    cancel();
+}
+
+void CaptureIndex::build(const CaptureFile* file) {
+    cancel();
+
+    capture = file;
+    stopping.store(false);
+    finished.store(false);
+    indexed_frames.store(0);
+    device_map.clear();
+    truncated = false;
+
+    // Место под весь индекс выделяется заранее: фоновый поток только
+    // заполняет ячейки, читатели не видят перераспределений
+    uint64_t blocks = (capture->count() + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+    block_min_us.assign(blocks, 0);
+    block_max_us.assign(blocks, 0);
+
+    worker = std::thread(&CaptureIndex::background, this);
+}
+
+void CaptureIndex::cancel() {
+    stopping.store(true);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+double CaptureIndex::progress() const {
+    if (!capture || capture->count() == 0) {
+        return 1.0;
+    }
+    return (double)indexed() / (double)capture->count();
+}
+
+void CaptureIndex::background() {
+    uint64_t count = capture->count();
+    uint64_t released = 0;
+    int64_t running_max_us = INT64_MIN;
+    DecodedPacket decoded;
+
+    for (uint64_t block = 0; block * BLOCK_FRAMES < count; block++) {
+        if (stopping.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        uint64_t begin = block * BLOCK_FRAMES;
+        uint64_t end = std::min(count, begin + BLOCK_FRAMES);
+        int64_t min_us = INT64_MAX;
+        int64_t max_us = INT64_MIN;
+
+        for (uint64_t row = begin; row < end; row++) {
+            int64_t t = capture->time_us(row);
+            if (t < min_us) min_us = t;
+            if (t > max_us) max_us = t;
+
+            decode_packet(capture->frame(row), decoded);
+            auto it = device_map.find(decoded.id);
+            if (it == device_map.end()) {
+                if (device_map.size() >= MAX_DEVICES) {
+                    truncated = true;
+                    continue;
+                }
+                CaptureDeviceEntry entry;
+                entry.id = decoded.id;
+                entry.type = 0;
+                entry.count = 0;
+                entry.first_row = row;
+                entry.last_row = row;
+                it = device_map.emplace(decoded.id, entry).first;
+            }
+            CaptureDeviceEntry& e = it->second;
+            if (decoded.type == PACKET_TYPE_SENSOR || decoded.type == PACKET_TYPE_REPEATER) {
+                e.type = decoded.type;
+            }
+            e.count++;
+            e.last_row = row;
+        }
+
+        running_max_us = std::max(running_max_us, max_us);
+        block_min_us[block] = min_us;
+        block_max_us[block] = running_max_us;
+        indexed_frames.store(end, std::memory_order_release);
+
+        if (end - released >= RELEASE_FRAMES) {
+            capture->release(released, end - released);
+            released = end;
+        }
+    }
+    finished.store(true, std::memory_order_release);
+}
+
+uint64_t CaptureIndex::find_time(int64_t time_us) const {
+    if (!capture || capture->format() != CAPTURE_RECORDS) {
+        return NOT_FOUND;
+    }
+    uint64_t done = indexed();
+    uint64_t blocks = done / BLOCK_FRAMES;
+    if (done == capture->count()) {
+        blocks = block_max_us.size();
+    }
+
+    // Первый блок, где есть время не раньше искомого. block_max_us -
+    // максимум с начала файла, он не убывает и при скачках часов назад
+    auto first = block_max_us.begin();
+    auto it = std::lower_bound(first, first + blocks, time_us);
+    if (it == first + blocks) {
+        // Вне построенной части индекса: дальше просмотр по строкам
+        for (uint64_t row = blocks * BLOCK_FRAMES; row < capture->count(); row++) {
+            if (capture->time_us(row) >= time_us) {
+                return row;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    uint64_t begin = (uint64_t)(it - first) * BLOCK_FRAMES;
+    uint64_t end = std::min(capture->count(), begin + BLOCK_FRAMES);
+    for (uint64_t row = begin; row < end; row++) {
+        if (capture->time_us(row) >= time_us) {
+            return row;
+        }
+    }
+    return NOT_FOUND;
+}
+
+bool CaptureIndex::device(uint32_t id, CaptureDeviceEntry& out) const {
+    if (!ready()) {
+        return false;
+    }
+    auto it = device_map.find(id);
+    if (it == device_map.end()) {
+        return false;
+    }
+    out = it->second;
+    return true;
+}
+
+std::vector<CaptureDeviceEntry> CaptureIndex::devices() const {
+    std::vector<CaptureDeviceEntry> out;
+    if (!ready()) {
+        return out;
+    }
+    out.reserve(device_map.size());
+    for (const auto& item : device_map) {
+        out.push_back(item.second);
+    }
+    std::sort(out.begin(), out.end(), [](const CaptureDeviceEntry& a, const CaptureDeviceEntry& b) {
+        return a.id < b.id;
+    });
+    return out;
+}
@@ -0,0 +1,78 @@
+#ifndef CAPTUREINDEX_H
+#define CAPTUREINDEX_H
+
+#include "CaptureFile.h"
+#include "DeviceIndex.h"
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Устройство, встреченное в файле захвата
+struct CaptureDeviceEntry {
+    uint32_t id;
+    uint8_t type;           // последний известный тип (0xF0/0xF1), иначе 0
+    uint64_t count;
+    uint64_t first_row;
+    uint64_t last_row;
+};
+
+// Разреженный индекс файла захвата для просмотра и поиска.
+//
+// Строится фоновым потоком за один последовательный проход: для каждого
+// блока из BLOCK_FRAMES кадров хранится наименьшее и наибольшее время
+// приема, плюс список устройств с первой и последней строкой. Память
+// индекса - 16 байт на блок и запись на устройство, независимо от
+// размера файла; прочитанные страницы файла сразу отпускаются.
+//
+// Поиск по времени работает уже по построенной части индекса,
+// список устройств доступен после окончания построения.
+class CaptureIndex {
+public:
+    static const uint64_t BLOCK_FRAMES = 1024;
+    static const size_t MAX_DEVICES = MAX_TRACKED_DEVICES;
+    static const uint64_t NOT_FOUND = UINT64_MAX;
+
+    CaptureIndex();
+    ~CaptureIndex();
+
+    // Запускает построение; файл должен оставаться открытым до cancel()
+    void build(const CaptureFile* capture);
+    // Останавливает построение и дожидается потока
+    void cancel();
+
+    uint64_t indexed() const { return indexed_frames.load(std::memory_order_acquire); }
+    bool ready() const { return finished.load(std::memory_order_acquire); }
+    double progress() const;
+
+    // Первая строка с временем приема не раньше time_us. Время в захвате
+    // почти монотонно (возможны скачки часов), поэтому поиск двоичный по
+    // нарастающему максимуму блоков и точный внутри найденного блока.
+    uint64_t find_time(int64_t time_us) const;
+
+    // После ready()
+    bool device(uint32_t id, CaptureDeviceEntry& out) const;
+    std::vector<CaptureDeviceEntry> devices() const;
+    bool devices_truncated() const { return truncated; }
+
+private:
+    void background();
+
+    const CaptureFile* capture;
+    std::thread worker;
+    std::atomic<bool> stopping;
+    std::atomic<bool> finished;
+    std::atomic<uint64_t> indexed_frames;
+
+    // Пишет фоновый поток; блок i читается после indexed() > i * BLOCK_FRAMES.
+    // block_max_us - наибольшее время с начала файла по конец блока: по
+    // нему возможен двоичный поиск, даже если часы шли назад
+    std::vector<int64_t> block_min_us;
+    std::vector<int64_t> block_max_us;
+
+    std::unordered_map<uint32_t, CaptureDeviceEntry> device_map;
+    bool truncated;
+};
+
+#endif
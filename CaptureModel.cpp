@@ -0,0 +1,144 @@
+#include "CaptureModel.h"
+#include <QColor>
+#include <QDateTime>
+#include <QFont>
+#include <climits>
+
+CaptureModel::CaptureModel(const CaptureFile *capture, QObject *parent)
+        : QAbstractTableModel(parent), capture(capture), cachedRow(-1)
+{
+}
+
+int CaptureModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    // Число строк модели Qt ограничено int
+    uint64_t count = capture->count();
+    return count > (uint64_t)INT_MAX ? INT_MAX : (int)count;
+}
+
+int CaptureModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : COL_COUNT;
+}
+
+void CaptureModel::reload()
+{
+    beginResetModel();
+    cachedRow = -1;
+    endResetModel();
+}
+
+const DecodedPacket &CaptureModel::decoded(int row) const
+{
+    if (row != cachedRow) {
+        decode_packet(capture->frame((uint64_t)row), cachedPacket);
+        cachedRow = row;
+    }
+    return cachedPacket;
+}
+
+QString CaptureModel::typeText(uint8_t type)
+{
+    if (type == PACKET_TYPE_SENSOR) return "ДАТЧИК";
+    if (type == PACKET_TYPE_REPEATER) return "РЕПИТЕР";
+    return "НЕИЗВЕСТНО";
+}
+
+QString CaptureModel::hexDump(const uint8_t *frame)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    QString text;
+    text.reserve((int)PACKET_SIZE * 3);
+    for (size_t i = 0; i < PACKET_SIZE; i++) {
+        if (i) text += ' ';
+        text += QChar(digits[frame[i] >> 4]);
+        text += QChar(digits[frame[i] & 0xF]);
+    }
+    return text;
+}
+
+QString CaptureModel::timeText(int row) const
+{
+    if (capture->format() != CAPTURE_RECORDS) {
+        return "-";
+    }
+    int64_t us = capture->time_us((uint64_t)row);
+    return QDateTime::fromMSecsSinceEpoch(us / 1000).toString("yyyy-MM-dd HH:mm:ss.zzz");
+}
+
+QVariant CaptureModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+    int row = index.row();
+
+    if (role == Qt::DisplayRole) {
+        const DecodedPacket &p = decoded(row);
+        switch (index.column()) {
+            case COL_ROW: return QString::number(row);
+            case COL_TIME: return timeText(row);
+            case COL_TYPE: return typeText(p.type);
+            case COL_ID: return "0x" + QString("%1").arg(p.id, 8, 16, QChar('0')).toUpper();
+            case COL_VERSION: return QString::number(p.fw_version);
+            case COL_PRESSURE: return QString::number(p.pressure_bar, 'f', 3);
+            case COL_TEMPERATURE: return QString::number(p.temperature_c);
+            case COL_VOLTAGE: return QString::number(p.voltage_v, 'f', 3);
+            case COL_RSSI: return QString::number(p.rssi);
+            case COL_HEX: return hexDump(capture->frame((uint64_t)row));
+        }
+    } else if (role == Qt::FontRole && index.column() == COL_HEX) {
+        return QFont("Courier New", 9);
+    } else if (role == Qt::ForegroundRole && index.column() == COL_TYPE) {
+        uint8_t type = decoded(row).type;
+        if (type != PACKET_TYPE_SENSOR && type != PACKET_TYPE_REPEATER) {
+            return QColor(Qt::gray);
+        }
+    } else if (role == Qt::TextAlignmentRole && index.column() != COL_HEX) {
+        return int(Qt::AlignCenter);
+    }
+    return QVariant();
+}
+
+QVariant CaptureModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (section) {
+        case COL_ROW: return "№";
+        case COL_TIME: return "Время приема";
+        case COL_TYPE: return "Тип";
+        case COL_ID: return "ID устройства";
+        case COL_VERSION: return "Версия";
+        case COL_PRESSURE: return "Давление (бар)";
+        case COL_TEMPERATURE: return "Температура (°C)";
+        case COL_VOLTAGE: return "Напряжение (В)";
+        case COL_RSSI: return "RSSI";
+        case COL_HEX: return "HEX";
+    }
+    return QVariant();
+}
+
+QString CaptureModel::describe(int row) const
+{
+    if (row < 0 || row >= rowCount()) {
+        return QString();
+    }
+    const DecodedPacket &p = decoded(row);
+    return QString("Кадр %1 | %2 | %3 | ID: 0x%4 | Вер: %5 | Д: %6 бар | Т: %7°C | Н: %8В | RSSI: %9\n"
+                   "HEX: %10")
+            .arg(row)
+            .arg(timeText(row))
+            .arg(typeText(p.type))
+            .arg(QString("%1").arg(p.id, 8, 16, QChar('0')).toUpper())
+            .arg(p.fw_version)
+            .arg(p.pressure_bar, 0, 'f', 3)
+            .arg(p.temperature_c)
+            .arg(p.voltage_v, 0, 'f', 3)
+            .arg(p.rssi)
+            .arg(hexDump(capture->frame((uint64_t)row)));
+}
@@ -0,0 +1,59 @@
+#ifndef CAPTUREMODEL_H
+#define CAPTUREMODEL_H
+
+#include "CaptureFile.h"
+#include <QAbstractTableModel>
+#include <QString>
+
+// Таблица кадров файла захвата для QTableView. Строки не хранятся:
+// представление запрашивает только видимые ячейки, и каждый кадр
+// разбирается прямо из отображенного файла при обращении к нему.
+// Память не зависит от размера файла.
+class CaptureModel : public QAbstractTableModel
+{
+Q_OBJECT
+
+public:
+    enum Column {
+        COL_ROW = 0,
+        COL_TIME,
+        COL_TYPE,
+        COL_ID,
+        COL_VERSION,
+        COL_PRESSURE,
+        COL_TEMPERATURE,
+        COL_VOLTAGE,
+        COL_RSSI,
+        COL_HEX,
+        COL_COUNT
+    };
+
+    explicit CaptureModel(const CaptureFile *capture, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Файл открыт заново
+    void reload();
+
+    // Подробное описание кадра с полным HEX-дампом
+    QString describe(int row) const;
+    QString timeText(int row) const;
+
+    static QString typeText(uint8_t type);
+    static QString hexDump(const uint8_t *frame);
+
+private:
+    const DecodedPacket &decoded(int row) const;
+
+    const CaptureFile *capture;
+
+    // Представление запрашивает ячейки строки подряд: последний
+    // разобранный кадр запоминается
+    mutable int cachedRow;
+    mutable DecodedPacket cachedPacket;
+};
+
+#endif
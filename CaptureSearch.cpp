@@ -0,0 +1,114 @@
+#include "CaptureSearch.h"
+#include <algorithm>
+
+// Кадры разбираются блоками по столбцам и проверяются фильтром целиком;
+// между блоками проверяется отмена
+static const uint64_t SEARCH_BLOCK = 4 * PacketFilter::BLOCK_ROWS;
+
+CaptureSearch::CaptureSearch()
+    : capture(nullptr), by_device(false), device_id(0), range_begin(0), range_end(0), forward(true),
+      stopping(false), finished(false), scanned(0), found(NOT_FOUND) {
+}
+
+CaptureSearch::~CaptureSearch() {
+    cancel();
+}
+
+void CaptureSearch::find_device(const CaptureFile* file, uint32_t id, uint64_t begin, uint64_t end,
+                                bool to_end) {
+    cancel();
+    by_device = true;
+    device_id = id;
+    start(file, begin, end, to_end);
+}
+
+void CaptureSearch::find_match(const CaptureFile* file, const PacketFilter& match, uint64_t begin,
+                               uint64_t end, bool to_end) {
+    cancel();
+    by_device = false;
+    filter = match;
+    start(file, begin, end, to_end);
+}
+
+void CaptureSearch::start(const CaptureFile* file, uint64_t begin, uint64_t end, bool to_end) {
+    capture = file;
+    range_begin = begin;
+    range_end = std::max(begin, end);
+    forward = to_end;
+    found = NOT_FOUND;
+    stopping.store(false);
+    finished.store(false);
+    scanned.store(0);
+    worker = std::thread(&CaptureSearch::background, this);
+}
+
+void CaptureSearch::cancel() {
+    stopping.store(true);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+double CaptureSearch::progress() const {
+    uint64_t total = range_end - range_begin;
+    if (total == 0) {
+        return 1.0;
+    }
+    return (double)scanned.load(std::memory_order_relaxed) / (double)total;
+}
+
+void CaptureSearch::background() {
+    PacketColumns columns;
+    std::vector<uint8_t> mask;
+    if (!by_device) {
+        columns.reserve(SEARCH_BLOCK);
+        mask.resize(SEARCH_BLOCK);
+    }
+
+    uint64_t begin = range_begin;
+    uint64_t end = range_end;
+    while (begin < end && found == NOT_FOUND) {
+        if (stopping.load(std::memory_order_relaxed)) {
+            return;
+        }
+        size_t n = (size_t)std::min(SEARCH_BLOCK, end - begin);
+        uint64_t first = forward ? begin : end - n;
+        found = by_device ? scan_device(first, n) : scan_match(first, n, columns, mask);
+        if (forward) {
+            begin += n;
+        } else {
+            end -= n;
+        }
+        scanned.fetch_add(n, std::memory_order_relaxed);
+    }
+    finished.store(true, std::memory_order_release);
+}
+
+uint64_t CaptureSearch::scan_device(uint64_t first, size_t n) const {
+    DecodedPacket p;
+    for (size_t k = 0; k < n; k++) {
+        uint64_t r = forward ? first + k : first + n - 1 - k;
+        decode_packet(capture->frame(r), p);
+        if (p.id == device_id) {
+            return r;
+        }
+    }
+    return NOT_FOUND;
+}
+
+uint64_t CaptureSearch::scan_match(uint64_t first, size_t n, PacketColumns& columns,
+                                   std::vector<uint8_t>& mask) const {
+    columns.clear();
+    decode_packets(capture->frame(first), capture->stride(), n, nullptr, PacketColumns::NO_SOURCE, columns);
+    if (filter.evaluate(columns, 0, n, mask.data()) == 0) {
+        return NOT_FOUND;
+    }
+    if (forward) {
+        return first + (uint64_t)(std::find(mask.begin(), mask.begin() + n, 1) - mask.begin());
+    }
+    size_t i = n - 1;
+    while (!mask[i]) {
+        i--;
+    }
+    return first + i;
+}
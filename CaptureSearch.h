@@ -0,0 +1,58 @@
+#ifndef CAPTURESEARCH_H
+#define CAPTURESEARCH_H
+
+#include "CaptureFile.h"
+#include "PacketFilter.h"
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Поиск кадра в файле захвата фоновым потоком, как построение
+// CaptureIndex: окно опрашивает progress() и ready() по таймеру и может
+// прервать поиск cancel(). Просматриваются строки [begin, end) вперед
+// или назад от границы; результат - первая подходящая строка по
+// направлению поиска.
+class CaptureSearch {
+public:
+    static const uint64_t NOT_FOUND = UINT64_MAX;
+
+    CaptureSearch();
+    ~CaptureSearch();
+
+    // Кадр устройства id. Файл должен оставаться открытым до cancel()
+    void find_device(const CaptureFile* capture, uint32_t id, uint64_t begin, uint64_t end, bool forward);
+    // Кадр, подходящий под фильтр (фильтр копируется)
+    void find_match(const CaptureFile* capture, const PacketFilter& filter, uint64_t begin, uint64_t end,
+                    bool forward);
+    // Останавливает поиск и дожидается потока
+    void cancel();
+
+    bool running() const { return worker.joinable() && !ready(); }
+    bool ready() const { return finished.load(std::memory_order_acquire); }
+    double progress() const;
+    // После ready(); NOT_FOUND - подходящих строк нет
+    uint64_t result() const { return found; }
+
+private:
+    void start(const CaptureFile* file, uint64_t begin, uint64_t end, bool forward);
+    void background();
+    uint64_t scan_device(uint64_t first, size_t n) const;
+    uint64_t scan_match(uint64_t first, size_t n, PacketColumns& columns, std::vector<uint8_t>& mask) const;
+
+    const CaptureFile* capture;
+    bool by_device;
+    uint32_t device_id;
+    PacketFilter filter;
+    uint64_t range_begin;
+    uint64_t range_end;
+    bool forward;
+
+    std::thread worker;
+    std::atomic<bool> stopping;
+    std::atomic<bool> finished;
+    std::atomic<uint64_t> scanned;
+    uint64_t found;             // пишет фоновый поток до finished
+};
+
+#endif
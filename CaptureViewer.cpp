@@ -0,0 +1,329 @@
+#include "CaptureViewer.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFont>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QItemSelectionModel>
+#include <QVBoxLayout>
+#include <algorithm>
+
+CaptureViewer::CaptureViewer(QWidget *parent)
+        : QWidget(parent, Qt::Window)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setMinimumSize(1200, 700);
+
+    model = new CaptureModel(&capture, this);
+
+    infoLabel = new QLabel(this);
+    infoLabel->setFont(QFont("Arial", 9));
+    indexProgress = new QProgressBar(this);
+    indexProgress->setRange(0, 1000);
+    indexProgress->setFormat("Индексирование: %p%");
+    indexProgress->setMaximumWidth(250);
+
+    searchEdit = new QLineEdit(this);
+    searchEdit->setPlaceholderText("#строка, 0xID, время (ЧЧ:ММ:СС, ГГГГ-ММ-ДД ЧЧ:ММ:СС) или фильтр (rssi > -80 && type == sensor)");
+    findNextButton = new QPushButton("Найти далее", this);
+    findPreviousButton = new QPushButton("Найти назад", this);
+    searchProgress = new QProgressBar(this);
+    searchProgress->setRange(0, 1000);
+    searchProgress->setFormat("Поиск: %p%");
+    searchProgress->setMaximumWidth(200);
+    searchProgress->hide();
+    cancelSearchButton = new QPushButton("Отмена", this);
+    cancelSearchButton->hide();
+
+    QHBoxLayout *topLayout = new QHBoxLayout();
+    topLayout->addWidget(infoLabel, 1);
+    topLayout->addWidget(indexProgress);
+    QHBoxLayout *searchLayout = new QHBoxLayout();
+    searchLayout->addWidget(searchEdit, 1);
+    searchLayout->addWidget(findPreviousButton);
+    searchLayout->addWidget(findNextButton);
+    searchLayout->addWidget(searchProgress);
+    searchLayout->addWidget(cancelSearchButton);
+
+    // Таблица: строки одной высоты и без заголовков строк, иначе
+    // представление обходит все строки файла при каждом обновлении
+    table = new QTableView(this);
+    table->setModel(model);
+    table->setAlternatingRowColors(true);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setShowGrid(true);
+    table->verticalHeader()->setVisible(false);
+    table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    table->verticalHeader()->setDefaultSectionSize(24);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    table->horizontalHeader()->setStretchLastSection(true);
+    table->setColumnWidth(CaptureModel::COL_ROW, 90);
+    table->setColumnWidth(CaptureModel::COL_TIME, 170);
+    table->setColumnWidth(CaptureModel::COL_TYPE, 90);
+    table->setColumnWidth(CaptureModel::COL_ID, 110);
+    table->setColumnWidth(CaptureModel::COL_VERSION, 60);
+    table->setColumnWidth(CaptureModel::COL_PRESSURE, 110);
+    table->setColumnWidth(CaptureModel::COL_TEMPERATURE, 110);
+    table->setColumnWidth(CaptureModel::COL_VOLTAGE, 100);
+    table->setColumnWidth(CaptureModel::COL_RSSI, 60);
+
+    detailsView = new QPlainTextEdit(this);
+    detailsView->setReadOnly(true);
+    detailsView->setFont(QFont("Courier New", 9));
+    detailsView->setMaximumHeight(70);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(topLayout);
+    layout->addLayout(searchLayout);
+    layout->addWidget(table, 1);
+    layout->addWidget(detailsView);
+
+    progressTimer = new QTimer(this);
+    connect(progressTimer, &QTimer::timeout, this, &CaptureViewer::updateIndexProgress);
+    searchTimer = new QTimer(this);
+    connect(searchTimer, &QTimer::timeout, this, &CaptureViewer::updateSearchProgress);
+    connect(cancelSearchButton, &QPushButton::clicked, this, &CaptureViewer::cancelSearch);
+    connect(searchEdit, &QLineEdit::returnPressed, this, &CaptureViewer::findNext);
+    connect(findNextButton, &QPushButton::clicked, this, &CaptureViewer::findNext);
+    connect(findPreviousButton, &QPushButton::clicked, this, &CaptureViewer::findPrevious);
+    connect(table->selectionModel(), &QItemSelectionModel::currentRowChanged,
+            this, &CaptureViewer::showCurrentRow);
+}
+
+CaptureViewer::~CaptureViewer()
+{
+    // Таблица и модель не должны пережить отображение файла
+    progressTimer->stop();
+    searchTimer->stop();
+    search.cancel();
+    index.cancel();
+    table->setModel(nullptr);
+    delete model;
+    model = nullptr;
+}
+
+bool CaptureViewer::openFile(const QString &path, QString *error)
+{
+    cancelSearch();
+    index.cancel();
+
+    std::string openError;
+    if (!capture.open(path.toStdString(), false, &openError)) {
+        if (error) *error = QString::fromStdString(openError);
+        return false;
+    }
+    capture.advise_random();
+    filePath = path;
+    model->reload();
+    setWindowTitle("Захват: " + QFileInfo(path).fileName());
+
+    index.build(&capture);
+    indexProgress->setValue(0);
+    indexProgress->show();
+    progressTimer->start(200);
+    updateInfo();
+    return true;
+}
+
+void CaptureViewer::updateInfo()
+{
+    QString text = QString("%1 | %2 | кадров: %3 | %4 МБ")
+            .arg(QFileInfo(filePath).fileName())
+            .arg(capture.format() == CAPTURE_RECORDS ? "ECP1" : "сырой поток без времени")
+            .arg(capture.count())
+            .arg(capture.size() / (1024.0 * 1024.0), 0, 'f', 1);
+    if (capture.format() == CAPTURE_RECORDS && capture.start_ms()) {
+        text += " | начало записи: " + QDateTime::fromMSecsSinceEpoch(capture.start_ms())
+                .toString("yyyy-MM-dd HH:mm:ss");
+    }
+    if (index.ready()) {
+        text += QString(" | устройств: %1").arg(index.devices().size());
+        if (index.devices_truncated()) {
+            text += "+";
+        }
+    }
+    if (capture.tail_bytes()) {
+        text += QString(" | неполный кадр в конце (%1 Б)").arg(capture.tail_bytes());
+    }
+    infoLabel->setText(text);
+}
+
+void CaptureViewer::updateIndexProgress()
+{
+    indexProgress->setValue((int)(index.progress() * 1000.0));
+    if (index.ready()) {
+        progressTimer->stop();
+        indexProgress->hide();
+        updateInfo();
+    }
+}
+
+uint64_t CaptureViewer::currentRow() const
+{
+    QModelIndex current = table->currentIndex();
+    return current.isValid() ? (uint64_t)current.row() : 0;
+}
+
+void CaptureViewer::goToRow(uint64_t row)
+{
+    if (row >= (uint64_t)model->rowCount()) {
+        return;
+    }
+    QModelIndex target = model->index((int)row, CaptureModel::COL_ROW);
+    table->setCurrentIndex(target);
+    table->scrollTo(target, QAbstractItemView::PositionAtCenter);
+}
+
+void CaptureViewer::showCurrentRow()
+{
+    detailsView->setPlainText(model->describe(table->currentIndex().row()));
+}
+
+void CaptureViewer::findNext()
+{
+    find(true);
+}
+
+void CaptureViewer::findPrevious()
+{
+    find(false);
+}
+
+void CaptureViewer::searchRange(bool forward, uint64_t &begin, uint64_t &end) const
+{
+    uint64_t count = (uint64_t)model->rowCount();
+    // Без выбранной строки поиск вперед идет с начала, назад - с конца
+    bool selected = table->currentIndex().isValid();
+    begin = forward ? (selected ? currentRow() + 1 : 0) : 0;
+    end = forward ? count : (selected ? currentRow() : count);
+}
+
+void CaptureViewer::startDeviceSearch(uint32_t id, bool forward)
+{
+    uint64_t begin, end;
+    searchRange(forward, begin, end);
+
+    // По индексу сразу видно, есть ли еще кадры устройства в нужную сторону
+    CaptureDeviceEntry entry;
+    if (index.ready()) {
+        if (!index.device(id, entry)) {
+            showFound(CaptureIndex::NOT_FOUND);
+            return;
+        }
+        begin = std::max<uint64_t>(begin, entry.first_row);
+        end = std::min<uint64_t>(end, entry.last_row + 1);
+    }
+
+    search.find_device(&capture, id, begin, end, forward);
+    showSearchStarted();
+}
+
+void CaptureViewer::startMatchSearch(const PacketFilter &filter, bool forward)
+{
+    uint64_t begin, end;
+    searchRange(forward, begin, end);
+    search.find_match(&capture, filter, begin, end, forward);
+    showSearchStarted();
+}
+
+void CaptureViewer::showSearchStarted()
+{
+    searchProgress->setValue(0);
+    searchProgress->show();
+    cancelSearchButton->show();
+    detailsView->setPlainText("Поиск: " + searchText);
+    searchTimer->start(100);
+}
+
+void CaptureViewer::updateSearchProgress()
+{
+    searchProgress->setValue((int)(search.progress() * 1000.0));
+    if (search.ready()) {
+        searchTimer->stop();
+        searchProgress->hide();
+        cancelSearchButton->hide();
+        showFound(search.result());
+    }
+}
+
+void CaptureViewer::cancelSearch()
+{
+    if (!search.running()) {
+        return;
+    }
+    search.cancel();
+    searchTimer->stop();
+    searchProgress->hide();
+    cancelSearchButton->hide();
+    detailsView->setPlainText("Поиск прерван: " + searchText);
+}
+
+void CaptureViewer::showFound(uint64_t row)
+{
+    if (row == CaptureIndex::NOT_FOUND || row >= (uint64_t)model->rowCount()) {
+        detailsView->setPlainText("Не найдено: " + searchText);
+    } else {
+        goToRow(row);
+    }
+}
+
+void CaptureViewer::find(bool forward)
+{
+    QString text = searchEdit->text().trimmed();
+    if (text.isEmpty() || !capture.is_open()) {
+        return;
+    }
+
+    // Новый запрос заменяет незаконченный
+    cancelSearch();
+    searchText = text;
+
+    bool ok = false;
+    QString error;
+
+    uint32_t id = 0;
+    if (text.startsWith("0x", Qt::CaseInsensitive)) {
+        id = text.mid(2).toUInt(&ok, 16);
+    }
+
+    if (text.startsWith('#')) {
+        uint64_t row = text.mid(1).toULongLong(&ok);
+        if (ok) {
+            showFound(row);
+        }
+    } else if (ok) {
+        startDeviceSearch(id, forward);
+    } else {
+        QDateTime time = QDateTime::fromString(text, "yyyy-MM-dd HH:mm:ss");
+        if (!time.isValid()) {
+            QTime t = QTime::fromString(text, "HH:mm:ss");
+            if (t.isValid()) {
+                QDate day = capture.start_ms()
+                        ? QDateTime::fromMSecsSinceEpoch(capture.start_ms()).date()
+                        : QDate::currentDate();
+                time = QDateTime(day, t);
+            }
+        }
+        if (time.isValid()) {
+            // Двоичный поиск по индексу: быстро, без фонового потока
+            ok = true;
+            showFound(index.find_time(time.toMSecsSinceEpoch() * 1000));
+        } else {
+            // Остальное - выражение фильтра
+            PacketFilter filter;
+            std::string message;
+            ok = filter.compile(text.toStdString(), &message);
+            if (!ok) {
+                error = QString::fromStdString(message);
+            } else {
+                startMatchSearch(filter, forward);
+            }
+        }
+    }
+
+    if (!ok) {
+        detailsView->setPlainText("Не понял запрос: " + text + (error.isEmpty() ? QString() : "\n" + error));
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef CAPTUREVIEWER_H
+#define CAPTUREVIEWER_H
+
+#include "CaptureFile.h"
+#include "CaptureIndex.h"
+#include "CaptureModel.h"
+#include "CaptureSearch.h"
+#include "PacketFilter.h"
+#include <QWidget>
+#include <QTableView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QProgressBar>
+#include <QPlainTextEdit>
+#include <QTimer>
+
+// Окно просмотра файла захвата. Файл отображается в память, таблица
+// разбирает только видимые строки, индекс строится в фоне с показом
+// хода построения. Поиск: номер строки (#N), ID устройства (0x...),
+// время приема (ЧЧ:ММ:СС либо ГГГГ-ММ-ДД ЧЧ:ММ:СС) или выражение
+// PacketFilter - следующий подходящий кадр. Поиск устройства и по
+// фильтру идет в фоне с ходом поиска и кнопкой отмены.
+class CaptureViewer : public QWidget
+{
+Q_OBJECT
+
+public:
+    explicit CaptureViewer(QWidget *parent = nullptr);
+    ~CaptureViewer();
+
+    bool openFile(const QString &path, QString *error);
+
+private slots:
+    void updateIndexProgress();
+    void updateSearchProgress();
+    void cancelSearch();
+    void findNext();
+    void findPrevious();
+    void showCurrentRow();
+
+private:
+    void find(bool forward);
+    void startDeviceSearch(uint32_t id, bool forward);
+    void startMatchSearch(const PacketFilter &filter, bool forward);
+    void searchRange(bool forward, uint64_t &begin, uint64_t &end) const;
+    void showSearchStarted();
+    void showFound(uint64_t row);
+    void goToRow(uint64_t row);
+    uint64_t currentRow() const;
+    void updateInfo();
+
+    // Индекс и поиск читают файл из своих потоков и останавливаются
+    // раньше, чем файл закрывается (порядок объявления)
+    CaptureFile capture;
+    CaptureIndex index;
+    CaptureSearch search;
+    QString filePath;
+    QString searchText;         // запрос текущего фонового поиска
+
+    CaptureModel *model;
+    QTableView *table;
+    QLabel *infoLabel;
+    QProgressBar *indexProgress;
+    QLineEdit *searchEdit;
+    QPushButton *findNextButton;
+    QPushButton *findPreviousButton;
+    QProgressBar *searchProgress;
+    QPushButton *cancelSearchButton;
+    QPlainTextEdit *detailsView;
+    QTimer *progressTimer;
+    QTimer *searchTimer;
+};
+
+#endif
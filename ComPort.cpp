@@ -1,5 +1,10 @@
 #include "ComPort.h"
 
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#endif
+
 #ifdef _WIN32
 std::vector<std::string> ComPortBase::get_windows_ports() {
     std::vector<std::string> ports;
@@ -165,11 +170,12 @@ int ComPortBase::setup_serial_port() {
         return -1;
     }
 
-    // Настраиваем таймауты
+    // Настраиваем таймауты: ReadFile возвращает то, что уже пришло,
+    // а без данных ждет не дольше 50 мс при любом размере буфера
     memset(&timeouts, 0, sizeof(timeouts));
-    timeouts.ReadIntervalTimeout = 50;
+    timeouts.ReadIntervalTimeout = MAXDWORD;
     timeouts.ReadTotalTimeoutConstant = 50;
-    timeouts.ReadTotalTimeoutMultiplier = 10;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
     timeouts.WriteTotalTimeoutConstant = 50;
     timeouts.WriteTotalTimeoutMultiplier = 10;
 
@@ -218,12 +224,52 @@ int ComPortBase::setup_serial_port() {
     }
 
     tcflush(serial_port, TCIOFLUSH);
+
+    // Не у всех драйверов есть TIOCSSERIAL: без флага порт просто
+    // работает как раньше
+    low_latency_set = false;
+#ifdef __linux__
+    if (low_latency) {
+        struct serial_struct serial;
+        if (ioctl(serial_port, TIOCGSERIAL, &serial) == 0) {
+            serial.flags |= ASYNC_LOW_LATENCY;
+            low_latency_set = ioctl(serial_port, TIOCSSERIAL, &serial) == 0;
+        }
+    }
+#endif
 #endif
 
     return serial_port;
 }
 
+int ComPortBase::reopen_port() {
+    if (found_name.empty()) {
+        return -1;
+    }
+    port = found_name.c_str();
+    int fd = setup_serial_port();
+    if (fd < 0) {
+        port = nullptr;
+        serial_port = -1;
+    }
+    return fd;
+}
+
+bool ComPortBase::port_present() {
+    if (found_name.empty()) {
+        return false;
+    }
+#ifdef _WIN32
+    std::vector<std::string> ports = get_windows_ports();
+    return std::find(ports.begin(), ports.end(), found_name) != ports.end();
+#else
+    return access((std::string(PORT_PREFIX) + found_name).c_str(), F_OK) == 0;
+#endif
+}
+
 int ComPortBase::search_port() {
+    connected_port = -1;
+
 #ifdef _WIN32
     // Windows: получаем список COM портов
     std::vector<std::string> ports = get_windows_ports();
@@ -239,6 +285,7 @@ int ComPortBase::search_port() {
 
         if (serial_port >= 0) {
             connected_port = serial_port;
+            found_name = port;
             break;
         } else {
             port = nullptr;
@@ -264,6 +311,7 @@ int ComPortBase::search_port() {
 
             if (serial_port >= 0) {
                 connected_port = serial_port;
+                found_name = port;
                 break;
             } else {
                 port = nullptr;
@@ -36,7 +36,8 @@
 
 class ComPortBase {
 public:
-    ComPortBase() : port(nullptr), serial_port(-1), found_ports(0), connected_port(-1), dir(nullptr), entry(nullptr) {
+    ComPortBase() : port(nullptr), dir(nullptr), entry(nullptr), serial_port(-1), found_ports(0), connected_port(-1),
+                    low_latency(false), low_latency_set(false) {
 #ifdef _WIN32
         memset(&dcb, 0, sizeof(dcb));
 #endif
@@ -44,6 +45,11 @@ public:
 
     int setup_serial_port();
     int search_port();
+    // Открывает порт, найденный прошлым search_port(), без перебора
+    int reopen_port();
+    // Устройство найденного порта есть в системе (не отключено)
+    bool port_present();
+    const std::string& found_port_name() const { return found_name; }
     void close_port() {
         if (serial_port >= 0) {
 #ifdef _WIN32
@@ -58,6 +64,11 @@ public:
     const char* get_port() const { return port; }
     void set_port(const char* p) { port = p; }
     void set_speed(speed_t speed) { speed_m = speed; }
+    // ASYNC_LOW_LATENCY при следующем открытии порта: драйвер отдает
+    // байты сразу, без задержки на накопление (у FTDI - до 16 мс)
+    void set_low_latency(bool enabled) { low_latency = enabled; }
+    // Флаг удалось установить на открытом порту
+    bool low_latency_active() const { return low_latency_set; }
 
 #ifdef _WIN32
     void set_speed_win(DWORD speed) { baud_rate = speed; }
@@ -74,6 +85,7 @@ private:
 #endif
 
     std::string name;
+    std::string found_name;
     void* dir;
     void* entry;
     char full_port[50];
@@ -85,6 +97,8 @@ private:
 
     int found_ports;
     int connected_port;
+    bool low_latency;
+    bool low_latency_set;
 
     // Вспомогательные методы для поиска портов
 #ifdef _WIN32
@@ -0,0 +1,774 @@
+#include "DataExporter.h"
+#include <string.h>
+#include <time.h>
+#include <cmath>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static int64_t wall_ms() {
+    return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Оставляет в пачке только записи, подходящие под фильтр. Записи
+// раскладываются по столбцам, чтобы фильтр проверял их блоками.
+static void filter_batch(const PacketFilter& filter, std::vector<ExportRecord>& batch,
+                         PacketColumns& columns, std::vector<uint8_t>& mask) {
+    size_t n = batch.size();
+    columns.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        const ExportRecord& r = batch[i];
+        columns.id[i] = r.id;
+        columns.type[i] = r.type;
+        columns.fw_version[i] = r.fw_version;
+        columns.pressure_bar[i] = r.pressure_bar;
+        columns.temperature_c[i] = r.temperature_c;
+        columns.voltage_v[i] = r.voltage_v;
+        columns.rssi[i] = r.rssi;
+    }
+    mask.resize(n);
+    filter.evaluate(columns, 0, n, mask.data());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (mask[i]) {
+            batch[kept++] = batch[i];
+        }
+    }
+    batch.resize(kept);
+}
+
+// ========== Форматирование ==========
+
+static char* put_str(char* p, const char* s) {
+    size_t n = strlen(s);
+    memcpy(p, s, n);
+    return p + n;
+}
+
+static char* put_int(char* p, char* end, int64_t v) {
+    return std::to_chars(p, end, v).ptr;
+}
+
+static char* put_float(char* p, char* end, double v, int precision) {
+    return std::to_chars(p, end, v, std::chars_format::fixed, precision).ptr;
+}
+
+static char* put_id(char* p, uint32_t id) {
+    static const char digits[] = "0123456789ABCDEF";
+    *p++ = '0';
+    *p++ = 'x';
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        *p++ = digits[(id >> shift) & 0xF];
+    }
+    return p;
+}
+
+static char* put_2digits(char* p, unsigned v) {
+    *p++ = (char)('0' + v / 10);
+    *p++ = (char)('0' + v % 10);
+    return p;
+}
+
+// Время UTC в формате ISO 8601: 2024-05-01T12:34:56.789Z
+static char* put_time(char* p, int64_t ms) {
+    int64_t secs = ms >= 0 ? ms / 1000 : (ms - 999) / 1000;
+    unsigned msec = (unsigned)(ms - secs * 1000);
+    int64_t days = secs >= 0 ? secs / 86400 : (secs - 86399) / 86400;
+    unsigned sod = (unsigned)(secs - days * 86400);
+
+    // Дни от эпохи в гражданскую дату (алгоритм Хиннанта)
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t y = (int64_t)yoe + era * 400;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    if (m <= 2) y++;
+
+    p = std::to_chars(p, p + 8, y).ptr;
+    *p++ = '-';
+    p = put_2digits(p, m);
+    *p++ = '-';
+    p = put_2digits(p, d);
+    *p++ = 'T';
+    p = put_2digits(p, sod / 3600);
+    *p++ = ':';
+    p = put_2digits(p, sod / 60 % 60);
+    *p++ = ':';
+    p = put_2digits(p, sod % 60);
+    *p++ = '.';
+    *p++ = (char)('0' + msec / 100);
+    p = put_2digits(p, msec % 100);
+    *p++ = 'Z';
+    return p;
+}
+
+static const char* type_name(uint8_t type) {
+    if (type == 0xF0) return "sensor";
+    if (type == 0xF1) return "repeater";
+    return "";
+}
+
+static double state_stddev(const DeviceStatsState& s, int field) {
+    return s.count > 1 ? std::sqrt(s.fields[field].m2 / (double)(s.count - 1)) : 0.0;
+}
+
+// ========== Файл экспорта ==========
+
+ExportFile::ExportFile(ExportFormat f, Schema s)
+    : format(f), schema(s), file(nullptr), buffer(f == EXPORT_ARROW ? 0 : BUFFER_SIZE), used(0),
+      source(PacketColumns::NO_SOURCE), opened(false),
+      max_bytes(0), max_age_ms(0), opened_ms(0), file_bytes(0),
+      row_count(0), byte_count(0), file_count(0), error_flag(false) {
+}
+
+ExportFile::~ExportFile() {
+    close();
+}
+
+bool ExportFile::open_file(const std::string& path) {
+    if (format == EXPORT_ARROW) {
+        // Файл ведет ArrowWriter
+        if (schema != SCHEMA_PACKETS) {
+            error_flag = true;
+            return false;
+        }
+        if (!arrow) {
+            arrow.reset(new ArrowWriter());
+            columns.reserve(ArrowWriter::BATCH_ROWS);
+        }
+        if (!arrow->open(path, nullptr)) {
+            error_flag = true;
+            return false;
+        }
+    } else {
+        file = fopen(path.c_str(), "wb");
+        if (!file) {
+            error_flag = true;
+            return false;
+        }
+    }
+    opened = true;
+    current_path = path;
+    opened_ms = wall_ms();
+    file_bytes = 0;
+    file_count++;
+    write_header();
+    return true;
+}
+
+bool ExportFile::open(const std::string& path, std::string* error) {
+    close();
+    prefix.clear();
+    max_bytes = 0;
+    max_age_ms = 0;
+    if (format == EXPORT_ARROW && schema != SCHEMA_PACKETS) {
+        if (error) *error = "реестр выгружается только в CSV или NDJSON";
+        return false;
+    }
+    if (!open_file(path)) {
+        if (error) *error = "не удалось создать " + path;
+        return false;
+    }
+    return true;
+}
+
+bool ExportFile::open_rotating(const std::string& file_prefix, uint64_t bytes, int64_t age_ms,
+                               std::string* error) {
+    close();
+    prefix = file_prefix;
+    max_bytes = bytes;
+    max_age_ms = age_ms;
+
+    std::error_code ec;
+    fs::path parent = fs::path(prefix).parent_path();
+    if (!parent.empty()) {
+        fs::create_directories(parent, ec);
+    }
+
+    if (!rotate()) {
+        if (error) *error = "не удалось создать файл экспорта " + prefix;
+        return false;
+    }
+    return true;
+}
+
+void ExportFile::close_current() {
+    if (arrow && arrow->is_open()) {
+        write_arrow_batch();
+        uint64_t before = arrow->bytes();
+        if (!arrow->close()) {
+            error_flag = true;
+        }
+        byte_count += arrow->bytes() - before;
+    }
+    if (file) {
+        drain();
+        if (fclose(file) != 0) {
+            error_flag = true;
+        }
+        file = nullptr;
+    }
+    opened = false;
+}
+
+void ExportFile::write_arrow_batch() {
+    if (columns.size() == 0) {
+        return;
+    }
+    uint64_t before = arrow->bytes();
+    if (!arrow->write_batch(columns)) {
+        error_flag = true;
+    }
+    byte_count += arrow->bytes() - before;
+    file_bytes = arrow->bytes();
+    columns.clear();
+}
+
+void ExportFile::set_source(const std::string& name) {
+    source = name.empty() ? PacketColumns::NO_SOURCE : columns.source_index(name);
+}
+
+bool ExportFile::rotate() {
+    if (opened) {
+        close_current();
+    }
+
+    time_t now = time(nullptr);
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+    const char* ext = format == EXPORT_CSV ? ".csv" : format == EXPORT_NDJSON ? ".ndjson" : ".arrow";
+    std::string path = prefix + "-" + stamp + ext;
+    for (int n = 1; fs::exists(path); n++) {
+        path = prefix + "-" + stamp + "-" + std::to_string(n) + ext;
+    }
+    return open_file(path);
+}
+
+void ExportFile::write_header() {
+    if (format != EXPORT_CSV) {
+        return;
+    }
+    const char* header = schema == SCHEMA_PACKETS
+            ? "time,id,type,fw_version,pressure_bar,temperature_c,voltage_v,rssi\n"
+            : "id,type,fw_version,pressure_bar,temperature_c,voltage_v,rssi,packets,"
+              "first_seen,last_seen,pressure_mean,pressure_stddev,rssi_mean,rssi_stddev\n";
+    used = (size_t)(put_str(buffer.data() + used, header) - buffer.data());
+}
+
+bool ExportFile::drain() {
+    if (!file || used == 0) {
+        used = 0;
+        return file != nullptr;
+    }
+    if (fwrite(buffer.data(), 1, used, file) != used) {
+        error_flag = true;
+    }
+    file_bytes += used;
+    byte_count += used;
+    used = 0;
+    return !error_flag;
+}
+
+void ExportFile::reserve_row() {
+    if (max_bytes && file_bytes + used >= max_bytes) {
+        rotate();
+    }
+    if (used + MAX_ROW_SIZE > buffer.size()) {
+        drain();
+    }
+}
+
+void ExportFile::write(const ExportRecord& r) {
+    if (!opened) {
+        return;
+    }
+
+    if (format == EXPORT_ARROW) {
+        if (max_bytes && file_bytes >= max_bytes) {
+            rotate();
+        }
+        columns.time_ms.push_back(r.time_ms);
+        columns.id.push_back(r.id);
+        columns.type.push_back(r.type);
+        columns.fw_version.push_back(r.fw_version);
+        columns.pressure_bar.push_back(r.pressure_bar);
+        columns.temperature_c.push_back(r.temperature_c);
+        columns.voltage_v.push_back(r.voltage_v);
+        columns.rssi.push_back(r.rssi);
+        columns.source.push_back(source);
+        row_count++;
+        if (columns.size() >= ArrowWriter::BATCH_ROWS) {
+            write_arrow_batch();
+        }
+        return;
+    }
+
+    reserve_row();
+
+    char* p = buffer.data() + used;
+    char* end = buffer.data() + buffer.size();
+
+    if (format == EXPORT_CSV) {
+        p = put_time(p, r.time_ms);
+        *p++ = ',';
+        p = put_id(p, r.id);
+        *p++ = ',';
+        p = put_str(p, type_name(r.type));
+        *p++ = ',';
+        if (r.type) p = put_int(p, end, r.fw_version);
+        *p++ = ',';
+        p = put_float(p, end, r.pressure_bar, 3);
+        *p++ = ',';
+        p = put_int(p, end, r.temperature_c);
+        *p++ = ',';
+        p = put_float(p, end, r.voltage_v, 3);
+        *p++ = ',';
+        p = put_int(p, end, r.rssi);
+    } else {
+        p = put_str(p, "{\"time\":\"");
+        p = put_time(p, r.time_ms);
+        p = put_str(p, "\",\"id\":\"");
+        p = put_id(p, r.id);
+        *p++ = '"';
+        if (r.type) {
+            p = put_str(p, ",\"type\":\"");
+            p = put_str(p, type_name(r.type));
+            p = put_str(p, "\",\"fw_version\":");
+            p = put_int(p, end, r.fw_version);
+        }
+        p = put_str(p, ",\"pressure_bar\":");
+        p = put_float(p, end, r.pressure_bar, 3);
+        p = put_str(p, ",\"temperature_c\":");
+        p = put_int(p, end, r.temperature_c);
+        p = put_str(p, ",\"voltage_v\":");
+        p = put_float(p, end, r.voltage_v, 3);
+        p = put_str(p, ",\"rssi\":");
+        p = put_int(p, end, r.rssi);
+        *p++ = '}';
+    }
+    *p++ = '\n';
+
+    used = (size_t)(p - buffer.data());
+    row_count++;
+}
+
+void ExportFile::write(const SessionDeviceRecord& r) {
+    if (!file) {
+        return;
+    }
+    reserve_row();
+
+    char* p = buffer.data() + used;
+    char* end = buffer.data() + buffer.size();
+    const DeviceStatsState& s = r.stats;
+
+    if (format == EXPORT_CSV) {
+        p = put_id(p, r.id);
+        *p++ = ',';
+        p = put_str(p, type_name(r.type));
+        *p++ = ',';
+        p = put_int(p, end, r.fw_version);
+        *p++ = ',';
+        p = put_float(p, end, r.pressure_bar, 3);
+        *p++ = ',';
+        p = put_int(p, end, r.temperature_c);
+        *p++ = ',';
+        p = put_float(p, end, r.voltage_v, 3);
+        *p++ = ',';
+        p = put_int(p, end, r.rssi);
+        *p++ = ',';
+        p = put_int(p, end, r.packet_count);
+        *p++ = ',';
+        p = put_time(p, r.first_seen_ms);
+        *p++ = ',';
+        p = put_time(p, r.last_seen_ms);
+        *p++ = ',';
+        p = put_float(p, end, s.fields[STAT_PRESSURE].mean, 3);
+        *p++ = ',';
+        p = put_float(p, end, state_stddev(s, STAT_PRESSURE), 3);
+        *p++ = ',';
+        p = put_float(p, end, s.fields[STAT_RSSI].mean, 1);
+        *p++ = ',';
+        p = put_float(p, end, state_stddev(s, STAT_RSSI), 1);
+    } else {
+        p = put_str(p, "{\"id\":\"");
+        p = put_id(p, r.id);
+        p = put_str(p, "\",\"type\":\"");
+        p = put_str(p, type_name(r.type));
+        p = put_str(p, "\",\"fw_version\":");
+        p = put_int(p, end, r.fw_version);
+        p = put_str(p, ",\"pressure_bar\":");
+        p = put_float(p, end, r.pressure_bar, 3);
+        p = put_str(p, ",\"temperature_c\":");
+        p = put_int(p, end, r.temperature_c);
+        p = put_str(p, ",\"voltage_v\":");
+        p = put_float(p, end, r.voltage_v, 3);
+        p = put_str(p, ",\"rssi\":");
+        p = put_int(p, end, r.rssi);
+        p = put_str(p, ",\"packets\":");
+        p = put_int(p, end, r.packet_count);
+        p = put_str(p, ",\"first_seen\":\"");
+        p = put_time(p, r.first_seen_ms);
+        p = put_str(p, "\",\"last_seen\":\"");
+        p = put_time(p, r.last_seen_ms);
+        p = put_str(p, "\",\"pressure_mean\":");
+        p = put_float(p, end, s.fields[STAT_PRESSURE].mean, 3);
+        p = put_str(p, ",\"pressure_stddev\":");
+        p = put_float(p, end, state_stddev(s, STAT_PRESSURE), 3);
+        p = put_str(p, ",\"rssi_mean\":");
+        p = put_float(p, end, s.fields[STAT_RSSI].mean, 1);
+        p = put_str(p, ",\"rssi_stddev\":");
+        p = put_float(p, end, state_stddev(s, STAT_RSSI), 1);
+        *p++ = '}';
+    }
+    *p++ = '\n';
+
+    used = (size_t)(p - buffer.data());
+    row_count++;
+}
+
+bool ExportFile::flush() {
+    if (!opened) {
+        return false;
+    }
+    if (max_age_ms && wall_ms() - opened_ms >= max_age_ms) {
+        rotate();
+    }
+    drain();
+    if (file && fflush(file) != 0) {
+        error_flag = true;
+    }
+    return !error_flag;
+}
+
+bool ExportFile::close() {
+    if (opened) {
+        close_current();
+    }
+    return !error_flag;
+}
+
+// ========== Экспорт ==========
+
+DataExporter::DataExporter()
+    : live(false), live_policy(QUEUE_DROP_NEWEST), live_stopping(false), dropped(0), blocked(0),
+      live_rows(0), live_bytes(0), live_files(0),
+      job_running(false), stopping(false), cancelling(false) {
+}
+
+DataExporter::~DataExporter() {
+    stop_live();
+
+    cancelling.store(true);
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    job_wake.notify_all();
+    if (job_worker.joinable()) {
+        job_worker.join();
+    }
+}
+
+bool DataExporter::start_live(const std::string& prefix, ExportFormat format,
+                              uint64_t rotate_bytes, int64_t rotate_ms, std::string* error) {
+    stop_live();
+
+    std::unique_ptr<ExportFile> f(new ExportFile(format, ExportFile::SCHEMA_PACKETS));
+    if (!f->open_rotating(prefix, rotate_bytes, rotate_ms, error)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(live_mutex);
+    live_file = std::move(f);
+    live_stopping = false;
+    dropped = 0;
+    blocked = 0;
+    live_rows = live_bytes = live_files = 0;
+    live_path = live_file->path();
+    pending.reserve(64 * 1024);
+    live_worker = std::thread(&DataExporter::live_loop, this);
+    live.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void DataExporter::stop_live() {
+    live.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        live_stopping = true;
+    }
+    live_wake.notify_all();
+    live_space.notify_all();
+    if (live_worker.joinable()) {
+        live_worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(live_mutex);
+    live_file.reset();
+}
+
+void DataExporter::set_source(const std::string& name) {
+    std::lock_guard<std::mutex> lock(live_mutex);
+    live_source = name;
+}
+
+void DataExporter::set_filter(std::shared_ptr<const PacketFilter> filter) {
+    std::lock_guard<std::mutex> lock(live_mutex);
+    live_filter = std::move(filter);
+}
+
+void DataExporter::set_live_policy(QueuePolicy policy) {
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        live_policy = policy == QUEUE_BLOCK ? QUEUE_BLOCK : QUEUE_DROP_NEWEST;
+    }
+    live_space.notify_all();
+}
+
+void DataExporter::append(const ExportRecord& r) {
+    append(&r, 1);
+}
+
+void DataExporter::append(const ExportRecord* records, size_t count) {
+    if (!live.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(live_mutex);
+    for (size_t i = 0; i < count; i++) {
+        if (pending.size() >= MAX_PENDING && live_policy == QUEUE_BLOCK && !live_stopping) {
+            // Поток записи забирает пачку сразу, не дожидаясь таймера
+            blocked++;
+            live_wake.notify_one();
+            live_space.wait(lock, [this] {
+                return pending.size() < MAX_PENDING || live_stopping || live_policy != QUEUE_BLOCK;
+            });
+        }
+        if (pending.size() >= MAX_PENDING) {
+            dropped++;
+            continue;
+        }
+        pending.push_back(records[i]);
+        if (pending.size() == MAX_PENDING / 2) {
+            live_wake.notify_one();
+        }
+    }
+}
+
+void DataExporter::live_loop() {
+    std::vector<ExportRecord> batch;
+    batch.reserve(64 * 1024);
+    PacketColumns columns;
+    std::vector<uint8_t> mask;
+
+    std::unique_lock<std::mutex> lock(live_mutex);
+    ExportFile* f = live_file.get();
+
+    for (;;) {
+        // Поток чтения не будит запись на каждый пакет: пачка забирается
+        // по таймеру или когда очередь заполнена наполовину
+        live_wake.wait_for(lock, std::chrono::milliseconds(100), [this] {
+            return live_stopping || pending.size() >= MAX_PENDING / 2;
+        });
+        bool last = live_stopping;
+        batch.swap(pending);
+        std::string source = live_source;
+        std::shared_ptr<const PacketFilter> filter = live_filter;
+
+        lock.unlock();
+        live_space.notify_all();
+        if (filter && !filter->empty()) {
+            filter_batch(*filter, batch, columns, mask);
+        }
+        f->set_source(source);
+        for (const ExportRecord& r : batch) {
+            f->write(r);
+        }
+        if (last) {
+            f->close();
+        } else {
+            f->flush();
+        }
+        batch.clear();
+        lock.lock();
+
+        live_rows = f->rows();
+        live_bytes = f->bytes();
+        live_files = f->files();
+        live_path = f->path();
+
+        if (last) {
+            break;
+        }
+    }
+}
+
+void DataExporter::post_job(const std::function<void()>& job) {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    jobs.push_back(job);
+    if (!job_worker.joinable()) {
+        job_worker = std::thread(&DataExporter::job_loop, this);
+    }
+    job_wake.notify_one();
+}
+
+void DataExporter::job_loop() {
+    std::unique_lock<std::mutex> lock(job_mutex);
+
+    for (;;) {
+        job_wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping) {
+            break;
+        }
+
+        std::function<void()> job = jobs.front();
+        jobs.pop_front();
+        job_running = true;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        job_running = false;
+    }
+}
+
+void DataExporter::post_message(const std::string& text) {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    messages.push_back(text);
+}
+
+void DataExporter::export_registry(const std::string& path, ExportFormat format,
+                                   std::vector<SessionDeviceRecord>&& records) {
+    auto shared = std::make_shared<std::vector<SessionDeviceRecord>>(std::move(records));
+
+    post_job([this, path, format, shared]() {
+        ExportFile f(format, ExportFile::SCHEMA_REGISTRY);
+        std::string error;
+        if (!f.open(path, &error)) {
+            post_message("Экспорт реестра: " + error);
+            return;
+        }
+        for (const SessionDeviceRecord& r : *shared) {
+            if (cancelling.load(std::memory_order_relaxed)) {
+                f.close();
+                remove(path.c_str());
+                return;
+            }
+            f.write(r);
+        }
+        bool ok = f.close();
+        post_message(ok ? "Реестр выгружен: " + std::to_string(f.rows()) + " устройств в " + path
+                        : "Экспорт реестра: ошибка записи " + path);
+    });
+}
+
+void DataExporter::export_history(const std::string& path, ExportFormat format, const HistoryStore& store,
+                                  uint32_t id, int64_t from_ms, int64_t to_ms,
+                                  std::shared_ptr<const PacketFilter> filter) {
+    if (filter && filter->empty()) {
+        filter.reset();
+    }
+    post_job([this, path, format, &store, id, from_ms, to_ms, filter]() {
+        ExportFile f(format, ExportFile::SCHEMA_PACKETS);
+        std::string error;
+        if (!f.open(path, &error)) {
+            post_message("Экспорт истории: " + error);
+            return;
+        }
+
+        // С фильтром точки копятся пачками и проверяются по столбцам
+        std::vector<ExportRecord> chunk;
+        PacketColumns columns;
+        std::vector<uint8_t> mask;
+        auto write_chunk = [&]() {
+            filter_batch(*filter, chunk, columns, mask);
+            for (const ExportRecord& r : chunk) {
+                f.write(r);
+            }
+            chunk.clear();
+        };
+
+        // Запрос не держит замков хранилища, пока идет обратный вызов: запись
+        // файла задерживает только эту выгрузку. Прерванная выгрузка
+        // дочитывает запрос вхолостую.
+        store.query(id, from_ms, to_ms, [&](const HistorySample& s) {
+            if (cancelling.load(std::memory_order_relaxed)) {
+                return;
+            }
+            ExportRecord r;
+            r.time_ms = s.time_ms;
+            r.id = s.id;
+            r.type = 0;
+            r.fw_version = 0;
+            r.temperature_c = s.temperature_c;
+            r.rssi = s.rssi;
+            r.pressure_bar = s.pressure_bar;
+            r.voltage_v = s.voltage_v;
+            if (!filter) {
+                f.write(r);
+                return;
+            }
+            chunk.push_back(r);
+            if (chunk.size() >= 64 * 1024) {
+                write_chunk();
+            }
+        });
+        if (cancelling.load()) {
+            f.close();
+            remove(path.c_str());
+            return;
+        }
+        if (filter) {
+            write_chunk();
+        }
+
+        bool ok = f.close();
+        post_message(ok ? "История выгружена: " + std::to_string(f.rows()) + " строк в " + path
+                        : "Экспорт истории: ошибка записи " + path);
+    });
+}
+
+ExportStats DataExporter::stats() const {
+    ExportStats s;
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        s.live_active = live.load(std::memory_order_relaxed);
+        s.live_rows = live_rows;
+        s.live_bytes = live_bytes;
+        s.live_files = live_files;
+        s.live_dropped = dropped;
+        s.live_blocked = blocked;
+        s.live_policy = live_policy;
+        s.live_file = live_path;
+    }
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        s.jobs_pending = jobs.size() + (job_running ? 1 : 0);
+    }
+    return s;
+}
+
+std::vector<std::string> DataExporter::take_messages() {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    std::vector<std::string> out;
+    out.swap(messages);
+    return out;
+}
@@ -0,0 +1,210 @@
+#ifndef DATAEXPORTER_H
+#define DATAEXPORTER_H
+
+#include "HistoryStore.h"
+#include "SessionSnapshot.h"
+#include "ArrowWriter.h"
+#include "PacketFilter.h"
+#include "BoundedQueue.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+enum ExportFormat {
+    EXPORT_CSV = 0,
+    EXPORT_NDJSON,
+    EXPORT_ARROW        // только пакеты и история, не реестр
+};
+
+// Декодированный пакет для экспорта
+struct ExportRecord {
+    int64_t time_ms;
+    uint32_t id;
+    uint8_t type;           // байт типа пакета; 0 - неизвестен (точки истории)
+    uint8_t fw_version;
+    int16_t temperature_c;
+    int16_t rssi;
+    float pressure_bar;
+    float voltage_v;
+};
+
+struct ExportStats {
+    bool live_active;
+    uint64_t live_rows;
+    uint64_t live_bytes;
+    uint64_t live_files;
+    uint64_t live_dropped;      // очередь переполнена
+    uint64_t live_blocked;      // ожиданий места в очереди (QUEUE_BLOCK)
+    QueuePolicy live_policy;
+    std::string live_file;
+    size_t jobs_pending;        // разовые выгрузки в очереди и в работе
+};
+
+// Файл экспорта. Строки CSV/NDJSON форматируются через std::to_chars в
+// большой переиспользуемый буфер, который целиком уходит в fwrite; для
+// Arrow записи собираются в столбцы и пишутся пачками по
+// ArrowWriter::BATCH_ROWS. При заданных ограничениях файл закрывается и
+// начинается новый (<префикс>-ГГГГММДД-ЧЧММСС.<расширение>).
+class ExportFile {
+public:
+    static const size_t BUFFER_SIZE = 1 << 20;
+    static const size_t MAX_ROW_SIZE = 512;
+
+    enum Schema {
+        SCHEMA_PACKETS = 0,
+        SCHEMA_REGISTRY
+    };
+
+    ExportFile(ExportFormat format, Schema schema);
+    ~ExportFile();
+
+    // Один файл по заданному пути
+    bool open(const std::string& path, std::string* error);
+    // Серия файлов с ротацией по размеру (байт) и возрасту (мс); 0 - без ограничения
+    bool open_rotating(const std::string& prefix, uint64_t max_bytes, int64_t max_age_ms, std::string* error);
+
+    void write(const ExportRecord& r);
+    void write(const SessionDeviceRecord& r);
+    // Источник последующих записей (только для Arrow)
+    void set_source(const std::string& name);
+    // Проверяет ротацию по времени и сбрасывает буфер в ОС
+    bool flush();
+    bool close();
+
+    uint64_t rows() const { return row_count; }
+    uint64_t bytes() const { return byte_count; }
+    uint64_t files() const { return file_count; }
+    const std::string& path() const { return current_path; }
+    bool failed() const { return error_flag; }
+
+private:
+    bool open_file(const std::string& path);
+    void close_current();
+    bool rotate();
+    void reserve_row();
+    void write_header();
+    bool drain();
+    void write_arrow_batch();
+
+    ExportFormat format;
+    Schema schema;
+    FILE* file;
+    std::vector<char> buffer;
+    size_t used;
+
+    // Arrow
+    std::unique_ptr<ArrowWriter> arrow;
+    PacketColumns columns;
+    uint16_t source;
+    bool opened;
+
+    std::string prefix;
+    uint64_t max_bytes;
+    int64_t max_age_ms;
+    int64_t opened_ms;
+    uint64_t file_bytes;
+
+    std::string current_path;
+    uint64_t row_count;
+    uint64_t byte_count;
+    uint64_t file_count;
+    bool error_flag;
+};
+
+// Экспорт данных в CSV / NDJSON.
+//
+// Непрерывный экспорт: поток чтения порта только кладет записи в очередь
+// (append), форматирование и запись выполняет отдельный поток пачками.
+// Если поток записи не успевает и очередь достигла MAX_PENDING - по
+// политике (set_live_policy): QUEUE_DROP_NEWEST (по умолчанию) - новые
+// записи отбрасываются со счетчиком, а чтение порта не ждет;
+// QUEUE_BLOCK - append ждет места, экспорт без потерь, а задержка
+// уходит в разбор (конвейер и поток чтения).
+//
+// Разовые выгрузки (реестр устройств, диапазон истории) выполняются
+// третьим потоком по очереди заданий и не мешают непрерывному экспорту.
+//
+// Фильтр (PacketFilter) применяется в потоках записи к целой пачке по
+// столбцам, поток чтения порта на него времени не тратит.
+class DataExporter {
+public:
+    static const size_t MAX_PENDING = 1 << 20;
+
+    DataExporter();
+    ~DataExporter();
+
+    bool start_live(const std::string& prefix, ExportFormat format,
+                    uint64_t rotate_bytes, int64_t rotate_ms, std::string* error);
+    void stop_live();
+    bool live_active() const { return live.load(std::memory_order_relaxed); }
+    // Имя источника (порта) для столбца source
+    void set_source(const std::string& name);
+    // Фильтр непрерывного экспорта; nullptr или пустой - все пакеты
+    void set_filter(std::shared_ptr<const PacketFilter> filter);
+    // QUEUE_BLOCK или QUEUE_DROP_NEWEST; остальные - как QUEUE_DROP_NEWEST
+    // (вытеснять или сливать строки файла нечего)
+    void set_live_policy(QueuePolicy policy);
+
+    // Поток чтения порта
+    void append(const ExportRecord& r);
+    // Пачка строк под одной блокировкой
+    void append(const ExportRecord* records, size_t count);
+
+    // Поток GUI: ставят выгрузку в очередь
+    void export_registry(const std::string& path, ExportFormat format,
+                         std::vector<SessionDeviceRecord>&& records);
+    // У точек истории нет типа и версии (0), условия на них не выполняются
+    void export_history(const std::string& path, ExportFormat format, const HistoryStore& store,
+                        uint32_t id, int64_t from_ms, int64_t to_ms,
+                        std::shared_ptr<const PacketFilter> filter = nullptr);
+
+    ExportStats stats() const;
+    // Сообщения о завершенных выгрузках
+    std::vector<std::string> take_messages();
+
+private:
+    void live_loop();
+    void job_loop();
+    void post_job(const std::function<void()>& job);
+    void post_message(const std::string& text);
+
+    // Непрерывный экспорт
+    std::atomic<bool> live;
+    mutable std::mutex live_mutex;
+    std::condition_variable live_wake;
+    std::condition_variable live_space;
+    QueuePolicy live_policy;
+    std::vector<ExportRecord> pending;
+    std::unique_ptr<ExportFile> live_file;
+    std::thread live_worker;
+    bool live_stopping;
+    uint64_t dropped;
+    uint64_t blocked;
+    uint64_t live_rows;
+    uint64_t live_bytes;
+    uint64_t live_files;
+    std::string live_path;
+    std::string live_source;
+    std::shared_ptr<const PacketFilter> live_filter;
+
+    // Разовые выгрузки
+    mutable std::mutex job_mutex;
+    std::condition_variable job_wake;
+    std::deque<std::function<void()>> jobs;
+    std::thread job_worker;
+    bool job_running;
+    bool stopping;
+    // Деструктор прерывает идущую выгрузку; недописанный файл удаляется
+    std::atomic<bool> cancelling;
+    std::vector<std::string> messages;
+};
+
+#endif
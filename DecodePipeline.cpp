@@ -0,0 +1,310 @@
+#include "DecodePipeline.h"
+#include <string.h>
+
+DecodePipeline::DecodePipeline()
+    : free_batches(nullptr), queued(0), sleeping(0), stopping(false), pending(0), waiting(0),
+      frames(0), dropped(0), batches(0), runs(0), steals(0), blocked(0) {
+}
+
+DecodePipeline::~DecodePipeline() {
+    stop();
+    while (free_batches) {
+        Batch* next = free_batches->next;
+        delete free_batches;
+        free_batches = next;
+    }
+}
+
+bool DecodePipeline::start(unsigned worker_count, unsigned source_count, DecodeHandler decode_handler,
+                           AggregateHandler aggregate_handler) {
+    stop();
+    if (worker_count == 0 || worker_count > MAX_WORKERS || source_count == 0 ||
+        !decode_handler || !aggregate_handler) {
+        return false;
+    }
+    decode = std::move(decode_handler);
+    aggregate = std::move(aggregate_handler);
+    stopping = false;
+
+    unsigned shard_count = worker_count * SHARDS_PER_WORKER;
+    if (shard_count > DEVICE_SHARDS) {
+        shard_count = DEVICE_SHARDS;
+    }
+    for (unsigned i = 0; i < shard_count; i++) {
+        shards.emplace_back(new Strand());
+        shards.back()->home = i % worker_count;
+        shards.back()->shard = (int)i;
+    }
+    for (unsigned i = 0; i < source_count; i++) {
+        sources.emplace_back(new Source());
+        sources.back()->strand.home = i % worker_count;
+        sources.back()->strand.source = i;
+        sources.back()->routed.assign(shard_count, nullptr);
+    }
+    for (unsigned i = 0; i < worker_count; i++) {
+        workers.emplace_back(new Worker());
+    }
+    for (unsigned i = 0; i < worker_count; i++) {
+        workers[i]->thread = std::thread([this, i]() { work(i); });
+    }
+    return true;
+}
+
+void DecodePipeline::stop() {
+    if (workers.empty()) {
+        return;
+    }
+    for (unsigned i = 0; i < sources.size(); i++) {
+        flush(i);
+    }
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake_cv.notify_all();
+    for (auto& w : workers) {
+        w->thread.join();
+    }
+    workers.clear();
+    sources.clear();
+    shards.clear();
+}
+
+DecodePipeline::Batch* DecodePipeline::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(free_mutex);
+        if (free_batches) {
+            Batch* batch = free_batches;
+            free_batches = batch->next;
+            batch->count = 0;
+            return batch;
+        }
+    }
+    Batch* batch = new Batch;
+    batch->next = nullptr;
+    batch->count = 0;
+    return batch;
+}
+
+void DecodePipeline::release(Batch* batch) {
+    std::lock_guard<std::mutex> lock(free_mutex);
+    batch->next = free_batches;
+    free_batches = batch;
+}
+
+void DecodePipeline::push(unsigned source, const uint8_t* frame, int64_t rx_us) {
+    Source& src = *sources[source];
+    if (!src.filling) {
+        src.filling = acquire();
+    }
+    PipelineFrame& f = src.filling->frames[src.filling->count++];
+    memcpy(f.raw, frame, PACKET_SIZE);
+    f.rx_us = rx_us;
+    f.source = source;
+    f.sequence = 0;
+    if (src.filling->count == BATCH_FRAMES) {
+        flush(source);
+    }
+}
+
+void DecodePipeline::flush(unsigned source) {
+    Source& src = *sources[source];
+    if (!src.filling || src.filling->count == 0) {
+        return;
+    }
+    wait_capacity();
+    frames.fetch_add(src.filling->count, std::memory_order_relaxed);
+    enqueue(&src.strand, src.filling);
+    src.filling = nullptr;
+}
+
+void DecodePipeline::wait_capacity() {
+    if (pending.load(std::memory_order_acquire) < MAX_PENDING) {
+        return;
+    }
+    blocked.fetch_add(1, std::memory_order_relaxed);
+    // Пара с finished(): либо там видно ждущего, либо здесь - уменьшенный
+    // pending
+    std::unique_lock<std::mutex> lock(done_mutex);
+    waiting.fetch_add(1);
+    done_cv.wait(lock, [this]() { return pending.load() < MAX_PENDING; });
+    waiting.fetch_sub(1);
+}
+
+void DecodePipeline::enqueue(Strand* strand, Batch* batch) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(strand->mutex);
+        strand->batches.push_back(batch);
+        idle = !strand->scheduled;
+        strand->scheduled = true;
+    }
+    if (idle) {
+        schedule(strand);
+    }
+}
+
+void DecodePipeline::schedule(Strand* strand) {
+    Worker& w = *workers[strand->home];
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.ready.push_back(strand);
+    }
+    // Пара с проверкой в work(): либо спящий поток увидит queued, либо
+    // здесь видно, что он спит
+    queued.fetch_add(1);
+    if (sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wake_cv.notify_one();
+    }
+}
+
+DecodePipeline::Strand* DecodePipeline::take(unsigned worker, bool* stolen) {
+    unsigned n = (unsigned)workers.size();
+    for (unsigned i = 0; i < n; i++) {
+        Worker& w = *workers[(worker + i) % n];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (w.ready.empty()) {
+            continue;
+        }
+        Strand* strand;
+        if (i == 0) {
+            strand = w.ready.front();
+            w.ready.pop_front();
+        } else {
+            strand = w.ready.back();
+            w.ready.pop_back();
+        }
+        queued.fetch_sub(1);
+        *stolen = i != 0;
+        return strand;
+    }
+    return nullptr;
+}
+
+void DecodePipeline::run(Strand* strand) {
+    uint64_t done = 0;
+    bool yield = false;
+    for (;;) {
+        Batch* batch;
+        {
+            std::lock_guard<std::mutex> lock(strand->mutex);
+            if (strand->batches.empty()) {
+                strand->scheduled = false;
+                break;
+            }
+            if (done == RUN_LIMIT) {
+                yield = true;
+                break;
+            }
+            batch = strand->batches.front();
+            strand->batches.pop_front();
+        }
+
+        if (strand->shard < 0) {
+            decode_batch(*sources[strand->source], batch);
+        } else {
+            aggregate((unsigned)strand->shard, batch->frames, batch->count);
+        }
+        release(batch);
+        done++;
+    }
+    finished(done);
+    if (yield) {
+        // Остальные очереди потока тоже ждут: эта остается
+        // запланированной и встает в конец
+        schedule(strand);
+    }
+}
+
+void DecodePipeline::decode_batch(Source& src, Batch* batch) {
+    for (uint32_t i = 0; i < batch->count; i++) {
+        PipelineFrame& f = batch->frames[i];
+        decode_packet(f.raw, f.decoded);
+        if (!decode(f)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        unsigned shard = shard_of(f.decoded.id);
+        Batch*& out = src.routed[shard];
+        if (!out) {
+            out = acquire();
+            src.touched.push_back(shard);
+        }
+        out->frames[out->count++] = f;
+        if (out->count == BATCH_FRAMES) {
+            enqueue(shards[shard].get(), out);
+            out = acquire();
+        }
+    }
+
+    // Неполные пачки сегментов уходят сразу: задержка кадра - не больше
+    // одной пачки источника
+    for (unsigned shard : src.touched) {
+        Batch*& out = src.routed[shard];
+        if (out->count) {
+            enqueue(shards[shard].get(), out);
+        } else {
+            release(out);
+        }
+        out = nullptr;
+    }
+    src.touched.clear();
+}
+
+void DecodePipeline::finished(uint64_t done) {
+    if (done == 0) {
+        return;
+    }
+    batches.fetch_add(done, std::memory_order_relaxed);
+    uint64_t left = pending.fetch_sub(done) - done;
+    if (left == 0 || (left < MAX_PENDING && waiting.load() > 0)) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done_cv.notify_all();
+    }
+}
+
+void DecodePipeline::drain() {
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [this]() { return pending.load(std::memory_order_acquire) == 0; });
+}
+
+void DecodePipeline::work(unsigned worker) {
+    for (;;) {
+        bool stolen = false;
+        Strand* strand = take(worker, &stolen);
+        if (strand) {
+            runs.fetch_add(1, std::memory_order_relaxed);
+            if (stolen) {
+                steals.fetch_add(1, std::memory_order_relaxed);
+            }
+            run(strand);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleeping.fetch_add(1);
+        while (queued.load() == 0 && !stopping) {
+            wake_cv.wait(lock);
+        }
+        sleeping.fetch_sub(1);
+        if (stopping && queued.load() == 0) {
+            break;
+        }
+    }
+}
+
+PipelineStats DecodePipeline::stats() const {
+    PipelineStats s;
+    s.frames = frames.load(std::memory_order_relaxed);
+    s.dropped = dropped.load(std::memory_order_relaxed);
+    s.batches = batches.load(std::memory_order_relaxed);
+    s.runs = runs.load(std::memory_order_relaxed);
+    s.steals = steals.load(std::memory_order_relaxed);
+    s.pending = pending.load(std::memory_order_relaxed);
+    s.blocked = blocked.load(std::memory_order_relaxed);
+    return s;
+}
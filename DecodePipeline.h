@@ -0,0 +1,182 @@
+#ifndef DECODEPIPELINE_H
+#define DECODEPIPELINE_H
+
+#include "PacketDecoder.h"
+#include "DeviceIndex.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Кадр в конвейере: сырые байты, разбор и метка приема
+struct PipelineFrame {
+    DecodedPacket decoded;
+    int64_t rx_us;              // метка приема (RxClock)
+    uint64_t sequence;          // номер кадра; заполняет обработчик разбора
+    uint32_t source;            // номер источника (потока чтения)
+    uint8_t raw[PACKET_SIZE];
+};
+
+// Счетчики конвейера; читаются из любого потока
+struct PipelineStats {
+    uint64_t frames;            // кадров от потоков чтения
+    uint64_t dropped;           // отброшено стадией разбора
+    uint64_t batches;           // пачек обработано (обе стадии)
+    uint64_t runs;              // запусков очередей рабочими потоками
+    uint64_t steals;            // ... из них взятых у другого потока
+    uint64_t pending;           // пачек в работе сейчас
+    uint64_t blocked;           // ожиданий потока чтения при MAX_PENDING
+};
+
+// Конвейер разбора и агрегатов на пуле потоков с перехватом работы.
+//
+// Потоки чтения только собирают кадры и отдают их пачками (push/flush),
+// дальше две стадии:
+//   разбор   - очередь источника: decode_packet и обработчик разбора
+//              (списки допуска, нумерация, запись захвата), затем кадры
+//              раскладываются по сегментам по хешу ID устройства;
+//   агрегаты - очередь сегмента: обработчик агрегатов по кадрам сегмента.
+// Каждая очередь выполняется одним потоком за раз строго по порядку
+// поступления. Кадры источника поэтому разбираются по порядку, а кадры
+// одного устройства, всегда попадающие в один сегмент, доходят до
+// агрегатов в порядке приема. Разные источники и сегменты идут
+// параллельно.
+//
+// Очередь сегмента ведет группу сегментов таблиц (DEVICE_SHARDS,
+// DeviceStats): сегмент s - в очереди s % очередей, поэтому сегмент
+// таблицы пишет только одна очередь и без блокировок. Очередей
+// SHARDS_PER_WORKER на поток (пачки сегментов не дробятся до одного
+// кадра), владелец очереди - поток очередь % потоков: без перекоса
+// нагрузки кадры сегмента обрабатывает один и тот же поток с теплым
+// кэшем.
+//
+// У рабочего потока своя очередь готовых к запуску очередей: свои
+// берутся с начала, простаивающий поток забирает чужие с конца. Перекос
+// по устройствам выравнивается перехватом целых сегментов; писатель у
+// сегмента и тогда один - очередь выполняется одним потоком за раз.
+//
+// Пачки берутся из списка свободных: в установившемся режиме конвейер
+// памяти не выделяет. Пачек в работе не больше MAX_PENDING: дальше поток
+// чтения ждет в push/flush (политика QUEUE_BLOCK) - кадры для захвата и
+// статистики не теряются, а очередь не растет без предела; отставание
+// остается в буфере источника.
+class DecodePipeline {
+public:
+    static const unsigned BATCH_FRAMES = 64;
+    // Не больше, чем сегментов: у каждого потока свой сегмент
+    static const unsigned MAX_WORKERS = DEVICE_SHARDS;
+    static const unsigned SHARDS_PER_WORKER = 4;
+    static const uint64_t MAX_PENDING = 1024;
+
+    // Стадия разбора, по порядку кадров источника; false - кадр отбросить
+    typedef std::function<bool(PipelineFrame& frame)> DecodeHandler;
+    // Стадия агрегатов: кадры сегмента shard по порядку
+    typedef std::function<void(unsigned shard, const PipelineFrame* frames, size_t count)> AggregateHandler;
+
+    DecodePipeline();
+    ~DecodePipeline();
+
+    // workers рабочих потоков, sources источников со своими потоками
+    // чтения; идущий конвейер останавливается
+    bool start(unsigned workers, unsigned sources, DecodeHandler decode, AggregateHandler aggregate);
+    // Дообрабатывает отданное и завершает рабочие потоки. Потоки чтения
+    // к этому моменту должны быть остановлены.
+    void stop();
+    bool running() const { return !workers.empty(); }
+
+    unsigned worker_count() const { return (unsigned)workers.size(); }
+    unsigned shard_count() const { return (unsigned)shards.size(); }
+    unsigned shard_of(uint32_t id) const { return device_shard(id) % (unsigned)shards.size(); }
+
+    // Поток чтения источника source: кадр в текущую пачку, полная пачка
+    // уходит в работу сама
+    void push(unsigned source, const uint8_t* frame, int64_t rx_us);
+    // Отдать неполную пачку (конец прочитанной порции)
+    void flush(unsigned source);
+    // Ждет, пока все отданное пройдет обе стадии
+    void drain();
+
+    PipelineStats stats() const;
+
+private:
+    // Очередь выполняет не больше стольких пачек подряд, потом уступает
+    static const unsigned RUN_LIMIT = 8;
+
+    struct Batch {
+        Batch* next;            // в списке свободных
+        uint32_t count;
+        PipelineFrame frames[BATCH_FRAMES];
+    };
+
+    // Пачки, обрабатываемые одним потоком за раз
+    struct Strand {
+        std::mutex mutex;
+        std::deque<Batch*> batches;
+        bool scheduled = false;     // стоит в очереди потока или выполняется
+        unsigned home = 0;          // поток по умолчанию
+        int shard = -1;             // -1 - очередь разбора источника
+        unsigned source = 0;
+    };
+
+    struct Source {
+        Strand strand;
+        Batch* filling = nullptr;       // только поток чтения
+        std::vector<Batch*> routed;     // по сегментам; только стадия разбора
+        std::vector<unsigned> touched;
+    };
+
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Strand*> ready;
+        std::thread thread;
+    };
+
+    Batch* acquire();
+    void release(Batch* batch);
+    void enqueue(Strand* strand, Batch* batch);
+    void schedule(Strand* strand);
+    Strand* take(unsigned worker, bool* stolen);
+    void run(Strand* strand);
+    void decode_batch(Source& source, Batch* batch);
+    void finished(uint64_t batches);
+    // Поток чтения: ждет, пока пачек в работе станет меньше MAX_PENDING
+    void wait_capacity();
+    void work(unsigned worker);
+
+    DecodeHandler decode;
+    AggregateHandler aggregate;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::unique_ptr<Source>> sources;
+    std::vector<std::unique_ptr<Strand>> shards;
+
+    std::mutex free_mutex;
+    Batch* free_batches;
+
+    // Готовых очередей во всех потоках и спящих потоков: по ним поток,
+    // поставивший работу, решает, будить ли кого-то
+    std::atomic<uint64_t> queued;
+    std::atomic<unsigned> sleeping;
+    std::mutex sleep_mutex;
+    std::condition_variable wake_cv;
+    bool stopping;
+
+    std::atomic<uint64_t> pending;
+    std::atomic<unsigned> waiting;      // потоков чтения в wait_capacity()
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> runs;
+    std::atomic<uint64_t> steals;
+    std::atomic<uint64_t> blocked;
+};
+
+#endif
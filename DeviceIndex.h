@@ -0,0 +1,119 @@
+#ifndef DEVICEINDEX_H
+#define DEVICEINDEX_H
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+// Таблица соответствия ID устройства -> плотный номер слота.
+// Писатели (поток чтения порта или сегменты DecodePipeline) добавляют
+// записи, любое число читателей ищет их без блокировок. Записи никогда
+// не удаляются. Найденное устройство писатель тоже получает без
+// блокировки; только новое добавляется под мьютексом, так что писателей
+// может быть несколько.
+// Каждая ячейка - одно 64-битное слово (ID в старшей половине, слот+1 в
+// младшей), поэтому запись публикуется одной атомарной операцией.
+class DeviceIndex {
+public:
+    static const uint32_t NOT_FOUND = UINT32_MAX;
+
+    explicit DeviceIndex(uint32_t max_devices)
+        : capacity(round_up_pow2(max_devices * 2)),
+          max_count(max_devices),
+          count(0),
+          cells(new std::atomic<uint64_t>[capacity]) {
+        for (uint32_t i = 0; i < capacity; i++) {
+            cells[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Для писателей. Возвращает NOT_FOUND, если таблица заполнена.
+    uint32_t find_or_insert(uint32_t id) {
+        uint32_t found = find(id);
+        if (found != NOT_FOUND) {
+            return found;
+        }
+
+        std::lock_guard<std::mutex> lock(insert_mutex);
+        uint32_t mask = capacity - 1;
+        for (uint32_t i = hash(id) & mask;; i = (i + 1) & mask) {
+            uint64_t cell = cells[i].load(std::memory_order_relaxed);
+            if (cell == 0) {
+                uint32_t n = count.load(std::memory_order_relaxed);
+                if (n >= max_count) {
+                    return NOT_FOUND;
+                }
+                cells[i].store(((uint64_t)id << 32) | (n + 1), std::memory_order_release);
+                count.store(n + 1, std::memory_order_release);
+                return n;
+            }
+            if ((uint32_t)(cell >> 32) == id) {
+                return (uint32_t)cell - 1;
+            }
+        }
+    }
+
+    uint32_t find(uint32_t id) const {
+        uint32_t mask = capacity - 1;
+        for (uint32_t i = hash(id) & mask;; i = (i + 1) & mask) {
+            uint64_t cell = cells[i].load(std::memory_order_acquire);
+            if (cell == 0) {
+                return NOT_FOUND;
+            }
+            if ((uint32_t)(cell >> 32) == id) {
+                return (uint32_t)cell - 1;
+            }
+        }
+    }
+
+    uint32_t size() const { return count.load(std::memory_order_acquire); }
+    uint32_t max_size() const { return max_count; }
+
+    // Забывает все ID; только когда к таблице никто не обращается
+    void clear() {
+        for (uint32_t i = 0; i < capacity; i++) {
+            cells[i].store(0, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_release);
+    }
+
+    static uint32_t hash(uint32_t id) {
+        // Перемешивание (murmur3 fmix32): ID датчиков часто идут подряд
+        id ^= id >> 16;
+        id *= 0x85EBCA6Bu;
+        id ^= id >> 13;
+        id *= 0xC2B2AE35u;
+        id ^= id >> 16;
+        return id;
+    }
+
+private:
+    static uint32_t round_up_pow2(uint32_t v) {
+        uint32_t p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+    const uint32_t capacity;
+    const uint32_t max_count;
+    std::atomic<uint32_t> count;
+    std::unique_ptr<std::atomic<uint64_t>[]> cells;
+    std::mutex insert_mutex;
+};
+
+// Предел числа устройств в таблицах по ID (с запасом для парка в 100
+// тыс.); общий для всех таблиц, чтобы устройство не пропадало из одних
+// и оставалось в других.
+static const uint32_t MAX_TRACKED_DEVICES = 1u << 18;
+
+// Сегменты состояния устройств. Сегмент устройства - по хешу ID, общий
+// для DecodePipeline и сегментированных таблиц (DeviceStats), так что
+// сегмент таблицы пишет только поток, обрабатывающий сегмент конвейера.
+static const unsigned DEVICE_SHARDS = 64;
+
+inline unsigned device_shard(uint32_t id) {
+    return DeviceIndex::hash(id) % DEVICE_SHARDS;
+}
+
+#endif
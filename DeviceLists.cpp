@@ -0,0 +1,244 @@
+#include "DeviceLists.h"
+#include <stdlib.h>
+#include <ctype.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// ========== DeviceIdSet ==========
+
+DeviceIdSet::DeviceIdSet() : prefixes(1024, 0) {
+}
+
+void DeviceIdSet::add(uint32_t lo, uint32_t hi) {
+    if (lo > hi) {
+        std::swap(lo, hi);
+    }
+    for (uint32_t p = lo >> 16; ; p++) {
+        prefixes[p >> 6] |= 1ull << (p & 63);
+        if (p == hi >> 16) {
+            break;
+        }
+    }
+    if (lo == hi) {
+        ids.insert(lo);
+    } else {
+        ranges.push_back(Range{lo, hi});
+    }
+}
+
+void DeviceIdSet::finish() {
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+        return a.lo < b.lo;
+    });
+
+    // Смежные и пересекающиеся диапазоны объединяются
+    size_t out = 0;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (out > 0 && (ranges[out - 1].hi == UINT32_MAX || ranges[i].lo <= ranges[out - 1].hi + 1)) {
+            ranges[out - 1].hi = std::max(ranges[out - 1].hi, ranges[i].hi);
+        } else {
+            ranges[out++] = ranges[i];
+        }
+    }
+    ranges.resize(out);
+    ranges.shrink_to_fit();
+
+    // Отдельные ID внутри диапазонов не нужны
+    for (auto it = ids.begin(); it != ids.end();) {
+        if (in_ranges(*it)) {
+            it = ids.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool DeviceIdSet::in_ranges(uint32_t id) const {
+    // Последний диапазон с lo <= id
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), id, [](uint32_t v, const Range& r) {
+        return v < r.lo;
+    });
+    return it != ranges.begin() && id <= (it - 1)->hi;
+}
+
+// ========== DeviceLists ==========
+
+DeviceLists::DeviceLists() : version(0), dropped(0), file_exists(false), file_mtime(0) {
+}
+
+static bool parse_id(const std::string& s, uint32_t& out) {
+    if (s.empty() || !isdigit((unsigned char)s[0])) {
+        return false;
+    }
+    char* end = nullptr;
+    unsigned long long v = strtoull(s.c_str(), &end, 0);
+    if (*end != '\0' || v > UINT32_MAX) {
+        return false;
+    }
+    out = (uint32_t)v;
+    return true;
+}
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) {
+        return std::string();
+    }
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+bool DeviceLists::parse(const std::string& text, std::string* error) {
+    std::shared_ptr<DeviceListSet> set = std::make_shared<DeviceListSet>();
+
+    std::istringstream in(text);
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash);
+        }
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+
+        size_t space = line.find_first_of(" \t");
+        std::string keyword = line.substr(0, space);
+        DeviceIdSet* target = nullptr;
+        if (keyword == "allow") {
+            target = &set->allow;
+        } else if (keyword == "deny") {
+            target = &set->deny;
+        } else {
+            if (error) *error = "строка " + std::to_string(line_no) + ": ожидалось allow или deny";
+            return false;
+        }
+
+        std::string items = space == std::string::npos ? std::string() : line.substr(space + 1);
+        std::istringstream list(items);
+        std::string item;
+        int count = 0;
+        while (std::getline(list, item, ',')) {
+            item = trim(item);
+            size_t dots = item.find("..");
+            uint32_t lo = 0, hi = 0;
+            bool ok;
+            if (dots == std::string::npos) {
+                ok = parse_id(item, lo);
+                hi = lo;
+            } else {
+                ok = parse_id(trim(item.substr(0, dots)), lo) && parse_id(trim(item.substr(dots + 2)), hi);
+            }
+            if (!ok) {
+                if (error) *error = "строка " + std::to_string(line_no) + ": неверный ID \"" + item + "\"";
+                return false;
+            }
+            target->add(lo, hi);
+            count++;
+        }
+        if (count == 0) {
+            if (error) *error = "строка " + std::to_string(line_no) + ": пустой список";
+            return false;
+        }
+    }
+
+    set->allow.finish();
+    set->deny.finish();
+    install(set->allow.empty() && set->deny.empty() ? nullptr : set);
+    return true;
+}
+
+bool DeviceLists::load_file(const std::string& path, std::string* error) {
+    std::error_code ec;
+    fs::file_time_type mtime = fs::last_write_time(path, ec);
+
+    // Путь и время запоминаются и при ошибке разбора: исправленный файл
+    // подхватится следующим reload_if_changed()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        file_path = path;
+        file_exists = !ec;
+        file_mtime = ec ? 0 : (int64_t)mtime.time_since_epoch().count();
+    }
+
+    std::ifstream f(path);
+    if (!f) {
+        if (error) *error = "не удалось открыть " + path;
+        return false;
+    }
+    std::stringstream buf;
+    buf << f.rdbuf();
+    return parse(buf.str(), error);
+}
+
+bool DeviceLists::reload_if_changed(const std::string& path, bool* reloaded, std::string* error) {
+    if (reloaded) *reloaded = false;
+
+    std::string known_path;
+    bool known_exists = false;
+    int64_t known_mtime = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        known_path = file_path;
+        known_exists = file_exists;
+        known_mtime = file_mtime;
+    }
+
+    // Время файла сравнивается только на равенство: его эпоха зависит
+    // от библиотеки
+    std::error_code ec;
+    fs::file_time_type mtime = fs::last_write_time(path, ec);
+    bool exists = !ec;
+    int64_t current_mtime = exists ? (int64_t)mtime.time_since_epoch().count() : 0;
+    if (path == known_path && exists == known_exists && current_mtime == known_mtime) {
+        return true;
+    }
+
+    if (!exists) {
+        // Файла нет: списки снимаются, если были
+        bool had_lists;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            file_path = path;
+            file_exists = false;
+            file_mtime = 0;
+            had_lists = lists != nullptr;
+        }
+        if (had_lists) {
+            install(nullptr);
+            if (reloaded) *reloaded = true;
+        }
+        return true;
+    }
+
+    if (reloaded) *reloaded = true;
+    return load_file(path, error);
+}
+
+void DeviceLists::install(std::shared_ptr<const DeviceListSet> set) {
+    std::lock_guard<std::mutex> lock(mutex);
+    lists = std::move(set);
+    version.fetch_add(1, std::memory_order_release);
+}
+
+std::shared_ptr<const DeviceListSet> DeviceLists::current() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lists;
+}
+
+size_t DeviceLists::allow_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lists ? lists->allow.id_count() + lists->allow.range_count() : 0;
+}
+
+size_t DeviceLists::deny_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lists ? lists->deny.id_count() + lists->deny.range_count() : 0;
+}
@@ -0,0 +1,108 @@
+#ifndef DEVICELISTS_H
+#define DEVICELISTS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Множество ID устройств: отдельные ID в хэш-множестве, диапазоны -
+// отсортированный список без пересечений. Перед ними битовая карта по
+// старшим 16 битам ID (8 КБ): ID из блока, где нет ни одного элемента,
+// отсекается одной проверкой бита - так отбрасывается почти весь чужой
+// трафик, у которого другой префикс ID.
+class DeviceIdSet {
+public:
+    DeviceIdSet();
+
+    void add(uint32_t lo, uint32_t hi);
+    // Сортирует и объединяет диапазоны; вызывается после всех add()
+    void finish();
+
+    bool empty() const { return ids.empty() && ranges.empty(); }
+    size_t id_count() const { return ids.size(); }
+    size_t range_count() const { return ranges.size(); }
+
+    bool contains(uint32_t id) const {
+        if (!(prefixes[id >> 22] >> ((id >> 16) & 63) & 1)) {
+            return false;
+        }
+        return ids.count(id) != 0 || in_ranges(id);
+    }
+
+private:
+    struct Range {
+        uint32_t lo;
+        uint32_t hi;
+    };
+
+    bool in_ranges(uint32_t id) const;
+
+    std::vector<uint64_t> prefixes;     // бит на каждые 65536 ID
+    std::unordered_set<uint32_t> ids;
+    std::vector<Range> ranges;
+};
+
+// Списки допуска и запрета устройств, неизменяемые после разбора
+struct DeviceListSet {
+    DeviceIdSet allow;      // пусто - допускаются все
+    DeviceIdSet deny;       // имеет приоритет над allow
+
+    bool accept(uint32_t id) const {
+        if (!deny.empty() && deny.contains(id)) {
+            return false;
+        }
+        return allow.empty() || allow.contains(id);
+    }
+};
+
+// Списки допуска/запрета устройств из файла:
+//
+//   # свои датчики
+//   allow 0x1A000000..0x1A00FFFF, 0x1B2C3D4E
+//   deny  0x1A000010
+//
+// Проверка выполняется потоком чтения сразу после разбора кадра, до
+// статистики, форматирования строки и сигнала в GUI. Файл можно менять
+// на ходу: reload_if_changed() собирает новый набор и подменяет его
+// целиком, при ошибке в файле действует прежний. Поток чтения держит
+// свою копию указателя на набор и берет новую только при смене
+// поколения (одно атомарное чтение на кадр).
+class DeviceLists {
+public:
+    DeviceLists();
+
+    // Заменяет списки; при ошибке старые остаются в силе
+    bool parse(const std::string& text, std::string* error);
+    bool load_file(const std::string& path, std::string* error);
+    // Загружает файл, если он появился или изменился с прошлого вызова
+    // (по времени изменения); удаленный файл снимает списки.
+    // Вызывается по таймеру, первый вызов - начальная загрузка.
+    bool reload_if_changed(const std::string& path, bool* reloaded, std::string* error);
+
+    // Поток чтения
+    uint64_t generation() const { return version.load(std::memory_order_acquire); }
+    std::shared_ptr<const DeviceListSet> current() const;
+    void count_dropped() { dropped.fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+    size_t allow_count() const;
+    size_t deny_count() const;
+
+private:
+    void install(std::shared_ptr<const DeviceListSet> set);
+
+    mutable std::mutex mutex;
+    std::shared_ptr<const DeviceListSet> lists;     // nullptr - без ограничений
+    std::atomic<uint64_t> version;
+    std::atomic<uint64_t> dropped;
+
+    std::string file_path;
+    bool file_exists;
+    int64_t file_mtime;
+};
+
+#endif
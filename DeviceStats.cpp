@@ -0,0 +1,363 @@
+#include "DeviceStats.h"
+#include <cmath>
+
+DeviceStats::Slot::Slot() : version(0), id(0), count(0), window_base(0) {
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        fields[f].min.store(0.0f, std::memory_order_relaxed);
+        fields[f].max.store(0.0f, std::memory_order_relaxed);
+        fields[f].mean.store(0.0, std::memory_order_relaxed);
+        fields[f].m2.store(0.0, std::memory_order_relaxed);
+        fields[f].ewma.store(0.0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < WINDOW_SIZE; i++) {
+            window[f][i].store(0.0f, std::memory_order_relaxed);
+        }
+    }
+}
+
+void DeviceStats::Slot::begin_write() {
+    // Нечетная версия - запись идет; барьер не дает данным обогнать ее
+    version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void DeviceStats::Slot::end_write() {
+    version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+DeviceStats::Shard::Shard() : index(SHARD_DEVICES), last_id(0), last_slot(nullptr), devices(0) {
+    for (uint32_t i = 0; i < SHARD_CHUNKS; i++) {
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+DeviceStats::Shard::~Shard() {
+    for (uint32_t i = 0; i < SHARD_CHUNKS; i++) {
+        delete[] chunks[i].load(std::memory_order_relaxed);
+    }
+}
+
+DeviceStats::Slot* DeviceStats::Shard::slot(uint32_t n) const {
+    Slot* chunk = chunks[n / CHUNK_SIZE].load(std::memory_order_acquire);
+    return chunk ? &chunk[n % CHUNK_SIZE] : nullptr;
+}
+
+DeviceStats::DeviceStats(double ewma_alpha) : alpha(ewma_alpha) {
+}
+
+DeviceStats::Slot* DeviceStats::slot_for(uint32_t id) {
+    Shard& sh = shards[device_shard(id)];
+    if (sh.last_slot && sh.last_id == id) {
+        return sh.last_slot;
+    }
+
+    uint32_t n = sh.index.find_or_insert(id);
+    if (n == DeviceIndex::NOT_FOUND) {
+        return nullptr;     // сегмент заполнен
+    }
+    uint32_t c = n / CHUNK_SIZE;
+    Slot* chunk = sh.chunks[c].load(std::memory_order_relaxed);
+    if (!chunk) {
+        // Писатель у сегмента один: блок публикуется без сравнения
+        chunk = new Slot[CHUNK_SIZE];
+        sh.chunks[c].store(chunk, std::memory_order_release);
+    }
+
+    sh.last_id = id;
+    sh.last_slot = &chunk[n % CHUNK_SIZE];
+    return sh.last_slot;
+}
+
+const DeviceStats::Slot* DeviceStats::find(uint32_t id) const {
+    const Shard& sh = shards[device_shard(id)];
+    uint32_t n = sh.index.find(id);
+    return n == DeviceIndex::NOT_FOUND ? nullptr : sh.slot(n);
+}
+
+void DeviceStats::update(uint32_t id, const float values[STAT_FIELD_COUNT]) {
+    Slot* s = slot_for(id);
+    if (!s) {
+        return;
+    }
+
+    const std::memory_order rx = std::memory_order_relaxed;
+    s->begin_write();
+    uint64_t n = s->count.load(rx) + 1;
+    s->count.store(n, rx);
+    if (n == 1) {
+        s->id.store(id, rx);
+        std::atomic<uint32_t>& devices = shards[device_shard(id)].devices;
+        devices.store(devices.load(rx) + 1, rx);
+    }
+    uint32_t window_pos = (uint32_t)((n - 1 - s->window_base.load(rx)) % WINDOW_SIZE);
+
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        Slot::Field& c = s->fields[f];
+        float x = values[f];
+
+        if (n == 1) {
+            c.min.store(x, rx);
+            c.max.store(x, rx);
+            c.mean.store(x, rx);
+            c.m2.store(0.0, rx);
+            c.ewma.store(x, rx);
+        } else {
+            if (x < c.min.load(rx)) c.min.store(x, rx);
+            if (x > c.max.load(rx)) c.max.store(x, rx);
+
+            // Алгоритм Уэлфорда
+            double mean = c.mean.load(rx);
+            double delta = x - mean;
+            mean += delta / (double)n;
+            c.mean.store(mean, rx);
+            c.m2.store(c.m2.load(rx) + delta * (x - mean), rx);
+
+            double ewma = c.ewma.load(rx);
+            c.ewma.store(ewma + alpha * (x - ewma), rx);
+        }
+
+        s->window[f][window_pos].store(x, rx);
+    }
+    s->end_write();
+}
+
+bool DeviceStats::read_slot(const Slot& s, SlotCopy& out) {
+    const std::memory_order rx = std::memory_order_relaxed;
+    for (;;) {
+        uint32_t before = s.version.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;       // писатель внутри записи, это десятки наносекунд
+        }
+        out.id = s.id.load(rx);
+        out.count = s.count.load(rx);
+        out.window_base = s.window_base.load(rx);
+        for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+            out.fields[f].min = s.fields[f].min.load(rx);
+            out.fields[f].max = s.fields[f].max.load(rx);
+            out.fields[f].mean = s.fields[f].mean.load(rx);
+            out.fields[f].m2 = s.fields[f].m2.load(rx);
+            out.fields[f].ewma = s.fields[f].ewma.load(rx);
+            for (uint32_t i = 0; i < WINDOW_SIZE; i++) {
+                out.window[f][i] = s.window[f][i].load(rx);
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.version.load(rx) == before) {
+            break;
+        }
+    }
+    return out.count != 0;
+}
+
+void DeviceStats::fill_summary(const SlotCopy& s, int field, FieldSummary& out) {
+    const DeviceStatsState::Field& c = s.fields[field];
+    uint64_t n = s.count;
+
+    out.count = n;
+    out.min = c.min;
+    out.max = c.max;
+    out.mean = c.mean;
+    out.stddev = n > 1 ? std::sqrt(c.m2 / (double)(n - 1)) : 0.0;
+    out.ewma = c.ewma;
+
+    // Окно пересчитываем при чтении: запись остается дешевой
+    uint64_t in_window = n - s.window_base;
+    uint32_t w = in_window < WINDOW_SIZE ? (uint32_t)in_window : WINDOW_SIZE;
+    const float* window = s.window[field];
+
+    out.window_count = w;
+    out.window_min = w ? window[0] : 0.0f;
+    out.window_max = w ? window[0] : 0.0f;
+
+    double mean = 0.0;
+    double m2 = 0.0;
+    for (uint32_t i = 0; i < w; i++) {
+        float x = window[i];
+        if (x < out.window_min) out.window_min = x;
+        if (x > out.window_max) out.window_max = x;
+
+        double delta = x - mean;
+        mean += delta / (double)(i + 1);
+        m2 += delta * (x - mean);
+    }
+
+    out.window_mean = mean;
+    out.window_stddev = w > 1 ? std::sqrt(m2 / (double)(w - 1)) : 0.0;
+}
+
+bool DeviceStats::snapshot(uint32_t id, DeviceStatsSnapshot& out) const {
+    const Slot* s = find(id);
+    SlotCopy copy;
+    if (!s || !read_slot(*s, copy)) {
+        return false;
+    }
+
+    out.id = id;
+    out.count = copy.count;
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        fill_summary(copy, f, out.fields[f]);
+    }
+    return true;
+}
+
+void DeviceStats::snapshot_all(std::vector<DeviceStatsSnapshot>& out) const {
+    out.clear();
+    SlotCopy copy;
+    for (const Shard& sh : shards) {
+        uint32_t count = sh.index.size();
+        for (uint32_t n = 0; n < count; n++) {
+            const Slot* s = sh.slot(n);
+            if (!s || !read_slot(*s, copy)) {
+                continue;
+            }
+            DeviceStatsSnapshot snap;
+            snap.id = copy.id;
+            snap.count = copy.count;
+            for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+                fill_summary(copy, f, snap.fields[f]);
+            }
+            out.push_back(snap);
+        }
+    }
+}
+
+// Объединение сводок по формулам Чана: среднее и сумма квадратов
+// отклонений двух выборок без исходных значений
+static void merge_moments(uint64_t& n, double& mean, double& m2,
+                          uint64_t n_b, double mean_b, double m2_b) {
+    if (n_b == 0) {
+        return;
+    }
+    uint64_t total = n + n_b;
+    double delta = mean_b - mean;
+    mean += delta * (double)n_b / (double)total;
+    m2 += m2_b + delta * delta * (double)n * (double)n_b / (double)total;
+    n = total;
+}
+
+void DeviceStats::merged(FieldSummary out[STAT_FIELD_COUNT], size_t* devices) const {
+    struct Acc {
+        uint64_t n = 0, wn = 0;
+        double mean = 0, m2 = 0, wmean = 0, wm2 = 0, ewma = 0;
+        float min = 0, max = 0, wmin = 0, wmax = 0;
+    } acc[STAT_FIELD_COUNT];
+    size_t found = 0;
+
+    SlotCopy copy;
+    for (const Shard& sh : shards) {
+        uint32_t count = sh.index.size();
+        for (uint32_t n = 0; n < count; n++) {
+            const Slot* s = sh.slot(n);
+            if (!s || !read_slot(*s, copy)) {
+                continue;
+            }
+            found++;
+            for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+                FieldSummary d;
+                fill_summary(copy, f, d);
+                Acc& a = acc[f];
+                if (a.n == 0 || d.min < a.min) a.min = d.min;
+                if (a.n == 0 || d.max > a.max) a.max = d.max;
+                a.ewma += d.ewma * (double)d.count;
+                merge_moments(a.n, a.mean, a.m2, d.count, d.mean, copy.fields[f].m2);
+
+                if (d.window_count) {
+                    if (a.wn == 0 || d.window_min < a.wmin) a.wmin = d.window_min;
+                    if (a.wn == 0 || d.window_max > a.wmax) a.wmax = d.window_max;
+                    double wm2 = d.window_stddev * d.window_stddev * (double)(d.window_count - 1);
+                    merge_moments(a.wn, a.wmean, a.wm2, d.window_count, d.window_mean, wm2);
+                }
+            }
+        }
+    }
+
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        const Acc& a = acc[f];
+        FieldSummary& o = out[f];
+        o.count = a.n;
+        o.min = a.min;
+        o.max = a.max;
+        o.mean = a.mean;
+        o.stddev = a.n > 1 ? std::sqrt(a.m2 / (double)(a.n - 1)) : 0.0;
+        o.ewma = a.n ? a.ewma / (double)a.n : 0.0;
+        o.window_count = (uint32_t)a.wn;
+        o.window_min = a.wmin;
+        o.window_max = a.wmax;
+        o.window_mean = a.wmean;
+        o.window_stddev = a.wn > 1 ? std::sqrt(a.wm2 / (double)(a.wn - 1)) : 0.0;
+    }
+    if (devices) {
+        *devices = found;
+    }
+}
+
+bool DeviceStats::save_state(uint32_t id, DeviceStatsState& out) const {
+    const Slot* s = find(id);
+    SlotCopy copy;
+    if (!s || !read_slot(*s, copy)) {
+        return false;
+    }
+
+    out.count = copy.count;
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        out.fields[f] = copy.fields[f];
+    }
+    return true;
+}
+
+void DeviceStats::restore_state(uint32_t id, const DeviceStatsState& state) {
+    Slot* s = slot_for(id);
+    if (!s) {
+        return;
+    }
+
+    const std::memory_order rx = std::memory_order_relaxed;
+    std::atomic<uint32_t>& devices = shards[device_shard(id)].devices;
+    bool had = s->count.load(rx) != 0;
+    if (had != (state.count != 0)) {
+        uint32_t d = devices.load(rx);
+        devices.store(had ? d - 1 : d + 1, rx);
+    }
+
+    s->begin_write();
+    s->id.store(id, rx);
+    s->count.store(state.count, rx);
+    s->window_base.store(state.count, rx);
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        Slot::Field& c = s->fields[f];
+        c.min.store(state.fields[f].min, rx);
+        c.max.store(state.fields[f].max, rx);
+        c.mean.store(state.fields[f].mean, rx);
+        c.m2.store(state.fields[f].m2, rx);
+        c.ewma.store(state.fields[f].ewma, rx);
+    }
+    s->end_write();
+}
+
+size_t DeviceStats::device_count() const {
+    // Счетчики сегментов, без обхода слотов
+    size_t count = 0;
+    for (const Shard& sh : shards) {
+        count += sh.devices.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void DeviceStats::clear() {
+    // Соответствие ID -> слот сохраняется, как в PacketHistograms:
+    // устройство с нулевым счетчиком для читателей не существует
+    const std::memory_order rx = std::memory_order_relaxed;
+    for (Shard& sh : shards) {
+        sh.devices.store(0, rx);
+        uint32_t size = sh.index.size();
+        for (uint32_t n = 0; n < size; n++) {
+            Slot* s = sh.slot(n);
+            if (!s) {
+                continue;
+            }
+            s->begin_write();
+            s->count.store(0, rx);
+            s->window_base.store(0, rx);
+            s->end_write();
+        }
+    }
+}
@@ -0,0 +1,171 @@
+#ifndef DEVICESTATS_H
+#define DEVICESTATS_H
+
+#include "DeviceIndex.h"
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// Числовые поля пакета, по которым ведется статистика
+enum StatField {
+    STAT_PRESSURE = 0,
+    STAT_TEMPERATURE,
+    STAT_VOLTAGE,
+    STAT_RSSI,
+    STAT_FIELD_COUNT
+};
+
+// Сводка по одному полю устройства
+struct FieldSummary {
+    // За все время
+    uint64_t count;
+    float min;
+    float max;
+    double mean;
+    double stddev;
+    double ewma;
+
+    // За скользящее окно последних WINDOW_SIZE пакетов
+    uint32_t window_count;
+    float window_min;
+    float window_max;
+    double window_mean;
+    double window_stddev;
+};
+
+struct DeviceStatsSnapshot {
+    uint32_t id;
+    uint64_t count;
+    FieldSummary fields[STAT_FIELD_COUNT];
+};
+
+// Накопленное состояние устройства для сохранения между запусками
+// (без скользящего окна)
+struct DeviceStatsState {
+    struct Field {
+        float min;
+        float max;
+        double mean;
+        double m2;
+        double ewma;
+    };
+
+    uint64_t count;
+    Field fields[STAT_FIELD_COUNT];
+};
+
+// Инкрементальная статистика по устройствам.
+//
+// Устройства разложены по DEVICE_SHARDS сегментам по хешу ID (тем же,
+// что у DecodePipeline). У сегмента один писатель: поток чтения или
+// поток, выполняющий этот сегмент конвейера, поэтому update() не берет
+// блокировок и писатели разных сегментов не мешают друг другу. Сегменты
+// выровнены по кэш-линии, слоты устройства выделяются блоками и не
+// переезжают, соответствие ID -> слот в сегменте дает DeviceIndex.
+//
+// Читатели (GUI, сохранение сессии) не останавливают прием: слот
+// защищен счетчиком версий (seqlock), как в LatestValues, и читатель
+// всегда получает целое состояние устройства. snapshot_all() и merged()
+// сшивают сегменты по одному: каждое устройство в них целое, но разные
+// устройства сняты в немного разные моменты.
+//
+// Хранение - по устройствам (слот со всеми полями), а не по столбцам, как
+// было до сегментов. Под seqlock столбцы разнесли бы версию и поля одного
+// устройства по десятку массивов: запись пакета пачкала бы столько же
+// кэш-линий, а читатель собирал бы копию из разных мест. Кроме того,
+// растущий столбец нельзя переразместить без блокировки, а блоки слотов
+// не переезжают. Проход по одному полю всех устройств (merged) от этого
+// медленнее, но он идет раз в обновление экрана, а запись - на каждый
+// пакет.
+class DeviceStats {
+public:
+    static const uint32_t WINDOW_SIZE = 32;
+    // Устройств в сегменте; при равномерном хеше это ~128 тыс. всего
+    static const uint32_t SHARD_DEVICES = 2048;
+
+    explicit DeviceStats(double ewma_alpha = 0.1);
+
+    // Писатель сегмента устройства id: каждый декодированный пакет
+    void update(uint32_t id, const float values[STAT_FIELD_COUNT]);
+
+    // Любой поток
+    bool snapshot(uint32_t id, DeviceStatsSnapshot& out) const;
+    size_t device_count() const;
+    // Снимки всех устройств, по сегментам
+    void snapshot_all(std::vector<DeviceStatsSnapshot>& out) const;
+    // Сводка по всем устройствам: число пакетов, min/max, среднее и
+    // разброс - как если бы все пакеты были одного устройства; EWMA -
+    // среднее EWMA устройств с весом по числу пакетов. *devices - сколько
+    // устройств вошло.
+    void merged(FieldSummary out[STAT_FIELD_COUNT], size_t* devices = nullptr) const;
+
+    // Только при остановленном приеме
+    void clear();
+
+    // Сохранение и восстановление накопленного состояния. Окно после
+    // восстановления начинается заново. save_state - любой поток,
+    // restore_state - при остановленном приеме.
+    bool save_state(uint32_t id, DeviceStatsState& out) const;
+    void restore_state(uint32_t id, const DeviceStatsState& state);
+
+private:
+    static const uint32_t CHUNK_SIZE = 32;
+    static const uint32_t SHARD_CHUNKS = SHARD_DEVICES / CHUNK_SIZE;
+
+    // Состояние устройства. Поля атомарные с relaxed-доступом: чтение
+    // одновременно с записью - не гонка данных, целостность копии дает
+    // version.
+    struct Slot {
+        struct Field {
+            std::atomic<float> min;
+            std::atomic<float> max;
+            std::atomic<double> mean;
+            std::atomic<double> m2;
+            std::atomic<double> ewma;
+        };
+
+        std::atomic<uint32_t> version;
+        std::atomic<uint32_t> id;
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> window_base;  // счетчик на момент восстановления
+        Field fields[STAT_FIELD_COUNT];
+        std::atomic<float> window[STAT_FIELD_COUNT][WINDOW_SIZE];
+
+        Slot();
+        void begin_write();
+        void end_write();
+    };
+
+    // Обычная копия слота для читателей
+    struct SlotCopy {
+        uint32_t id;
+        uint64_t count;
+        uint64_t window_base;
+        DeviceStatsState::Field fields[STAT_FIELD_COUNT];
+        float window[STAT_FIELD_COUNT][WINDOW_SIZE];
+    };
+
+    struct alignas(64) Shard {
+        DeviceIndex index;
+        std::atomic<Slot*> chunks[SHARD_CHUNKS];
+        // Только для писателя: датчики часто шлют пакеты сериями
+        uint32_t last_id;
+        Slot* last_slot;
+        // Устройств с пакетами; пишет писатель сегмента
+        std::atomic<uint32_t> devices;
+
+        Shard();
+        ~Shard();
+        Slot* slot(uint32_t n) const;
+    };
+
+    Slot* slot_for(uint32_t id);
+    const Slot* find(uint32_t id) const;
+    static bool read_slot(const Slot& s, SlotCopy& out);
+    static void fill_summary(const SlotCopy& s, int field, FieldSummary& out);
+
+    double alpha;
+    Shard shards[DEVICE_SHARDS];
+};
+
+#endif
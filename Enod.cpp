@@ -1,156 +1,453 @@
 #include "Enod.h"
 #include <unistd.h>
+#include <errno.h>
 #include <cstring>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <iomanip>
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <poll.h>
 #endif
 
-Enod::Enod(QObject* parent) : QObject(parent) {
+// Точек истории в одном взятии замка агрегатов
+static const size_t REPLAY_BATCH = 4096;
+
+Enod::Enod(QObject* parent) : QObject(parent), source_(new SerialSource()) {
 }
 
-void Enod::parce_packet() {
-    packet_ = packet_data.data();
+Enod::~Enod() {
+    // Прерванное проигрывание дочитывает запрос вхолостую
+    replay_cancel_.store(true);
+    if (replay_.joinable()) {
+        replay_.join();
+    }
+}
 
-    auto get_device_type_str = [](uint8_t type_byte) -> const char* {
-        if (type_byte == 0xF0) return "ДАТЧИК";
-        if (type_byte == 0xF1) return "РЕПИТЕР";
-        return "НЕИЗВЕСТНО";
-    };
+void Enod::replay_rollups() {
+    if (replay_.joinable() || !history_.is_open()) {
+        return;
+    }
+    replaying_.store(true);
+    replay_ = std::thread([this]() {
+        int64_t from = rollups_.latest();
+        std::vector<HistorySample> batch;
+        batch.reserve(REPLAY_BATCH);
+        history_.query(HistoryStore::ALL_DEVICES, from == INT64_MIN ? INT64_MIN : from + 1, INT64_MAX,
+                       [&](const HistorySample& s) {
+                           if (replay_cancel_.load(std::memory_order_relaxed)) {
+                               return;
+                           }
+                           batch.push_back(s);
+                           if (batch.size() == REPLAY_BATCH) {
+                               rollups_.add(batch.data(), batch.size());
+                               batch.clear();
+                           }
+                       });
+        rollups_.add(batch.data(), batch.size());
+        replaying_.store(false);
+    });
+}
+
+void Enod::set_source(std::unique_ptr<ByteSource> source) {
+    acquisition_.stop();
+    if (source) {
+        source_ = std::move(source);
+    }
+}
+
+void Enod::reset() {
+    packet_idx = 0;
+    packet_num = 0;
+    latest_.clear();
+    display_.clear();
+}
+
+void Enod::handle_packet(int64_t rx_us) {
+    PipelineFrame frame;
+    std::memcpy(frame.raw, packet, PACKET_SIZE);
+    decode_packet(frame.raw, frame.decoded);
+    frame.rx_us = rx_us;
+    frame.source = 0;
+    frame.sequence = 0;
+    if (accept_frame(frame)) {
+        aggregate_frames(&frame, 1);
+    }
+}
+
+bool Enod::accept_frame(PipelineFrame& frame) {
+    // Списки допуска: чужие устройства отбрасываются до статистики,
+    // форматирования и GUI
+    uint64_t lists_generation = device_lists_.generation();
+    if (lists_generation != lists_generation_) {
+        active_lists_ = device_lists_.current();
+        lists_generation_ = lists_generation;
+    }
+    if (active_lists_ && !active_lists_->accept(frame.decoded.id)) {
+        device_lists_.count_dropped();
+        return false;
+    }
+
+    frame.sequence = (uint64_t)packet_num++;
 
-    std::memcpy(device_data_.raw_packet, packet_, 26);
-    device_data_.type_str = get_device_type_str(packet_[2]);
+    // Интервалы порта - между соседними кадрами любых устройств, поэтому
+    // по порядку приема, а не в сегментах
+    histograms_.record_port((uint64_t)frame.rx_us, frame.decoded.rssi);
 
-    device_data_.id = ((uint32_t)packet_[6] << 24) |
-                      ((uint32_t)packet_[5] << 16) |
-                      ((uint32_t)packet_[4] << 8) |
-                      packet_[3];
+    // Запись кадров для офлайн-разбора
+    if (capture_.is_open()) {
+        capture_.append(frame.raw, rx_clock_.wall_us(frame.rx_us));
+    }
+    return true;
+}
 
-    // Давление
-    pressure = ((uint16_t)packet_[8] << 8) | packet_[7];
-    device_data_.pressure_bar = 2750.0f * (pressure - 1) / 100000.0f;
+void Enod::aggregate_frames(const PipelineFrame* frames, size_t count) {
+    // Пачка не больше пачки конвейера: все на стеке
+    const size_t BATCH = DecodePipeline::BATCH_FRAMES;
+    uint32_t ids[BATCH];
+    uint64_t rx_us[BATCH];
+    int64_t wall_ms[BATCH];
+    float values[BATCH][STAT_FIELD_COUNT];
+    HistorySample history[BATCH];
+    ExportRecord records[BATCH];
+    DisplayRecord shown[BATCH];
+    uint64_t display_keys[BATCH];
+    bool exporting = exporter_.live_active();
+
+    for (size_t begin = 0; begin < count; begin += BATCH) {
+        size_t n = std::min(BATCH, count - begin);
+        size_t history_count = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            const PipelineFrame& frame = frames[begin + i];
+            const DecodedPacket& d = frame.decoded;
+
+            // Статистика устройства
+            float* v = values[i];
+            v[STAT_PRESSURE] = d.pressure_bar;
+            v[STAT_TEMPERATURE] = (float)d.temperature_c;
+            v[STAT_VOLTAGE] = d.voltage_v;
+            v[STAT_RSSI] = (float)d.rssi;
+            stats_.update(d.id, v);
+
+            // Интервалы и таймауты - по монотонной метке приема
+            ids[i] = d.id;
+            rx_us[i] = (uint64_t)frame.rx_us;
+
+            // Гистограммы интервалов прихода и RSSI
+            histograms_.record_device(d.id, rx_us[i], d.rssi);
+
+            int64_t wall_us = rx_clock_.wall_us(frame.rx_us);
+            wall_ms[i] = wall_us / 1000;
+
+            // Таблица последних значений (без ожидания читателей)
+            LatestPacket latest;
+            latest.id = d.id;
+            latest.type = d.type;
+            latest.fw_version = (uint8_t)d.fw_version;
+            latest.temperature_c = (int16_t)d.temperature_c;
+            latest.rssi = (int16_t)d.rssi;
+            latest.reserved = 0;
+            latest.pressure_bar = d.pressure_bar;
+            latest.voltage_v = d.voltage_v;
+            latest.packet_count = 0;
+            latest.time_us = wall_us;
+            latest.sequence = frame.sequence;
+            std::memcpy(latest.raw, frame.raw, sizeof(latest.raw));
+            std::memset(latest.padding, 0, sizeof(latest.padding));
+            latest_.publish(latest);
+
+            HistorySample sample;
+            sample.id = d.id;
+            sample.time_ms = wall_ms[i];
+            sample.pressure_bar = d.pressure_bar;
+            sample.voltage_v = d.voltage_v;
+            sample.temperature_c = (int16_t)d.temperature_c;
+            sample.rssi = (int16_t)d.rssi;
+
+            // История - только известные типы устройств
+            if (d.type == PACKET_TYPE_SENSOR || d.type == PACKET_TYPE_REPEATER) {
+                history[history_count++] = sample;
+            }
+
+            if (exporting) {
+                ExportRecord& record = records[i];
+                record.time_ms = sample.time_ms;
+                record.id = d.id;
+                record.type = d.type;
+                record.fw_version = (uint8_t)d.fw_version;
+                record.temperature_c = sample.temperature_c;
+                record.rssi = sample.rssi;
+                record.pressure_bar = d.pressure_bar;
+                record.voltage_v = d.voltage_v;
+            }
 
-    // Температура
-    temp_raw = packet_[14];
-    device_data_.temperature_c = (int)temp_raw - 55;
+            // Отображение: только очередь, строку таблицы GUI заполняет
+            // для тех кадров, что до него дошли
+            shown[i].decoded = d;
+            shown[i].rx_wall_ms = wall_ms[i];
+            display_keys[i] = d.id;
+        }
 
-    // Напряжение
-    voltage_raw = packet_[13];
-    device_data_.voltage_v = voltage_raw * 0.01512f;
+        // Таблицы под мьютексом - по одному взятию на пачку
+        losses_.update(ids, rx_us, n);
+        alarms_.evaluate(ids, values, rx_us, n);
+        fleet_.update(ids, wall_ms, n);
+        // Агрегаты - по тем же точкам, что история: после перезапуска они
+        // добираются из нее
+        rollups_.add(history, history_count);
+        history_.append(history, history_count);
+        if (exporting) {
+            exporter_.append(records, n);
+        }
+        display_.push(shown, display_keys, n);
+    }
 
-    // Версия прошивки
-    fw_unsigned = packet_[19];
-    fw_signed = (int8_t)fw_unsigned;
-    device_data_.fw_version = abs((int)fw_signed);
+    if (count && !display_signaled_.exchange(true)) {
+        emit displayReady();
+    }
+}
 
-    // RSSI
-    device_data_.rssi = -(int8_t)packet_[24];
+size_t Enod::take_display(std::vector<DisplayEntry>& out) {
+    // Флаг снимается до выборки: кадр, положенный после нее, вызовет
+    // новый сигнал
+    display_signaled_.store(false);
+    return display_.take(out);
 }
 
-std::string Enod::get_data_string() {
-    snprintf(buffer, sizeof(buffer),
-             "[%2d] %-7s | ID: 0x%08X | "
-             "Вер: %2d | "
-             "Д: %6.3f бар | "
-             "Т: %2d°C | "
-             "Н: %5.3fВ | "
-             "RSSI: %3d | "
-             "Байты: 0x%02X%02X%02X%02X",
-             packet_num,
-             device_data_.type_str,
-             device_data_.id,
-             device_data_.fw_version,
-             device_data_.pressure_bar,
-             device_data_.temperature_c,
-             device_data_.voltage_v,
-             device_data_.rssi,
-             device_data_.raw_packet[3],
-             device_data_.raw_packet[4],
-             device_data_.raw_packet[5],
-             device_data_.raw_packet[6]);
-
-    packet_num++;
-    return std::string(buffer);
+void Enod::start_reading() {
+    stop();
+    if (replay_.joinable()) {
+        replay_.join();
+    }
+    display_.open();
+    rx_clock_.anchor();
+
+    // Разбор и агрегаты в пуле: поток чтения только собирает кадры
+    unsigned workers = pipeline_workers();
+    if (workers > 0) {
+        pipeline_.start(workers, 1,
+                        [this](PipelineFrame& frame) { return accept_frame(frame); },
+                        [this](unsigned, const PipelineFrame* frames, size_t count) {
+                            aggregate_frames(frames, count);
+                        });
+    }
+    acquisition_.start([this]() { read_port(); });
 }
 
 void Enod::read_port() {
-    _port = search_port();
+    // Приоритет и память настраиваются до первого байта; буферы
+    // отображаются в память заранее и в режиме реального времени
+    // закрепляются
+    RealtimeConfig rt = realtime_.enter();
+    realtime_.lock_buffer(source_->buffer(), source_->buffer_size());
+    realtime_.lock_buffer(packet, sizeof(packet));
+    source_->set_low_latency(rt.enabled && rt.low_latency_port);
+
+    // Переподключение до остановки: каждая потеря связи - один разрыв,
+    // сколько бы попыток ни понадобилось
+    link_.connecting();
+    for (;;) {
+        if (!source_->open()) {
+            link_.lost(rx_clock_.wall_us(rx_clock_.now_us()), GAP_NO_PORT);
+        } else {
+            realtime_.set_port_status(rt.enabled && rt.low_latency_port, source_->low_latency_active());
+            int64_t gap_us = link_.connected(rx_clock_.wall_us(rx_clock_.now_us()));
+            if (gap_us > 0) {
+                losses_.add_gap((uint64_t)gap_us);
+            }
+            // Начало кадра до разрыва уже не дополнится
+            packet_idx = 0;
+
+            LinkGapReason reason = GAP_ERROR;
+            bool lost = read_backend() == READ_URING && UringReader::available()
+                    ? read_until_lost_uring(&reason, rt.enabled)
+                    : read_until_lost(&reason, rt.enabled);
+            source_->close();
+            if (!lost) {
+                break;
+            }
+            link_.lost(rx_clock_.wall_us(rx_clock_.now_us()), reason);
+        }
 
-    if (_port < 0) {
-        emit newDataAvailable(QString("Ошибка: Не удалось найти рабочий порт"));
-        return;
+        if (!acquisition_.pause((int)link_.next_delay_ms())) {
+            break;
+        }
+        link_.connecting();
     }
 
-    stop_flag = false;
+    link_.stopped(rx_clock_.wall_us(rx_clock_.now_us()));
+    realtime_.leave();
+}
 
-#ifdef _WIN32
-    HANDLE hPort = (HANDLE)_port;
+void Enod::take_chunk(const uint8_t* data, int bytes, int64_t rx_us) {
+    bool pipelined = pipeline_.running();
+    for (int i = 0; i < bytes; i++) {
+        packet[packet_idx++] = data[i];
 
-    while (!stop_flag) {
-        if (ReadFile(hPort, &byte, 1, &bytes_read_win, NULL)) {
-            bytes_read = bytes_read_win;
+        if (packet_idx == 26) {
+            if (pipelined) {
+                pipeline_.push(0, packet, rx_us);
+            } else {
+                handle_packet(rx_us);
+            }
 
-            if (bytes_read > 0) {
-                packet[packet_idx++] = byte;
+            // Сбрасываем индекс
+            packet_idx = 0;
+        }
+    }
+    // Кадры этого чтения уходят в работу, не дожидаясь полной пачки
+    if (pipelined) {
+        pipeline_.flush(0);
+    }
+}
 
-                if (packet_idx == 26) {
-                    std::memcpy(packet_data.data(), packet, 26);
-                    parce_packet();
+bool Enod::link_check_failed(int64_t last_data_us, LinkGapReason* reason) {
+    // Отключенный USB-адаптер не всегда дает POLLHUP
+    if (!source_->present()) {
+        *reason = GAP_REMOVED;
+        return true;
+    }
+    // Файл и stdin не переподключаются: тишина - не потеря связи
+    int64_t stall_us = (int64_t)link_.stall_timeout_ms() * 1000;
+    if (stall_us && source_->reconnects() && rx_clock_.now_us() - last_data_us >= stall_us) {
+        *reason = GAP_STALL;
+        return true;
+    }
+    return false;
+}
 
-                    // Получаем строку данных
-                    data_str = get_data_string();
+bool Enod::source_lost(int status, LinkGapReason* reason) {
+    if (status == SOURCE_END && !source_->reconnects()) {
+        return false;       // файл дочитан, stdin закрыт
+    }
+    *reason = source_->present() ? GAP_ERROR : GAP_REMOVED;
+    return true;
+}
 
-                    // Испускаем сигнал с данными
-                    emit newDataAvailable(QString::fromStdString(data_str));
+bool Enod::read_until_lost(LinkGapReason* reason, bool realtime) {
+    int64_t last_data_us = rx_clock_.now_us();
+    int64_t last_check_us = last_data_us;
+    const uint8_t* data = nullptr;
 
-                    // Сбрасываем индекс
-                    packet_idx = 0;
+    // Без дескриптора (COM-порт в Windows) read() сам ждет не дольше
+    // таймаута порта
+    int fd = source_->fd();
+#ifdef _WIN32
+    (void)realtime;     // опоздания пробуждений в Windows не замеряются
+    fd = -1;
+#endif
+    // В режиме реального времени поток просыпается по таймеру чаще:
+    // каждое пробуждение - замер опоздания планировщика
+    int timeout_ms = realtime ? 10 : 1000;
+    for (;;) {
+        // Все, что накопилось в драйвере, за один вызов; метка - сразу
+        // после чтения, до любой обработки
+        int bytes = SOURCE_IDLE;
+        if (fd >= 0) {
+            AcquisitionThread::Wait w = acquisition_.wait_readable(fd, timeout_ms);
+            if (w == AcquisitionThread::WAIT_STOP) {
+                return false;
+            }
+            if (w == AcquisitionThread::WAIT_ERROR) {
+                // POLLHUP без данных: конец канала или отключение решает read()
+                bytes = source_->read(&data);
+                if (bytes == SOURCE_IDLE) {
+                    bytes = SOURCE_ERROR;
+                }
+            } else if (w == AcquisitionThread::WAIT_READY) {
+                bytes = source_->read(&data);
+            } else {
+                int64_t late_us = acquisition_.timeout_lateness_us();
+                if (late_us >= 0) {
+                    realtime_.record_wakeup(late_us);
                 }
             }
         } else {
-            DWORD error = GetLastError();
-            if (error != ERROR_IO_PENDING) {
-                break;
+            if (acquisition_.stop_requested()) {
+                return false;
             }
+            bytes = source_->read(&data);
+        }
+        int64_t rx_us = rx_clock_.now_us();
+        if (bytes > 0) {
+            last_data_us = rx_us;
+            take_chunk(data, bytes, rx_us);
+            continue;
+        }
+        if (bytes != SOURCE_IDLE) {
+            return source_lost(bytes, reason);
         }
 
-        usleep(1000);
+        // Проверки источника - не чаще раза в секунду
+        if (rx_us - last_check_us >= 1000000) {
+            last_check_us = rx_us;
+            if (link_check_failed(last_data_us, reason)) {
+                return true;
+            }
+        }
     }
-#else
-    while (!stop_flag) {
-        bytes_read = read(_port, &byte, 1);
-
-        if (bytes_read > 0) {
-            packet[packet_idx++] = byte;
-
-            if (packet_idx == 26) {
-                std::memcpy(packet_data.data(), packet, 26);
-                parce_packet();
-
-                // Получаем строку данных
-                data_str = get_data_string();
+}
 
-                // Испускаем сигнал с данными
-                emit newDataAvailable(QString::fromStdString(data_str));
+bool Enod::read_until_lost_uring(LinkGapReason* reason, bool realtime) {
+#ifdef _WIN32
+    return read_until_lost(reason, realtime);
+#else
+    std::string error;
+    UringReader uring;
+    if (source_->fd() < 0 || !uring.open(1, source_->buffer_size(), &error) || uring.add_port(source_->fd()) < 0) {
+        // Кольцо не создалось (лимиты, seccomp) - тот же источник по-старому
+        return read_until_lost(reason, realtime);
+    }
+    uring.set_wake_fd(acquisition_.wake_fd());
+
+    int64_t last_data_us = rx_clock_.now_us();
+    int64_t last_check_us = last_data_us;
+    int timeout_ms = realtime ? 10 : 1000;
+    int ended = SOURCE_IDLE;
+
+    auto handler = [&](int, uint8_t* data, int result) {
+        int64_t rx_us = rx_clock_.now_us();
+        int bytes = source_->completed(result, data);
+        if (bytes > 0) {
+            last_data_us = rx_us;
+            take_chunk(data, bytes, rx_us);
+            return true;
+        }
+        if (bytes == SOURCE_IDLE) {
+            return true;
+        }
+        ended = bytes;
+        return false;
+    };
 
-                // Сбрасываем индекс
-                packet_idx = 0;
-            }
+    while (ended == SOURCE_IDLE) {
+        int64_t before_us = rx_clock_.now_us();
+        bool woken = false;
+        int handled = uring.wait(timeout_ms, handler, &woken);
+        if (woken || acquisition_.stop_requested()) {
+            return false;
         }
-        else if (bytes_read < 0) {
-            break;
+        if (handled < 0) {
+            *reason = GAP_ERROR;
+            return true;
+        }
+        if (handled > 0) {
+            continue;
         }
 
-        usleep(1000);
+        int64_t now_us = rx_clock_.now_us();
+        realtime_.record_wakeup(now_us - before_us - (int64_t)timeout_ms * 1000);
+        if (now_us - last_check_us >= 1000000) {
+            last_check_us = now_us;
+            if (link_check_failed(last_data_us, reason)) {
+                return true;
+            }
+        }
     }
+    return source_lost(ended, reason);
 #endif
-
-    if (_port >= 0) {
-        close_port();
-    }
-
-    stop_flag = false;
 }
\ No newline at end of file
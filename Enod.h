@@ -2,13 +2,37 @@
 #define ENOD_H
 
 #include "ComPort.h"
+#include "PacketDecoder.h"
+#include "DeviceStats.h"
+#include "PacketHistograms.h"
+#include "LossEstimator.h"
+#include "AlarmRules.h"
+#include "HistoryStore.h"
+#include "Rollups.h"
+#include "DataExporter.h"
+#include "CaptureFile.h"
+#include "DeviceLists.h"
+#include "FleetCoverage.h"
+#include "LatestValues.h"
+#include "AcquisitionThread.h"
+#include "LinkSupervisor.h"
+#include "RxClock.h"
+#include "RealtimeMode.h"
+#include "UringReader.h"
+#include "ByteSource.h"
+#include "DecodePipeline.h"
+#include "BoundedQueue.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-#include <array>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 #include <QObject>
+#include <QString>
 #include <sstream>
 
 #ifdef _WIN32
@@ -16,62 +40,145 @@
     #define usleep(x) Sleep((x)/1000)
 #endif
 
-typedef struct {
-    const char* type_str;
-    uint32_t id;
-    float pressure_bar;
-    int temperature_c;
-    float voltage_v;
-    int fw_version;
-    int rssi;
-    uint8_t raw_packet[26];
-} DeviceData;
-
-class Enod : public QObject, public ComPortBase {
+// Кадр для отображения в GUI: таблица заполняется прямо из полей
+struct DisplayRecord {
+    DecodedPacket decoded;
+    int64_t rx_wall_ms;         // время приема (UTC, мс)
+};
+
+class Enod : public QObject {
 Q_OBJECT
 
 public:
     Enod(QObject* parent = nullptr);
-    void parce_packet();
-    std::string get_data_string();
+    ~Enod();
     void read_port();
-    void stop() {
-        stop_flag = true;
-    }
-    void reset() {
-        stop_flag = false;
-        packet_idx = 0;
-        packet_num = 0;
-    }
-
-    DeviceData device_data_;
-    volatile bool stop_flag = false;
-
-    // Делаем эти переменные публичными для доступа из MainWindow
-    int packet_idx = 0;
-    int packet_num = 0;
+    // Запуск read_port() в собственном потоке; идущее чтение
+    // останавливается
+    void start_reading();
+    // Возвращается, когда поток чтения завершен и принятое обработано
+    void stop() { display_.close(); acquisition_.stop(); pipeline_.stop(); }
+    // Поток чтения внутри read_port()
+    bool running() const { return acquisition_.running(); }
+    // Сброс счетчиков пакетов и последних значений; только после stop()
+    void reset();
+
+    // Источник байтов (по умолчанию - COM-порт); менять только при
+    // остановленном чтении
+    void set_source(std::unique_ptr<ByteSource> source);
+    ByteSource& source() { return *source_; }
+    const ByteSource& source() const { return *source_; }
+
+    DeviceStats& stats() { return stats_; }
+    PacketHistograms& histograms() { return histograms_; }
+    LossEstimator& losses() { return losses_; }
+    AlarmRules& alarms() { return alarms_; }
+    HistoryStore& history() { return history_; }
+    Rollups& rollups() { return rollups_; }
+    // Добирает в агрегаты точки истории после последнего сохранения
+    // rollups_ (или всю историю, если файла не было) своим потоком.
+    // start_reading() дожидается его: живые точки пишутся в историю и не
+    // должны проиграться второй раз. Пока он идет, latest() агрегатов
+    // ничего не говорит о полноте, и их не сохраняют.
+    void replay_rollups();
+    bool replaying_rollups() const { return replaying_.load(); }
+    DataExporter& exporter() { return exporter_; }
+    CaptureWriter& capture() { return capture_; }
+    DeviceLists& device_lists() { return device_lists_; }
+    FleetCoverage& fleet() { return fleet_; }
+    // Последние значения по устройствам: читаются из любого потока
+    const LatestValues& latest() const { return latest_; }
+    // Состояние связи и разрывы
+    LinkSupervisor& link() { return link_; }
+
+    // Часы меток приема; привязка к UTC обновляется при start_reading()
+    const RxClock& rx_clock() const { return rx_clock_; }
+    // Режим реального времени потока чтения и опоздания его пробуждений
+    RealtimeMode& realtime() { return realtime_; }
+
+    enum ReadBackend {
+        READ_POLL = 0,      // poll() + read()
+        READ_URING          // io_uring с зарегистрированным буфером
+    };
+    // Действует со следующего подключения; без io_uring - READ_POLL
+    void set_read_backend(ReadBackend backend) { read_backend_.store(backend, std::memory_order_relaxed); }
+    ReadBackend read_backend() const { return (ReadBackend)read_backend_.load(std::memory_order_relaxed); }
+
+    // Потоки разбора и агрегатов (DecodePipeline); 0 - все в потоке
+    // чтения. Действует со следующего start_reading().
+    void set_pipeline_workers(unsigned workers) { pipeline_workers_.store(workers, std::memory_order_relaxed); }
+    unsigned pipeline_workers() const { return pipeline_workers_.load(std::memory_order_relaxed); }
+    PipelineStats pipeline_stats() const { return pipeline_.stats(); }
+
+    // Очередь отображения. Стадия агрегатов кладет в нее кадры, уже
+    // учтенные захватом, статистикой, историей и экспортом, и испускает
+    // displayReady() один раз, пока GUI не заберет накопленное
+    // (take_display). Отстающий GUI теряет или сливает только
+    // отображение, очередь событий Qt не растет. По умолчанию
+    // QUEUE_COALESCE: на устройство одна строка с последними значениями.
+    // QUEUE_BLOCK задерживает разбор, пока GUI не заберет пачку.
+    static const size_t DISPLAY_QUEUE_SIZE = 4096;
+    typedef BoundedQueue<DisplayRecord>::Entry DisplayEntry;
+    size_t take_display(std::vector<DisplayEntry>& out);
+    void set_display_policy(QueuePolicy policy) { display_.set_policy(policy); }
+    QueueStats display_stats() const { return display_.stats(); }
 
 signals:
-    void newDataAvailable(const QString& data);
+    // В очереди отображения есть кадры; до take_display() не повторяется
+    void displayReady();
 
 private:
-    char buffer[200];
-    std::string data_str;
-    std::array<uint8_t, 26> packet_data;
-    int _port;
-    uint8_t byte = 0;
-    uint8_t packet[26];
-    const uint8_t* packet_;
-    int bytes_read;
-    uint16_t pressure;
-    int8_t temp_raw;
-    uint8_t voltage_raw;
-    uint8_t fw_unsigned;
-    int8_t fw_signed;
+    void handle_packet(int64_t rx_us);
+    // Стадия разбора: по порядку приема источника; false - кадр отброшен
+    bool accept_frame(PipelineFrame& frame);
+    // Стадия агрегатов: кадры одного устройства - по порядку, разные
+    // устройства - из разных потоков конвейера одновременно. Таблицы с
+    // блокировкой получают пачку кадров за одно взятие мьютекса
+    void aggregate_frames(const PipelineFrame* frames, size_t count);
+    // Собирает кадры из принятых байтов chunk; rx_us - метка этого чтения
+    void take_chunk(const uint8_t* data, int bytes, int64_t rx_us);
+    // Читает открытый источник до остановки или конца данных (false) или
+    // потери связи (true)
+    bool read_until_lost(LinkGapReason* reason, bool realtime);
+    bool read_until_lost_uring(LinkGapReason* reason, bool realtime);
+    // Порт пропал или молчит дольше stall_timeout
+    bool link_check_failed(int64_t last_data_us, LinkGapReason* reason);
+    // Итог чтения SOURCE_END / SOURCE_ERROR: true - потеря связи
+    bool source_lost(int status, LinkGapReason* reason);
 
-#ifdef _WIN32
-    DWORD bytes_read_win;
-#endif
+    // Состояние потока чтения (packet_num - стадии разбора); другие
+    // потоки видят данные через latest_
+    int packet_idx = 0;
+    int packet_num = 0;
+
+    DeviceStats stats_;
+    PacketHistograms histograms_;
+    LossEstimator losses_;
+    AlarmRules alarms_;
+    HistoryStore history_;
+    Rollups rollups_;
+    DataExporter exporter_;     // после history_: выгрузки читают историю
+    CaptureWriter capture_;
+    DeviceLists device_lists_;
+    FleetCoverage fleet_;
+    LatestValues latest_;
+    BoundedQueue<DisplayRecord> display_{DISPLAY_QUEUE_SIZE, QUEUE_COALESCE};
+    std::atomic<bool> display_signaled_{false};
+    LinkSupervisor link_;
+    RxClock rx_clock_;
+    RealtimeMode realtime_;
+    std::atomic<int> read_backend_{READ_POLL};
+    std::atomic<unsigned> pipeline_workers_{0};
+    std::thread replay_;
+    std::atomic<bool> replaying_{false};
+    std::atomic<bool> replay_cancel_{false};
+    DecodePipeline pipeline_;   // после агрегатов: останавливаясь, дообрабатывает кадры
+    std::unique_ptr<ByteSource> source_;
+    AcquisitionThread acquisition_;     // последним: останавливается первым
+    // Копия текущих списков для стадии разбора
+    std::shared_ptr<const DeviceListSet> active_lists_;
+    uint64_t lists_generation_ = 0;
+    uint8_t packet[26];
 };
 
 #endif
\ No newline at end of file
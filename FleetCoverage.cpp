@@ -0,0 +1,190 @@
+#include "FleetCoverage.h"
+#include "PacketHistograms.h"
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+FleetCoverage::FleetCoverage()
+    : active(false), head(NONE), tail(NONE), seen_count(0), foreign_packets(0) {
+}
+
+bool FleetCoverage::parse(const std::string& text, std::string* error) {
+    std::vector<uint32_t> list;
+
+    std::istringstream in(text);
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash);
+        }
+        size_t begin = line.find_first_not_of(" \t\r\"");
+        if (begin == std::string::npos) {
+            continue;
+        }
+
+        const char* p = line.c_str() + begin;
+        char* end = nullptr;
+        unsigned long long id = isdigit((unsigned char)*p) ? strtoull(p, &end, 0) : 0;
+        bool ok = end && end != p && id <= UINT32_MAX &&
+                  (*end == '\0' || strchr(" \t\r,;\"", *end) != nullptr);
+        if (!ok) {
+            if (list.empty() && line_no == 1) {
+                continue;       // заголовок CSV
+            }
+            if (error) *error = "строка " + std::to_string(line_no) + ": ожидался ID устройства";
+            return false;
+        }
+        list.push_back((uint32_t)id);
+        if (list.size() > MAX_DEVICES) {
+            if (error) *error = "больше " + std::to_string(MAX_DEVICES) + " устройств";
+            return false;
+        }
+    }
+
+    // Плотные номера; повторы ID получают тот же номер
+    std::unique_ptr<DeviceIndex> new_index(new DeviceIndex(list.empty() ? 1 : (uint32_t)list.size()));
+    std::vector<uint32_t> new_ids;
+    new_ids.reserve(list.size());
+    for (uint32_t id : list) {
+        if (new_index->find_or_insert(id) == new_ids.size()) {
+            new_ids.push_back(id);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t n = new_ids.size();
+    index = std::move(new_index);
+    ids = std::move(new_ids);
+    seen_bits.assign((n + 63) / 64, 0);
+    last_seen_ms.assign(n, 0);
+    prev.assign(n, (uint32_t)NONE);
+    next.assign(n, (uint32_t)NONE);
+    head = tail = NONE;
+    seen_count = 0;
+    foreign_packets = 0;
+    active.store(n > 0, std::memory_order_relaxed);
+    return true;
+}
+
+bool FleetCoverage::load_file(const std::string& path, std::string* error) {
+    std::ifstream f(path);
+    if (!f) {
+        if (error) *error = "не удалось открыть " + path;
+        return false;
+    }
+    std::stringstream buf;
+    buf << f.rdbuf();
+    return parse(buf.str(), error);
+}
+
+void FleetCoverage::clear() {
+    parse(std::string(), nullptr);
+}
+
+void FleetCoverage::unlink(uint32_t slot) {
+    uint32_t p = prev[slot], n = next[slot];
+    if (p != NONE) next[p] = n; else head = n;
+    if (n != NONE) prev[n] = p; else tail = p;
+    prev[slot] = next[slot] = NONE;
+}
+
+void FleetCoverage::insert_sorted(uint32_t slot) {
+    // Обычно время не меньше, чем у последнего, и вставка - в конец
+    int64_t t = last_seen_ms[slot];
+    uint32_t after = tail;
+    while (after != NONE && last_seen_ms[after] > t) {
+        after = prev[after];
+    }
+
+    uint32_t before = after == NONE ? head : next[after];
+    prev[slot] = after;
+    next[slot] = before;
+    if (after != NONE) next[after] = slot; else head = slot;
+    if (before != NONE) prev[before] = slot; else tail = slot;
+}
+
+void FleetCoverage::update(uint32_t id, int64_t time_ms) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    update_locked(id, time_ms);
+}
+
+void FleetCoverage::update(const uint32_t* ids, const int64_t* time_ms, size_t count) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < count; i++) {
+        update_locked(ids[i], time_ms[i]);
+    }
+}
+
+void FleetCoverage::update_locked(uint32_t id, int64_t time_ms) {
+    uint32_t slot = index ? index->find(id) : DeviceIndex::NOT_FOUND;
+    if (slot == DeviceIndex::NOT_FOUND) {
+        foreign_packets++;
+        return;
+    }
+
+    uint64_t bit = 1ull << (slot & 63);
+    if (seen_bits[slot >> 6] & bit) {
+        unlink(slot);
+    } else {
+        seen_bits[slot >> 6] |= bit;
+        seen_count++;
+    }
+    last_seen_ms[slot] = time_ms;
+    insert_sorted(slot);
+}
+
+FleetCoverageStats FleetCoverage::stats(int64_t silent_before_ms) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    FleetCoverageStats s;
+    s.expected = (uint32_t)ids.size();
+    s.seen = seen_count;
+    s.never_seen = s.expected - seen_count;
+    s.silent = 0;
+    for (uint32_t slot = head; slot != NONE && last_seen_ms[slot] < silent_before_ms; slot = next[slot]) {
+        s.silent++;
+    }
+    s.foreign_packets = foreign_packets;
+    return s;
+}
+
+std::vector<uint32_t> FleetCoverage::never_seen(size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint32_t> out;
+    size_t n = ids.size();
+    for (size_t w = 0; w < seen_bits.size() && out.size() < limit; w++) {
+        // Незаполненные биты последнего слова - не устройства
+        uint64_t missing = ~seen_bits[w];
+        if (w == seen_bits.size() - 1 && n % 64) {
+            missing &= (1ull << (n % 64)) - 1;
+        }
+        while (missing && out.size() < limit) {
+            unsigned bit = ctz64(missing);
+            out.push_back(ids[w * 64 + bit]);
+            missing &= missing - 1;
+        }
+    }
+    return out;
+}
+
+std::vector<FleetSilentDevice> FleetCoverage::silent(int64_t silent_before_ms, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<FleetSilentDevice> out;
+    for (uint32_t slot = head; slot != NONE && last_seen_ms[slot] < silent_before_ms && out.size() < limit;
+         slot = next[slot]) {
+        out.push_back(FleetSilentDevice{ids[slot], last_seen_ms[slot]});
+    }
+    return out;
+}
@@ -0,0 +1,85 @@
+#ifndef FLEETCOVERAGE_H
+#define FLEETCOVERAGE_H
+
+#include "DeviceIndex.h"
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct FleetCoverageStats {
+    uint32_t expected;
+    uint32_t seen;
+    uint32_t never_seen;
+    uint32_t silent;            // видны раньше, но молчат дольше порога
+    uint64_t foreign_packets;   // пакеты устройств не из списка
+};
+
+struct FleetSilentDevice {
+    uint32_t id;
+    int64_t last_seen_ms;
+};
+
+// Покрытие ожидаемого парка устройств.
+//
+// Список ожидаемых ID загружается один раз (до MAX_DEVICES) и получает
+// плотную нумерацию через DeviceIndex. Для каждого номера хранится
+// бит "видели" и время последнего пакета, а все виденные устройства
+// связаны в список по времени последнего пакета (давно молчащие в
+// начале). Пакет обновляет бит и переносит устройство в конец списка
+// за O(1), поэтому:
+//   - never_seen() проходит битовую карту по 64 устройства за слово;
+//   - silent() идет от начала списка и останавливается на первом
+//     устройстве, слышном после порога, - O(числа молчащих).
+// Реестр устройств при этом не перебирается.
+class FleetCoverage {
+public:
+    static const uint32_t MAX_DEVICES = 1u << 20;
+    static const uint32_t NONE = UINT32_MAX;
+
+    FleetCoverage();
+
+    // Строка - ID устройства (десятичный или 0x...), дальше через пробел,
+    // запятую или ';' может идти что угодно (название, место).
+    // Нечисловая первая строка считается заголовком CSV. Заменяет список
+    // и сбрасывает отметки; при ошибке прежний список остается.
+    bool parse(const std::string& text, std::string* error);
+    bool load_file(const std::string& path, std::string* error);
+    void clear();
+
+    bool empty() const { return !active.load(std::memory_order_relaxed); }
+
+    // Поток чтения: пакет устройства. Время может идти назад (отметки из
+    // снимка, перевод часов) - тогда место в списке ищется с конца.
+    void update(uint32_t id, int64_t time_ms);
+    // Пачка пакетов под одной блокировкой
+    void update(const uint32_t* ids, const int64_t* time_ms, size_t count);
+
+    FleetCoverageStats stats(int64_t silent_before_ms) const;
+    std::vector<uint32_t> never_seen(size_t limit) const;
+    // Молчат с момента раньше silent_before_ms, самые давние первыми
+    std::vector<FleetSilentDevice> silent(int64_t silent_before_ms, size_t limit) const;
+
+private:
+    void unlink(uint32_t slot);
+    void insert_sorted(uint32_t slot);
+    void update_locked(uint32_t id, int64_t time_ms);
+
+    std::atomic<bool> active;
+    mutable std::mutex mutex;
+
+    std::unique_ptr<DeviceIndex> index;
+    std::vector<uint32_t> ids;          // номер -> ID
+    std::vector<uint64_t> seen_bits;
+    std::vector<int64_t> last_seen_ms;
+    std::vector<uint32_t> prev;         // список по времени последнего пакета
+    std::vector<uint32_t> next;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t seen_count;
+    uint64_t foreign_packets;
+};
+
+#endif
@@ -0,0 +1,758 @@
+#include "HistoryStore.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// EHS1 - без списка замененных сегментов (читается для совместимости)
+static const char SEGMENT_MAGIC_V1[4] = {'E', 'H', 'S', '1'};
+static const char SEGMENT_MAGIC[4] = {'E', 'H', 'S', '2'};
+static const size_t SEGMENT_HEADER_SIZE = 4 + 4 + 8 + 8 + 8;
+
+static bool sync_file(FILE* f) {
+    if (fflush(f) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+// Переименование переживает сбой питания, только когда синхронизирован
+// каталог (в Windows каталог так не открыть - NTFS журналирует его сама)
+static bool sync_parent_dir(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    std::string dir = fs::path(path).parent_path().string();
+    int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out.resize(size > 0 ? (size_t)size : 0);
+    bool ok = out.empty() || fread(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
+
+HistoryStore::HistoryStore()
+    : opened(false), open_samples(0), open_t_min(0), open_t_max(0),
+      wal_seq(0), wal_dropped(0), wal_error(false), wal(nullptr), wal_file_seq(0),
+      next_seq(1), compactions(0), stopping(false) {
+}
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+
+std::string HistoryStore::segment_path(uint64_t seq) const {
+    char name[64];
+    snprintf(name, sizeof(name), "seg-%012llu.ehs", (unsigned long long)seq);
+    return (fs::path(dir) / name).string();
+}
+
+std::string HistoryStore::wal_path(uint64_t seq) const {
+    char name[64];
+    snprintf(name, sizeof(name), "wal-%012llu.log", (unsigned long long)seq);
+    return (fs::path(dir) / name).string();
+}
+
+bool HistoryStore::open(const std::string& path, std::string* error) {
+    close();
+
+    std::error_code ec;
+    fs::create_directories(path, ec);
+    if (ec) {
+        if (error) *error = "не удалось создать каталог " + path;
+        return false;
+    }
+    dir = path;
+
+    // Сегменты и журналы, оставшиеся с прошлого запуска
+    std::vector<std::pair<uint64_t, std::string>> wals;
+    segments.clear();
+    next_seq = 1;
+
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        unsigned long long seq = 0;
+
+        if (sscanf(name.c_str(), "seg-%llu.ehs", &seq) == 1) {
+            std::shared_ptr<Segment> seg;
+            if (read_segment_header(entry.path().string(), seg)) {
+                seg->seq = seq;
+                segments.push_back(seg);
+            }
+        } else if (sscanf(name.c_str(), "wal-%llu.log", &seq) == 1) {
+            wals.push_back(std::make_pair((uint64_t)seq, entry.path().string()));
+        } else {
+            continue;
+        }
+        if (seq >= next_seq) next_seq = seq + 1;
+    }
+
+    // Слияние, прерванное сбоем до удаления исходных файлов: сегменты,
+    // перечисленные в слитом, удаляются
+    std::set<uint64_t> replaced;
+    for (const auto& seg : segments) {
+        replaced.insert(seg->replaces.begin(), seg->replaces.end());
+    }
+    for (auto it = segments.begin(); it != segments.end();) {
+        if (replaced.count((*it)->seq)) {
+            fs::remove((*it)->path, ec);
+            it = segments.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Проигрываем журналы: каждый превращается в сегмент с тем же номером
+    std::sort(wals.begin(), wals.end());
+    for (const auto& w : wals) {
+        bool have_segment = replaced.count(w.first) != 0;
+        for (const auto& seg : segments) {
+            if (seg->seq == w.first) have_segment = true;
+        }
+        if (!have_segment) {
+            open_encoders = std::make_shared<EncoderMap>();
+            open_samples = 0;
+            if (replay_wal(w.second) && open_samples > 0) {
+                std::shared_ptr<Segment> seg;
+                if (write_segment(segment_path(w.first), *open_encoders, std::vector<uint64_t>(), seg)) {
+                    seg->seq = w.first;
+                    segments.push_back(seg);
+                }
+            }
+        }
+        fs::remove(w.second, ec);
+    }
+
+    std::sort(segments.begin(), segments.end(),
+              [](const std::shared_ptr<Segment>& a, const std::shared_ptr<Segment>& b) {
+                  return a->t_min != b->t_min ? a->t_min < b->t_min : a->seq < b->seq;
+              });
+
+    open_encoders = std::make_shared<EncoderMap>();
+    open_samples = 0;
+    wal_buffer.clear();
+    wal_buffer.reserve(WAL_BUFFER_SIZE);
+    wal_dropped = 0;
+    wal_error = false;
+
+    wal_seq = next_seq++;
+    {
+        std::lock_guard<std::mutex> io(wal_mutex);
+        if (!open_wal_file(wal_seq)) {
+            if (error) *error = "не удалось создать журнал в " + dir;
+            return false;
+        }
+    }
+
+    opened = true;
+    stopping = false;
+    worker = std::thread(&HistoryStore::background, this);
+    return true;
+}
+
+void HistoryStore::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!opened) {
+            return;
+        }
+        // Открытый сегмент тоже уходит на диск
+        if (open_samples > 0) {
+            seal_locked();
+        }
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    remove_retired(true);
+
+    // Журнал нового номера после запечатывания пуст
+    {
+        std::lock_guard<std::mutex> io(wal_mutex);
+        if (wal) {
+            fclose(wal);
+            wal = nullptr;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code ec;
+    fs::remove(wal_path(wal_seq), ec);
+    opened = false;
+}
+
+bool HistoryStore::is_open() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return opened;
+}
+
+bool HistoryStore::open_wal_file(uint64_t seq) {
+    // Дописывание: хвост запечатанного журнала мог уже попасть в файл
+    wal = fopen(wal_path(seq).c_str(), "ab");
+    wal_file_seq = seq;
+    return wal != nullptr;
+}
+
+void HistoryStore::encode_wal(const HistorySample& s) {
+    if (wal_buffer.size() + WAL_RECORD_SIZE > WAL_BUFFER_LIMIT) {
+        wal_dropped++;
+        return;
+    }
+    uint8_t rec[WAL_RECORD_SIZE];
+    memcpy(rec, &s.id, 4);
+    memcpy(rec + 4, &s.time_ms, 8);
+    memcpy(rec + 12, &s.pressure_bar, 4);
+    memcpy(rec + 16, &s.voltage_v, 4);
+    memcpy(rec + 20, &s.temperature_c, 2);
+    memcpy(rec + 22, &s.rssi, 2);
+
+    size_t before = wal_buffer.size();
+    wal_buffer.insert(wal_buffer.end(), rec, rec + WAL_RECORD_SIZE);
+    if (before < WAL_BUFFER_SIZE && wal_buffer.size() >= WAL_BUFFER_SIZE) {
+        wake.notify_one();
+    }
+}
+
+void HistoryStore::write_pending_wal() {
+    std::lock_guard<std::mutex> io(wal_mutex);
+    uint64_t seq;
+    wal_writing.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wal_writing.swap(wal_buffer);
+        seq = wal_seq;
+    }
+    if (wal_writing.empty()) {
+        return;
+    }
+
+    // Файл запечатанного сегмента закрывается: его хвост допишет finish_wal()
+    if (wal && wal_file_seq != seq) {
+        fclose(wal);
+        wal = nullptr;
+    }
+    if (!wal) {
+        open_wal_file(seq);
+    }
+    bool ok = wal && fwrite(wal_writing.data(), 1, wal_writing.size(), wal) == wal_writing.size() &&
+              fflush(wal) == 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ok) {
+        wal_dropped += wal_writing.size() / WAL_RECORD_SIZE;
+    }
+    wal_error = !ok;
+}
+
+void HistoryStore::finish_wal(const SealJob& job) {
+    std::lock_guard<std::mutex> io(wal_mutex);
+    if (wal && wal_file_seq == job.seq) {
+        fclose(wal);
+        wal = nullptr;
+    }
+    FILE* f = fopen(job.wal_path.c_str(), "ab");
+    bool ok = f && fwrite(job.wal_tail.data(), 1, job.wal_tail.size(), f) == job.wal_tail.size() &&
+              sync_file(f);
+    if (f) {
+        fclose(f);
+    }
+    if (!ok) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wal_dropped += job.wal_tail.size() / WAL_RECORD_SIZE;
+        wal_error = true;
+    }
+}
+
+bool HistoryStore::replay_wal(const std::string& path) {
+    std::vector<uint8_t> data;
+    if (!read_file(path, data)) {
+        return false;
+    }
+
+    // Неполная последняя запись (обрыв при сбое) отбрасывается
+    size_t n = data.size() / WAL_RECORD_SIZE;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t* rec = &data[i * WAL_RECORD_SIZE];
+        HistorySample s;
+        memcpy(&s.id, rec, 4);
+        memcpy(&s.time_ms, rec + 4, 8);
+        memcpy(&s.pressure_bar, rec + 12, 4);
+        memcpy(&s.voltage_v, rec + 16, 4);
+        memcpy(&s.temperature_c, rec + 20, 2);
+        memcpy(&s.rssi, rec + 22, 2);
+        append_locked(s);
+    }
+    return true;
+}
+
+void HistoryStore::append_locked(const HistorySample& s) {
+    auto it = open_encoders->find(s.id);
+    if (it == open_encoders->end()) {
+        it = open_encoders->emplace(s.id, SeriesEncoder(s.id)).first;
+    }
+    it->second.append(s);
+
+    if (open_samples == 0 || s.time_ms < open_t_min) open_t_min = s.time_ms;
+    if (open_samples == 0 || s.time_ms > open_t_max) open_t_max = s.time_ms;
+    open_samples++;
+}
+
+void HistoryStore::append(const HistorySample& s) {
+    append(&s, 1);
+}
+
+void HistoryStore::append(const HistorySample* samples, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!opened) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        encode_wal(samples[i]);
+        append_locked(samples[i]);
+
+        if (open_samples >= SEAL_SAMPLES || open_t_max - open_t_min >= SEAL_SPAN_MS) {
+            seal_locked();
+            wake.notify_one();
+        }
+    }
+}
+
+void HistoryStore::flush() {
+    write_pending_wal();
+}
+
+void HistoryStore::seal() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (opened && open_samples > 0) {
+        seal_locked();
+        wake.notify_one();
+    }
+}
+
+void HistoryStore::seal_locked() {
+    // Без ввода-вывода: хвост журнала уходит с заданием, фоновый поток
+    // дописывает и синхронизирует его, пишет сегмент и только потом
+    // удаляет журнал
+    SealJob job;
+    job.encoders = open_encoders;
+    job.seq = wal_seq;
+    job.wal_path = wal_path(wal_seq);
+    job.wal_tail.swap(wal_buffer);
+    jobs.push_back(std::move(job));
+
+    open_encoders = std::make_shared<EncoderMap>();
+    open_samples = 0;
+    wal_seq = next_seq++;
+    wal_buffer.reserve(WAL_BUFFER_SIZE);
+}
+
+bool HistoryStore::write_segment(const std::string& path, const EncoderMap& encoders,
+                                 const std::vector<uint64_t>& replaces, std::shared_ptr<Segment>& out) {
+    size_t data_offset = SEGMENT_HEADER_SIZE + 4 + replaces.size() * 8;
+    std::vector<uint8_t> buf;
+    buf.resize(data_offset);
+
+    uint32_t blocks = 0;
+    int64_t t_min = 0;
+    int64_t t_max = 0;
+    uint64_t samples = 0;
+
+    for (const auto& kv : encoders) {
+        const SeriesEncoder& e = kv.second;
+        if (e.count() == 0) continue;
+        if (samples == 0 || e.first_time() < t_min) t_min = e.first_time();
+        if (samples == 0 || e.last_time() > t_max) t_max = e.last_time();
+        samples += e.count();
+        blocks++;
+        e.serialize(buf);
+    }
+
+    memcpy(&buf[0], SEGMENT_MAGIC, 4);
+    memcpy(&buf[4], &blocks, 4);
+    memcpy(&buf[8], &t_min, 8);
+    memcpy(&buf[16], &t_max, 8);
+    memcpy(&buf[24], &samples, 8);
+    uint32_t replaced = (uint32_t)replaces.size();
+    memcpy(&buf[SEGMENT_HEADER_SIZE], &replaced, 4);
+    if (replaced) {
+        memcpy(&buf[SEGMENT_HEADER_SIZE + 4], replaces.data(), replaces.size() * 8);
+    }
+
+    // Запись во временный файл и атомарное переименование
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size() && sync_file(f);
+    fclose(f);
+
+    std::error_code ec;
+    if (!ok) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    // Журнал и слитые сегменты удаляются только после этого; без
+    // синхронизации сегмент убирается, чтобы точки не удвоились с журналом
+    if (!sync_parent_dir(path)) {
+        fs::remove(path, ec);
+        return false;
+    }
+
+    out = std::make_shared<Segment>();
+    out->path = path;
+    out->seq = 0;
+    out->t_min = t_min;
+    out->t_max = t_max;
+    out->samples = samples;
+    out->bytes = buf.size();
+    out->data_offset = data_offset;
+    out->replaces = replaces;
+    return true;
+}
+
+bool HistoryStore::read_segment_header(const std::string& path, std::shared_ptr<Segment>& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    uint8_t hdr[SEGMENT_HEADER_SIZE];
+    bool ok = fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr);
+    bool v1 = ok && memcmp(hdr, SEGMENT_MAGIC_V1, 4) == 0;
+    ok = ok && (v1 || memcmp(hdr, SEGMENT_MAGIC, 4) == 0);
+
+    std::vector<uint64_t> replaces;
+    uint32_t replaced = 0;
+    if (ok && !v1) {
+        ok = fread(&replaced, 4, 1, f) == 1 && replaced <= (1u << 20);
+        if (ok) {
+            replaces.resize(replaced);
+            ok = replaced == 0 || fread(replaces.data(), 8, replaced, f) == replaced;
+        }
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    if (!ok) {
+        return false;
+    }
+
+    out = std::make_shared<Segment>();
+    out->path = path;
+    out->seq = 0;
+    memcpy(&out->t_min, hdr + 8, 8);
+    memcpy(&out->t_max, hdr + 16, 8);
+    memcpy(&out->samples, hdr + 24, 8);
+    out->bytes = size > 0 ? (uint64_t)size : 0;
+    out->data_offset = v1 ? SEGMENT_HEADER_SIZE : SEGMENT_HEADER_SIZE + 4 + (size_t)replaced * 8;
+    out->replaces.swap(replaces);
+    return true;
+}
+
+uint64_t HistoryStore::scan_encoders(const EncoderMap& encoders, uint32_t id, int64_t from_ms, int64_t to_ms,
+                                     const std::function<void(const HistorySample&)>& fn) {
+    uint64_t n = 0;
+    std::vector<uint8_t> block;
+
+    for (const auto& kv : encoders) {
+        const SeriesEncoder& e = kv.second;
+        if ((id != ALL_DEVICES && e.id() != id) || e.count() == 0) continue;
+        if (e.last_time() < from_ms || e.first_time() > to_ms) continue;
+
+        block.clear();
+        e.serialize(block);
+
+        SeriesDecoder d;
+        if (!d.open(block.data(), block.size(), nullptr)) continue;
+        HistorySample s;
+        while (d.next(s)) {
+            if (s.time_ms >= from_ms && s.time_ms <= to_ms) {
+                fn(s);
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+uint64_t HistoryStore::scan_segment(const Segment& seg, uint32_t id, int64_t from_ms, int64_t to_ms,
+                                    const std::function<void(const HistorySample&)>& fn) {
+    std::vector<uint8_t> data;
+    if (!read_file(seg.path, data) || data.size() < seg.data_offset) {
+        return 0;
+    }
+
+    uint32_t blocks;
+    memcpy(&blocks, &data[4], 4);
+
+    uint64_t n = 0;
+    size_t pos = seg.data_offset;
+    for (uint32_t b = 0; b < blocks && pos < data.size(); b++) {
+        SeriesDecoder d;
+        size_t size = 0;
+        if (!d.open(&data[pos], data.size() - pos, &size)) {
+            break;
+        }
+        pos += size;
+
+        // Заголовок блока позволяет пропустить чужие устройства и время
+        if (id != ALL_DEVICES && d.id() != id) continue;
+        if (d.last_time() < from_ms || d.first_time() > to_ms) continue;
+
+        HistorySample s;
+        while (d.next(s)) {
+            if (s.time_ms >= from_ms && s.time_ms <= to_ms) {
+                fn(s);
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+uint64_t HistoryStore::query(uint32_t id, int64_t from_ms, int64_t to_ms,
+                             const std::function<void(const HistorySample&)>& fn) const {
+    std::vector<std::shared_ptr<Segment>> segs;
+    std::vector<std::shared_ptr<EncoderMap>> sealed;
+    uint64_t n = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        segs = segments;
+        for (const SealJob& job : jobs) {
+            sealed.push_back(job.encoders);
+        }
+    }
+
+    for (const auto& seg : segs) {
+        if (seg->t_max < from_ms || seg->t_min > to_ms) continue;
+        n += scan_segment(*seg, id, from_ms, to_ms, fn);
+    }
+    for (const auto& enc : sealed) {
+        n += scan_encoders(*enc, id, from_ms, to_ms, fn);
+    }
+
+    // Открытый сегмент меняется потоком чтения: под замком только копия
+    // нужных рядов, разбор и вызовы fn - после, как у запечатанных
+    EncoderMap open_copy;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (open_samples > 0 && open_t_max >= from_ms && open_t_min <= to_ms) {
+            auto copy = [&](const EncoderMap::value_type& kv) {
+                const SeriesEncoder& e = kv.second;
+                if (e.count() != 0 && e.last_time() >= from_ms && e.first_time() <= to_ms) {
+                    open_copy.emplace_hint(open_copy.end(), kv.first, e);
+                }
+            };
+            if (id == ALL_DEVICES) {
+                for (const auto& kv : *open_encoders) {
+                    copy(kv);
+                }
+            } else {
+                auto it = open_encoders->find(id);
+                if (it != open_encoders->end()) {
+                    copy(*it);
+                }
+            }
+        }
+    }
+    n += scan_encoders(open_copy, id, from_ms, to_ms, fn);
+    return n;
+}
+
+HistoryStoreStats HistoryStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    HistoryStoreStats st;
+    memset(&st, 0, sizeof(st));
+    for (const auto& seg : segments) {
+        st.samples_total += seg->samples;
+        st.bytes_on_disk += seg->bytes;
+    }
+    for (const SealJob& job : jobs) {
+        for (const auto& kv : *job.encoders) {
+            st.samples_total += kv.second.count();
+        }
+    }
+    st.samples_open = open_samples;
+    st.samples_total += open_samples;
+    st.segment_count = segments.size();
+    st.compactions = compactions;
+    st.wal_dropped = wal_dropped;
+    st.wal_error = wal_error;
+    return st;
+}
+
+void HistoryStore::background() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;) {
+        wake.wait_for(lock, std::chrono::milliseconds(200));
+        // Все задания закрытия уже поставлены вместе с stopping
+        bool last = stopping;
+        lock.unlock();
+
+        // Журнал сбрасывается в ОС не реже раза в 200 мс, вне замка приема
+        write_pending_wal();
+
+        // Запись запечатанных сегментов
+        for (;;) {
+            SealJob job;
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (jobs.empty()) {
+                    break;
+                }
+                job.encoders = jobs.front().encoders;
+                job.seq = jobs.front().seq;
+                job.wal_path = jobs.front().wal_path;
+                job.wal_tail.swap(jobs.front().wal_tail);
+            }
+
+            finish_wal(job);
+            std::shared_ptr<Segment> seg;
+            bool ok = write_segment(segment_path(job.seq), *job.encoders, std::vector<uint64_t>(), seg);
+
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (ok) {
+                    seg->seq = job.seq;
+                    segments.push_back(seg);
+                }
+                jobs.erase(jobs.begin());
+            }
+            // При ошибке журнал остается и будет проигран при следующем открытии
+            if (ok) {
+                std::error_code ec;
+                fs::remove(job.wal_path, ec);
+            }
+        }
+
+        if (last) {
+            break;
+        }
+
+        compact();
+        remove_retired(false);
+        lock.lock();
+    }
+}
+
+void HistoryStore::remove_retired(bool all) {
+    // Запрос держит копию указателя, пока читает файл
+    for (auto it = retired.begin(); it != retired.end();) {
+        if (all || it->use_count() == 1) {
+            std::error_code ec;
+            fs::remove((*it)->path, ec);
+            it = retired.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void HistoryStore::compact() {
+    // Ищем подряд идущие (по времени) мелкие сегменты
+    std::vector<std::shared_ptr<Segment>> run;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::sort(segments.begin(), segments.end(),
+                  [](const std::shared_ptr<Segment>& a, const std::shared_ptr<Segment>& b) {
+                      return a->t_min != b->t_min ? a->t_min < b->t_min : a->seq < b->seq;
+                  });
+
+        for (const auto& seg : segments) {
+            if (seg->bytes < COMPACT_BELOW_BYTES) {
+                run.push_back(seg);
+                if (run.size() >= 16) break;
+            } else if (run.size() >= COMPACT_MIN_SEGMENTS) {
+                break;
+            } else {
+                run.clear();
+            }
+        }
+        if (run.size() < COMPACT_MIN_SEGMENTS) {
+            return;
+        }
+    }
+
+    // Перекодируем точки всех сегментов в один
+    EncoderMap merged;
+    for (const auto& seg : run) {
+        scan_segment(*seg, ALL_DEVICES, INT64_MIN, INT64_MAX, [&merged](const HistorySample& s) {
+            auto it = merged.find(s.id);
+            if (it == merged.end()) {
+                it = merged.emplace(s.id, SeriesEncoder(s.id)).first;
+            }
+            it->second.append(s);
+        });
+    }
+
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seq = next_seq++;
+    }
+
+    // Слитый сегмент перечисляет замененные вместе с их списками: если
+    // исходный файл пережил сбой, open() удалит его по любому потомку
+    std::vector<uint64_t> replaces;
+    for (const auto& seg : run) {
+        replaces.push_back(seg->seq);
+        replaces.insert(replaces.end(), seg->replaces.begin(), seg->replaces.end());
+    }
+    std::sort(replaces.begin(), replaces.end());
+    replaces.erase(std::unique(replaces.begin(), replaces.end()), replaces.end());
+
+    std::shared_ptr<Segment> out;
+    if (!write_segment(segment_path(seq), merged, replaces, out)) {
+        return;
+    }
+    out->seq = seq;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& seg : run) {
+        segments.erase(std::remove(segments.begin(), segments.end(), seg), segments.end());
+        retired.push_back(seg);
+    }
+    segments.push_back(out);
+    compactions++;
+}
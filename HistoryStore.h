@@ -0,0 +1,171 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include "SeriesCodec.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+struct HistoryStoreStats {
+    uint64_t samples_total;     // на диске и в открытом сегменте
+    uint64_t samples_open;
+    uint64_t bytes_on_disk;     // только сегменты, без журнала
+    size_t segment_count;
+    uint64_t compactions;
+    uint64_t wal_dropped;       // точек не попало в журнал (переполнение, ошибка записи)
+    bool wal_error;             // последняя запись журнала не удалась
+};
+
+// Локальное хранилище истории измерений.
+//
+// Поток чтения порта добавляет точки в открытый сегмент: по каждому
+// устройству ведется SeriesEncoder, а сырые точки копятся в буфере
+// журнала (WAL). Файлы пишет только фоновый поток, под своим замком
+// (wal_mutex): остановка диска не задерживает append(). Буфер журнала
+// ограничен WAL_BUFFER_LIMIT; сверх него точки идут только в сегмент и
+// считаются в wal_dropped - при сбое их не восстановить.
+//
+// Когда открытый сегмент набирает SEAL_SAMPLES точек или охватывает
+// SEAL_SPAN_MS, он запечатывается: журнал переключается на новый номер,
+// фоновый поток дописывает и синхронизирует старый журнал, записывает
+// сегмент и только потом удаляет журнал. Тот же поток сливает мелкие
+// сегменты в крупные. При открытии журналы, оставшиеся после аварийного
+// завершения, проигрываются заново.
+//
+// Слитый сегмент перечисляет в заголовке номера сегментов, которые он
+// заменяет (с их собственными списками). Исходные файлы удаляются после
+// записи слитого, когда их перестают читать запросы; если сбой случился
+// раньше, open() удаляет перечисленные сегменты сам, и точки не
+// удваиваются.
+//
+// Файлы каталога:
+//   seg-<seq>.ehs  - сегмент: заголовок, список замененных сегментов и
+//                    блоки SeriesEncoder по устройствам
+//   wal-<seq>.log  - журнал: записи фиксированного размера
+class HistoryStore {
+public:
+    static const uint32_t ALL_DEVICES = 0xFFFFFFFFu;
+    static const uint32_t SEAL_SAMPLES = 1000000;
+    static const int64_t SEAL_SPAN_MS = 3600ll * 1000;
+    static const uint64_t COMPACT_BELOW_BYTES = 8ull * 1024 * 1024;
+    static const size_t COMPACT_MIN_SEGMENTS = 4;
+
+    HistoryStore();
+    ~HistoryStore();
+
+    bool open(const std::string& dir, std::string* error);
+    void close();
+    bool is_open() const;
+
+    // Поток чтения порта
+    void append(const HistorySample& s);
+    // Пачка точек под одной блокировкой
+    void append(const HistorySample* samples, size_t count);
+    // Сбрасывает буфер журнала в ОС (пишет вызывающий поток)
+    void flush();
+    // Принудительно запечатывает открытый сегмент
+    void seal();
+
+    // Любой поток: точки устройства (или всех устройств) в [from_ms, to_ms]
+    // в порядке сегментов; по каждому устройству - по возрастанию времени.
+    // Возвращает число переданных точек.
+    uint64_t query(uint32_t id, int64_t from_ms, int64_t to_ms,
+                   const std::function<void(const HistorySample&)>& fn) const;
+
+    HistoryStoreStats stats() const;
+
+private:
+    struct Segment {
+        std::string path;
+        uint64_t seq;
+        int64_t t_min;
+        int64_t t_max;
+        uint64_t samples;
+        uint64_t bytes;
+        size_t data_offset;             // начало блоков в файле
+        std::vector<uint64_t> replaces; // номера слитых в него сегментов
+    };
+
+    typedef std::map<uint32_t, SeriesEncoder> EncoderMap;
+
+    struct SealJob {
+        std::shared_ptr<EncoderMap> encoders;
+        uint64_t seq;
+        std::string wal_path;
+        std::vector<uint8_t> wal_tail;  // записи журнала, еще не попавшие в файл
+    };
+
+    static const size_t WAL_RECORD_SIZE = 24;
+    static const size_t WAL_BUFFER_SIZE = 64 * 1024;       // будить фоновый поток
+    static const size_t WAL_BUFFER_LIMIT = 16 * 1024 * 1024;
+
+    std::string segment_path(uint64_t seq) const;
+    std::string wal_path(uint64_t seq) const;
+
+    // Под wal_mutex
+    bool open_wal_file(uint64_t seq);
+    void encode_wal(const HistorySample& s);
+    // Фоновый поток и flush(): накопленные записи - в файл журнала
+    void write_pending_wal();
+    // Дописывает хвост журнала запечатанного сегмента и синхронизирует его
+    void finish_wal(const SealJob& job);
+    bool replay_wal(const std::string& path);
+    void append_locked(const HistorySample& s);
+    void seal_locked();
+
+    static bool write_segment(const std::string& path, const EncoderMap& encoders,
+                              const std::vector<uint64_t>& replaces, std::shared_ptr<Segment>& out);
+    static bool read_segment_header(const std::string& path, std::shared_ptr<Segment>& out);
+    static uint64_t scan_encoders(const EncoderMap& encoders, uint32_t id, int64_t from_ms, int64_t to_ms,
+                                  const std::function<void(const HistorySample&)>& fn);
+    static uint64_t scan_segment(const Segment& seg, uint32_t id, int64_t from_ms, int64_t to_ms,
+                                 const std::function<void(const HistorySample&)>& fn);
+
+    void background();
+    void compact();
+    // Удаляет файлы слитых сегментов, которые больше не читаются (all -
+    // все, при закрытии)
+    void remove_retired(bool all);
+
+    std::string dir;
+    mutable std::mutex mutex;
+    bool opened;
+
+    // Открытый сегмент
+    std::shared_ptr<EncoderMap> open_encoders;
+    uint64_t open_samples;
+    int64_t open_t_min;
+    int64_t open_t_max;
+
+    // Журнал открытого сегмента: записи копятся под mutex, файл - под
+    // wal_mutex (берется раньше mutex)
+    uint64_t wal_seq;
+    std::vector<uint8_t> wal_buffer;
+    uint64_t wal_dropped;
+    bool wal_error;
+    std::mutex wal_mutex;
+    FILE* wal;
+    uint64_t wal_file_seq;
+    std::vector<uint8_t> wal_writing;
+
+    std::vector<std::shared_ptr<Segment>> segments;
+    // Слиты, но файлы еще могут читать запросы; только фоновый поток
+    std::vector<std::shared_ptr<Segment>> retired;
+    std::vector<SealJob> jobs;      // запечатаны, но еще не записаны
+    uint64_t next_seq;
+    uint64_t compactions;
+
+    std::thread worker;
+    std::condition_variable wake;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "LatestValues.h"
+#include <stddef.h>
+#include <string.h>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define LATEST_CPU_PAUSE() _mm_pause()
+#else
+#define LATEST_CPU_PAUSE() ((void)0)
+#endif
+
+static_assert(offsetof(LatestPacket, packet_count) % 8 + sizeof(uint32_t) <= 8,
+              "packet_count должен лежать в одном слове");
+
+// Повтор чтения слота: запись длится десятки наносекунд, но писателя,
+// вытесненного посреди нее, ждать на процессоре бессмысленно
+static void wait_writer(unsigned& spins) {
+    if (++spins < 64) {
+        LATEST_CPU_PAUSE();
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+LatestValues::Slot::Slot() : version(0) {
+    for (uint32_t i = 0; i < WORDS; i++) {
+        words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatestValues::Slot::write(const LatestPacket& p) {
+    uint64_t buf[WORDS];
+    memcpy(buf, &p, sizeof(buf));
+
+    // Нечетная версия - запись идет; барьер не дает данным обогнать ее
+    uint32_t v = version.load(std::memory_order_relaxed);
+    version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint32_t i = 0; i < WORDS; i++) {
+        words[i].store(buf[i], std::memory_order_relaxed);
+    }
+    version.store(v + 2, std::memory_order_release);
+}
+
+bool LatestValues::Slot::try_write(const LatestPacket& p) {
+    uint64_t buf[WORDS];
+    memcpy(buf, &p, sizeof(buf));
+
+    uint32_t v = version.load(std::memory_order_relaxed);
+    if ((v & 1) || !version.compare_exchange_strong(v, v + 1, std::memory_order_relaxed)) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint32_t i = 0; i < WORDS; i++) {
+        words[i].store(buf[i], std::memory_order_relaxed);
+    }
+    version.store(v + 2, std::memory_order_release);
+    return true;
+}
+
+bool LatestValues::Slot::read(LatestPacket& out) const {
+    uint64_t buf[WORDS];
+    unsigned spins = 0;
+    for (;;) {
+        uint32_t before = version.load(std::memory_order_acquire);
+        if (before & 1) {
+            wait_writer(spins);     // писатель внутри записи
+            continue;
+        }
+        for (uint32_t i = 0; i < WORDS; i++) {
+            buf[i] = words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+        wait_writer(spins);
+    }
+    memcpy(&out, buf, sizeof(out));
+    return out.packet_count != 0;
+}
+
+uint32_t LatestValues::Slot::packet_count() const {
+    uint64_t word = words[offsetof(LatestPacket, packet_count) / 8].load(std::memory_order_relaxed);
+    uint32_t count;
+    memcpy(&count, (const uint8_t*)&word + offsetof(LatestPacket, packet_count) % 8, sizeof(count));
+    return count;
+}
+
+LatestValues::LatestValues() : index(MAX_DEVICES) {
+    for (uint32_t i = 0; i < MAX_CHUNKS; i++) {
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+LatestValues::~LatestValues() {
+    for (uint32_t i = 0; i < MAX_CHUNKS; i++) {
+        delete[] chunks[i].load(std::memory_order_relaxed);
+    }
+}
+
+LatestValues::Slot* LatestValues::slot(uint32_t n) const {
+    Slot* chunk = chunks[n / CHUNK_SIZE].load(std::memory_order_acquire);
+    return chunk ? &chunk[n % CHUNK_SIZE] : nullptr;
+}
+
+void LatestValues::publish(LatestPacket p) {
+    uint32_t n = index.find_or_insert(p.id);
+    Slot* s = nullptr;
+    if (n != DeviceIndex::NOT_FOUND) {
+        uint32_t c = n / CHUNK_SIZE;
+        Slot* chunk = chunks[c].load(std::memory_order_acquire);
+        if (!chunk) {
+            // Раз на CHUNK_SIZE новых устройств; при одновременном
+            // выделении остается опубликованный первым
+            Slot* fresh = new Slot[CHUNK_SIZE];
+            if (chunks[c].compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) {
+                chunk = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        s = &chunk[n % CHUNK_SIZE];
+    }
+
+    p.packet_count = s ? s->packet_count() + 1 : 1;
+    if (s) {
+        s->write(p);
+    }
+    last_slot.try_write(p);
+}
+
+bool LatestValues::device(uint32_t id, LatestPacket& out) const {
+    uint32_t n = index.find(id);
+    if (n == DeviceIndex::NOT_FOUND) {
+        return false;
+    }
+    const Slot* s = slot(n);
+    return s && s->read(out);
+}
+
+bool LatestValues::last(LatestPacket& out) const {
+    return last_slot.read(out);
+}
+
+void LatestValues::clear() {
+    LatestPacket empty;
+    memset(&empty, 0, sizeof(empty));
+    uint32_t count = index.size();
+    for (uint32_t n = 0; n < count; n++) {
+        Slot* s = slot(n);
+        if (s) {
+            s->write(empty);
+        }
+    }
+    last_slot.write(empty);
+    // Слоты остаются выделенными и достаются устройствам заново по порядку
+    index.clear();
+}
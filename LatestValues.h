@@ -0,0 +1,97 @@
+#ifndef LATESTVALUES_H
+#define LATESTVALUES_H
+
+#include "DeviceIndex.h"
+#include <stdint.h>
+#include <atomic>
+
+// Последний пакет устройства. Размер кратен 8 байтам: запись копируется
+// в слот словами по 8 байт.
+struct LatestPacket {
+    uint32_t id;
+    uint8_t type;
+    uint8_t fw_version;
+    int16_t temperature_c;
+    int16_t rssi;
+    uint16_t reserved;
+    float pressure_bar;
+    float voltage_v;
+    uint32_t packet_count;      // пакетов устройства; заполняет publish()
+    int64_t time_us;            // время приема (UTC)
+    uint64_t sequence;          // номер пакета с начала чтения порта
+    uint8_t raw[26];
+    uint8_t padding[6];
+};
+
+static_assert(sizeof(LatestPacket) % 8 == 0, "LatestPacket копируется словами по 8 байт");
+
+// Таблица последних значений по устройствам.
+//
+// У слота устройства один писатель (поток чтения порта или сегмент
+// DecodePipeline этого устройства), читателей любое число. Каждый
+// слот защищен счетчиком версий (seqlock): писатель делает счетчик
+// нечетным, записывает данные и снова делает его четным; читатель
+// копирует слот и повторяет чтение, если счетчик был нечетным или
+// изменился. Писатель никогда не ждет читателей, читатели не берут
+// блокировок и всегда получают целую запись, а не смесь двух пакетов.
+// Данные слота - атомарные слова с relaxed-доступом, так что
+// одновременное чтение и запись не являются гонкой данных.
+//
+// Слоты выделяются блоками по мере появления устройств, как в
+// PacketHistograms; соответствие ID -> слот дает DeviceIndex. Слот
+// последнего пакета общий для всех писателей: его захватывает
+// сравнением с обменом тот, кто пришел первым, остальные в этот момент
+// его не пишут - чей пакет последний, при параллельной записи все равно
+// не определено.
+//
+// Устройств - до MAX_DEVICES (с запасом для парка в 100 тыс.). Пакеты
+// устройств сверх предела попадают только в last(): device() для них
+// возвращает false, packet_count всегда 1.
+class LatestValues {
+public:
+    static const uint32_t MAX_DEVICES = MAX_TRACKED_DEVICES;
+
+    LatestValues();
+    ~LatestValues();
+
+    // Писатель устройства p.id
+    void publish(LatestPacket p);
+
+    // Любой поток; false - пакетов устройства еще не было
+    bool device(uint32_t id, LatestPacket& out) const;
+    // Последний пакет любого устройства
+    bool last(LatestPacket& out) const;
+    uint32_t device_count() const { return index.size(); }
+
+    // Забывает значения и устройства (device_count() - 0). Только при
+    // остановленном потоке чтения и без читателей в других потоках.
+    void clear();
+
+private:
+    static const uint32_t WORDS = sizeof(LatestPacket) / 8;
+    static const uint32_t CHUNK_SIZE = 256;
+    static const uint32_t MAX_CHUNKS = MAX_DEVICES / CHUNK_SIZE;
+
+    // Слот занимает целые кэш-линии: запись одного устройства не
+    // сбрасывает у читателей линии соседних
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> version;
+        std::atomic<uint64_t> words[WORDS];
+
+        Slot();
+        void write(const LatestPacket& p);
+        // Запись при нескольких писателях; false - слот занят другим
+        bool try_write(const LatestPacket& p);
+        bool read(LatestPacket& out) const;
+        // Только для писателя: его собственные записи всегда целые
+        uint32_t packet_count() const;
+    };
+
+    Slot* slot(uint32_t n) const;
+
+    DeviceIndex index;
+    std::atomic<Slot*> chunks[MAX_CHUNKS];
+    Slot last_slot;
+};
+
+#endif
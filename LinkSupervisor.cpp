@@ -0,0 +1,107 @@
+#include "LinkSupervisor.h"
+#include <chrono>
+
+LinkSupervisor::LinkSupervisor(uint32_t initial_ms, uint32_t max_ms)
+    : initial_ms(initial_ms), max_ms(max_ms), current_ms(initial_ms),
+      rng((uint32_t)std::chrono::steady_clock::now().time_since_epoch().count()),
+      link_state(LINK_IDLE), failed_attempts(0), stall_ms(60000),
+      open(false), total_count(0), closed_total_us(0) {
+}
+
+void LinkSupervisor::connecting() {
+    link_state.store(LINK_CONNECTING, std::memory_order_relaxed);
+}
+
+int64_t LinkSupervisor::connected(int64_t now_us) {
+    current_ms = initial_ms;
+    failed_attempts.store(0, std::memory_order_relaxed);
+    link_state.store(LINK_UP, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!open) {
+        return 0;
+    }
+    int64_t start_us = gaps.back().start_us;
+    close_gap(now_us);
+    return now_us > start_us ? now_us - start_us : 0;
+}
+
+void LinkSupervisor::lost(int64_t now_us, LinkGapReason reason) {
+    link_state.store(LINK_BACKOFF, std::memory_order_relaxed);
+    failed_attempts.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (open) {
+        return;
+    }
+    if (gaps.size() == MAX_KEPT) {
+        gaps.pop_front();
+    }
+    gaps.push_back(LinkGap{now_us, 0, (uint8_t)reason});
+    open = true;
+    total_count++;
+}
+
+uint32_t LinkSupervisor::next_delay_ms() {
+    uint32_t base = current_ms;
+    current_ms = current_ms >= max_ms / 2 ? max_ms : current_ms * 2;
+    return base / 2 + (uint32_t)(rng() % (base / 2 + 1));
+}
+
+void LinkSupervisor::stopped(int64_t now_us) {
+    current_ms = initial_ms;
+    failed_attempts.store(0, std::memory_order_relaxed);
+    link_state.store(LINK_IDLE, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (open) {
+        close_gap(now_us);
+    }
+}
+
+void LinkSupervisor::close_gap(int64_t now_us) {
+    LinkGap& g = gaps.back();
+    g.end_us = now_us > g.start_us ? now_us : g.start_us;
+    closed_total_us += g.end_us - g.start_us;
+    open = false;
+}
+
+uint64_t LinkSupervisor::gap_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_count;
+}
+
+int64_t LinkSupervisor::gap_total_us(int64_t now_us) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t total = closed_total_us;
+    if (open && now_us > gaps.back().start_us) {
+        total += now_us - gaps.back().start_us;
+    }
+    return total;
+}
+
+bool LinkSupervisor::gap_open() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return open;
+}
+
+std::vector<LinkGap> LinkSupervisor::recent_gaps(size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t n = gaps.size() < limit ? gaps.size() : limit;
+    return std::vector<LinkGap>(gaps.end() - n, gaps.end());
+}
+
+void LinkSupervisor::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Открытый разрыв еще идет и остается; забываются закрытые
+    if (open) {
+        LinkGap g = gaps.back();
+        gaps.clear();
+        gaps.push_back(g);
+        total_count = 1;
+    } else {
+        gaps.clear();
+        total_count = 0;
+    }
+    closed_total_us = 0;
+}
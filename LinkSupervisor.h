@@ -0,0 +1,93 @@
+#ifndef LINKSUPERVISOR_H
+#define LINKSUPERVISOR_H
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+
+enum LinkState {
+    LINK_IDLE = 0,      // чтение не запущено
+    LINK_CONNECTING,    // поиск и открытие порта
+    LINK_UP,            // порт открыт, данные читаются
+    LINK_BACKOFF        // пауза перед следующей попыткой
+};
+
+enum LinkGapReason {
+    GAP_ERROR = 0,      // ошибка чтения или порт закрылся
+    GAP_STALL,          // порт на месте, но данных нет дольше stall_timeout
+    GAP_REMOVED,        // устройство порта исчезло
+    GAP_NO_PORT         // порт не открылся при запуске
+};
+
+// Разрыв связи с приемником. Время - UTC, мкс; end_us == 0, пока
+// разрыв не закрыт.
+struct LinkGap {
+    int64_t start_us;
+    int64_t end_us;
+    uint8_t reason;
+};
+
+// Надзор за соединением с приемником.
+//
+// Поток чтения сообщает о потере связи (lost) и о восстановлении
+// (connected); между ними идет один разрыв, сколько бы попыток ни
+// потребовалось. Паузы между попытками растут вдвое от initial_ms до
+// max_ms, к каждой добавляется случайная половина (equal jitter), чтобы
+// несколько приложений на одном сервере портов не переподключались
+// одновременно. Последние MAX_KEPT разрывов доступны любому потоку.
+class LinkSupervisor {
+public:
+    static const size_t MAX_KEPT = 1024;
+
+    explicit LinkSupervisor(uint32_t initial_ms = 250, uint32_t max_ms = 30000);
+
+    // 0 - зависание не отслеживается; по умолчанию минута: эфир может
+    // молчать дольше периода передачи датчиков
+    void set_stall_timeout_ms(uint32_t ms) { stall_ms.store(ms, std::memory_order_relaxed); }
+    uint32_t stall_timeout_ms() const { return stall_ms.load(std::memory_order_relaxed); }
+
+    // Поток чтения
+    void connecting();
+    // Закрывает открытый разрыв; возвращает его длительность (0 - разрыва не было)
+    int64_t connected(int64_t now_us);
+    // Открывает разрыв, если он еще не открыт
+    void lost(int64_t now_us, LinkGapReason reason);
+    // Пауза перед следующей попыткой
+    uint32_t next_delay_ms();
+    // Чтение остановлено: открытый разрыв закрывается моментом остановки
+    void stopped(int64_t now_us);
+
+    // Любой поток
+    LinkState state() const { return (LinkState)link_state.load(std::memory_order_relaxed); }
+    uint32_t attempts() const { return failed_attempts.load(std::memory_order_relaxed); }
+    uint64_t gap_count() const;
+    // Суммарная длительность разрывов, включая открытый
+    int64_t gap_total_us(int64_t now_us) const;
+    bool gap_open() const;
+    // Последние разрывы, новые в конце
+    std::vector<LinkGap> recent_gaps(size_t limit) const;
+    void clear();
+
+private:
+    void close_gap(int64_t now_us);
+
+    uint32_t initial_ms;
+    uint32_t max_ms;
+    uint32_t current_ms;
+    std::minstd_rand rng;
+
+    std::atomic<int> link_state;
+    std::atomic<uint32_t> failed_attempts;
+    std::atomic<uint32_t> stall_ms;
+
+    mutable std::mutex mutex;
+    std::deque<LinkGap> gaps;
+    bool open;
+    uint64_t total_count;
+    int64_t closed_total_us;
+};
+
+#endif
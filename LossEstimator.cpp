@@ -0,0 +1,280 @@
+#include "LossEstimator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+LossEstimator::LossEstimator(uint64_t window_us) : window_us(window_us), gap_total_us(0) {
+}
+
+double LossEstimator::rate(uint64_t missed, uint64_t expected) {
+    return expected ? (double)missed / (double)expected : 0.0;
+}
+
+void LossEstimator::rerank(Shard& sh, uint32_t id, State& s) {
+    double r = rate(s.missed, s.expected);
+    if (r == s.ranked_rate) {
+        return;
+    }
+    sh.ranking.erase(RankKey(s.ranked_rate, id));
+    sh.ranking.insert(RankKey(r, id));
+    s.ranked_rate = r;
+}
+
+void LossEstimator::update(uint32_t id, uint64_t now_us) {
+    Shard& sh = shards[device_shard(id)];
+    std::lock_guard<std::mutex> lock(sh.mutex);
+    update_locked(sh, id, now_us);
+}
+
+void LossEstimator::update(const uint32_t* ids, const uint64_t* now_us, size_t count) {
+    // Подряд идущие пакеты одного сегмента - под одним взятием замка
+    size_t i = 0;
+    while (i < count) {
+        unsigned shard = device_shard(ids[i]);
+        Shard& sh = shards[shard];
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        do {
+            update_locked(sh, ids[i], now_us[i]);
+            i++;
+        } while (i < count && device_shard(ids[i]) == shard);
+    }
+}
+
+void LossEstimator::update_locked(Shard& sh, uint32_t id, uint64_t now_us) {
+    uint64_t gap_total = gap_total_us.load(std::memory_order_relaxed);
+    auto it = sh.states.find(id);
+    if (it == sh.states.end()) {
+        // Первый пакет устройства
+        State s;
+        memset(&s, 0, sizeof(s));
+        auto cfg = sh.configured_periods.find(id);
+        if (cfg != sh.configured_periods.end()) {
+            s.period_us = cfg->second;
+            s.configured = true;
+            s.learned_intervals = LEARN_INTERVALS;
+        }
+        s.last_us = now_us;
+        s.received = 1;
+        s.window_start_us = now_us;
+        s.gap_mark_us = gap_total;
+        sh.states.emplace(id, s);
+        sh.ranking.insert(RankKey(0.0, id));
+        return;
+    }
+
+    State& s = it->second;
+    if (now_us <= s.last_us) {
+        return;
+    }
+    uint64_t dt = now_us - s.last_us;
+
+    // Повтор того же пакета через репитер
+    if (dt < DUPLICATE_US) {
+        return;
+    }
+
+    if (s.period_us == 0) {
+        s.period_us = dt;
+        s.learned_intervals = 1;
+        s.last_us = now_us;
+        s.received++;
+        s.gap_mark_us = gap_total;
+        return;
+    }
+
+    if (dt < (uint64_t)(DUPLICATE_FRACTION * (double)s.period_us)) {
+        return;
+    }
+
+    // Смена окна
+    if (now_us - s.window_start_us >= window_us) {
+        s.prev_window_expected = s.window_expected;
+        s.prev_window_missed = s.window_missed;
+        s.window_expected = 0;
+        s.window_missed = 0;
+        s.window_start_us = now_us;
+    }
+
+    s.received++;
+    s.last_us = now_us;
+
+    // Интервал через разрыв связи: передачи за время разрыва не
+    // ожидаются, период по такому интервалу не учится
+    uint64_t gap_us = gap_total - s.gap_mark_us;
+    if (gap_us) {
+        s.gap_mark_us = gap_total;
+        if (s.learned_intervals >= LEARN_INTERVALS) {
+            uint64_t live_us = dt > gap_us ? dt - gap_us : 0;
+            uint64_t k = (uint64_t)std::llround((double)live_us / (double)s.period_us);
+            if (k == 0) {
+                k = 1;
+            }
+            s.expected += k;
+            s.missed += k - 1;
+            s.window_expected += k;
+            s.window_missed += k - 1;
+            rerank(sh, id, s);
+        }
+        return;
+    }
+
+    uint64_t k = (uint64_t)std::llround((double)dt / (double)s.period_us);
+
+    if (k == 0) {
+        // Интервал заметно короче периода: возможно, период выучен неверно
+        if (!s.configured && ++s.short_intervals >= RELEARN_THRESHOLD) {
+            s.period_us = dt;
+            s.short_intervals = 0;
+            s.learned_intervals = 1;
+        }
+        if (s.learned_intervals >= LEARN_INTERVALS) {
+            s.expected++;
+            s.window_expected++;
+        }
+        rerank(sh, id, s);
+        return;
+    }
+    s.short_intervals = 0;
+
+    if (s.learned_intervals < LEARN_INTERVALS) {
+        // Обучение: берем минимальный интервал, потери пока не считаем
+        if (dt < s.period_us) {
+            s.period_us = dt;
+        }
+        s.learned_intervals++;
+        return;
+    }
+
+    s.expected += k;
+    s.missed += k - 1;
+    s.window_expected += k;
+    s.window_missed += k - 1;
+
+    // Медленная подстройка выученного периода под дрейф генератора
+    if (!s.configured) {
+        int64_t err = (int64_t)(dt / k) - (int64_t)s.period_us;
+        s.period_us = (uint64_t)((int64_t)s.period_us + err / 16);
+    }
+
+    rerank(sh, id, s);
+}
+
+int LossEstimator::load_periods(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) {
+        return -1;
+    }
+
+    int loaded = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char* end = nullptr;
+        unsigned long id = strtoul(line, &end, 0);
+        if (end == line) {
+            continue;
+        }
+        char* end2 = nullptr;
+        double period_s = strtod(end, &end2);
+        if (end2 == end || period_s <= 0) {
+            continue;
+        }
+
+        set_period((uint32_t)id, period_s);
+        loaded++;
+    }
+
+    fclose(f);
+    return loaded;
+}
+
+void LossEstimator::set_period(uint32_t id, double period_s) {
+    Shard& sh = shards[device_shard(id)];
+    std::lock_guard<std::mutex> lock(sh.mutex);
+
+    uint64_t period_us = (uint64_t)(period_s * 1e6);
+    sh.configured_periods[id] = period_us;
+
+    auto it = sh.states.find(id);
+    if (it != sh.states.end()) {
+        it->second.period_us = period_us;
+        it->second.configured = true;
+        it->second.learned_intervals = LEARN_INTERVALS;
+    }
+}
+
+void LossEstimator::fill_info(uint32_t id, const State& s, DeviceLossInfo& out) const {
+    out.id = id;
+    out.period_s = s.learned_intervals >= LEARN_INTERVALS ? s.period_us / 1e6 : 0.0;
+    out.period_from_config = s.configured;
+    out.received = s.received;
+    out.expected = s.expected;
+    out.missed = s.missed;
+    out.loss_rate = rate(s.missed, s.expected);
+    out.window_expected = s.prev_window_expected;
+    out.window_missed = s.prev_window_missed;
+    out.window_loss_rate = rate(s.prev_window_missed, s.prev_window_expected);
+}
+
+bool LossEstimator::device(uint32_t id, DeviceLossInfo& out) const {
+    const Shard& sh = shards[device_shard(id)];
+    std::lock_guard<std::mutex> lock(sh.mutex);
+
+    auto it = sh.states.find(id);
+    if (it == sh.states.end()) {
+        return false;
+    }
+    fill_info(id, it->second, out);
+    return true;
+}
+
+// Из каждого сегмента - не больше count первых по рейтингу, общий
+// порядок - тот же, что у рейтинга сегмента
+std::vector<DeviceLossInfo> LossEstimator::worst(size_t count) const {
+    std::vector<DeviceLossInfo> result;
+    for (const Shard& sh : shards) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        size_t taken = 0;
+        for (auto it = sh.ranking.begin(); it != sh.ranking.end() && taken < count; ++it) {
+            if (it->first <= 0.0) {
+                break;
+            }
+            auto st = sh.states.find(it->second);
+            if (st == sh.states.end()) {
+                continue;
+            }
+            DeviceLossInfo info;
+            fill_info(it->second, st->second, info);
+            result.push_back(info);
+            taken++;
+        }
+    }
+
+    auto worse = [](const DeviceLossInfo& a, const DeviceLossInfo& b) {
+        return RankKey(a.loss_rate, a.id) > RankKey(b.loss_rate, b.id);
+    };
+    if (result.size() > count) {
+        std::partial_sort(result.begin(), result.begin() + count, result.end(), worse);
+        result.resize(count);
+    } else {
+        std::sort(result.begin(), result.end(), worse);
+    }
+    return result;
+}
+
+void LossEstimator::clear() {
+    for (Shard& sh : shards) {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        sh.states.clear();
+        sh.ranking.clear();
+    }
+    gap_total_us.store(0);
+}
+
+void LossEstimator::add_gap(uint64_t duration_us) {
+    gap_total_us.fetch_add(duration_us, std::memory_order_relaxed);
+}
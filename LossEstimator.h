@@ -0,0 +1,110 @@
+#ifndef LOSSESTIMATOR_H
+#define LOSSESTIMATOR_H
+
+#include "DeviceIndex.h"
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <string>
+#include <functional>
+
+// Оценка потерь по одному устройству
+struct DeviceLossInfo {
+    uint32_t id;
+    double period_s;        // номинальный период передачи (0 - еще не известен)
+    bool period_from_config;
+    uint64_t received;
+    uint64_t expected;
+    uint64_t missed;
+    double loss_rate;       // missed / expected за все время
+
+    // Последнее закрытое окно
+    uint64_t window_expected;
+    uint64_t window_missed;
+    double window_loss_rate;
+};
+
+// Оценка пропущенных передач датчиков.
+// Номинальный период берется из конфигурации или выучивается по истории
+// интервалов прихода. Каждый пакет обновляет только свое устройство и
+// его позицию в рейтинге (O(log n)), полного обхода устройств нет.
+//
+// Устройства разложены по DEVICE_SHARDS сегментам, как в DeviceStats, у
+// каждого сегмента свой замок и свой рейтинг: потоки конвейера с разными
+// сегментами не ждут друг друга. worst() сшивает вершины рейтингов.
+class LossEstimator {
+public:
+    explicit LossEstimator(uint64_t window_us = 600ull * 1000000ull);
+
+    // Поток чтения: пакет устройства id пришел в момент now_us
+    void update(uint32_t id, uint64_t now_us);
+    // Пачка пакетов под одной блокировкой
+    void update(const uint32_t* ids, const uint64_t* now_us, size_t count);
+    // Поток чтения: связи с приемником не было duration_us. Интервал,
+    // в который попал разрыв, считается без времени разрыва.
+    void add_gap(uint64_t duration_us);
+
+    // Файл вида "0x1A2B3C4D 30" (ID и период в секундах), '#' - комментарий.
+    // Возвращает число прочитанных записей или -1, если файл не открылся.
+    int load_periods(const std::string& path);
+    void set_period(uint32_t id, double period_s);
+
+    bool device(uint32_t id, DeviceLossInfo& out) const;
+    // Устройства с наибольшей долей потерь
+    std::vector<DeviceLossInfo> worst(size_t count) const;
+    void clear();
+
+private:
+    // Интервалы короче этой доли периода или короче DUPLICATE_US
+    // считаются повтором того же пакета (ретрансляция)
+    static constexpr double DUPLICATE_FRACTION = 0.2;
+    static const uint64_t DUPLICATE_US = 200000;
+    // Сколько интервалов наблюдаем до начала подсчета потерь
+    static const uint32_t LEARN_INTERVALS = 4;
+    // Сколько подряд коротких интервалов нужно, чтобы переучить период
+    static const uint32_t RELEARN_THRESHOLD = 3;
+
+    struct State {
+        uint64_t last_us;
+        uint64_t period_us;
+        bool configured;
+        uint32_t learned_intervals;
+        uint32_t short_intervals;
+
+        uint64_t received;
+        uint64_t expected;
+        uint64_t missed;
+
+        uint64_t window_start_us;
+        uint64_t window_expected;
+        uint64_t window_missed;
+        uint64_t prev_window_expected;
+        uint64_t prev_window_missed;
+
+        double ranked_rate;
+        uint64_t gap_mark_us;       // gap_total_us на момент прошлого пакета
+    };
+
+    typedef std::pair<double, uint32_t> RankKey;
+
+    static double rate(uint64_t missed, uint64_t expected);
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<uint32_t, State> states;
+        std::unordered_map<uint32_t, uint64_t> configured_periods;
+        std::set<RankKey, std::greater<RankKey>> ranking;
+    };
+
+    void fill_info(uint32_t id, const State& s, DeviceLossInfo& out) const;
+    static void rerank(Shard& sh, uint32_t id, State& s);
+    void update_locked(Shard& sh, uint32_t id, uint64_t now_us);
+
+    uint64_t window_us;
+    std::atomic<uint64_t> gap_total_us;
+    Shard shards[DEVICE_SHARDS];
+};
+
+#endif
@@ -1,5 +1,5 @@
 #include "MainWindow.h"
-#include <QtConcurrent/QtConcurrent>
+#include "CaptureViewer.h"
 #include <QHeaderView>
 #include <QDateTime>
 #include <QTimer>
@@ -8,12 +8,21 @@
 #include <QFont>
 #include <QFontMetrics>
 #include <QPalette>
+#include <QCoreApplication>
+#include <QFile>
+#include <QTextDocument>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QDir>
+#include <QStandardItemModel>
+#include <algorithm>
+#include <cstring>
 
 MainWindow::MainWindow(QWidget *parent)
         : QMainWindow(parent), enod(nullptr), isConnected(false),
           uniquePacketCount(0), totalPacketCount(0),
           sensorCount(0), repeaterCount(0), unknownCount(0),
-          packetCountInPeriod(0), uniquePacketCountInPeriod(0),
+          uniquePacketCountInPeriod(0),
           lastSummaryTime(QDateTime::currentDateTime()),
           lastPacketTime(QDateTime::currentDateTime()),
           lastRepeaterTime(QDateTime::currentDateTime())
@@ -31,13 +40,75 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Подключаем сигналы и слоты
     connect(refreshButton, &QPushButton::clicked, this, &MainWindow::refreshPorts);
+    connect(sourceComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::updateSourceKind);
+    updateSourceKind();
     connect(connectButton, &QPushButton::clicked, this, &MainWindow::connectToPort);
     connect(disconnectButton, &QPushButton::clicked, this, &MainWindow::disconnectFromPort);
     connect(clearButton, &QPushButton::clicked, this, &MainWindow::clearDisplay);
     connect(resetButton, &QPushButton::clicked, this, &MainWindow::resetData);
+    connect(liveExportButton, &QPushButton::toggled, this, &MainWindow::toggleLiveExport);
+    connect(exportRegistryButton, &QPushButton::clicked, this, &MainWindow::exportRegistry);
+    connect(exportHistoryButton, &QPushButton::clicked, this, &MainWindow::exportHistory);
+    connect(captureButton, &QPushButton::toggled, this, &MainWindow::toggleCapture);
+    connect(openCaptureButton, &QPushButton::clicked, this, &MainWindow::openCapture);
+    connect(tableFilterEdit, &QLineEdit::returnPressed, this, &MainWindow::applyTableFilter);
+    connect(exportFilterCheckBox, &QCheckBox::toggled, this, &MainWindow::toggleExportFilter);
+    connect(exportLosslessCheckBox, &QCheckBox::toggled, this, &MainWindow::applyQueuePolicies);
+    connect(displayPolicyComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::applyQueuePolicies);
+    connect(fleetImportButton, &QPushButton::clicked, this, &MainWindow::importFleet);
+    connect(fleetMissingButton, &QPushButton::clicked, this, &MainWindow::showMissingDevices);
+
+    // Кадры для отображения: один сигнал на накопленную пачку
+    connect(enod, &Enod::displayReady, this, &MainWindow::drainDisplay);
+    applyQueuePolicies();
+
+    // Номинальные периоды передачи датчиков (необязательный файл)
+    enod->losses().load_periods(
+            (QCoreApplication::applicationDirPath() + "/periods.conf").toStdString());
+
+    // Хранилище истории
+    std::string historyError;
+    if (!enod->history().open((QCoreApplication::applicationDirPath() + "/history").toStdString(), &historyError)) {
+        statusBar()->showMessage("История недоступна: " + QString::fromStdString(historyError));
+    }
+    rollupsPath = QCoreApplication::applicationDirPath() + "/history/rollups.bin";
+    enod->rollups().load(rollupsPath.toStdString());
+    // Агрегаты сохраняются раз в минуту: точки после последнего сохранения
+    // (или все, если файла нет) добираются из истории фоновым потоком,
+    // пока порт еще не выбран
+    enod->replay_rollups();
+
+    // Реестр устройств прошлой сессии; строки таблицы досоздаются уже
+    // после показа окна
+    sessionSnapshotPath = QCoreApplication::applicationDirPath() + "/session.snap";
+    restoreSession();
+
+    // Правила тревог (необязательный файл)
+    QString alarmsPath = QCoreApplication::applicationDirPath() + "/alarms.rules";
+    if (QFile::exists(alarmsPath)) {
+        std::string error;
+        if (enod->alarms().load_file(alarmsPath.toStdString(), &error)) {
+            statusBar()->showMessage(QString("Загружено правил тревог: %1").arg(enod->alarms().rule_count()), 3000);
+        } else {
+            statusBar()->showMessage("alarms.rules: " + QString::fromStdString(error));
+        }
+    }
 
-    // Подключаем сигнал от Enod
-    connect(enod, &Enod::newDataAvailable, this, &MainWindow::onDataReceived);
+    // Ожидаемый парк устройств (необязательный файл)
+    QString fleetPath = QCoreApplication::applicationDirPath() + "/fleet.list";
+    if (QFile::exists(fleetPath)) {
+        std::string error;
+        if (enod->fleet().load_file(fleetPath.toStdString(), &error)) {
+            seedFleetFromRegistry();
+        } else {
+            statusBar()->showMessage("fleet.list: " + QString::fromStdString(error));
+        }
+    }
+
+    // Списки допуска/запрета устройств (необязательный файл)
+    deviceListsPath = QCoreApplication::applicationDirPath() + "/devices.list";
+    reloadDeviceLists();
 
     // Таймер для обновления текущего времени
     QTimer *clockTimer = new QTimer(this);
@@ -47,13 +118,28 @@ MainWindow::MainWindow(QWidget *parent)
     // Таймер для обновления индикаторов связи
     QTimer *indicatorTimer = new QTimer(this);
     connect(indicatorTimer, &QTimer::timeout, this, &MainWindow::updateConnectionIndicators);
+    connect(indicatorTimer, &QTimer::timeout, this, &MainWindow::updateFleetSummary);
+    connect(indicatorTimer, &QTimer::timeout, this, &MainWindow::updateLossRanking);
+    connect(indicatorTimer, &QTimer::timeout, this, &MainWindow::updateFleetCoverage);
+    connect(indicatorTimer, &QTimer::timeout, this, &MainWindow::updateLinkStatus);
+    connect(indicatorTimer, &QTimer::timeout, this, &MainWindow::updateRealtimeStatus);
     indicatorTimer->start(1000);
 
+    // Таймер для выборки тревог пачками
+    QTimer *alarmTimer = new QTimer(this);
+    connect(alarmTimer, &QTimer::timeout, this, &MainWindow::drainAlarms);
+    alarmTimer->start(250);
+
     // Таймер для периодической сводки
     QTimer *summaryTimer = new QTimer(this);
     connect(summaryTimer, &QTimer::timeout, this, &MainWindow::generateSummary);
     summaryTimer->start(30000);
 
+    // Таймер для снимка реестра устройств
+    QTimer *snapshotTimer = new QTimer(this);
+    connect(snapshotTimer, &QTimer::timeout, this, &MainWindow::saveSession);
+    snapshotTimer->start(60000);
+
     // Первоначальное обновление списка портов
     refreshPorts();
 }
@@ -61,7 +147,11 @@ MainWindow::MainWindow(QWidget *parent)
 MainWindow::~MainWindow()
 {
     if (enod) {
+        // Дожидается потока чтения: после этого enod можно удалять
         enod->stop();
+        saveSession();
+        sessionSnapshot.wait();
+        enod->rollups().wait();
         delete enod;
     }
 }
@@ -78,15 +168,68 @@ void MainWindow::setupUI()
     QGroupBox *portControlGroup = new QGroupBox("Управление портом", centralWidget);
     portControlGroup->setMaximumWidth(280);
 
-    QLabel *portLabel = new QLabel("Порт:", portControlGroup);
-    portComboBox = new QComboBox(portControlGroup);
+    QLabel *sourceLabel = new QLabel("Источник:", portControlGroup);
+    sourceComboBox = new QComboBox(portControlGroup);
+    sourceComboBox->addItem("COM-порт", SOURCE_SERIAL);
+    sourceComboBox->addItem("Файл (повтор)", SOURCE_FILE);
+    sourceComboBox->addItem("stdin / канал", SOURCE_PIPE);
+    sourceComboBox->addItem("TCP", SOURCE_TCP);
+    sourceComboBox->addItem("RFC 2217", SOURCE_RFC2217);
+    sourceComboBox->addItem("UNIX-сокет", SOURCE_UNIX);
+    sourceAddressEdit = new QLineEdit(portControlGroup);
+    sourceAddressEdit->setClearButtonEnabled(true);
+
+    // Выбор COM-порта: виден только для него
+    serialSettingsWidget = new QWidget(portControlGroup);
+    QLabel *portLabel = new QLabel("Порт:", serialSettingsWidget);
+    portComboBox = new QComboBox(serialSettingsWidget);
     portComboBox->addItem("Выберите порт...");
 
-    QLabel *speedLabel = new QLabel("Скорость:", portControlGroup);
-    speedComboBox = new QComboBox(portControlGroup);
-    speedComboBox->addItems(QStringList() << "1200" << "2400" << "4800" << "9600" << "19200" << "38400" << "57600" << "115200");
+    QVBoxLayout *serialLayout = new QVBoxLayout(serialSettingsWidget);
+    serialLayout->setContentsMargins(0, 0, 0, 0);
+    serialLayout->addWidget(portLabel);
+    serialLayout->addWidget(portComboBox);
+
+    // Скорость линии: у COM-порта и у порта за сервером RFC 2217
+    speedSettingsWidget = new QWidget(portControlGroup);
+    QLabel *speedLabel = new QLabel("Скорость:", speedSettingsWidget);
+    speedComboBox = new QComboBox(speedSettingsWidget);
+    speedComboBox->addItems(QStringList() << "1200" << "2400" << "4800" << "9600" << "19200" << "38400" << "57600" << "115200"
+                                          << "230400" << "460800" << "921600");
     speedComboBox->setCurrentIndex(3);
 
+    QVBoxLayout *speedLayout = new QVBoxLayout(speedSettingsWidget);
+    speedLayout->setContentsMargins(0, 0, 0, 0);
+    speedLayout->addWidget(speedLabel);
+    speedLayout->addWidget(speedComboBox);
+
+    QLabel *readBackendLabel = new QLabel("Чтение:", portControlGroup);
+    readBackendComboBox = new QComboBox(portControlGroup);
+    readBackendComboBox->addItem("poll/read", Enod::READ_POLL);
+    readBackendComboBox->addItem("io_uring", Enod::READ_URING);
+    if (!UringReader::available()) {
+        // Пункт остается виден, но выбрать его нельзя
+        qobject_cast<QStandardItemModel*>(readBackendComboBox->model())->item(1)->setEnabled(false);
+        readBackendComboBox->setToolTip("io_uring недоступен: нужно ядро Linux 5.11+");
+    } else {
+        readBackendComboBox->setToolTip("Действует со следующего подключения");
+    }
+    pipelineWorkersSpinBox = new QSpinBox(portControlGroup);
+    pipelineWorkersSpinBox->setRange(0, (int)DecodePipeline::MAX_WORKERS);
+    pipelineWorkersSpinBox->setValue(0);
+    pipelineWorkersSpinBox->setPrefix("Потоков разбора: ");
+    pipelineWorkersSpinBox->setSpecialValueText("Разбор в потоке чтения");
+    pipelineWorkersSpinBox->setToolTip("Разбор кадров и статистика в пуле потоков, для многих быстрых портов.\n"
+                                       "Действует со следующего подключения");
+    displayPolicyComboBox = new QComboBox(portControlGroup);
+    displayPolicyComboBox->addItem(QString("Таблица: %1").arg(queue_policy_name(QUEUE_COALESCE)), QUEUE_COALESCE);
+    displayPolicyComboBox->addItem(QString("Таблица: %1").arg(queue_policy_name(QUEUE_DROP_OLDEST)), QUEUE_DROP_OLDEST);
+    displayPolicyComboBox->addItem(QString("Таблица: %1").arg(queue_policy_name(QUEUE_DROP_NEWEST)), QUEUE_DROP_NEWEST);
+    displayPolicyComboBox->addItem(QString("Таблица: %1").arg(queue_policy_name(QUEUE_BLOCK)), QUEUE_BLOCK);
+    displayPolicyComboBox->setToolTip("Что делать с кадрами для таблицы, когда интерфейс не успевает.\n"
+                                      "Запись кадров, статистика, история и экспорт получают все кадры;\n"
+                                      "при ожидании разбор стоит, пока интерфейс не заберет очередь.");
+
     refreshButton = new QPushButton("Обновить список портов", portControlGroup);
     connectButton = new QPushButton("Подключиться", portControlGroup);
     disconnectButton = new QPushButton("Отключиться", portControlGroup);
@@ -96,16 +239,81 @@ void MainWindow::setupUI()
     resetButton->setToolTip("Сбросить все данные и статистику");
 
     QVBoxLayout *portLayout = new QVBoxLayout(portControlGroup);
-    portLayout->addWidget(portLabel);
-    portLayout->addWidget(portComboBox);
-    portLayout->addWidget(speedLabel);
-    portLayout->addWidget(speedComboBox);
+    portLayout->addWidget(sourceLabel);
+    portLayout->addWidget(sourceComboBox);
+    portLayout->addWidget(sourceAddressEdit);
+    portLayout->addWidget(serialSettingsWidget);
+    portLayout->addWidget(speedSettingsWidget);
+    portLayout->addWidget(readBackendLabel);
+    portLayout->addWidget(readBackendComboBox);
+    portLayout->addWidget(pipelineWorkersSpinBox);
+    portLayout->addWidget(displayPolicyComboBox);
     portLayout->addSpacing(10);
     portLayout->addWidget(refreshButton);
     portLayout->addWidget(connectButton);
     portLayout->addWidget(disconnectButton);
     portLayout->addWidget(clearButton);
     portLayout->addWidget(resetButton);
+
+    // Экспорт
+    QGroupBox *exportGroup = new QGroupBox("Экспорт", portControlGroup);
+    QVBoxLayout *exportLayout = new QVBoxLayout(exportGroup);
+    exportFormatComboBox = new QComboBox(exportGroup);
+    exportFormatComboBox->addItems(QStringList() << "CSV" << "NDJSON" << "Arrow IPC");
+    liveExportButton = new QPushButton("Непрерывный экспорт", exportGroup);
+    liveExportButton->setCheckable(true);
+    liveExportButton->setToolTip("Запись всех пакетов в каталог export с ротацией файлов");
+    exportRegistryButton = new QPushButton("Реестр устройств...", exportGroup);
+    exportHistoryButton = new QPushButton("История...", exportGroup);
+    captureButton = new QPushButton("Запись кадров", exportGroup);
+    captureButton->setCheckable(true);
+    captureButton->setToolTip("Запись всех принятых кадров в каталог captures для CaptureAnalyzer");
+    openCaptureButton = new QPushButton("Открыть захват...", exportGroup);
+    exportFilterCheckBox = new QCheckBox("Фильтровать экспорт", exportGroup);
+    exportFilterCheckBox->setToolTip("Непрерывный экспорт и история - только пакеты, подходящие под фильтр таблицы");
+    exportLosslessCheckBox = new QCheckBox("Экспорт без потерь", exportGroup);
+    exportLosslessCheckBox->setToolTip("Если запись не успевает, разбор ждет ее, а не отбрасывает строки");
+    exportStatusLabel = new QLabel("Экспорт: -", exportGroup);
+    exportStatusLabel->setWordWrap(true);
+    exportStatusLabel->setFont(QFont("Arial", 9));
+    exportLayout->addWidget(exportFormatComboBox);
+    exportLayout->addWidget(liveExportButton);
+    exportLayout->addWidget(exportFilterCheckBox);
+    exportLayout->addWidget(exportLosslessCheckBox);
+    exportLayout->addWidget(exportRegistryButton);
+    exportLayout->addWidget(exportHistoryButton);
+    exportLayout->addWidget(captureButton);
+    exportLayout->addWidget(openCaptureButton);
+    exportLayout->addWidget(exportStatusLabel);
+
+    // Режим реального времени: действует со следующего подключения
+    QGroupBox *realtimeGroup = new QGroupBox("Реальное время", portControlGroup);
+    QVBoxLayout *realtimeLayout = new QVBoxLayout(realtimeGroup);
+    realtimeCheckBox = new QCheckBox("Приоритетное чтение порта", realtimeGroup);
+    realtimeCheckBox->setToolTip("SCHED_FIFO, привязка к ядру, блокировка памяти и ASYNC_LOW_LATENCY на порту.\n"
+                                 "Нужны права CAP_SYS_NICE и CAP_IPC_LOCK; без них включается то, что разрешено.\n"
+                                 "Действует со следующего подключения.");
+    realtimePrioritySpinBox = new QSpinBox(realtimeGroup);
+    realtimePrioritySpinBox->setRange(1, 99);
+    realtimePrioritySpinBox->setValue(80);
+    realtimePrioritySpinBox->setPrefix("Приоритет ");
+    realtimeCpuSpinBox = new QSpinBox(realtimeGroup);
+    realtimeCpuSpinBox->setRange(-1, 255);
+    realtimeCpuSpinBox->setValue(-1);
+    realtimeCpuSpinBox->setPrefix("Ядро ");
+    realtimeCpuSpinBox->setSpecialValueText("Любое ядро");
+    realtimeLabel = new QLabel("Пробуждения: -", realtimeGroup);
+    realtimeLabel->setWordWrap(true);
+    realtimeLabel->setFont(QFont("Arial", 9));
+    realtimeLayout->addWidget(realtimeCheckBox);
+    realtimeLayout->addWidget(realtimePrioritySpinBox);
+    realtimeLayout->addWidget(realtimeCpuSpinBox);
+    realtimeLayout->addWidget(realtimeLabel);
+
+    portLayout->addSpacing(10);
+    portLayout->addWidget(realtimeGroup);
+    portLayout->addSpacing(10);
+    portLayout->addWidget(exportGroup);
     portLayout->addStretch();
 
     // ========== ЦЕНТРАЛЬНАЯ ПАНЕЛЬ: Таблица данных ==========
@@ -113,11 +321,14 @@ void MainWindow::setupUI()
 
     // Создаем таблицу
     dataTable = new QTableWidget(dataGroup);
-    dataTable->setColumnCount(9);
+    dataTable->setColumnCount(17);
     QStringList headers;
     headers << "Время пакета" << "ID устройства" << "Тип" << "Версия"
             << "Давление (бар)" << "Температура (°C)" << "Напряжение (В)"
-            << "RSSI" << "Всего пакетов";
+            << "RSSI" << "Всего пакетов"
+            << "Давл. ср." << "Давл. σ" << "RSSI ср." << "RSSI σ"
+            << "Интервал p50/90/99 (с)" << "RSSI p50/90/99"
+            << "Период (с)" << "Потери %";
     dataTable->setHorizontalHeaderLabels(headers);
 
     // Настройка внешнего вида таблицы
@@ -138,6 +349,14 @@ void MainWindow::setupUI()
     dataTable->setColumnWidth(6, 100);
     dataTable->setColumnWidth(7, 70);
     dataTable->setColumnWidth(8, 100);
+    dataTable->setColumnWidth(9, 80);
+    dataTable->setColumnWidth(10, 70);
+    dataTable->setColumnWidth(11, 70);
+    dataTable->setColumnWidth(12, 60);
+    dataTable->setColumnWidth(13, 150);
+    dataTable->setColumnWidth(14, 110);
+    dataTable->setColumnWidth(15, 80);
+    dataTable->setColumnWidth(16, 70);
 
     // Устанавливаем высоту строк
     dataTable->verticalHeader()->setDefaultSectionSize(24);
@@ -147,7 +366,15 @@ void MainWindow::setupUI()
     header->setStretchLastSection(false);
     header->setSectionResizeMode(QHeaderView::Fixed);
 
+    // Фильтр строк
+    tableFilterEdit = new QLineEdit(dataGroup);
+    tableFilterEdit->setClearButtonEnabled(true);
+    tableFilterEdit->setPlaceholderText("Фильтр, например: rssi > -80 && pressure < 2.0 && id in 0x1A00..0x1AFF (Enter)");
+    tableFilterEdit->setToolTip("Поля: id, type, fw, pressure, temp, voltage, rssi; "
+                                "== != < <= > >=, in a..b, in {a, b}, &&, ||, !, скобки");
+
     QVBoxLayout *dataLayout = new QVBoxLayout(dataGroup);
+    dataLayout->addWidget(tableFilterEdit);
     dataLayout->addWidget(dataTable);
 
     // ========== ПРАВАЯ ПАНЕЛЬ: Статус и статистика ==========
@@ -190,8 +417,13 @@ void MainWindow::setupUI()
 
     // Статус подключения
     connectionStatusLabel = new QLabel("Статус: Не подключено", statusGroup);
-    portInfoLabel = new QLabel("Порт: -", statusGroup);
+    portInfoLabel = new QLabel("Источник: -", statusGroup);
     speedInfoLabel = new QLabel("Скорость: -", statusGroup);
+    linkGapsLabel = new QLabel("Разрывов связи: 0", statusGroup);
+    sourceStatsLabel = new QLabel("Прием: -", statusGroup);
+    sourceStatsLabel->setWordWrap(true);
+    queueStatsLabel = new QLabel("Отображение: -", statusGroup);
+    queueStatsLabel->setWordWrap(true);
 
     // Статистика по типам устройств
     QGroupBox *deviceStatsGroup = new QGroupBox("Статистика устройств", statusGroup);
@@ -202,6 +434,11 @@ void MainWindow::setupUI()
     totalDevicesLabel = new QLabel("Всего устройств: 0", deviceStatsGroup);
     totalPacketsLabel = new QLabel("Всего пакетов: 0", deviceStatsGroup);
     packetRateLabel = new QLabel("Скорость приема: 0 пак/с", deviceStatsGroup);
+    historyLabel = new QLabel("История: -", deviceStatsGroup);
+    deviceListsLabel = new QLabel("Списки устройств: нет", deviceStatsGroup);
+    deviceListsLabel->setToolTip("Файл devices.list: строки allow/deny со списком ID и диапазонов a..b");
+    portIntervalLabel = new QLabel("Интервал p50/90/99: -", deviceStatsGroup);
+    portRssiLabel = new QLabel("RSSI p50/90/99: -", deviceStatsGroup);
 
     // Устанавливаем шрифт для статистики
     QFont statsFont("Arial", 9);
@@ -210,12 +447,20 @@ void MainWindow::setupUI()
     totalDevicesLabel->setFont(statsFont);
     totalPacketsLabel->setFont(statsFont);
     packetRateLabel->setFont(statsFont);
+    historyLabel->setFont(statsFont);
+    deviceListsLabel->setFont(statsFont);
+    portIntervalLabel->setFont(statsFont);
+    portRssiLabel->setFont(statsFont);
 
     deviceStatsLayout->addWidget(sensorCountLabel);
     deviceStatsLayout->addWidget(repeaterCountLabel);
     deviceStatsLayout->addWidget(totalDevicesLabel);
     deviceStatsLayout->addWidget(totalPacketsLabel);
     deviceStatsLayout->addWidget(packetRateLabel);
+    deviceStatsLayout->addWidget(portIntervalLabel);
+    deviceStatsLayout->addWidget(portRssiLabel);
+    deviceStatsLayout->addWidget(historyLabel);
+    deviceStatsLayout->addWidget(deviceListsLabel);
     deviceStatsLayout->addStretch();
 
     // Информация о последнем пакете (датчика)
@@ -255,6 +500,47 @@ void MainWindow::setupUI()
     lastPacketLayout->addWidget(lastTotalPacketsLabel);
     lastPacketLayout->addStretch();
 
+    // Рейтинг устройств по потерям
+    QGroupBox *lossGroup = new QGroupBox("Потери пакетов", statusGroup);
+    QVBoxLayout *lossLayout = new QVBoxLayout(lossGroup);
+
+    lossRankingLabel = new QLabel("Потерь не обнаружено", lossGroup);
+    lossRankingLabel->setFont(QFont("Arial", 9));
+    lossLayout->addWidget(lossRankingLabel);
+
+    // Покрытие ожидаемого парка
+    QGroupBox *fleetGroup = new QGroupBox("Покрытие парка", statusGroup);
+    QVBoxLayout *fleetLayout = new QVBoxLayout(fleetGroup);
+
+    fleetLabel = new QLabel("Список устройств не загружен", fleetGroup);
+    fleetLabel->setFont(QFont("Arial", 9));
+    fleetSilentSpinBox = new QSpinBox(fleetGroup);
+    fleetSilentSpinBox->setRange(1, 24 * 60);
+    fleetSilentSpinBox->setValue(10);
+    fleetSilentSpinBox->setPrefix("Молчит дольше ");
+    fleetSilentSpinBox->setSuffix(" мин");
+    fleetImportButton = new QPushButton("Список...", fleetGroup);
+    fleetImportButton->setToolTip("Загрузить ожидаемые ID устройств (по одному в строке или CSV с ID в первом столбце)");
+    fleetMissingButton = new QPushButton("Пропавшие", fleetGroup);
+
+    QHBoxLayout *fleetButtonsLayout = new QHBoxLayout();
+    fleetButtonsLayout->addWidget(fleetSilentSpinBox);
+    fleetButtonsLayout->addWidget(fleetImportButton);
+    fleetButtonsLayout->addWidget(fleetMissingButton);
+    fleetLayout->addWidget(fleetLabel);
+    fleetLayout->addLayout(fleetButtonsLayout);
+
+    // Журнал тревог
+    QGroupBox *alarmGroup = new QGroupBox("Тревоги", statusGroup);
+    QVBoxLayout *alarmLayout = new QVBoxLayout(alarmGroup);
+
+    alarmLog = new QTextEdit(alarmGroup);
+    alarmLog->setReadOnly(true);
+    alarmLog->setFont(QFont("Arial", 9));
+    alarmLog->setMaximumHeight(120);
+    alarmLog->document()->setMaximumBlockCount(500);
+    alarmLayout->addWidget(alarmLog);
+
     // Сводка за период
     QGroupBox *summaryGroup = new QGroupBox("Сводка за 30 сек", statusGroup);
     QVBoxLayout *summaryLayout = new QVBoxLayout(summaryGroup);
@@ -276,11 +562,20 @@ void MainWindow::setupUI()
     statusLayout->addWidget(connectionStatusLabel);
     statusLayout->addWidget(portInfoLabel);
     statusLayout->addWidget(speedInfoLabel);
+    statusLayout->addWidget(linkGapsLabel);
+    statusLayout->addWidget(sourceStatsLabel);
+    statusLayout->addWidget(queueStatsLabel);
     statusLayout->addSpacing(10);
     statusLayout->addWidget(deviceStatsGroup);
     statusLayout->addSpacing(10);
     statusLayout->addWidget(lastPacketGroup);
     statusLayout->addSpacing(10);
+    statusLayout->addWidget(lossGroup);
+    statusLayout->addSpacing(10);
+    statusLayout->addWidget(fleetGroup);
+    statusLayout->addSpacing(10);
+    statusLayout->addWidget(alarmGroup);
+    statusLayout->addSpacing(10);
     statusLayout->addWidget(summaryGroup);
     statusLayout->addStretch();
 
@@ -306,6 +601,57 @@ void MainWindow::updateClock()
                                     .arg(currentTime.toString("HH:mm:ss"))
                                     .arg(sensorCount)
                                     .arg(totalPacketCount));
+
+    // Состояние хранилища истории
+    if (enod->history().is_open()) {
+        HistoryStoreStats hs = enod->history().stats();
+        uint64_t sealed = hs.samples_total - hs.samples_open;
+        historyLabel->setText(QString("История: %1 точек, %2 МБ (%3 Б/точку)")
+                                      .arg(hs.samples_total)
+                                      .arg(hs.bytes_on_disk / (1024.0 * 1024.0), 0, 'f', 1)
+                                      .arg(sealed ? (double)hs.bytes_on_disk / sealed : 0.0, 0, 'f', 2));
+        if (hs.wal_error || hs.wal_dropped) {
+            historyLabel->setText(historyLabel->text() +
+                                  QString("\nЖурнал: %1, без журнала %2 точек")
+                                          .arg(hs.wal_error ? "ошибка записи" : "в норме")
+                                          .arg(hs.wal_dropped));
+        }
+    }
+
+    // Списки устройств: изменения файла подхватываются на ходу
+    reloadDeviceLists();
+
+    // Состояние экспорта
+    ExportStats es = enod->exporter().stats();
+    QString exportText = es.live_active
+            ? QString("Экспорт: %1 строк, %2 МБ, файлов %3")
+                      .arg(es.live_rows)
+                      .arg(es.live_bytes / (1024.0 * 1024.0), 0, 'f', 1)
+                      .arg(es.live_files)
+            : QString("Экспорт: выключен");
+    if (es.live_dropped) {
+        exportText += QString(", потеряно %1").arg(es.live_dropped);
+    }
+    if (es.live_blocked) {
+        exportText += QString(", ожиданий записи %1").arg(es.live_blocked);
+    }
+    if (es.jobs_pending) {
+        exportText += QString("\nВыгрузок в работе: %1").arg(es.jobs_pending);
+    }
+    if (enod->capture().is_open()) {
+        exportText += QString("\nЗапись кадров: %1, %2 МБ")
+                .arg(enod->capture().frames())
+                .arg(enod->capture().bytes() / (1024.0 * 1024.0), 0, 'f', 1);
+        if (enod->capture().write_error()) {
+            exportText += ", ошибка записи";
+        }
+    }
+    exportStatusLabel->setText(exportText);
+    exportStatusLabel->setToolTip(QString::fromStdString(es.live_file));
+
+    for (const std::string& message : enod->exporter().take_messages()) {
+        statusBar()->showMessage(QString::fromStdString(message), 5000);
+    }
 }
 
 void MainWindow::updateConnectionIndicators()
@@ -342,16 +688,188 @@ void MainWindow::updateConnectionIndicators()
     }
 }
 
+void MainWindow::updateLinkStatus()
+{
+    LinkSupervisor& link = enod->link();
+    SourceStats source = enod->source().stats();
+
+    if (isConnected) {
+        switch (link.state()) {
+        case LINK_UP:
+            connectionStatusLabel->setText("Статус: Подключено");
+            break;
+        case LINK_CONNECTING:
+            connectionStatusLabel->setText("Статус: Подключение...");
+            break;
+        case LINK_BACKOFF:
+            connectionStatusLabel->setText(QString("Статус: Нет связи, переподключение (попыток: %1)")
+                                                   .arg(link.attempts()));
+            break;
+        default:
+            connectionStatusLabel->setText(source.finished
+                                                   ? "Статус: Данные источника закончились"
+                                                   : "Статус: Чтение остановлено");
+            break;
+        }
+    }
+
+    // Разрывы: счетчик и последние события во всплывающей подсказке
+    static const char* const reasons[] = {"ошибка чтения", "нет данных", "устройство отключено", "порт не найден"};
+    int64_t nowUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    linkGapsLabel->setText(QString("Разрывов связи: %1, всего %2 с")
+                                   .arg(link.gap_count())
+                                   .arg(link.gap_total_us(nowUs) / 1000000));
+
+    QStringList lines;
+    std::vector<LinkGap> gaps = link.recent_gaps(10);
+    for (auto it = gaps.rbegin(); it != gaps.rend(); ++it) {
+        QString start = QDateTime::fromMSecsSinceEpoch(it->start_us / 1000).toString("dd.MM HH:mm:ss");
+        QString end = it->end_us
+                ? QDateTime::fromMSecsSinceEpoch(it->end_us / 1000).toString("HH:mm:ss")
+                : QString("...");
+        lines << QString("%1 - %2: %3").arg(start, end, reasons[it->reason < 4 ? it->reason : 0]);
+    }
+    linkGapsLabel->setToolTip(lines.isEmpty() ? QString("Разрывов не было") : lines.join("\n"));
+
+    // Счетчики источника; скорость - за время с прошлого обновления
+    qint64 nowMs = nowUs / 1000;
+    double rate = 0;
+    if (lastSourceStatsMs && nowMs > lastSourceStatsMs && source.bytes >= lastSourceBytes) {
+        rate = (double)(source.bytes - lastSourceBytes) * 1000.0 / (double)(nowMs - lastSourceStatsMs);
+    }
+    lastSourceBytes = source.bytes;
+    lastSourceStatsMs = nowMs;
+
+    QString text = QString("Прием: %1 КБ/с, всего %2 КБ")
+                           .arg(rate / 1024.0, 0, 'f', 1)
+                           .arg(source.bytes / 1024);
+    if (source.reads) {
+        text += QString(", %1 Б за чтение (макс. %2)").arg(source.bytes / source.reads).arg(source.max_read);
+    }
+    QString tip = QString("Чтений с данными: %1\nОткрытий: %2\nОшибок: %3")
+                          .arg(source.reads)
+                          .arg(source.opens)
+                          .arg(source.failures);
+
+    // Порт за сервером RFC 2217: что сервер подтвердил и ошибки его линии
+    const Rfc2217Source* rfc = dynamic_cast<const Rfc2217Source*>(&enod->source());
+    if (rfc) {
+        tip += rfc->remote_baud()
+                ? QString("\nСкорость на сервере: %1").arg(rfc->remote_baud())
+                : QString("\nСкорость сервером не подтверждена");
+        tip += QString("\nОшибок линии на сервере: %1").arg(rfc->line_errors());
+    }
+
+    // Конвейер разбора: сколько прошло и насколько потоки не успевают
+    if (enod->pipeline_workers() > 0) {
+        PipelineStats ps = enod->pipeline_stats();
+        tip += QString("\nКонвейер: %1 кадров, %2 запусков, из них перехватов %3, пачек в работе %4")
+                       .arg(ps.frames)
+                       .arg(ps.runs)
+                       .arg(ps.steals)
+                       .arg(ps.pending);
+        if (ps.blocked) {
+            tip += QString("\nЧтение ждало конвейер: %1 раз").arg(ps.blocked);
+        }
+    }
+    sourceStatsLabel->setText(text);
+    sourceStatsLabel->setToolTip(tip);
+
+    // Очереди к потребителям: что потеряно или слито, пока они отставали
+    QueueStats ds = enod->display_stats();
+    QueueStats as = enod->alarms().event_stats();
+    QString queueText = QString("Отображение: показано %1, слито %2, пропущено %3")
+                                .arg(ds.taken)
+                                .arg(ds.coalesced)
+                                .arg(ds.dropped);
+    if (as.dropped) {
+        queueText += QString("\nСобытий тревог потеряно: %1").arg(as.dropped);
+    }
+    queueStatsLabel->setText(queueText);
+    queueStatsLabel->setToolTip(QString("Таблица: %1, в очереди %2 из %3 (максимум %4), ожиданий %5\n"
+                                        "Тревоги: %6, в очереди %7 из %8, потеряно %9")
+                                        .arg(queue_policy_name(ds.policy))
+                                        .arg(ds.size)
+                                        .arg(ds.capacity)
+                                        .arg(ds.high_water)
+                                        .arg(ds.blocked)
+                                        .arg(queue_policy_name(as.policy))
+                                        .arg(as.size)
+                                        .arg(as.capacity)
+                                        .arg(as.dropped));
+}
+
+void MainWindow::applyReaderSettings()
+{
+    RealtimeConfig config;
+    config.enabled = realtimeCheckBox->isChecked();
+    config.priority = realtimePrioritySpinBox->value();
+    config.cpu = realtimeCpuSpinBox->value();
+    enod->realtime().configure(config);
+
+    enod->set_read_backend((Enod::ReadBackend)readBackendComboBox->currentData().toInt());
+    enod->set_pipeline_workers((unsigned)pipelineWorkersSpinBox->value());
+}
+
+void MainWindow::applyQueuePolicies()
+{
+    // Действуют сразу, в том числе во время чтения
+    enod->set_display_policy((QueuePolicy)displayPolicyComboBox->currentData().toInt());
+    enod->exporter().set_live_policy(exportLosslessCheckBox->isChecked() ? QUEUE_BLOCK : QUEUE_DROP_NEWEST);
+}
+
+void MainWindow::drainDisplay()
+{
+    std::vector<Enod::DisplayEntry> entries;
+    if (enod->take_display(entries) == 0) {
+        return;
+    }
+    for (const Enod::DisplayEntry& e : entries) {
+        onDataReceived(e.value, (int)e.merged);
+    }
+
+    // Сводка - один раз на пачку, а не на каждый кадр
+    updateStatisticsDisplay();
+}
+
+void MainWindow::updateRealtimeStatus()
+{
+    RealtimeStatus rs = enod->realtime().status();
+    WakeupLatency wl = enod->realtime().latency();
+
+    QString text;
+    if (rs.active) {
+        QStringList parts;
+        if (rs.fifo) parts << "приоритет";
+        if (rs.affinity) parts << "ядро";
+        if (rs.memory_locked) parts << "память";
+        if (rs.low_latency) parts << "порт";
+        text = "Включено: " + (parts.isEmpty() ? QString("ничего") : parts.join(", ")) + "\n";
+    }
+    if (wl.samples) {
+        text += QString("Опоздание пробуждения: макс %1 мкс, p99 до %2 мкс, ср. %3 мкс")
+                        .arg(wl.max_us)
+                        .arg(wl.p99_us)
+                        .arg(wl.mean_us, 0, 'f', 0);
+    } else {
+        text += "Пробуждения: -";
+    }
+    realtimeLabel->setText(text);
+    realtimeLabel->setToolTip(rs.errors.empty() ? QString() : QString::fromStdString(rs.errors));
+    realtimeLabel->setStyleSheet(rs.active && !rs.errors.empty() ? "QLabel { color: #B26A00; }" : "");
+}
+
 void MainWindow::refreshPorts()
 {
     portComboBox->clear();
     portComboBox->addItem("Выберите порт...");
 
-    Enod tempEnod;
-    int result = tempEnod.search_port();
+    ComPortBase probe;
+    int result = probe.search_port();
+    probe.close_port();
 
-    if (result >= 0 && tempEnod.port) {
-        QString portName = QString(tempEnod.port);
+    if (result >= 0 && !probe.found_port_name().empty()) {
+        QString portName = QString::fromStdString(probe.found_port_name());
         portComboBox->addItem(portName);
         statusBar()->showMessage("Найден порт: " + portName, 3000);
     } else {
@@ -360,75 +878,147 @@ void MainWindow::refreshPorts()
     }
 }
 
-void MainWindow::connectToPort()
+void MainWindow::updateSourceKind()
 {
-    if (portComboBox->currentIndex() == 0) {
-        QMessageBox::warning(this, "Ошибка", "Выберите порт из списка!");
-        return;
+    SourceKind kind = (SourceKind)sourceComboBox->currentData().toInt();
+    bool serial = kind == SOURCE_SERIAL;
+    serialSettingsWidget->setVisible(serial);
+    speedSettingsWidget->setVisible(serial || kind == SOURCE_RFC2217);
+    refreshButton->setVisible(serial);
+    sourceAddressEdit->setVisible(!serial);
+
+    switch (kind) {
+    case SOURCE_FILE:
+        sourceAddressEdit->setPlaceholderText("Путь к файлу с сырыми кадрами");
+        break;
+    case SOURCE_PIPE:
+        sourceAddressEdit->setPlaceholderText("Путь к каналу или - для stdin");
+        break;
+    case SOURCE_TCP:
+    case SOURCE_RFC2217:
+        sourceAddressEdit->setPlaceholderText("узел:порт");
+        break;
+    case SOURCE_UNIX:
+        sourceAddressEdit->setPlaceholderText("Путь к сокету");
+        break;
+    default:
+        break;
     }
+}
+
+void MainWindow::connectToPort()
+{
+    SourceKind kind = (SourceKind)sourceComboBox->currentData().toInt();
+    QString sourceName;
+    QString speedText = "-";
+
+    if (kind == SOURCE_SERIAL) {
+        if (portComboBox->currentIndex() == 0) {
+            QMessageBox::warning(this, "Ошибка", "Выберите порт из списка!");
+            return;
+        }
 
-    QString selectedPort = portComboBox->currentText();
-    QString speedText = speedComboBox->currentText();
+        sourceName = portComboBox->currentText();
+        speedText = speedComboBox->currentText();
 
-    // Устанавливаем порт
-    enod->set_port(selectedPort.toUtf8().constData());
+        // Устанавливаем порт
+        std::unique_ptr<SerialSource> serial(new SerialSource());
+        ComPortBase& port = serial->port();
+        port.set_port(sourceName.toUtf8().constData());
 
-    // Устанавливаем скорость
+        // Устанавливаем скорость
 #ifdef _WIN32
-    if (speedText == "1200") {
-        enod->set_speed_win(CBR_1200);
-    } else if (speedText == "2400") {
-        enod->set_speed_win(CBR_2400);
-    } else if (speedText == "4800") {
-        enod->set_speed_win(CBR_4800);
-    } else if (speedText == "9600") {
-        enod->set_speed_win(CBR_9600);
-    } else if (speedText == "19200") {
-        enod->set_speed_win(CBR_19200);
-    } else if (speedText == "38400") {
-        enod->set_speed_win(CBR_38400);
-    } else if (speedText == "57600") {
-        enod->set_speed_win(CBR_57600);
-    } else if (speedText == "115200") {
-        enod->set_speed_win(CBR_115200);
-    }
+        if (speedText == "1200") {
+            port.set_speed_win(CBR_1200);
+        } else if (speedText == "2400") {
+            port.set_speed_win(CBR_2400);
+        } else if (speedText == "4800") {
+            port.set_speed_win(CBR_4800);
+        } else if (speedText == "9600") {
+            port.set_speed_win(CBR_9600);
+        } else if (speedText == "19200") {
+            port.set_speed_win(CBR_19200);
+        } else if (speedText == "38400") {
+            port.set_speed_win(CBR_38400);
+        } else if (speedText == "57600") {
+            port.set_speed_win(CBR_57600);
+        } else if (speedText == "115200") {
+            port.set_speed_win(CBR_115200);
+        } else {
+            port.set_speed_win(speedText.toULong());
+        }
 #else
-    if (speedText == "1200") {
-        enod->set_speed(B1200);
-    } else if (speedText == "2400") {
-        enod->set_speed(B2400);
-    } else if (speedText == "4800") {
-        enod->set_speed(B4800);
-    } else if (speedText == "9600") {
-        enod->set_speed(B9600);
-    } else if (speedText == "19200") {
-        enod->set_speed(B19200);
-    } else if (speedText == "38400") {
-        enod->set_speed(B38400);
-    } else if (speedText == "57600") {
-        enod->set_speed(B57600);
-    } else if (speedText == "115200") {
-        enod->set_speed(B115200);
-    }
+        if (speedText == "1200") {
+            port.set_speed(B1200);
+        } else if (speedText == "2400") {
+            port.set_speed(B2400);
+        } else if (speedText == "4800") {
+            port.set_speed(B4800);
+        } else if (speedText == "9600") {
+            port.set_speed(B9600);
+        } else if (speedText == "19200") {
+            port.set_speed(B19200);
+        } else if (speedText == "38400") {
+            port.set_speed(B38400);
+        } else if (speedText == "57600") {
+            port.set_speed(B57600);
+        } else if (speedText == "115200") {
+            port.set_speed(B115200);
+        } else if (speedText == "230400") {
+            port.set_speed(B230400);
+        } else if (speedText == "460800") {
+            port.set_speed(B460800);
+        } else if (speedText == "921600") {
+            port.set_speed(B921600);
+        }
 #endif
 
+        enod->set_source(std::move(serial));
+    } else {
+        // Адрес в виде, который разбирает make_byte_source
+        static const char* const prefixes[] = {"", "file:", "pipe:", "tcp://", "unix:", "rfc2217://"};
+        QString address = sourceAddressEdit->text().trimmed();
+        std::string full = kind == SOURCE_PIPE && (address.isEmpty() || address == "-")
+                ? std::string("-")
+                : prefixes[kind] + address.toStdString();
+        if (kind == SOURCE_RFC2217) {
+            // Скорость задает сервер по команде SET-BAUDRATE
+            speedText = speedComboBox->currentText();
+            full += "?baud=" + speedText.toStdString();
+        }
+        std::string error;
+        std::unique_ptr<ByteSource> source = make_byte_source(full, &error);
+        if (!source) {
+            QMessageBox::warning(this, "Ошибка", QString::fromStdString(error));
+            return;
+        }
+        sourceName = QString::fromStdString(source->describe());
+        enod->set_source(std::move(source));
+    }
+    enod->exporter().set_source(sourceName.toStdString());
+    lastSourceBytes = 0;
+    lastSourceStatsMs = 0;
+
     isConnected = true;
     connectButton->setEnabled(false);
     disconnectButton->setEnabled(true);
+    sourceComboBox->setEnabled(false);
+    sourceAddressEdit->setEnabled(false);
     portComboBox->setEnabled(false);
     speedComboBox->setEnabled(false);
+    readBackendComboBox->setEnabled(false);
+    pipelineWorkersSpinBox->setEnabled(false);
     refreshButton->setEnabled(false);
 
     connectionStatusLabel->setText("Статус: Подключено");
-    portInfoLabel->setText("Порт: " + selectedPort);
+    portInfoLabel->setText("Источник: " + sourceName);
     speedInfoLabel->setText("Скорость: " + speedText);
 
-    statusBar()->showMessage("Подключено к " + selectedPort);
+    statusBar()->showMessage("Подключено к " + sourceName);
 
-    // Запускаем чтение порта в отдельном потоке
-    QtConcurrent::run([this]() {
-        enod->read_port();
-    });
+    // Запускаем чтение источника в отдельном потоке
+    applyReaderSettings();
+    enod->start_reading();
 }
 
 void MainWindow::disconnectFromPort()
@@ -440,12 +1030,16 @@ void MainWindow::disconnectFromPort()
 
     connectButton->setEnabled(true);
     disconnectButton->setEnabled(false);
+    sourceComboBox->setEnabled(true);
+    sourceAddressEdit->setEnabled(true);
     portComboBox->setEnabled(true);
     speedComboBox->setEnabled(true);
+    readBackendComboBox->setEnabled(true);
+    pipelineWorkersSpinBox->setEnabled(true);
     refreshButton->setEnabled(true);
 
     connectionStatusLabel->setText("Статус: Не подключено");
-    portInfoLabel->setText("Порт: -");
+    portInfoLabel->setText("Источник: -");
     speedInfoLabel->setText("Скорость: -");
 
     statusBar()->showMessage("Отключено");
@@ -455,26 +1049,15 @@ void MainWindow::resetData()
 {
     // Останавливаем чтение порта, если подключены
     if (isConnected) {
-        // Устанавливаем флаг остановки
-        enod->stop_flag = true;
-
-        // Даем время для завершения текущей операции чтения (100 мс достаточно)
-        QElapsedTimer timer;
-        timer.start();
-        while (timer.elapsed() < 100) {
-            QCoreApplication::processEvents();
-        }
-
-        // Сбрасываем состояние Enod
-        enod->packet_idx = 0;
-        enod->packet_num = 0;
-        enod->stop_flag = false;
+        enod->stop();
     }
 
+    // Сбрасываем состояние Enod; поток чтения уже завершен
+    enod->reset();
+
     // Сбрасываем статистику
     uniquePacketCount = 0;
     totalPacketCount = 0;
-    packetCountInPeriod = 0;
     uniquePacketCountInPeriod = 0;
     sensorCount = 0;
     repeaterCount = 0;
@@ -482,10 +1065,22 @@ void MainWindow::resetData()
     lastSummaryTime = QDateTime::currentDateTime();
     lastPacketTime = QDateTime::currentDateTime();
     lastRepeaterTime = QDateTime::currentDateTime();
-    packetTimestamps.clear();
+    firstPacketMs = 0;
     devicePacketCount.clear();
     deviceDataMap.clear();
     repeaterDataMap.clear();
+    deviceRows.clear();
+    restoreQueue.clear();
+    restoreNext = 0;
+    enod->stats().clear();
+    enod->histograms().clear();
+    enod->losses().clear();
+    enod->link().clear();
+    enod->source().clear_stats();
+    lastSourceBytes = 0;
+    lastSourceStatsMs = 0;
+    enod->alarms().clear_state();
+    alarmLog->clear();
 
     // Очищаем таблицу
     dataTable->setRowCount(0);
@@ -495,124 +1090,46 @@ void MainWindow::resetData()
 
     // Обновляем статистику
     updateStatisticsDisplay();
+    updateFleetSummary();
 
     // Обновляем индикаторы
     updateConnectionIndicators();
+    updateLossRanking();
 
     // Перезапускаем чтение порта, если были подключены
     if (isConnected) {
-        // Запускаем чтение порта в отдельном потоке
-        QtConcurrent::run([this]() {
-            enod->read_port();
-        });
+        // Порт открывается заново без перебора
+        applyReaderSettings();
+        enod->start_reading();
         statusBar()->showMessage("Данные сброшены, чтение порта перезапущено", 3000);
     } else {
         statusBar()->showMessage("Данные сброшены", 3000);
     }
 }
 
-void MainWindow::onDataReceived(const QString& data)
+void MainWindow::onDataReceived(const DisplayRecord& record, int frames)
 {
-    QDateTime currentTime = QDateTime::currentDateTime();
-    packetTimestamps.append(currentTime);
+    // Время приема снято в потоке чтения, а не после очереди событий GUI
+    qint64 rxWallMs = record.rx_wall_ms;
+    QDateTime currentTime = QDateTime::fromMSecsSinceEpoch(rxWallMs);
+    if (firstPacketMs == 0) {
+        firstPacketMs = rxWallMs;
+    }
 
     // Обновляем счетчик всех пакетов
-    totalPacketCount++;
-    packetCountInPeriod++;
-
-    // Парсим данные из строки
-    QStringList parts = data.split('|');
-
-    QString type = "НЕИЗВЕСТНО";
-    QString deviceId = "N/A";
-    QString version = "N/A";
-    QString pressure = "N/A";
-    QString temperature = "N/A";
-    QString voltage = "N/A";
-    QString rssi = "N/A";
-
-    if (parts.size() >= 8) {
-        // Первая часть: "[X] ТИП"
-        QString firstPart = parts[0].trimmed();
-        int bracketPos = firstPart.indexOf(']');
-        if (bracketPos > 0) {
-            QString typeStr = firstPart.mid(bracketPos + 2).trimmed();
-            if (typeStr.contains("ДАТЧИК")) {
-                type = "ДАТЧИК";
-            } else if (typeStr.contains("РЕПИТЕР")) {
-                type = "РЕПИТЕР";
-            } else {
-                type = "НЕИЗВЕСТНО";
-            }
-        }
-
-        // Вторая часть: "ID: 0xXXXXXXXX"
-        if (parts[1].contains("ID:")) {
-            QString idPart = parts[1];
-            int colonPos = idPart.indexOf(':');
-            if (colonPos > 0) {
-                deviceId = idPart.mid(colonPos + 1).trimmed();
-            }
-        }
-
-        // Третья часть: "Вер: XX"
-        if (parts[2].contains("Вер:")) {
-            QString verPart = parts[2];
-            int colonPos = verPart.indexOf(':');
-            if (colonPos > 0) {
-                version = verPart.mid(colonPos + 1).trimmed();
-            }
-        }
-
-        // Четвертая часть: "Д: X.XXX бар"
-        if (parts[3].contains("Д:")) {
-            QString pressurePart = parts[3];
-            int colonPos = pressurePart.indexOf(':');
-            if (colonPos > 0) {
-                QString value = pressurePart.mid(colonPos + 1).trimmed();
-                QStringList valueParts = value.split(' ');
-                if (!valueParts.isEmpty()) {
-                    pressure = valueParts[0];
-                }
-            }
-        }
-
-        // Пятая часть: "Т: XX°C"
-        if (parts[4].contains("Т:")) {
-            QString tempPart = parts[4];
-            int colonPos = tempPart.indexOf(':');
-            if (colonPos > 0) {
-                QString value = tempPart.mid(colonPos + 1).trimmed();
-                QStringList valueParts = value.split(QString::fromUtf8("°"));
-                if (!valueParts.isEmpty()) {
-                    temperature = valueParts[0];
-                }
-            }
-        }
-
-        // Шестая часть: "Н: X.XXXВ"
-        if (parts[5].contains("Н:")) {
-            QString voltPart = parts[5];
-            int colonPos = voltPart.indexOf(':');
-            if (colonPos > 0) {
-                QString value = voltPart.mid(colonPos + 1).trimmed();
-                if (value.endsWith("В")) {
-                    voltage = value.left(value.length() - 1);
-                } else {
-                    voltage = value;
-                }
-            }
-        }
-
-        // Седьмая часть: "RSSI: XXX"
-        if (parts[6].contains("RSSI:")) {
-            QString rssiPart = parts[6];
-            int colonPos = rssiPart.indexOf(':');
-            if (colonPos > 0) {
-                rssi = rssiPart.mid(colonPos + 1).trimmed();
-            }
-        }
-    }
+    totalPacketCount += frames;
+
+    // Поля - прямо из разобранного кадра, в тех же форматах, что и в
+    // снимке сессии (restoreSession)
+    const DecodedPacket& d = record.decoded;
+    QString type = d.type == PACKET_TYPE_SENSOR ? "ДАТЧИК"
+                 : d.type == PACKET_TYPE_REPEATER ? "РЕПИТЕР" : "НЕИЗВЕСТНО";
+    QString deviceId = QString::asprintf("0x%08X", d.id);
+    QString version = QString::number(d.fw_version);
+    QString pressure = QString::number(d.pressure_bar, 'f', 3);
+    QString temperature = QString::number(d.temperature_c);
+    QString voltage = QString::number(d.voltage_v, 'f', 3);
+    QString rssi = QString::number(d.rssi);
 
     // Игнорируем неизвестные устройства
     if (type == "НЕИЗВЕСТНО") {
@@ -621,7 +1138,7 @@ void MainWindow::onDataReceived(const QString& data)
 
     if (type == "РЕПИТЕР") {
         // Обработка репитера
-        repeaterCount++;
+        repeaterCount += frames;
         lastRepeaterTime = currentTime;
 
         // Сохраняем данные репитера
@@ -635,7 +1152,7 @@ void MainWindow::onDataReceived(const QString& data)
         info.rssi = rssi;
         info.firstSeen = currentTime;
         info.lastSeen = currentTime;
-        info.totalPacketCount = 1;
+        info.totalPacketCount = frames;
 
         repeaterDataMap[deviceId] = info;
 
@@ -664,10 +1181,10 @@ void MainWindow::onDataReceived(const QString& data)
             info.rssi = rssi;
             info.firstSeen = currentTime;
             info.lastSeen = currentTime;
-            info.totalPacketCount = 1;
+            info.totalPacketCount = frames;
 
             deviceDataMap[deviceKey] = info;
-            devicePacketCount[deviceId] = 1;
+            devicePacketCount[deviceId] = frames;
 
             // Добавляем датчик в таблицу
             addPacketToTable(deviceKey, info, true);
@@ -675,7 +1192,11 @@ void MainWindow::onDataReceived(const QString& data)
             // Обновляем существующее устройство
             DevicePacketInfo& info = deviceDataMap[deviceKey];
             info.lastSeen = currentTime;
-            info.totalPacketCount++;
+            info.totalPacketCount += frames;
+
+            // Первый живой пакет устройства из снимка
+            bool wasRestored = info.restored;
+            info.restored = false;
 
             // Обновляем данные, если они изменились
             bool dataChanged = false;
@@ -689,25 +1210,31 @@ void MainWindow::onDataReceived(const QString& data)
             }
 
             // Обновляем счетчик для этого устройства
-            devicePacketCount[deviceId]++;
+            devicePacketCount[deviceId] += frames;
 
             // Обновляем строку в таблице
             updatePacketInTable(deviceKey, info);
+            if (wasRestored && deviceRows.contains(deviceKey)) {
+                setRowRestored(deviceRows.value(deviceKey), false);
+            }
         }
 
         // Обновляем информацию о последнем пакете (датчика)
         updateLastPacketInfo(currentTime, deviceId, type, version, pressure,
                              temperature, voltage, rssi, devicePacketCount[deviceId]);
     }
-
-    // Обновляем статистику
-    updateStatisticsDisplay();
 }
 
 void MainWindow::addPacketToTable(const QString& packetKey, const DevicePacketInfo& info, bool isNewDevice)
 {
     int row = dataTable->rowCount();
     dataTable->insertRow(row);
+    fillTableRow(row, packetKey, info, isNewDevice);
+}
+
+void MainWindow::fillTableRow(int row, const QString& packetKey, const DevicePacketInfo& info, bool isNewDevice)
+{
+    deviceRows[packetKey] = row;
 
     // Время последнего пакета
     QTableWidgetItem *timeItem = new QTableWidgetItem(info.lastSeen.toString("HH:mm:ss"));
@@ -736,12 +1263,28 @@ void MainWindow::addPacketToTable(const QString& packetKey, const DevicePacketIn
     // Всего пакетов
     QTableWidgetItem *totalItem = new QTableWidgetItem(QString::number(info.totalPacketCount));
 
+    // Статистика по давлению и RSSI (заполняется в updateStatsInTable)
+    QTableWidgetItem *pressureMeanItem = new QTableWidgetItem();
+    QTableWidgetItem *pressureStdItem = new QTableWidgetItem();
+    QTableWidgetItem *rssiMeanItem = new QTableWidgetItem();
+    QTableWidgetItem *rssiStdItem = new QTableWidgetItem();
+
+    // Распределения интервалов и RSSI (заполняются в updateHistogramsInTable)
+    QTableWidgetItem *intervalPctItem = new QTableWidgetItem();
+    QTableWidgetItem *rssiPctItem = new QTableWidgetItem();
+
+    // Период передачи и потери (заполняются в updateLossInTable)
+    QTableWidgetItem *periodItem = new QTableWidgetItem();
+    QTableWidgetItem *lossItem = new QTableWidgetItem();
+
     // Устанавливаем цвет для датчиков (голубой)
     QColor rowColor = QColor(220, 240, 255);
 
     // Применяем цвет ко всем ячейкам
     QList<QTableWidgetItem*> items = {timeItem, idItem, typeItem, versionItem, pressureItem,
-                                      tempItem, voltageItem, rssiItem, totalItem};
+                                      tempItem, voltageItem, rssiItem, totalItem,
+                                      pressureMeanItem, pressureStdItem, rssiMeanItem, rssiStdItem,
+                                      intervalPctItem, rssiPctItem, periodItem, lossItem};
     for (auto item : items) {
         item->setBackground(rowColor);
         item->setForeground(Qt::black);
@@ -762,6 +1305,14 @@ void MainWindow::addPacketToTable(const QString& packetKey, const DevicePacketIn
     voltageItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
     rssiItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
     totalItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    pressureMeanItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    pressureStdItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    rssiMeanItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    rssiStdItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    intervalPctItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    rssiPctItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    periodItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    lossItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
 
     // Сохраняем ключ устройства в данные строки
     timeItem->setData(Qt::UserRole, packetKey);
@@ -776,37 +1327,316 @@ void MainWindow::addPacketToTable(const QString& packetKey, const DevicePacketIn
     dataTable->setItem(row, 6, voltageItem);
     dataTable->setItem(row, 7, rssiItem);
     dataTable->setItem(row, 8, totalItem);
+    dataTable->setItem(row, 9, pressureMeanItem);
+    dataTable->setItem(row, 10, pressureStdItem);
+    dataTable->setItem(row, 11, rssiMeanItem);
+    dataTable->setItem(row, 12, rssiStdItem);
+    dataTable->setItem(row, 13, intervalPctItem);
+    dataTable->setItem(row, 14, rssiPctItem);
+    dataTable->setItem(row, 15, periodItem);
+    dataTable->setItem(row, 16, lossItem);
+
+    updateStatsInTable(row, info.deviceId);
+    updateHistogramsInTable(row, info.deviceId);
+    updateLossInTable(row, info.deviceId);
+    updateRowFilter(row, info);
 }
 
 void MainWindow::updatePacketInTable(const QString& packetKey, const DevicePacketInfo& info)
 {
     // Ищем строку с этим устройством
-    for (int row = 0; row < dataTable->rowCount(); ++row) {
-        QTableWidgetItem *item = dataTable->item(row, 0);
-        if (item && item->data(Qt::UserRole).toString() == packetKey) {
-            // Обновляем данные
-            QTableWidgetItem *timeItem = dataTable->item(row, 0);
-            QTableWidgetItem *pressureItem = dataTable->item(row, 4);
-            QTableWidgetItem *tempItem = dataTable->item(row, 5);
-            QTableWidgetItem *voltageItem = dataTable->item(row, 6);
-            QTableWidgetItem *rssiItem = dataTable->item(row, 7);
-            QTableWidgetItem *totalItem = dataTable->item(row, 8);
-
-            if (timeItem) timeItem->setText(info.lastSeen.toString("HH:mm:ss"));
-            if (pressureItem) pressureItem->setText(info.pressure);
-            if (tempItem) tempItem->setText(info.temperature);
-            if (voltageItem) voltageItem->setText(info.voltage);
-            if (rssiItem) rssiItem->setText(info.rssi);
-            if (totalItem) totalItem->setText(QString::number(info.totalPacketCount));
+    auto it = deviceRows.constFind(packetKey);
+    if (it == deviceRows.constEnd()) {
+        return;
+    }
+    int row = it.value();
+
+    QTableWidgetItem *timeItem = dataTable->item(row, 0);
+    QTableWidgetItem *pressureItem = dataTable->item(row, 4);
+    QTableWidgetItem *tempItem = dataTable->item(row, 5);
+    QTableWidgetItem *voltageItem = dataTable->item(row, 6);
+    QTableWidgetItem *rssiItem = dataTable->item(row, 7);
+    QTableWidgetItem *totalItem = dataTable->item(row, 8);
+
+    if (timeItem) timeItem->setText(info.lastSeen.toString("HH:mm:ss"));
+    if (pressureItem) pressureItem->setText(info.pressure);
+    if (tempItem) tempItem->setText(info.temperature);
+    if (voltageItem) voltageItem->setText(info.voltage);
+    if (rssiItem) rssiItem->setText(info.rssi);
+    if (totalItem) totalItem->setText(QString::number(info.totalPacketCount));
+
+    updateStatsInTable(row, info.deviceId);
+    updateHistogramsInTable(row, info.deviceId);
+    updateLossInTable(row, info.deviceId);
+    updateRowFilter(row, info);
+}
 
-            break;
+void MainWindow::updateRowFilter(int row, const DevicePacketInfo& info)
+{
+    if (!packetFilter) {
+        return;
+    }
+
+    // В таблице только датчики; значения - последний пакет устройства
+    DecodedPacket p;
+    p.id = info.deviceId.toUInt(nullptr, 0);
+    p.type = PACKET_TYPE_SENSOR;
+    p.fw_version = info.version.toInt();
+    p.pressure_bar = info.pressure.toFloat();
+    p.temperature_c = info.temperature.toInt();
+    p.voltage_v = info.voltage.toFloat();
+    p.rssi = info.rssi.toInt();
+
+    bool hidden = !packetFilter->matches(p);
+    if (dataTable->isRowHidden(row) != hidden) {
+        dataTable->setRowHidden(row, hidden);
+    }
+}
+
+void MainWindow::updateStatsInTable(int row, const QString& deviceId)
+{
+    DeviceStatsSnapshot snap;
+    if (!enod->stats().snapshot(deviceId.toUInt(nullptr, 0), snap)) {
+        return;
+    }
+
+    const FieldSummary& p = snap.fields[STAT_PRESSURE];
+    const FieldSummary& t = snap.fields[STAT_TEMPERATURE];
+    const FieldSummary& v = snap.fields[STAT_VOLTAGE];
+    const FieldSummary& r = snap.fields[STAT_RSSI];
+
+    QTableWidgetItem *pressureMeanItem = dataTable->item(row, 9);
+    QTableWidgetItem *pressureStdItem = dataTable->item(row, 10);
+    QTableWidgetItem *rssiMeanItem = dataTable->item(row, 11);
+    QTableWidgetItem *rssiStdItem = dataTable->item(row, 12);
+
+    if (pressureMeanItem) pressureMeanItem->setText(QString::number(p.mean, 'f', 3));
+    if (pressureStdItem) pressureStdItem->setText(QString::number(p.stddev, 'f', 3));
+    if (rssiMeanItem) rssiMeanItem->setText(QString::number(r.mean, 'f', 1));
+    if (rssiStdItem) rssiStdItem->setText(QString::number(r.stddev, 'f', 1));
+
+    // Полная сводка во всплывающей подсказке строки
+    auto fieldLine = [](const char* name, const FieldSummary& f, int prec) {
+        return QString("%1: мин %2, макс %3, ср %4 ± %5, EWMA %6 | окно %7: ср %8 ± %9 [%10..%11]")
+                .arg(name)
+                .arg(f.min, 0, 'f', prec).arg(f.max, 0, 'f', prec)
+                .arg(f.mean, 0, 'f', prec).arg(f.stddev, 0, 'f', prec)
+                .arg(f.ewma, 0, 'f', prec)
+                .arg(f.window_count)
+                .arg(f.window_mean, 0, 'f', prec).arg(f.window_stddev, 0, 'f', prec)
+                .arg(f.window_min, 0, 'f', prec).arg(f.window_max, 0, 'f', prec);
+    };
+
+    QString tooltip = fieldLine("Давление", p, 3) + "\n" +
+                      fieldLine("Температура", t, 1) + "\n" +
+                      fieldLine("Напряжение", v, 3) + "\n" +
+                      fieldLine("RSSI", r, 1);
+
+    for (int col = 9; col <= 12; ++col) {
+        if (QTableWidgetItem *item = dataTable->item(row, col)) {
+            item->setToolTip(tooltip);
         }
     }
 }
 
+QString MainWindow::formatIntervalPercentiles(const IntervalHistogram::Counts& counts)
+{
+    if (counts.total == 0) {
+        return "-";
+    }
+    return QString("%1 / %2 / %3")
+            .arg(counts.value_at_percentile(50) / 1e6, 0, 'f', 2)
+            .arg(counts.value_at_percentile(90) / 1e6, 0, 'f', 2)
+            .arg(counts.value_at_percentile(99) / 1e6, 0, 'f', 2);
+}
+
+QString MainWindow::formatRssiPercentiles(const RssiHistogram::Counts& counts)
+{
+    if (counts.total == 0) {
+        return "-";
+    }
+    // В гистограмме хранится модуль RSSI
+    return QString("%1 / %2 / %3")
+            .arg(-(qint64)counts.value_at_percentile(50))
+            .arg(-(qint64)counts.value_at_percentile(90))
+            .arg(-(qint64)counts.value_at_percentile(99));
+}
+
+void MainWindow::updateHistogramsInTable(int row, const QString& deviceId)
+{
+    IntervalHistogram::Counts interval;
+    RssiHistogram::Counts rssi;
+    if (!enod->histograms().device_counts(deviceId.toUInt(nullptr, 0), &interval, &rssi)) {
+        return;
+    }
+
+    if (QTableWidgetItem *intervalItem = dataTable->item(row, 13)) {
+        intervalItem->setText(formatIntervalPercentiles(interval));
+    }
+    if (QTableWidgetItem *rssiItem = dataTable->item(row, 14)) {
+        rssiItem->setText(formatRssiPercentiles(rssi));
+    }
+}
+
+void MainWindow::updateLossInTable(int row, const QString& deviceId)
+{
+    DeviceLossInfo loss;
+    if (!enod->losses().device(deviceId.toUInt(nullptr, 0), loss)) {
+        return;
+    }
+
+    QTableWidgetItem *periodItem = dataTable->item(row, 15);
+    QTableWidgetItem *lossItem = dataTable->item(row, 16);
+
+    if (periodItem) {
+        periodItem->setText(loss.period_s > 0 ? QString::number(loss.period_s, 'f', 1) : "-");
+        periodItem->setToolTip(loss.period_from_config ? "Период из periods.conf" : "Период выучен по интервалам");
+    }
+    if (lossItem) {
+        lossItem->setText(loss.expected ? QString::number(loss.loss_rate * 100.0, 'f', 1) : "-");
+        lossItem->setToolTip(QString("Пропущено %1 из %2 ожидаемых\nПоследнее окно: %3 из %4 (%5%)")
+                                     .arg(loss.missed).arg(loss.expected)
+                                     .arg(loss.window_missed).arg(loss.window_expected)
+                                     .arg(loss.window_loss_rate * 100.0, 0, 'f', 1));
+    }
+}
+
+void MainWindow::updateLossRanking()
+{
+    std::vector<DeviceLossInfo> worst = enod->losses().worst(5);
+
+    if (worst.empty()) {
+        lossRankingLabel->setText("Потерь не обнаружено");
+        return;
+    }
+
+    QStringList lines;
+    for (const DeviceLossInfo& loss : worst) {
+        lines << QString("%1: %2% (%3/%4)")
+                         .arg(QString::asprintf("0x%08X", loss.id))
+                         .arg(loss.loss_rate * 100.0, 0, 'f', 1)
+                         .arg(loss.missed).arg(loss.expected);
+    }
+    lossRankingLabel->setText(lines.join("\n"));
+}
+
+void MainWindow::updateFleetCoverage()
+{
+    FleetCoverage& fleet = enod->fleet();
+    if (fleet.empty()) {
+        fleetLabel->setText("Список устройств не загружен");
+        return;
+    }
+
+    // Подсчет молчащих проходит только по ним, а не по всему парку
+    qint64 silentBefore = QDateTime::currentMSecsSinceEpoch() - fleetSilentSpinBox->value() * 60000ll;
+    FleetCoverageStats s = fleet.stats(silentBefore);
+    fleetLabel->setText(QString("Ожидается: %1\nВидно: %2 (%3%)\nНи разу не видно: %4\nМолчат: %5\nПакетов чужих: %6")
+                                .arg(s.expected)
+                                .arg(s.seen)
+                                .arg(s.expected ? 100.0 * s.seen / s.expected : 0.0, 0, 'f', 1)
+                                .arg(s.never_seen)
+                                .arg(s.silent)
+                                .arg(s.foreign_packets));
+}
+
+void MainWindow::seedFleetFromRegistry()
+{
+    // Устройства, уже известные до загрузки списка (в том числе из
+    // снимка сессии), - по времени, чтобы список молчащих остался упорядочен
+    QList<QPair<qint64, uint32_t>> known;
+    for (auto it = deviceDataMap.constBegin(); it != deviceDataMap.constEnd(); ++it) {
+        known.append(qMakePair(it.value().lastSeen.toMSecsSinceEpoch(), it.value().deviceId.toUInt(nullptr, 0)));
+    }
+    for (auto it = repeaterDataMap.constBegin(); it != repeaterDataMap.constEnd(); ++it) {
+        known.append(qMakePair(it.value().lastSeen.toMSecsSinceEpoch(), it.value().deviceId.toUInt(nullptr, 0)));
+    }
+    std::sort(known.begin(), known.end());
+    for (const auto& device : known) {
+        enod->fleet().update(device.second, device.first);
+    }
+}
+
+void MainWindow::importFleet()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Ожидаемые устройства", QCoreApplication::applicationDirPath(),
+                                                "Список (*.list *.txt *.csv);;Все файлы (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+
+    std::string error;
+    if (!enod->fleet().load_file(path.toStdString(), &error)) {
+        statusBar()->showMessage("Список устройств: " + QString::fromStdString(error));
+        return;
+    }
+    seedFleetFromRegistry();
+    updateFleetCoverage();
+    statusBar()->showMessage("Загружен список устройств: " + path, 3000);
+}
+
+void MainWindow::showMissingDevices()
+{
+    if (enod->fleet().empty()) {
+        statusBar()->showMessage("Список ожидаемых устройств не загружен", 3000);
+        return;
+    }
+
+    const size_t limit = 10000;
+    qint64 silentBefore = QDateTime::currentMSecsSinceEpoch() - fleetSilentSpinBox->value() * 60000ll;
+    std::vector<uint32_t> never = enod->fleet().never_seen(limit);
+    std::vector<FleetSilentDevice> silent = enod->fleet().silent(silentBefore, limit);
+
+    QStringList lines;
+    lines << QString("Ни разу не видно (%1%2):").arg(never.size()).arg(never.size() == limit ? "+" : "");
+    for (uint32_t id : never) {
+        lines << QString::asprintf("0x%08X", id);
+    }
+    lines << QString() << QString("Молчат дольше %1 мин (%2%3), давние первыми:")
+                                  .arg(fleetSilentSpinBox->value())
+                                  .arg(silent.size()).arg(silent.size() == limit ? "+" : "");
+    for (const FleetSilentDevice& d : silent) {
+        lines << QString::asprintf("0x%08X  ", d.id) +
+                 QDateTime::fromMSecsSinceEpoch(d.last_seen_ms).toString("dd.MM.yyyy HH:mm:ss");
+    }
+
+    QMessageBox box(this);
+    box.setWindowTitle("Пропавшие устройства");
+    box.setText(QString("Не видно: %1, молчат: %2").arg(never.size()).arg(silent.size()));
+    box.setDetailedText(lines.join("\n"));
+    box.exec();
+}
+
+void MainWindow::drainAlarms()
+{
+    std::vector<AlarmEvent> events = enod->alarms().take_events();
+    if (events.empty()) {
+        return;
+    }
+
+    // Время события - монотонная метка приема; в UTC по привязке часов Enod
+    const RxClock& clock = enod->rx_clock();
+
+    QStringList lines;
+    for (const AlarmEvent& ev : events) {
+        QDateTime time = QDateTime::fromMSecsSinceEpoch(clock.wall_us((int64_t)ev.time_us) / 1000);
+        lines << QString("%1 %2 %3 %4")
+                         .arg(time.toString("HH:mm:ss"))
+                         .arg(ev.raised ? "ТРЕВОГА" : "норма")
+                         .arg(QString::fromStdString(ev.rule))
+                         .arg(QString::asprintf("0x%08X", ev.id));
+    }
+    alarmLog->append(lines.join("\n"));
+
+    statusBar()->showMessage(QString("Новых событий тревог: %1").arg(events.size()), 3000);
+}
+
 void MainWindow::clearDisplay()
 {
     dataTable->setRowCount(0);
+    deviceRows.clear();
+    restoreQueue.clear();
+    restoreNext = 0;
     statusBar()->showMessage("Таблица очищена", 2000);
 }
 
@@ -850,18 +1680,395 @@ void MainWindow::updateStatisticsDisplay()
 
     // Рассчитываем скорость приема (пакетов в секунду)
     double packetRate = 0;
-    if (!packetTimestamps.isEmpty()) {
-        QDateTime now = QDateTime::currentDateTime();
-        QDateTime oldest = packetTimestamps.first();
-        qint64 seconds = oldest.secsTo(now);
-        if (seconds > 0) {
-            packetRate = totalPacketCount / (double)seconds;
+    if (firstPacketMs != 0) {
+        qint64 ms = QDateTime::currentMSecsSinceEpoch() - firstPacketMs;
+        if (ms >= 1000) {
+            packetRate = totalPacketCount / (ms / 1000.0);
         }
     }
 
     packetRateLabel->setText(QString("Скорость приема: %1 пак/с").arg(packetRate, 0, 'f', 1));
 }
 
+// Сводка по парку обходит все сегменты статистики - раз в секунду по
+// таймеру индикаторов, а не на каждую пачку отображения
+void MainWindow::updateFleetSummary()
+{
+    FieldSummary fleetStats[STAT_FIELD_COUNT];
+    size_t statDevices = 0;
+    enod->stats().merged(fleetStats, &statDevices);
+    auto fleetLine = [](const char* name, const FieldSummary& f, int prec) {
+        return QString("%1: мин %2, макс %3, ср %4 ± %5")
+                .arg(name)
+                .arg(f.min, 0, 'f', prec).arg(f.max, 0, 'f', prec)
+                .arg(f.mean, 0, 'f', prec).arg(f.stddev, 0, 'f', prec);
+    };
+    totalDevicesLabel->setToolTip(statDevices
+            ? QString("По всем устройствам (%1), пакетов %2\n").arg(statDevices).arg(fleetStats[STAT_PRESSURE].count) +
+              fleetLine("Давление", fleetStats[STAT_PRESSURE], 3) + "\n" +
+              fleetLine("Температура", fleetStats[STAT_TEMPERATURE], 1) + "\n" +
+              fleetLine("Напряжение", fleetStats[STAT_VOLTAGE], 3) + "\n" +
+              fleetLine("RSSI", fleetStats[STAT_RSSI], 1)
+            : QString("Статистики пока нет"));
+
+    // Распределения по порту (чтение без блокировок)
+    IntervalHistogram::Counts portInterval;
+    RssiHistogram::Counts portRssi;
+    enod->histograms().port_counts(&portInterval, &portRssi);
+    portIntervalLabel->setText("Интервал p50/90/99: " + formatIntervalPercentiles(portInterval) + " с");
+    portRssiLabel->setText("RSSI p50/90/99: " + formatRssiPercentiles(portRssi));
+}
+
+void MainWindow::reloadDeviceLists()
+{
+    DeviceLists& lists = enod->device_lists();
+    bool reloaded = false;
+    std::string error;
+    if (!lists.reload_if_changed(deviceListsPath.toStdString(), &reloaded, &error)) {
+        statusBar()->showMessage("devices.list: " + QString::fromStdString(error));
+    } else if (reloaded) {
+        statusBar()->showMessage(QString("Списки устройств: допуск %1, запрет %2")
+                                         .arg(lists.allow_count()).arg(lists.deny_count()), 3000);
+    }
+
+    if (lists.allow_count() || lists.deny_count() || lists.dropped_count()) {
+        deviceListsLabel->setText(QString("Списки устройств: допуск %1, запрет %2, отброшено %3")
+                                          .arg(lists.allow_count())
+                                          .arg(lists.deny_count())
+                                          .arg(lists.dropped_count()));
+    } else {
+        deviceListsLabel->setText("Списки устройств: нет");
+    }
+}
+
+void MainWindow::restoreSession()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    std::string error;
+    if (!sessionSnapshot.map(sessionSnapshotPath.toStdString(), &error)) {
+        if (QFile::exists(sessionSnapshotPath)) {
+            statusBar()->showMessage("session.snap: " + QString::fromStdString(error));
+        }
+        return;
+    }
+
+    QDateTime snapshotTime = QDateTime::fromMSecsSinceEpoch(sessionSnapshot.saved_ms());
+    const SessionDeviceRecord* records = sessionSnapshot.records();
+    uint32_t count = sessionSnapshot.count();
+
+    // Реестр заполняется сразу, строки таблицы - пачками между событиями
+    // (fillRestoredRows): 100 тыс. строк по 17 ячеек разом задержали бы
+    // показ окна на секунды
+    restoreQueue.clear();
+    restoreNext = 0;
+    restoreSnapshotTime = snapshotTime;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const SessionDeviceRecord& r = records[i];
+
+        DevicePacketInfo info;
+        info.deviceId = QString::asprintf("0x%08X", r.id);
+        info.type = r.type == 0xF1 ? "РЕПИТЕР" : "ДАТЧИК";
+        info.version = QString::number(r.fw_version);
+        info.pressure = QString::number(r.pressure_bar, 'f', 3);
+        info.temperature = QString::number(r.temperature_c);
+        info.voltage = QString::number(r.voltage_v, 'f', 3);
+        info.rssi = QString::number(r.rssi);
+        info.firstSeen = QDateTime::fromMSecsSinceEpoch(r.first_seen_ms);
+        info.lastSeen = QDateTime::fromMSecsSinceEpoch(r.last_seen_ms);
+        info.totalPacketCount = (int)r.packet_count;
+        info.restored = true;
+
+        if (r.stats.count > 0) {
+            enod->stats().restore_state(r.id, r.stats);
+        }
+
+        if (r.type == 0xF1) {
+            repeaterDataMap[info.deviceId] = info;
+            continue;
+        }
+
+        deviceDataMap[info.deviceId] = info;
+        devicePacketCount[info.deviceId] = info.totalPacketCount;
+        uniquePacketCount++;
+        sensorCount++;
+        restoreQueue.append(info.deviceId);
+    }
+
+    sessionSnapshot.unmap();
+    if (!restoreQueue.isEmpty()) {
+        deviceRows.reserve(deviceRows.size() + restoreQueue.size());
+        QTimer::singleShot(0, this, &MainWindow::fillRestoredRows);
+    }
+
+    updateStatisticsDisplay();
+    updateFleetSummary();
+    statusBar()->showMessage(QString("Восстановлено устройств: %1 (снимок от %2, %3 мс)")
+                                     .arg(count)
+                                     .arg(snapshotTime.toString("dd.MM.yyyy HH:mm:ss"))
+                                     .arg(timer.elapsed()), 5000);
+}
+
+// Строки добавляются пачкой одним setRowCount: insertRow на каждое
+// устройство сдвигает модель. Живой пакет устройства, строки которого
+// еще нет, меняет только deviceDataMap - строка создается по текущим
+// данным и без серого выделения.
+void MainWindow::fillRestoredRows()
+{
+    static const int ROWS_PER_PASS = 2000;
+
+    int end = std::min(restoreNext + ROWS_PER_PASS, (int)restoreQueue.size());
+    if (restoreNext >= end) {
+        return;
+    }
+
+    dataTable->setUpdatesEnabled(false);
+    int row = dataTable->rowCount();
+    dataTable->setRowCount(row + (end - restoreNext));
+    for (; restoreNext < end; restoreNext++, row++) {
+        const QString& key = restoreQueue.at(restoreNext);
+        const DevicePacketInfo& info = deviceDataMap[key];
+        fillTableRow(row, key, info, false);
+        if (info.restored) {
+            setRowRestored(row, true, restoreSnapshotTime);
+        }
+    }
+    dataTable->setUpdatesEnabled(true);
+
+    if (restoreNext < restoreQueue.size()) {
+        QTimer::singleShot(0, this, &MainWindow::fillRestoredRows);
+    } else {
+        restoreQueue.clear();
+        restoreNext = 0;
+    }
+}
+
+void MainWindow::setRowRestored(int row, bool restored, const QDateTime& snapshotTime)
+{
+    // Строки из снимка выделяются серым до первого живого пакета
+    QColor color = restored ? QColor(110, 110, 110) : QColor(Qt::black);
+    for (int col = 0; col < dataTable->columnCount(); ++col) {
+        if (QTableWidgetItem *item = dataTable->item(row, col)) {
+            item->setForeground(color);
+        }
+    }
+
+    if (QTableWidgetItem *timeItem = dataTable->item(row, 0)) {
+        timeItem->setToolTip(restored
+                             ? "Из снимка сессии от " + snapshotTime.toString("dd.MM.yyyy HH:mm:ss")
+                             : QString());
+    }
+}
+
+std::vector<SessionDeviceRecord> MainWindow::collectRegistry()
+{
+    std::vector<SessionDeviceRecord> records;
+    records.reserve(deviceDataMap.size() + repeaterDataMap.size());
+
+    auto append = [&](const DevicePacketInfo& info, uint8_t type) {
+        SessionDeviceRecord r;
+        memset(&r, 0, sizeof(r));
+        r.id = info.deviceId.toUInt(nullptr, 0);
+        r.type = type;
+        r.fw_version = (uint8_t)info.version.toUInt();
+        r.temperature_c = (int16_t)info.temperature.toInt();
+        r.rssi = (int16_t)info.rssi.toInt();
+        r.pressure_bar = info.pressure.toFloat();
+        r.voltage_v = info.voltage.toFloat();
+
+        // Точные значения последнего пакета - из таблицы потока чтения
+        LatestPacket latest;
+        if (enod->latest().device(r.id, latest)) {
+            r.fw_version = latest.fw_version;
+            r.temperature_c = latest.temperature_c;
+            r.rssi = latest.rssi;
+            r.pressure_bar = latest.pressure_bar;
+            r.voltage_v = latest.voltage_v;
+        }
+        r.packet_count = (uint32_t)info.totalPacketCount;
+        r.first_seen_ms = info.firstSeen.toMSecsSinceEpoch();
+        r.last_seen_ms = info.lastSeen.toMSecsSinceEpoch();
+        enod->stats().save_state(r.id, r.stats);
+        records.push_back(r);
+    };
+
+    for (auto it = deviceDataMap.constBegin(); it != deviceDataMap.constEnd(); ++it) {
+        append(it.value(), 0xF0);
+    }
+    for (auto it = repeaterDataMap.constBegin(); it != repeaterDataMap.constEnd(); ++it) {
+        append(it.value(), 0xF1);
+    }
+
+    return records;
+}
+
+void MainWindow::saveSession()
+{
+    sessionSnapshot.save_async(sessionSnapshotPath.toStdString(), collectRegistry(),
+                               QDateTime::currentMSecsSinceEpoch());
+    // Агрегаты - вместе с реестром, чтобы сбой не терял их целиком;
+    // недостроенные не сохраняются - файл прошлого сохранения остается
+    if (!enod->replaying_rollups()) {
+        enod->rollups().save_async(rollupsPath.toStdString());
+    }
+}
+
+void MainWindow::toggleLiveExport(bool enabled)
+{
+    if (!enabled) {
+        enod->exporter().stop_live();
+        statusBar()->showMessage("Непрерывный экспорт остановлен", 3000);
+        return;
+    }
+
+    // Новый файл каждые 64 МБ или каждый час
+    ExportFormat format = (ExportFormat)exportFormatComboBox->currentIndex();
+    QString prefix = QCoreApplication::applicationDirPath() + "/export/packets";
+    std::string error;
+    if (!enod->exporter().start_live(prefix.toStdString(), format,
+                                     64ull * 1024 * 1024, 3600ll * 1000, &error)) {
+        liveExportButton->setChecked(false);
+        statusBar()->showMessage("Экспорт: " + QString::fromStdString(error));
+        return;
+    }
+    statusBar()->showMessage("Непрерывный экспорт в " + prefix + "-*", 3000);
+}
+
+void MainWindow::toggleCapture(bool enabled)
+{
+    if (!enabled) {
+        enod->capture().close();
+        statusBar()->showMessage("Запись кадров остановлена", 3000);
+        return;
+    }
+
+    QString dir = QCoreApplication::applicationDirPath() + "/captures";
+    QDir().mkpath(dir);
+    QDateTime now = QDateTime::currentDateTime();
+    QString path = dir + "/capture-" + now.toString("yyyyMMdd-HHmmss") + ".ecap";
+    std::string error;
+    if (!enod->capture().open(path.toStdString(), now.toMSecsSinceEpoch(), &error)) {
+        captureButton->setChecked(false);
+        statusBar()->showMessage("Запись кадров: " + QString::fromStdString(error));
+        return;
+    }
+    statusBar()->showMessage("Запись кадров в " + path, 3000);
+}
+
+void MainWindow::applyTableFilter()
+{
+    std::shared_ptr<PacketFilter> filter = std::make_shared<PacketFilter>();
+    std::string error;
+    if (!filter->compile(tableFilterEdit->text().toStdString(), &error)) {
+        statusBar()->showMessage("Фильтр: " + QString::fromStdString(error));
+        return;
+    }
+
+    packetFilter = filter->empty() ? nullptr : filter;
+    if (exportFilterCheckBox->isChecked()) {
+        enod->exporter().set_filter(packetFilter);
+    }
+
+    dataTable->setUpdatesEnabled(false);
+    int shown = 0;
+    for (auto it = deviceRows.constBegin(); it != deviceRows.constEnd(); ++it) {
+        auto info = deviceDataMap.constFind(it.key());
+        if (info == deviceDataMap.constEnd()) {
+            continue;
+        }
+        if (packetFilter) {
+            updateRowFilter(it.value(), info.value());
+        } else {
+            dataTable->setRowHidden(it.value(), false);
+        }
+        if (!dataTable->isRowHidden(it.value())) {
+            shown++;
+        }
+    }
+    dataTable->setUpdatesEnabled(true);
+
+    statusBar()->showMessage(packetFilter ? QString("Фильтр: показано %1 из %2").arg(shown).arg(deviceRows.size())
+                                          : QString("Фильтр снят"), 3000);
+}
+
+void MainWindow::toggleExportFilter(bool enabled)
+{
+    enod->exporter().set_filter(enabled ? packetFilter : nullptr);
+}
+
+void MainWindow::openCapture()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Открыть файл захвата",
+                                                QCoreApplication::applicationDirPath() + "/captures",
+                                                "Захват (*.ecap);;Сырой поток (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+
+    // Окно удаляется само при закрытии
+    CaptureViewer *viewer = new CaptureViewer(this);
+    QString error;
+    if (!viewer->openFile(path, &error)) {
+        delete viewer;
+        statusBar()->showMessage("Захват: " + error, 5000);
+        return;
+    }
+    viewer->show();
+}
+
+QString MainWindow::exportFileFilter(ExportFormat format)
+{
+    switch (format) {
+        case EXPORT_CSV: return "CSV (*.csv)";
+        case EXPORT_NDJSON: return "NDJSON (*.ndjson)";
+        case EXPORT_ARROW: return "Arrow IPC (*.arrow *.feather)";
+    }
+    return QString();
+}
+
+void MainWindow::exportRegistry()
+{
+    ExportFormat format = (ExportFormat)exportFormatComboBox->currentIndex();
+    if (format == EXPORT_ARROW) {
+        statusBar()->showMessage("Реестр выгружается только в CSV или NDJSON", 3000);
+        return;
+    }
+    QString path = QFileDialog::getSaveFileName(this, "Экспорт реестра устройств", QString(),
+                                                exportFileFilter(format));
+    if (path.isEmpty()) {
+        return;
+    }
+    enod->exporter().export_registry(path.toStdString(), format, collectRegistry());
+}
+
+void MainWindow::exportHistory()
+{
+    if (!enod->history().is_open()) {
+        statusBar()->showMessage("История недоступна", 3000);
+        return;
+    }
+
+    bool ok = false;
+    int hours = QInputDialog::getInt(this, "Экспорт истории", "За последние, ч:", 24, 1, 24 * 365, 1, &ok);
+    if (!ok) {
+        return;
+    }
+
+    ExportFormat format = (ExportFormat)exportFormatComboBox->currentIndex();
+    QString path = QFileDialog::getSaveFileName(this, "Экспорт истории", QString(), exportFileFilter(format));
+    if (path.isEmpty()) {
+        return;
+    }
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    enod->exporter().export_history(path.toStdString(), format, enod->history(), HistoryStore::ALL_DEVICES,
+                                    now - hours * 3600ll * 1000, now,
+                                    exportFilterCheckBox->isChecked() ? packetFilter : nullptr);
+    statusBar()->showMessage("Экспорт истории запущен", 3000);
+}
+
 void MainWindow::generateSummary()
 {
     if (!isConnected) return;
@@ -870,14 +2077,27 @@ void MainWindow::generateSummary()
     qint64 seconds = lastSummaryTime.secsTo(now);
 
     if (seconds > 0) {
-        double periodRate = packetCountInPeriod / (double)seconds;
+        // Сводка за период собирается из агрегатов по интервалам
+        RollupAggregate period = enod->rollups().query(Rollups::ALL_DEVICES,
+                                                        lastSummaryTime.toMSecsSinceEpoch(),
+                                                        now.toMSecsSinceEpoch());
+        double periodRate = period.count / (double)seconds;
 
-        periodPacketsLabel->setText(QString("Пакетов: %1").arg(packetCountInPeriod));
+        periodPacketsLabel->setText(QString("Пакетов: %1").arg(period.count));
         periodUniqueLabel->setText(QString("Новых устройств: %1").arg(uniquePacketCountInPeriod));
         periodRateLabel->setText(QString("Скорость: %1 пак/с").arg(periodRate, 0, 'f', 1));
+        if (period.count > 0) {
+            periodPacketsLabel->setToolTip(
+                    QString("Давление: ср. %1, мин %2, макс %3 бар\nRSSI: ср. %4, мин %5, макс %6")
+                            .arg(period.fields[STAT_PRESSURE].mean(period.count), 0, 'f', 2)
+                            .arg(period.fields[STAT_PRESSURE].min, 0, 'f', 2)
+                            .arg(period.fields[STAT_PRESSURE].max, 0, 'f', 2)
+                            .arg(period.fields[STAT_RSSI].mean(period.count), 0, 'f', 1)
+                            .arg(period.fields[STAT_RSSI].min, 0, 'f', 0)
+                            .arg(period.fields[STAT_RSSI].max, 0, 'f', 0));
+        }
 
         // Сбрасываем счетчики периода
-        packetCountInPeriod = 0;
         uniquePacketCountInPeriod = 0;
         lastSummaryTime = now;
     }
@@ -5,11 +5,16 @@
 #include <QMainWindow>
 #include <QStatusBar>
 #include "Enod.h"
+#include "SessionSnapshot.h"
+#include "PacketFilter.h"
 #include <QDateTime>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
 #include <QComboBox>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QSpinBox>
 #include <QLabel>
 #include <QTextEdit>
 #include <QGroupBox>
@@ -17,7 +22,9 @@
 #include <QTableWidget>
 #include <QHeaderView>
 #include <QMap>
+#include <QHash>
 #include <QList>
+#include <memory>
 
 struct DevicePacketInfo {
     QString deviceId;
@@ -30,6 +37,7 @@ struct DevicePacketInfo {
     QDateTime firstSeen;
     QDateTime lastSeen;
     int totalPacketCount;
+    bool restored = false;      // из снимка сессии, живых пакетов еще не было
 };
 
 class MainWindow : public QMainWindow
@@ -46,17 +54,53 @@ private slots:
     void disconnectFromPort();
     void clearDisplay();
     void resetData();
-    void onDataReceived(const QString& data);
+    void drainDisplay();
     void updateStatisticsDisplay();
+    void updateFleetSummary();
     void generateSummary();
     void updateClock();
     void updateConnectionIndicators();
+    void updateLossRanking();
+    void drainAlarms();
+    void saveSession();
+    void toggleLiveExport(bool enabled);
+    void exportRegistry();
+    void exportHistory();
+    void toggleCapture(bool enabled);
+    void openCapture();
+    void applyTableFilter();
+    void toggleExportFilter(bool enabled);
+    void applyQueuePolicies();
+    void importFleet();
+    void showMissingDevices();
+    void updateFleetCoverage();
+    void updateLinkStatus();
+    void updateRealtimeStatus();
+    void updateSourceKind();
 
 private:
     void setupUI();
     void setupStatusBar();
+    void restoreSession();
+    void fillRestoredRows();
+    std::vector<SessionDeviceRecord> collectRegistry();
+    void setRowRestored(int row, bool restored, const QDateTime& snapshotTime = QDateTime());
     void addPacketToTable(const QString& packetKey, const DevicePacketInfo& info, bool isNewDevice);
+    void fillTableRow(int row, const QString& packetKey, const DevicePacketInfo& info, bool isNewDevice);
     void updatePacketInTable(const QString& packetKey, const DevicePacketInfo& info);
+    void updateStatsInTable(int row, const QString& deviceId);
+    void updateHistogramsInTable(int row, const QString& deviceId);
+    void updateLossInTable(int row, const QString& deviceId);
+    void updateRowFilter(int row, const DevicePacketInfo& info);
+    void reloadDeviceLists();
+    void seedFleetFromRegistry();
+    void applyReaderSettings();
+    // frames - сколько принятых кадров представляет строка (слияние в
+    // очереди отображения)
+    void onDataReceived(const DisplayRecord& record, int frames);
+    static QString formatIntervalPercentiles(const IntervalHistogram::Counts& counts);
+    static QString formatRssiPercentiles(const RssiHistogram::Counts& counts);
+    static QString exportFileFilter(ExportFormat format);
     void clearLastPacketInfo();
     void updateLastPacketInfo(const QDateTime& time, const QString& deviceId,
                               const QString& type, const QString& version,
@@ -65,24 +109,52 @@ private:
                               int totalPackets);
 
     // Элементы интерфейса
+    QComboBox *sourceComboBox;
+    QLineEdit *sourceAddressEdit;
+    QWidget *serialSettingsWidget;
+    QWidget *speedSettingsWidget;
     QComboBox *portComboBox;
     QComboBox *speedComboBox;
+    QComboBox *readBackendComboBox;
+    QSpinBox *pipelineWorkersSpinBox;
+    QComboBox *displayPolicyComboBox;
     QPushButton *refreshButton;
     QPushButton *connectButton;
     QPushButton *disconnectButton;
     QPushButton *clearButton;
     QPushButton *resetButton;
 
+    // Экспорт
+    QComboBox *exportFormatComboBox;
+    QPushButton *liveExportButton;
+    QPushButton *exportRegistryButton;
+    QPushButton *exportHistoryButton;
+    QPushButton *captureButton;
+    QPushButton *openCaptureButton;
+    QCheckBox *exportFilterCheckBox;
+    QCheckBox *exportLosslessCheckBox;
+    QLabel *exportStatusLabel;
+
+    // Режим реального времени потока чтения
+    QCheckBox *realtimeCheckBox;
+    QSpinBox *realtimePrioritySpinBox;
+    QSpinBox *realtimeCpuSpinBox;
+    QLabel *realtimeLabel;
+
     // Индикаторы
     QLabel *sensorIndicator;
     QLabel *repeaterIndicator;
 
     QTableWidget *dataTable;
+    QLineEdit *tableFilterEdit;
     QLabel *statusBarLabel;
 
     QLabel *connectionStatusLabel;
     QLabel *portInfoLabel;
     QLabel *speedInfoLabel;
+    QLabel *linkGapsLabel;
+    QLabel *sourceStatsLabel;
+    QLabel *queueStatsLabel;
 
     // Статистика и время
     QLabel *currentTimeLabel;
@@ -91,6 +163,10 @@ private:
     QLabel *totalDevicesLabel;
     QLabel *totalPacketsLabel;
     QLabel *packetRateLabel;
+    QLabel *portIntervalLabel;
+    QLabel *portRssiLabel;
+    QLabel *historyLabel;
+    QLabel *deviceListsLabel;
 
     // Последний пакет (датчика)
     QLabel *lastPacketTimeLabel;
@@ -108,14 +184,28 @@ private:
     QLabel *periodUniqueLabel;
     QLabel *periodRateLabel;
 
+    // Потери пакетов
+    QLabel *lossRankingLabel;
+
+    // Покрытие ожидаемого парка
+    QLabel *fleetLabel;
+    QSpinBox *fleetSilentSpinBox;
+    QPushButton *fleetImportButton;
+    QPushButton *fleetMissingButton;
+
+    // Журнал тревог
+    QTextEdit *alarmLog;
+
     // Данные и статистика
     Enod *enod;
     bool isConnected;
+    // Прошлый замер счетчика источника для скорости приема
+    quint64 lastSourceBytes = 0;
+    qint64 lastSourceStatsMs = 0;
 
     // Статистика пакетов
     int uniquePacketCount;
     int totalPacketCount;
-    int packetCountInPeriod;
     int uniquePacketCountInPeriod;
     QDateTime lastSummaryTime;
     QDateTime lastPacketTime;
@@ -127,10 +217,26 @@ private:
     int unknownCount;
 
     // Хранение данных
-    QList<QDateTime> packetTimestamps;
+    qint64 firstPacketMs = 0;       // прием первого пакета (UTC, мс); 0 - пакетов не было
     QMap<QString, int> devicePacketCount;
     QMap<QString, DevicePacketInfo> deviceDataMap;
     QMap<QString, DevicePacketInfo> repeaterDataMap;
+    QHash<QString, int> deviceRows;     // строка таблицы по ключу устройства
+
+    // Фильтр таблицы; при включенном флажке - и непрерывного экспорта
+    std::shared_ptr<const PacketFilter> packetFilter;
+
+    // Снимок реестра устройств
+    SessionSnapshot sessionSnapshot;
+    QString sessionSnapshotPath;
+    // Датчики из снимка, строки которых еще не созданы (fillRestoredRows)
+    QStringList restoreQueue;
+    int restoreNext = 0;
+    QDateTime restoreSnapshotTime;
+    QString rollupsPath;
+
+    // Списки допуска/запрета устройств (перечитываются при изменении)
+    QString deviceListsPath;
 };
 
 #endif // MAINWINDOW_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "PacketDecoder.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Формулы разбора полей. Общие для одиночного и пакетного разбора,
+// чтобы живой поток и офлайн-обработка давали одинаковые значения.
+
+static inline uint32_t packet_id(const uint8_t* p) {
+    return ((uint32_t)p[6] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[4] << 8) | p[3];
+}
+
+static inline float packet_pressure(const uint8_t* p) {
+    uint16_t raw = ((uint16_t)p[8] << 8) | p[7];
+    return 2750.0f * (raw - 1) / 100000.0f;
+}
+
+static inline int packet_temperature(const uint8_t* p) {
+    return (int)(int8_t)p[14] - 55;
+}
+
+static inline float packet_voltage(const uint8_t* p) {
+    return p[13] * 0.01512f;
+}
+
+static inline int packet_fw_version(const uint8_t* p) {
+    return abs((int)(int8_t)p[19]);
+}
+
+static inline int packet_rssi(const uint8_t* p) {
+    return -(int8_t)p[24];
+}
+
+void decode_packet(const uint8_t* p, DecodedPacket& out) {
+    out.id = packet_id(p);
+    out.type = p[2];
+    out.pressure_bar = packet_pressure(p);
+    out.temperature_c = packet_temperature(p);
+    out.voltage_v = packet_voltage(p);
+    out.fw_version = packet_fw_version(p);
+    out.rssi = packet_rssi(p);
+}
+
+void PacketColumns::reserve(size_t n) {
+    time_ms.reserve(n);
+    id.reserve(n);
+    type.reserve(n);
+    fw_version.reserve(n);
+    pressure_bar.reserve(n);
+    temperature_c.reserve(n);
+    voltage_v.reserve(n);
+    rssi.reserve(n);
+    source.reserve(n);
+}
+
+void PacketColumns::clear() {
+    resize(0);
+}
+
+void PacketColumns::resize(size_t n) {
+    time_ms.resize(n);
+    id.resize(n);
+    type.resize(n);
+    fw_version.resize(n);
+    pressure_bar.resize(n);
+    temperature_c.resize(n);
+    voltage_v.resize(n);
+    rssi.resize(n);
+    source.resize(n);
+}
+
+uint16_t PacketColumns::source_index(const std::string& name) {
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i] == name) {
+            return (uint16_t)i;
+        }
+    }
+    if (sources.size() >= NO_SOURCE) {
+        return NO_SOURCE;
+    }
+    sources.push_back(name);
+    return (uint16_t)(sources.size() - 1);
+}
+
+void decode_packets(const uint8_t* frames, size_t stride, size_t count,
+                    const int64_t* times, uint16_t src, PacketColumns& out) {
+    size_t base = out.size();
+    out.resize(base + count);
+
+    // По столбцу за проход: в цикле нет ветвлений и зависимостей между
+    // итерациями, компилятор разворачивает и векторизует арифметику
+    int64_t* t = out.time_ms.data() + base;
+    if (times) {
+        memcpy(t, times, count * sizeof(int64_t));
+    } else {
+        for (size_t i = 0; i < count; i++) t[i] = 0;
+    }
+
+    uint32_t* id = out.id.data() + base;
+    for (size_t i = 0; i < count; i++) id[i] = packet_id(frames + i * stride);
+
+    uint8_t* type = out.type.data() + base;
+    for (size_t i = 0; i < count; i++) type[i] = frames[i * stride + 2];
+
+    float* pressure = out.pressure_bar.data() + base;
+    for (size_t i = 0; i < count; i++) pressure[i] = packet_pressure(frames + i * stride);
+
+    int16_t* temperature = out.temperature_c.data() + base;
+    for (size_t i = 0; i < count; i++) temperature[i] = (int16_t)packet_temperature(frames + i * stride);
+
+    float* voltage = out.voltage_v.data() + base;
+    for (size_t i = 0; i < count; i++) voltage[i] = packet_voltage(frames + i * stride);
+
+    uint8_t* fw = out.fw_version.data() + base;
+    for (size_t i = 0; i < count; i++) fw[i] = (uint8_t)packet_fw_version(frames + i * stride);
+
+    int16_t* rssi = out.rssi.data() + base;
+    for (size_t i = 0; i < count; i++) rssi[i] = (int16_t)packet_rssi(frames + i * stride);
+
+    uint16_t* source = out.source.data() + base;
+    for (size_t i = 0; i < count; i++) source[i] = src;
+}
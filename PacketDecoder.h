@@ -0,0 +1,59 @@
+#ifndef PACKETDECODER_H
+#define PACKETDECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Размер кадра датчика/репитера
+static const size_t PACKET_SIZE = 26;
+
+static const uint8_t PACKET_TYPE_SENSOR = 0xF0;
+static const uint8_t PACKET_TYPE_REPEATER = 0xF1;
+
+// Поля одного кадра
+struct DecodedPacket {
+    uint32_t id;
+    uint8_t type;
+    float pressure_bar;
+    int temperature_c;
+    float voltage_v;
+    int fw_version;
+    int rssi;
+};
+
+// Разбор одного кадра; используется потоком чтения порта (Enod)
+void decode_packet(const uint8_t* p, DecodedPacket& out);
+
+// Декодированные кадры по столбцам (SoA). Каждое поле - отдельный
+// непрерывный массив, поэтому пакетный разбор идет по столбцу за раз,
+// а столбцы без копирования уходят в экспорт и фильтры.
+struct PacketColumns {
+    static const uint16_t NO_SOURCE = 0xFFFF;
+
+    std::vector<int64_t> time_ms;
+    std::vector<uint32_t> id;
+    std::vector<uint8_t> type;          // 0 - неизвестен (точки истории)
+    std::vector<uint8_t> fw_version;
+    std::vector<float> pressure_bar;
+    std::vector<int16_t> temperature_c;
+    std::vector<float> voltage_v;
+    std::vector<int16_t> rssi;
+    std::vector<uint16_t> source;       // индекс в sources или NO_SOURCE
+    std::vector<std::string> sources;   // имена источников (портов, файлов)
+
+    size_t size() const { return id.size(); }
+    void reserve(size_t n);
+    // Очищает строки; словарь источников сохраняется
+    void clear();
+    void resize(size_t n);
+    uint16_t source_index(const std::string& name);
+};
+
+// Пакетный разбор count кадров, идущих с шагом stride байт, в конец out.
+// times - время приема каждого кадра (может быть nullptr).
+void decode_packets(const uint8_t* frames, size_t stride, size_t count,
+                    const int64_t* times, uint16_t source, PacketColumns& out);
+
+#endif
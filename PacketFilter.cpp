@@ -0,0 +1,600 @@
+#include "PacketFilter.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// Литералы ограничены, чтобы c - 1 и c + 1 не переполнялись
+static const int64_t LITERAL_LIMIT = 1ll << 53;
+
+// ---------------------------------------------------------------------------
+// Разбор выражения
+
+class PacketFilter::Parser {
+public:
+    Parser(const std::string& text, std::vector<Op>& out) : text(text), out(out), pos(0) {
+        next();
+    }
+
+    bool parse(std::string* error) {
+        if (!parse_or()) {
+            if (error) *error = message;
+            return false;
+        }
+        if (token.kind != TOK_END) {
+            fail("лишний текст");
+            if (error) *error = message;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    enum TokenKind {
+        TOK_END,
+        TOK_IDENT,
+        TOK_NUMBER,
+        TOK_COMPARE,
+        TOK_AND,
+        TOK_OR,
+        TOK_NOT,
+        TOK_LPAREN,
+        TOK_RPAREN,
+        TOK_LBRACE,
+        TOK_RBRACE,
+        TOK_COMMA,
+        TOK_RANGE,
+        TOK_ERROR
+    };
+
+    struct Token {
+        TokenKind kind;
+        size_t pos;
+        std::string text;
+        bool is_float;
+        int64_t int_value;
+        double float_value;
+        Compare cmp;
+    };
+
+    bool fail(const std::string& what) {
+        if (message.empty()) {
+            message = "позиция " + std::to_string(token.pos + 1) + ": " +
+                      (token.kind == TOK_ERROR ? std::string("недопустимый символ или число") : what);
+        }
+        return false;
+    }
+
+    void next() {
+        while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+        token = Token();
+        token.pos = pos;
+        if (pos >= text.size()) {
+            token.kind = TOK_END;
+            return;
+        }
+
+        char c = text[pos];
+        char c2 = pos + 1 < text.size() ? text[pos + 1] : '\0';
+
+        if (isalpha((unsigned char)c) || c == '_') {
+            size_t start = pos;
+            while (pos < text.size() && (isalnum((unsigned char)text[pos]) || text[pos] == '_')) pos++;
+            token.text = text.substr(start, pos - start);
+            std::transform(token.text.begin(), token.text.end(), token.text.begin(),
+                           [](unsigned char ch) { return (char)tolower(ch); });
+            if (token.text == "and") token.kind = TOK_AND;
+            else if (token.text == "or") token.kind = TOK_OR;
+            else if (token.text == "not") token.kind = TOK_NOT;
+            else token.kind = TOK_IDENT;
+            return;
+        }
+
+        if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)c2)) ||
+            (c == '-' && (isdigit((unsigned char)c2) || c2 == '.'))) {
+            lex_number();
+            return;
+        }
+
+        pos += 2;
+        if (c == '=' && c2 == '=') { token.kind = TOK_COMPARE; token.cmp = CMP_EQ; return; }
+        if (c == '!' && c2 == '=') { token.kind = TOK_COMPARE; token.cmp = CMP_NE; return; }
+        if (c == '<' && c2 == '=') { token.kind = TOK_COMPARE; token.cmp = CMP_LE; return; }
+        if (c == '>' && c2 == '=') { token.kind = TOK_COMPARE; token.cmp = CMP_GE; return; }
+        if (c == '&' && c2 == '&') { token.kind = TOK_AND; return; }
+        if (c == '|' && c2 == '|') { token.kind = TOK_OR; return; }
+        if (c == '.' && c2 == '.') { token.kind = TOK_RANGE; return; }
+        pos--;
+        switch (c) {
+            case '<': token.kind = TOK_COMPARE; token.cmp = CMP_LT; return;
+            case '>': token.kind = TOK_COMPARE; token.cmp = CMP_GT; return;
+            case '=': token.kind = TOK_COMPARE; token.cmp = CMP_EQ; return;
+            case '!': token.kind = TOK_NOT; return;
+            case '(': token.kind = TOK_LPAREN; return;
+            case ')': token.kind = TOK_RPAREN; return;
+            case '{': token.kind = TOK_LBRACE; return;
+            case '}': token.kind = TOK_RBRACE; return;
+            case ',': token.kind = TOK_COMMA; return;
+        }
+        token.kind = TOK_ERROR;
+    }
+
+    void lex_number() {
+        size_t start = pos;
+        bool negative = text[pos] == '-';
+        if (negative) pos++;
+
+        token.kind = TOK_NUMBER;
+        if (text[pos] == '0' && pos + 1 < text.size() && (text[pos + 1] == 'x' || text[pos + 1] == 'X')) {
+            pos += 2;
+            size_t digits = pos;
+            while (pos < text.size() && isxdigit((unsigned char)text[pos])) pos++;
+            if (pos == digits || pos - digits > 13) {
+                token.kind = TOK_ERROR;
+                return;
+            }
+            int64_t v = (int64_t)strtoull(text.substr(digits, pos - digits).c_str(), nullptr, 16);
+            token.int_value = negative ? -v : v;
+            token.float_value = (double)token.int_value;
+            return;
+        }
+
+        while (pos < text.size() && isdigit((unsigned char)text[pos])) pos++;
+        // Точка - часть числа, только если за ней цифра: "1..5" - диапазон
+        if (pos + 1 < text.size() && text[pos] == '.' && isdigit((unsigned char)text[pos + 1])) {
+            token.is_float = true;
+            pos++;
+            while (pos < text.size() && isdigit((unsigned char)text[pos])) pos++;
+        }
+        std::string literal = text.substr(start, pos - start);
+        token.float_value = strtod(literal.c_str(), nullptr);
+        if (!token.is_float) {
+            if (literal.size() > 17) {
+                token.kind = TOK_ERROR;
+                return;
+            }
+            token.int_value = strtoll(literal.c_str(), nullptr, 10);
+        }
+    }
+
+    // or := and ('||' and)*
+    bool parse_or() {
+        if (!parse_and()) return false;
+        while (token.kind == TOK_OR) {
+            next();
+            if (!parse_and()) return false;
+            emit_logic(Op::OR);
+        }
+        return true;
+    }
+
+    // and := unary ('&&' unary)*
+    bool parse_and() {
+        if (!parse_unary()) return false;
+        while (token.kind == TOK_AND) {
+            next();
+            if (!parse_unary()) return false;
+            emit_logic(Op::AND);
+        }
+        return true;
+    }
+
+    // unary := '!' unary | '(' or ')' | comparison
+    bool parse_unary() {
+        if (token.kind == TOK_NOT) {
+            next();
+            if (!parse_unary()) return false;
+            emit_logic(Op::NOT);
+            return true;
+        }
+        if (token.kind == TOK_LPAREN) {
+            next();
+            if (!parse_or()) return false;
+            if (token.kind != TOK_RPAREN) return fail("ожидалась ')'");
+            next();
+            return true;
+        }
+        return parse_comparison();
+    }
+
+    // comparison := field cmp value | field 'in' value '..' value | field 'in' '{' value (',' value)* '}'
+    bool parse_comparison() {
+        if (token.kind != TOK_IDENT) {
+            return fail(token.kind == TOK_END ? "выражение оборвано" : "ожидалось имя поля");
+        }
+        Field field;
+        const std::string& name = token.text;
+        if (name == "id") field = FIELD_ID;
+        else if (name == "type") field = FIELD_TYPE;
+        else if (name == "fw" || name == "version") field = FIELD_FW_VERSION;
+        else if (name == "pressure") field = FIELD_PRESSURE;
+        else if (name == "temperature" || name == "temp") field = FIELD_TEMPERATURE;
+        else if (name == "voltage") field = FIELD_VOLTAGE;
+        else if (name == "rssi") field = FIELD_RSSI;
+        else return fail("неизвестное поле '" + name + "'");
+        next();
+
+        if (token.kind == TOK_IDENT && token.text == "in") {
+            next();
+            if (token.kind == TOK_LBRACE) {
+                next();
+                for (bool first = true;; first = false) {
+                    Value v;
+                    if (!parse_value(field, v)) return false;
+                    emit_range(field, v, v, false);
+                    if (!first) emit_logic(Op::OR);
+                    if (token.kind == TOK_RBRACE) break;
+                    if (token.kind != TOK_COMMA) return fail("ожидалась ',' или '}'");
+                    next();
+                }
+                next();
+                return true;
+            }
+            Value lo, hi;
+            if (!parse_value(field, lo)) return false;
+            if (token.kind != TOK_RANGE) return fail("ожидалось '..' или '{'");
+            next();
+            if (!parse_value(field, hi)) return false;
+            emit_range(field, lo, hi, false);
+            return true;
+        }
+
+        if (token.kind != TOK_COMPARE) return fail("ожидалось сравнение");
+        Compare cmp = token.cmp;
+        next();
+        Value v;
+        if (!parse_value(field, v)) return false;
+        emit_compare(field, cmp, v);
+        return true;
+    }
+
+    struct Value {
+        int64_t i;
+        double f;
+    };
+
+    static bool is_float_field(Field field) {
+        return field == FIELD_PRESSURE || field == FIELD_VOLTAGE;
+    }
+
+    bool parse_value(Field field, Value& v) {
+        if (token.kind == TOK_IDENT) {
+            if (field != FIELD_TYPE) return fail("имя '" + token.text + "' допустимо только для type");
+            if (token.text == "sensor") v.i = PACKET_TYPE_SENSOR;
+            else if (token.text == "repeater") v.i = PACKET_TYPE_REPEATER;
+            else return fail("неизвестный тип '" + token.text + "' (sensor, repeater)");
+            v.f = (double)v.i;
+            next();
+            return true;
+        }
+        if (token.kind != TOK_NUMBER) return fail("ожидалось значение");
+        if (!is_float_field(field)) {
+            if (token.is_float) return fail("поле целое, дробное значение недопустимо");
+            if (token.int_value > LITERAL_LIMIT || token.int_value < -LITERAL_LIMIT) {
+                return fail("слишком большое значение");
+            }
+        }
+        v.i = token.int_value;
+        v.f = token.float_value;
+        next();
+        return true;
+    }
+
+    static void domain(Field field, int64_t& lo, int64_t& hi) {
+        switch (field) {
+            case FIELD_ID: lo = 0; hi = UINT32_MAX; return;
+            case FIELD_TYPE:
+            case FIELD_FW_VERSION: lo = 0; hi = UINT8_MAX; return;
+            default: lo = INT16_MIN; hi = INT16_MAX; return;
+        }
+    }
+
+    void emit_constant(bool value) {
+        Op op = Op();
+        op.code = Op::CONSTANT;
+        op.value = value ? 1.0f : 0.0f;
+        out.push_back(op);
+    }
+
+    void emit_range(Field field, const Value& lo, const Value& hi, bool negate) {
+        if (is_float_field(field)) {
+            Op op = Op();
+            op.code = Op::FLOAT_RANGE;
+            op.field = field;
+            op.value = (float)lo.f;
+            op.high = (float)hi.f;
+            out.push_back(op);
+        } else {
+            // Диапазон обрезается по области значений столбца; пустой или
+            // полный диапазон сворачивается в константу
+            int64_t dmin, dmax;
+            domain(field, dmin, dmax);
+            int64_t a = std::max(lo.i, dmin);
+            int64_t b = std::min(hi.i, dmax);
+            if (a > b) {
+                emit_constant(negate);
+                return;
+            }
+            if (a == dmin && b == dmax) {
+                emit_constant(!negate);
+                return;
+            }
+            Op op = Op();
+            op.code = Op::INT_RANGE;
+            op.field = field;
+            op.lo = a;
+            op.hi = b;
+            out.push_back(op);
+        }
+        if (negate) {
+            emit_logic(Op::NOT);
+        }
+    }
+
+    void emit_compare(Field field, Compare cmp, const Value& v) {
+        if (is_float_field(field)) {
+            Op op = Op();
+            op.code = Op::FLOAT_COMPARE;
+            op.field = field;
+            op.cmp = cmp;
+            op.value = (float)v.f;
+            out.push_back(op);
+            return;
+        }
+
+        Value lo = v, hi = v;
+        lo.i = hi.i = v.i;
+        switch (cmp) {
+            case CMP_EQ: emit_range(field, lo, hi, false); return;
+            case CMP_NE: emit_range(field, lo, hi, true); return;
+            case CMP_LT: lo.i = -LITERAL_LIMIT - 1; hi.i = v.i - 1; break;
+            case CMP_LE: lo.i = -LITERAL_LIMIT - 1; break;
+            case CMP_GT: lo.i = v.i + 1; hi.i = LITERAL_LIMIT + 1; break;
+            case CMP_GE: hi.i = LITERAL_LIMIT + 1; break;
+        }
+        emit_range(field, lo, hi, false);
+    }
+
+    void emit_logic(Op::Code code) {
+        Op op = Op();
+        op.code = code;
+        out.push_back(op);
+    }
+
+    const std::string& text;
+    std::vector<Op>& out;
+    size_t pos;
+    Token token;
+    std::string message;
+};
+
+// ---------------------------------------------------------------------------
+// Выполнение
+
+PacketFilter::PacketFilter() : max_depth(0) {
+}
+
+bool PacketFilter::compile(const std::string& text, std::string* error) {
+    std::vector<Op> compiled;
+    bool blank = std::all_of(text.begin(), text.end(), [](unsigned char c) { return isspace(c) != 0; });
+    if (!blank) {
+        Parser parser(text, compiled);
+        if (!parser.parse(error)) {
+            return false;
+        }
+    }
+
+    // Глубина стека масок
+    size_t depth = 0, deepest = 0;
+    for (const Op& op : compiled) {
+        if (op.code == Op::AND || op.code == Op::OR) depth--;
+        else if (op.code != Op::NOT) depth++;
+        deepest = std::max(deepest, depth);
+    }
+    if (deepest > MAX_DEPTH) {
+        if (error) *error = "выражение вложено глубже " + std::to_string(MAX_DEPTH) + " уровней";
+        return false;
+    }
+
+    program.swap(compiled);
+    max_depth = deepest;
+    source_text = text;
+    return true;
+}
+
+// Команды работают над блоком ровно из BLOCK_ROWS строк: при известном
+// числе итераций компилятор векторизует циклы без хвостов и проверок
+// (в том числе при -O2). Неполный последний блок дополняется копией.
+// __restrict: запись в uint8_t иначе может перекрывать столбец.
+static const size_t N = PacketFilter::BLOCK_ROWS;
+
+static void int_range(const uint32_t* __restrict col, int64_t lo, int64_t hi, uint8_t* __restrict out) {
+    // lo <= x <= hi  <=>  (x - lo) <= (hi - lo) в беззнаковой арифметике
+    uint32_t base = (uint32_t)lo;
+    uint32_t width = (uint32_t)(hi - lo);
+    for (size_t i = 0; i < N; i++) {
+        out[i] = (uint8_t)((uint32_t)(col[i] - base) <= width);
+    }
+}
+
+template<class T>
+static void small_int_range(const T* __restrict col, int64_t lo, int64_t hi, uint8_t* __restrict out) {
+    int32_t base = (int32_t)lo;
+    uint32_t width = (uint32_t)(hi - lo);
+    for (size_t i = 0; i < N; i++) {
+        out[i] = (uint8_t)((uint32_t)((int32_t)col[i] - base) <= width);
+    }
+}
+
+static void float_compare(const float* __restrict col, int cmp, float v, uint8_t* __restrict out) {
+    switch (cmp) {
+        case 0: for (size_t i = 0; i < N; i++) out[i] = (uint8_t)(col[i] == v); break;
+        case 1: for (size_t i = 0; i < N; i++) out[i] = (uint8_t)(col[i] != v); break;
+        case 2: for (size_t i = 0; i < N; i++) out[i] = (uint8_t)(col[i] < v); break;
+        case 3: for (size_t i = 0; i < N; i++) out[i] = (uint8_t)(col[i] <= v); break;
+        case 4: for (size_t i = 0; i < N; i++) out[i] = (uint8_t)(col[i] > v); break;
+        default: for (size_t i = 0; i < N; i++) out[i] = (uint8_t)(col[i] >= v); break;
+    }
+}
+
+static void float_range(const float* __restrict col, float lo, float hi, uint8_t* __restrict out) {
+    for (size_t i = 0; i < N; i++) {
+        out[i] = (uint8_t)((col[i] >= lo) & (col[i] <= hi));
+    }
+}
+
+static void mask_not(uint8_t* m) {
+    for (size_t i = 0; i < N; i++) m[i] ^= 1;
+}
+
+static void mask_and(uint8_t* __restrict a, const uint8_t* __restrict b) {
+    for (size_t i = 0; i < N; i++) a[i] &= b[i];
+}
+
+static void mask_or(uint8_t* __restrict a, const uint8_t* __restrict b) {
+    for (size_t i = 0; i < N; i++) a[i] |= b[i];
+}
+
+static size_t mask_count(const uint8_t* m, size_t n) {
+    // Блок не длиннее BLOCK_ROWS: 32-битного счетчика хватает
+    uint32_t count = 0;
+    for (size_t i = 0; i < n; i++) count += m[i];
+    return count;
+}
+
+const uint8_t* PacketFilter::run_block(const PacketColumns& c, size_t first, std::vector<uint8_t>& stack) const {
+    size_t sp = 0;
+    for (const Op& op : program) {
+        uint8_t* top = stack.data() + sp * N;
+        uint8_t* below = top - N;
+        switch (op.code) {
+            case Op::INT_RANGE:
+                switch (op.field) {
+                    case FIELD_ID: int_range(c.id.data() + first, op.lo, op.hi, top); break;
+                    case FIELD_TYPE: small_int_range(c.type.data() + first, op.lo, op.hi, top); break;
+                    case FIELD_FW_VERSION: small_int_range(c.fw_version.data() + first, op.lo, op.hi, top); break;
+                    case FIELD_TEMPERATURE: small_int_range(c.temperature_c.data() + first, op.lo, op.hi, top); break;
+                    default: small_int_range(c.rssi.data() + first, op.lo, op.hi, top); break;
+                }
+                sp++;
+                break;
+            case Op::FLOAT_COMPARE:
+                float_compare((op.field == FIELD_PRESSURE ? c.pressure_bar.data() : c.voltage_v.data()) + first,
+                              op.cmp, op.value, top);
+                sp++;
+                break;
+            case Op::FLOAT_RANGE:
+                float_range((op.field == FIELD_PRESSURE ? c.pressure_bar.data() : c.voltage_v.data()) + first,
+                            op.value, op.high, top);
+                sp++;
+                break;
+            case Op::CONSTANT:
+                memset(top, op.value != 0.0f ? 1 : 0, N);
+                sp++;
+                break;
+            case Op::NOT:
+                mask_not(below);
+                break;
+            case Op::AND:
+                mask_and(below - N, below);
+                sp--;
+                break;
+            case Op::OR:
+                mask_or(below - N, below);
+                sp--;
+                break;
+        }
+    }
+    return stack.data();
+}
+
+size_t PacketFilter::evaluate(const PacketColumns& columns, size_t first, size_t count, uint8_t* mask) const {
+    if (program.empty()) {
+        memset(mask, 1, count);
+        return count;
+    }
+
+    std::vector<uint8_t> stack(max_depth * N);
+    size_t selected = 0;
+    size_t done = 0;
+    for (; done + N <= count; done += N) {
+        memcpy(mask + done, run_block(columns, first + done, stack), N);
+        selected += mask_count(mask + done, N);
+    }
+
+    size_t rest = count - done;
+    if (rest) {
+        PacketColumns tail;
+        tail.resize(N);
+        size_t from = first + done;
+        std::copy_n(columns.id.begin() + from, rest, tail.id.begin());
+        std::copy_n(columns.type.begin() + from, rest, tail.type.begin());
+        std::copy_n(columns.fw_version.begin() + from, rest, tail.fw_version.begin());
+        std::copy_n(columns.pressure_bar.begin() + from, rest, tail.pressure_bar.begin());
+        std::copy_n(columns.temperature_c.begin() + from, rest, tail.temperature_c.begin());
+        std::copy_n(columns.voltage_v.begin() + from, rest, tail.voltage_v.begin());
+        std::copy_n(columns.rssi.begin() + from, rest, tail.rssi.begin());
+        memcpy(mask + done, run_block(tail, 0, stack), rest);
+        selected += mask_count(mask + done, rest);
+    }
+    return selected;
+}
+
+bool PacketFilter::matches(const DecodedPacket& p) const {
+    if (program.empty()) {
+        return true;
+    }
+
+    uint8_t stack[MAX_DEPTH];
+    size_t sp = 0;
+    for (const Op& op : program) {
+        switch (op.code) {
+            case Op::INT_RANGE: {
+                int64_t v;
+                switch (op.field) {
+                    case FIELD_ID: v = p.id; break;
+                    case FIELD_TYPE: v = p.type; break;
+                    case FIELD_FW_VERSION: v = (uint8_t)p.fw_version; break;
+                    case FIELD_TEMPERATURE: v = (int16_t)p.temperature_c; break;
+                    default: v = (int16_t)p.rssi; break;
+                }
+                stack[sp++] = v >= op.lo && v <= op.hi;
+                break;
+            }
+            case Op::FLOAT_COMPARE:
+            case Op::FLOAT_RANGE: {
+                float v = op.field == FIELD_PRESSURE ? p.pressure_bar : p.voltage_v;
+                bool r;
+                if (op.code == Op::FLOAT_RANGE) {
+                    r = v >= op.value && v <= op.high;
+                } else {
+                    switch (op.cmp) {
+                        case CMP_EQ: r = v == op.value; break;
+                        case CMP_NE: r = v != op.value; break;
+                        case CMP_LT: r = v < op.value; break;
+                        case CMP_LE: r = v <= op.value; break;
+                        case CMP_GT: r = v > op.value; break;
+                        default: r = v >= op.value; break;
+                    }
+                }
+                stack[sp++] = r;
+                break;
+            }
+            case Op::CONSTANT:
+                stack[sp++] = op.value != 0.0f;
+                break;
+            case Op::NOT:
+                stack[sp - 1] ^= 1;
+                break;
+            case Op::AND:
+                sp--;
+                stack[sp - 1] &= stack[sp];
+                break;
+            case Op::OR:
+                sp--;
+                stack[sp - 1] |= stack[sp];
+                break;
+        }
+    }
+    return stack[0] != 0;
+}
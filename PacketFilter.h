@@ -0,0 +1,96 @@
+#ifndef PACKETFILTER_H
+#define PACKETFILTER_H
+
+#include "PacketDecoder.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Фильтр пакетов по выражению, например
+//   type==sensor && rssi>-80 && pressure<2.0 && id in 0x1A00..0x1AFF
+//
+// Поля: id, type (sensor, repeater или число), fw (version), pressure,
+// temperature (temp), voltage, rssi. Операции: == != < <= > >=,
+// "in a..b" (диапазон, границы включены), "in {a, b, c}" (список),
+// && (and), || (or), ! (not), скобки.
+//
+// Выражение разбирается и проверяется по типам один раз в compile() и
+// превращается в короткую программу. Сравнения целых полей сводятся к
+// проверке диапазона (одно беззнаковое сравнение на строку), константы
+// вне диапазона поля сворачиваются в true/false. evaluate() выполняет
+// программу над столбцами PacketColumns блоками по BLOCK_ROWS строк:
+// каждая команда - простой цикл по столбцу без ветвлений, который
+// компилятор векторизует, поэтому отбор из миллионов строк занимает
+// миллисекунды. Скомпилированный фильтр неизменяем, и один объект
+// можно одновременно использовать из разных потоков.
+class PacketFilter {
+public:
+    static const size_t BLOCK_ROWS = 1024;
+    // Предел глубины стека выражения; глубже вложенные фильтры не
+    // компилируются, а matches() обходится стеком на стеке потока
+    static const size_t MAX_DEPTH = 64;
+
+    PacketFilter();
+
+    // Пустой текст - фильтр пропускает все. При ошибке фильтр не меняется.
+    bool compile(const std::string& text, std::string* error);
+
+    bool empty() const { return program.empty(); }
+    const std::string& text() const { return source_text; }
+
+    // mask[i] = 1, если строка first + i подходит; возвращает число подходящих
+    size_t evaluate(const PacketColumns& columns, size_t first, size_t count, uint8_t* mask) const;
+    // Один пакет
+    bool matches(const DecodedPacket& p) const;
+
+private:
+    enum Field {
+        FIELD_ID = 0,
+        FIELD_TYPE,
+        FIELD_FW_VERSION,
+        FIELD_PRESSURE,
+        FIELD_TEMPERATURE,
+        FIELD_VOLTAGE,
+        FIELD_RSSI
+    };
+
+    enum Compare {
+        CMP_EQ = 0,
+        CMP_NE,
+        CMP_LT,
+        CMP_LE,
+        CMP_GT,
+        CMP_GE
+    };
+
+    struct Op {
+        enum Code {
+            INT_RANGE,      // lo <= поле <= hi (целые поля)
+            FLOAT_COMPARE,  // поле <cmp> value (поля с плавающей точкой)
+            FLOAT_RANGE,    // value <= поле <= high
+            CONSTANT,       // value != 0
+            NOT,
+            AND,
+            OR
+        } code;
+        Field field;
+        Compare cmp;
+        int64_t lo;
+        int64_t hi;
+        float value;
+        float high;
+    };
+
+    class Parser;
+
+    // Выполняет программу над строками [first, first + BLOCK_ROWS);
+    // результат - в начале stack
+    const uint8_t* run_block(const PacketColumns& columns, size_t first, std::vector<uint8_t>& stack) const;
+
+    std::vector<Op> program;    // обратная польская запись
+    size_t max_depth;
+    std::string source_text;
+};
+
+#endif
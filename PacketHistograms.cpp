@@ -0,0 +1,132 @@
+#include "PacketHistograms.h"
+
+PacketHistograms::PacketHistograms()
+    : index(MAX_DEVICES), port_last_arrival_us(0) {
+    for (uint32_t i = 0; i < MAX_CHUNKS; i++) {
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+PacketHistograms::~PacketHistograms() {
+    for (uint32_t i = 0; i < MAX_CHUNKS; i++) {
+        delete[] chunks[i].load(std::memory_order_relaxed);
+    }
+}
+
+DeviceHistograms* PacketHistograms::slot(uint32_t n) const {
+    DeviceHistograms* chunk = chunks[n / CHUNK_SIZE].load(std::memory_order_acquire);
+    return chunk ? &chunk[n % CHUNK_SIZE] : nullptr;
+}
+
+uint64_t PacketHistograms::rssi_value(int rssi) {
+    // RSSI отрицательный: храним модуль, положительные значения прижимаем к 0
+    if (rssi >= 0) return 0;
+    return (uint64_t)(-rssi);
+}
+
+void PacketHistograms::record_port(uint64_t now_us, int rssi) {
+    uint64_t port_last = port_last_arrival_us.load(std::memory_order_relaxed);
+    if (port_last != 0 && now_us >= port_last) {
+        port_interval.record(now_us - port_last);
+    }
+    port_last_arrival_us.store(now_us, std::memory_order_relaxed);
+    port_rssi.record(rssi_value(rssi));
+}
+
+void PacketHistograms::record_device(uint32_t id, uint64_t now_us, int rssi) {
+    uint32_t n = index.find_or_insert(id);
+    if (n == DeviceIndex::NOT_FOUND) {
+        return;
+    }
+
+    uint32_t c = n / CHUNK_SIZE;
+    DeviceHistograms* chunk = chunks[c].load(std::memory_order_acquire);
+    if (!chunk) {
+        // Читатели уже могут найти слот через индекс, но до публикации
+        // блока slot() для них вернет nullptr. Блок может одновременно
+        // выделить другой сегмент: остается тот, что опубликован первым.
+        DeviceHistograms* fresh = new DeviceHistograms[CHUNK_SIZE];
+        for (uint32_t i = 0; i < CHUNK_SIZE; i++) {
+            fresh[i].last_arrival_us.store(0, std::memory_order_relaxed);
+        }
+        if (chunks[c].compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) {
+            chunk = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+
+    DeviceHistograms& h = chunk[n % CHUNK_SIZE];
+    uint64_t last = h.last_arrival_us.load(std::memory_order_relaxed);
+    if (last != 0 && now_us >= last) {
+        h.interval.record(now_us - last);
+    }
+    h.last_arrival_us.store(now_us, std::memory_order_relaxed);
+    h.rssi.record(rssi_value(rssi));
+}
+
+bool PacketHistograms::device_counts(uint32_t id, IntervalHistogram::Counts* interval,
+                                     RssiHistogram::Counts* rssi) const {
+    uint32_t n = index.find(id);
+    if (n == DeviceIndex::NOT_FOUND) {
+        return false;
+    }
+
+    const DeviceHistograms* h = slot(n);
+    if (!h) {
+        return false;
+    }
+
+    if (interval) {
+        interval->reset();
+        h->interval.add_to(*interval);
+    }
+    if (rssi) {
+        rssi->reset();
+        h->rssi.add_to(*rssi);
+    }
+    return true;
+}
+
+void PacketHistograms::port_counts(IntervalHistogram::Counts* interval, RssiHistogram::Counts* rssi) const {
+    if (interval) {
+        interval->reset();
+        port_interval.add_to(*interval);
+    }
+    if (rssi) {
+        rssi->reset();
+        port_rssi.add_to(*rssi);
+    }
+}
+
+void PacketHistograms::merge_devices(IntervalHistogram::Counts* interval, RssiHistogram::Counts* rssi) const {
+    if (interval) interval->reset();
+    if (rssi) rssi->reset();
+
+    uint32_t count = index.size();
+    for (uint32_t n = 0; n < count; n++) {
+        const DeviceHistograms* h = slot(n);
+        if (!h) {
+            continue;
+        }
+        if (interval) h->interval.add_to(*interval);
+        if (rssi) h->rssi.add_to(*rssi);
+    }
+}
+
+void PacketHistograms::clear() {
+    port_interval.reset();
+    port_rssi.reset();
+    port_last_arrival_us.store(0, std::memory_order_relaxed);
+
+    uint32_t count = index.size();
+    for (uint32_t n = 0; n < count; n++) {
+        DeviceHistograms* h = slot(n);
+        if (!h) {
+            continue;
+        }
+        h->interval.reset();
+        h->rssi.reset();
+        h->last_arrival_us.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,182 @@
+#ifndef PACKETHISTOGRAMS_H
+#define PACKETHISTOGRAMS_H
+
+#include "DeviceIndex.h"
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Число старших и младших нулевых битов; v != 0
+inline unsigned clz64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_clzll(v);
+#else
+    unsigned n = 0;
+    while (!(v & (1ull << 63))) { v <<= 1; n++; }
+    return n;
+#endif
+}
+
+inline unsigned ctz64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(v);
+#else
+    unsigned n = 0;
+    while (!(v & 1)) { v >>= 1; n++; }
+    return n;
+#endif
+}
+
+// Гистограмма с логарифмическими корзинами (в духе HDR Histogram).
+// Значения до 2^SUB_BITS хранятся точно, дальше каждая октава делится на
+// 2^(SUB_BITS-1) корзин, т.е. относительная погрешность ~2^(1-SUB_BITS).
+// Память фиксирована: BUCKETS счетчиков.
+// Пишет один поток (поток чтения), читать можно из любого потока без
+// блокировок: счетчики атомарные, запись не ждет читателей.
+template<unsigned VALUE_BITS, unsigned SUB_BITS>
+class LogHistogram {
+public:
+    static const unsigned HALF = 1u << (SUB_BITS - 1);
+    static const unsigned BUCKETS = (VALUE_BITS - SUB_BITS + 2) * HALF;
+    static const uint64_t MAX_VALUE = (VALUE_BITS >= 64) ? UINT64_MAX : ((1ull << VALUE_BITS) - 1);
+
+    // Обычная (неатомарная) копия счетчиков для запросов и объединения
+    struct Counts {
+        uint64_t total;
+        uint64_t buckets[BUCKETS];
+
+        Counts() { reset(); }
+
+        void reset() {
+            total = 0;
+            memset(buckets, 0, sizeof(buckets));
+        }
+
+        void merge(const Counts& other) {
+            total += other.total;
+            for (unsigned i = 0; i < BUCKETS; i++) {
+                buckets[i] += other.buckets[i];
+            }
+        }
+
+        // p в диапазоне [0, 100]; возвращает середину найденной корзины
+        uint64_t value_at_percentile(double p) const {
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t rank = (uint64_t)(p / 100.0 * (double)total + 0.5);
+            if (rank < 1) rank = 1;
+            if (rank > total) rank = total;
+
+            uint64_t seen = 0;
+            for (unsigned i = 0; i < BUCKETS; i++) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    return bucket_low(i) + bucket_width(i) / 2;
+                }
+            }
+            return MAX_VALUE;
+        }
+    };
+
+    LogHistogram() { reset(); }
+
+    void record(uint64_t value) {
+        unsigned idx = bucket_index(value > MAX_VALUE ? MAX_VALUE : value);
+        // Писатель единственный, поэтому read-modify-write не нужен
+        buckets[idx].store(buckets[idx].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void add_to(Counts& out) const {
+        out.total += total.load(std::memory_order_acquire);
+        for (unsigned i = 0; i < BUCKETS; i++) {
+            out.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void reset() {
+        for (unsigned i = 0; i < BUCKETS; i++) {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+        total.store(0, std::memory_order_release);
+    }
+
+    static unsigned bucket_index(uint64_t v) {
+        unsigned msb = 63 - clz64(v | 1);
+        unsigned shift = msb > SUB_BITS - 1 ? msb - (SUB_BITS - 1) : 0;
+        return shift * HALF + (unsigned)(v >> shift);
+    }
+
+    static uint64_t bucket_low(unsigned idx) {
+        if (idx < 2 * HALF) {
+            return idx;
+        }
+        unsigned shift = idx / HALF - 1;
+        return (uint64_t)(idx - shift * HALF) << shift;
+    }
+
+    static uint64_t bucket_width(unsigned idx) {
+        return idx < 2 * HALF ? 1 : 1ull << (idx / HALF - 1);
+    }
+
+private:
+    std::atomic<uint32_t> buckets[BUCKETS];
+    std::atomic<uint64_t> total;
+};
+
+// Интервалы между пакетами в микросекундах (до ~19 часов, точность ~6%)
+typedef LogHistogram<36, 5> IntervalHistogram;
+// Модуль RSSI в дБм (точно до 128)
+typedef LogHistogram<8, 7> RssiHistogram;
+
+struct DeviceHistograms {
+    IntervalHistogram interval;
+    RssiHistogram rssi;
+    std::atomic<uint64_t> last_arrival_us;
+};
+
+// Гистограммы интервалов прихода и RSSI по устройствам и по порту
+// Устройства сверх MAX_DEVICES учитываются только в гистограммах порта.
+class PacketHistograms {
+public:
+    static const uint32_t MAX_DEVICES = MAX_TRACKED_DEVICES;
+
+    PacketHistograms();
+    ~PacketHistograms();
+
+    // Поток чтения: регистрирует пакет устройства id, пришедший в now_us
+    void record(uint32_t id, uint64_t now_us, int rssi) {
+        record_port(now_us, rssi);
+        record_device(id, now_us, rssi);
+    }
+    // То же по частям для DecodePipeline: уровень порта пишет один поток
+    // по порядку приема, уровень устройства - сегмент устройства (у
+    // каждого устройства по-прежнему один писатель)
+    void record_port(uint64_t now_us, int rssi);
+    void record_device(uint32_t id, uint64_t now_us, int rssi);
+
+    // Любой поток: копии счетчиков, без блокировок
+    bool device_counts(uint32_t id, IntervalHistogram::Counts* interval, RssiHistogram::Counts* rssi) const;
+    void port_counts(IntervalHistogram::Counts* interval, RssiHistogram::Counts* rssi) const;
+    void merge_devices(IntervalHistogram::Counts* interval, RssiHistogram::Counts* rssi) const;
+
+    // Обнуляет счетчики; соответствие ID -> слот сохраняется
+    void clear();
+
+private:
+    static const uint32_t CHUNK_SIZE = 256;
+    static const uint32_t MAX_CHUNKS = MAX_DEVICES / CHUNK_SIZE;
+
+    DeviceHistograms* slot(uint32_t index) const;
+    static uint64_t rssi_value(int rssi);
+
+    DeviceIndex index;
+    std::atomic<DeviceHistograms*> chunks[MAX_CHUNKS];
+
+    IntervalHistogram port_interval;
+    RssiHistogram port_rssi;
+    std::atomic<uint64_t> port_last_arrival_us;
+};
+
+#endif
@@ -0,0 +1,1115 @@
+// Сравнение путей чтения портов на нагрузке через псевдотерминалы.
+//
+// Для каждого порта создается пара pty: сторона устройства настроена как
+// в ComPortBase::setup_serial_port (raw, VMIN=0, VTIME=1), в другую
+// поток-передатчик пишет 26-байтные кадры с заданной частотой. В каждом
+// кадре - момент отправки по CLOCK_MONOTONIC, так что приемник считает
+// задержку доставки каждого кадра.
+//
+// Пути чтения:
+//   poll   - поток на порт, poll() + read(), как в Enod::read_until_lost
+//   uring  - один поток на все порты через UringReader (io_uring,
+//            зарегистрированные буферы, пачки завершений)
+//
+// Для каждого пути печатаются: принято/потеряно кадров, процессорное
+// время приема (весь процесс минус передатчик, включая рабочие потоки
+// ядра io_uring), системные вызовы на кадр и задержка p50/p99/max.
+//
+// --loopback raw|rfc2217 проверяет сетевой источник (SocketSource,
+// Rfc2217Source) на локальном заменителе сервера последовательных
+// портов: сервер в том же процессе отдает кадры со скоростью линии -b,
+// в режиме rfc2217 отвечает на согласование Telnet и удваивает 0xFF.
+// В кадрах есть байты 0xFF, приемник проверяет каждый кадр.
+// --serve ПОРТ запускает тот же заменитель отдельно, для подключения
+// из приложения.
+//
+// --pipeline N[,N...] проверяет конвейер разбора (DecodePipeline) с
+// N рабочими потоками; 0 - разбор и агрегаты в потоке чтения, как без
+// конвейера. Передатчик пишет в -p портов кадры датчиков (-d устройств
+// на порт, у каждого свой счетчик кадров), один поток читает все порты
+// и отдает кадры конвейеру. Агрегаты - настоящие: DeviceStats,
+// PacketHistograms, LossEstimator, LatestValues. Печатаются потери,
+// нарушения порядка кадров устройства, задержка от отправки до
+// агрегатов и пиковая пропускная способность: те же кадры из памяти,
+// по потоку-поставщику на порт, без ограничения частоты.
+//
+// Использование: PortBench [-p портов] [-r кадров/с на порт] [-t секунд] [--mode poll|uring|both]
+//                PortBench --loopback raw|rfc2217 [-b бод] [-t секунд] [--mode poll|uring|both]
+//                PortBench --serve ПОРТ [--rfc2217] [-b бод]
+//                PortBench --pipeline N[,N...] [-p портов] [-d устройств] [-r кадров/с] [-t секунд]
+
+#include "ByteSource.h"
+#include "UringReader.h"
+#include "DecodePipeline.h"
+#include "DeviceStats.h"
+#include "PacketHistograms.h"
+#include "LossEstimator.h"
+#include "LatestValues.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int FRAME_SIZE = 26;
+
+static int64_t mono_ns(clockid_t clock = CLOCK_MONOTONIC) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t process_cpu_ns() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ((int64_t)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000 +
+           ((int64_t)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+}
+
+struct PtyPair {
+    int master;
+    int device;
+};
+
+static bool open_pty(PtyPair& p, std::string* error) {
+    p.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (p.master < 0 || grantpt(p.master) != 0 || unlockpt(p.master) != 0) {
+        *error = std::string("posix_openpt: ") + strerror(errno);
+        return false;
+    }
+    p.device = open(ptsname(p.master), O_RDWR | O_NOCTTY);
+    if (p.device < 0) {
+        *error = std::string("open pty: ") + strerror(errno);
+        return false;
+    }
+
+    // Как у настоящего порта
+    struct termios tty;
+    tcgetattr(p.device, &tty);
+    cfmakeraw(&tty);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 1;
+    tcsetattr(p.device, TCSANOW, &tty);
+    tcgetattr(p.master, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(p.master, TCSANOW, &tty);
+    return true;
+}
+
+// Кадр сетевого теста: метка, затем чередование 0xFF и счетчика
+static void fill_frame(uint8_t* frame, int64_t stamp, uint64_t seq) {
+    memcpy(frame, &stamp, sizeof(stamp));
+    for (int i = 8; i < FRAME_SIZE; i++) {
+        frame[i] = (i & 1) ? 0xFF : (uint8_t)(seq + i);
+    }
+}
+
+static bool frame_ok(const uint8_t* frame) {
+    for (int i = 8; i < FRAME_SIZE; i++) {
+        uint8_t expected = (i & 1) ? 0xFF : (uint8_t)(frame[8] + (i - 8));
+        if (frame[i] != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Сборка кадров порта и задержки их доставки
+struct PortSink {
+    uint8_t frame[FRAME_SIZE];
+    int idx = 0;
+    uint64_t frames = 0;
+    uint64_t bad = 0;
+    bool verify = false;
+    std::vector<int32_t> latency_us;
+
+    void take(const uint8_t* data, int bytes) {
+        int64_t now = mono_ns();
+        for (int i = 0; i < bytes; i++) {
+            frame[idx++] = data[i];
+            if (idx == FRAME_SIZE) {
+                int64_t sent;
+                memcpy(&sent, frame, sizeof(sent));
+                latency_us.push_back((int32_t)((now - sent) / 1000));
+                frames++;
+                if (verify && !frame_ok(frame)) {
+                    bad++;
+                }
+                idx = 0;
+            }
+        }
+    }
+};
+
+struct RunResult {
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    int64_t cpu_ns = 0;
+    uint64_t syscalls = 0;
+    std::vector<int32_t> latency_us;
+};
+
+// Передатчик: раз в миллисекунду дописывает в каждый порт кадры,
+// которые к этому моменту положено отправить
+static void transmit(const std::vector<PtyPair>& ptys, double rate, double seconds,
+                     std::atomic<uint64_t>& sent, int64_t& cpu_ns) {
+    int64_t cpu_start = mono_ns(CLOCK_THREAD_CPUTIME_ID);
+    int64_t start = mono_ns();
+    int64_t end = start + (int64_t)(seconds * 1e9);
+    std::vector<uint64_t> done(ptys.size(), 0);
+    std::vector<uint8_t> batch;
+
+    for (int64_t now = start; now < end; now = mono_ns()) {
+        uint64_t due = (uint64_t)((double)(now - start) * rate / 1e9);
+        for (size_t p = 0; p < ptys.size(); p++) {
+            uint64_t n = due - done[p];
+            if (n == 0) {
+                continue;
+            }
+            batch.assign(n * FRAME_SIZE, 0x5A);
+            for (uint64_t f = 0; f < n; f++) {
+                memcpy(&batch[f * FRAME_SIZE], &now, sizeof(now));
+            }
+            size_t off = 0;
+            while (off < batch.size()) {
+                ssize_t w = write(ptys[p].master, batch.data() + off, batch.size() - off);
+                if (w <= 0) {
+                    break;
+                }
+                off += (size_t)w;
+            }
+            done[p] += off / FRAME_SIZE;
+            sent.fetch_add(off / FRAME_SIZE, std::memory_order_relaxed);
+        }
+        struct timespec tick = {0, 1000000};
+        nanosleep(&tick, nullptr);
+    }
+    cpu_ns = mono_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+}
+
+static void receive_poll(int fd, int wake, PortSink& sink, uint64_t& syscalls) {
+    uint8_t buf[4096];
+    struct pollfd fds[2];
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake;
+    fds[1].events = POLLIN;
+    for (;;) {
+        fds[0].revents = fds[1].revents = 0;
+        int r = poll(fds, 2, 1000);
+        syscalls++;
+        if (r < 0 && errno != EINTR) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            syscalls++;
+            if (n > 0) {
+                sink.take(buf, (int)n);
+            }
+        } else if (fds[1].revents) {
+            return;
+        }
+    }
+}
+
+static void receive_uring(UringReader& uring, std::vector<PortSink>& sinks, std::atomic<bool>& stop) {
+    auto handler = [&](int port, const uint8_t* data, int result) {
+        if (result > 0) {
+            sinks[port].take(data, result);
+        }
+        return result >= 0 || result == -EAGAIN || result == -EINTR;
+    };
+    while (!stop.load(std::memory_order_relaxed)) {
+        bool woken = false;
+        if (uring.wait(1000, handler, &woken) < 0 || woken) {
+            break;
+        }
+    }
+}
+
+static bool run(const char* mode, int ports, double rate, double seconds, RunResult& out) {
+    std::string error;
+    std::vector<PtyPair> ptys(ports);
+    for (int i = 0; i < ports; i++) {
+        if (!open_pty(ptys[i], &error)) {
+            fprintf(stderr, "PortBench: %s\n", error.c_str());
+            return false;
+        }
+    }
+    int wake = eventfd(0, EFD_CLOEXEC);
+    std::vector<PortSink> sinks(ports);
+    std::vector<uint64_t> syscalls(ports, 0);
+    std::atomic<bool> stop(false);
+    UringReader uring;
+    bool use_uring = strcmp(mode, "uring") == 0;
+
+    if (use_uring) {
+        if (!uring.open((unsigned)ports, 4096, &error)) {
+            fprintf(stderr, "PortBench: %s\n", error.c_str());
+            return false;
+        }
+        for (int i = 0; i < ports; i++) {
+            uring.add_port(ptys[i].device);
+        }
+        uring.set_wake_fd(wake);
+    }
+
+    int64_t cpu_start = process_cpu_ns();
+    std::vector<std::thread> readers;
+    if (use_uring) {
+        readers.emplace_back([&]() { receive_uring(uring, sinks, stop); });
+    } else {
+        for (int i = 0; i < ports; i++) {
+            readers.emplace_back([&, i]() { receive_poll(ptys[i].device, wake, sinks[i], syscalls[i]); });
+        }
+    }
+
+    std::atomic<uint64_t> sent(0);
+    int64_t transmit_cpu_ns = 0;
+    transmit(ptys, rate, seconds, sent, transmit_cpu_ns);
+
+    // Дочитываем хвост и останавливаем приемники
+    int64_t grace_end = mono_ns() + 500000000;
+    for (;;) {
+        uint64_t got = 0;
+        for (const PortSink& s : sinks) {
+            got += s.frames;
+        }
+        if (got >= sent.load() || mono_ns() > grace_end) {
+            break;
+        }
+        usleep(1000);
+    }
+    stop.store(true);
+    uint64_t one = 1;
+    if (write(wake, &one, sizeof(one)) < 0) {
+        perror("eventfd");
+    }
+    for (std::thread& t : readers) {
+        t.join();
+    }
+
+    out.cpu_ns = process_cpu_ns() - cpu_start - transmit_cpu_ns;
+    out.sent = sent.load();
+    out.syscalls = use_uring ? uring.enter_calls() : 0;
+    for (int i = 0; i < ports; i++) {
+        out.received += sinks[i].frames;
+        out.syscalls += syscalls[i];
+        out.latency_us.insert(out.latency_us.end(), sinks[i].latency_us.begin(), sinks[i].latency_us.end());
+    }
+
+    uring.close();
+    for (PtyPair& p : ptys) {
+        close(p.device);
+        close(p.master);
+    }
+    close(wake);
+    return true;
+}
+
+static void print_result(const char* mode, const RunResult& r) {
+    std::vector<int32_t> lat = r.latency_us;
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) {
+        return lat.empty() ? 0 : lat[std::min(lat.size() - 1, (size_t)(p / 100.0 * (double)lat.size()))];
+    };
+    double frames = r.received ? (double)r.received : 1.0;
+    printf("%-6s %10llu %8llu %9.1f %10.2f %10llu %9.3f %8d %8d %8d\n",
+           mode, (unsigned long long)r.received, (unsigned long long)(r.sent - std::min(r.sent, r.received)),
+           r.cpu_ns / 1e6, r.cpu_ns / 1e3 / frames,
+           (unsigned long long)r.syscalls, r.syscalls / frames,
+           pct(50), pct(99), lat.empty() ? 0 : lat.back());
+}
+
+// ---------------------------------------------------------------------------
+// Заменитель сервера последовательных портов
+
+static const uint8_t IAC = 255;
+
+struct StandIn {
+    bool rfc2217 = false;
+    uint32_t baud = 0;          // последняя SET-BAUDRATE от клиента
+    int state = 0;              // 0 - данные, 1 - после IAC, 2 - опция, 3 - SB, 4 - SB после IAC
+    uint8_t command = 0;
+    std::vector<uint8_t> sb;
+};
+
+static void standin_send(int fd, const uint8_t* data, size_t size) {
+    while (size) {
+        ssize_t w = send(fd, data, size, MSG_NOSIGNAL);
+        if (w <= 0) {
+            return;
+        }
+        data += w;
+        size -= (size_t)w;
+    }
+}
+
+// Команды клиента: на WILL/DO поддерживаемых опций - согласие, на
+// SB COM-PORT-OPTION - ответ с кодом + 100 и тем же значением
+static void standin_input(int fd, StandIn& st) {
+    uint8_t buf[512];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        for (ssize_t i = 0; i < n && st.rfc2217; i++) {
+            uint8_t b = buf[i];
+            switch (st.state) {
+            case 0:
+                st.state = b == IAC ? 1 : 0;
+                break;
+            case 1:
+                if (b >= 251) {
+                    st.command = b;
+                    st.state = 2;
+                } else if (b == 250) {
+                    st.sb.clear();
+                    st.state = 3;
+                } else {
+                    st.state = 0;
+                }
+                break;
+            case 2: {
+                bool supported = b == 0 || b == 3 || b == 44;
+                uint8_t reply[3] = {IAC, 0, b};
+                if (st.command == 251) {            // WILL
+                    reply[1] = supported ? 253 : 254;
+                    standin_send(fd, reply, 3);
+                } else if (st.command == 253) {     // DO
+                    reply[1] = supported && b != 44 ? 251 : 252;
+                    standin_send(fd, reply, 3);
+                }
+                st.state = 0;
+                break;
+            }
+            case 3:
+                if (b == IAC) {
+                    st.state = 4;
+                } else {
+                    st.sb.push_back(b);
+                }
+                break;
+            case 4:
+                if (b == IAC) {
+                    st.sb.push_back(b);
+                    st.state = 3;
+                    break;
+                }
+                if (b == 240 && st.sb.size() >= 2 && st.sb[0] == 44) {
+                    if (st.sb[1] == 1 && st.sb.size() >= 6) {
+                        st.baud = ((uint32_t)st.sb[2] << 24) | ((uint32_t)st.sb[3] << 16) |
+                                  ((uint32_t)st.sb[4] << 8) | st.sb[5];
+                    }
+                    std::vector<uint8_t> reply = {IAC, 250, 44, (uint8_t)(st.sb[1] + 100)};
+                    for (size_t k = 2; k < st.sb.size(); k++) {
+                        reply.push_back(st.sb[k]);
+                        if (st.sb[k] == IAC) {
+                            reply.push_back(IAC);
+                        }
+                    }
+                    reply.push_back(IAC);
+                    reply.push_back(240);
+                    standin_send(fd, reply.data(), reply.size());
+                }
+                st.state = 0;
+                break;
+            }
+        }
+    }
+}
+
+// Отдает кадры клиенту с частотой rate до конца времени или разрыва
+static void standin_serve(int fd, StandIn& st, double rate, double seconds,
+                          std::atomic<uint64_t>& sent, int64_t* cpu_ns) {
+    // Как у настоящих серверов: кадр уходит сразу, без Nagle
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    int64_t cpu_start = mono_ns(CLOCK_THREAD_CPUTIME_ID);
+    int64_t start = mono_ns();
+    int64_t end = seconds > 0 ? start + (int64_t)(seconds * 1e9) : INT64_MAX;
+    uint64_t done = 0;
+    std::vector<uint8_t> batch;
+    uint8_t frame[FRAME_SIZE];
+
+    for (int64_t now = start; now < end; now = mono_ns()) {
+        standin_input(fd, st);
+        uint64_t due = (uint64_t)((double)(now - start) * rate / 1e9);
+        batch.clear();
+        for (uint64_t f = done; f < due; f++) {
+            fill_frame(frame, now, f);
+            for (int i = 0; i < FRAME_SIZE; i++) {
+                batch.push_back(frame[i]);
+                if (st.rfc2217 && frame[i] == IAC) {
+                    batch.push_back(IAC);
+                }
+            }
+        }
+        if (!batch.empty()) {
+            ssize_t w = 0;
+            size_t off = 0;
+            while (off < batch.size() && (w = send(fd, batch.data() + off, batch.size() - off, MSG_NOSIGNAL)) > 0) {
+                off += (size_t)w;
+            }
+            if (w < 0) {
+                break;      // клиент отключился
+            }
+            sent.fetch_add(due - done, std::memory_order_relaxed);
+            done = due;
+        }
+        struct timespec tick = {0, 1000000};
+        nanosleep(&tick, nullptr);
+    }
+    if (cpu_ns) {
+        *cpu_ns = mono_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+    }
+}
+
+static int listen_loopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+        perror("PortBench: bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct NetResult {
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t bad = 0;
+    uint64_t wire_bytes = 0;
+    uint32_t remote_baud = 0;
+    int64_t cpu_ns = 0;
+    double seconds = 0;
+    std::vector<int32_t> latency_us;
+};
+
+static bool run_loopback(bool rfc2217, const char* mode, double rate, double seconds, uint32_t baud, NetResult& out) {
+    int listener = listen_loopback(0);
+    if (listener < 0) {
+        return false;
+    }
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(listener, (struct sockaddr*)&addr, &len);
+    int port = ntohs(addr.sin_port);
+
+    std::atomic<uint64_t> sent(0);
+    int64_t server_cpu_ns = 0;
+    StandIn st;
+    st.rfc2217 = rfc2217;
+    std::thread server([&]() {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd >= 0) {
+            standin_serve(fd, st, rate, seconds, sent, &server_cpu_ns);
+            close(fd);      // конец данных для клиента
+        }
+    });
+
+    std::string error;
+    std::string address = (rfc2217 ? "rfc2217://127.0.0.1:" : "tcp://127.0.0.1:") + std::to_string(port);
+    if (rfc2217) {
+        address += "?baud=" + std::to_string(baud);
+    }
+    std::unique_ptr<ByteSource> source = make_byte_source(address, &error);
+    int64_t cpu_start = process_cpu_ns();
+    int64_t start = mono_ns();
+    if (!source || !source->open(&error)) {
+        fprintf(stderr, "PortBench: %s\n", error.c_str());
+        shutdown(listener, SHUT_RDWR);
+        server.join();
+        close(listener);
+        return false;
+    }
+
+    PortSink sink;
+    sink.verify = true;
+    if (strcmp(mode, "uring") == 0) {
+        UringReader uring;
+        uring.open(1, source->buffer_size());
+        uring.add_port(source->fd());
+        bool ended = false;
+        auto handler = [&](int, uint8_t* data, int result) {
+            int bytes = source->completed(result, data);
+            if (bytes > 0) {
+                sink.take(data, bytes);
+            }
+            ended = bytes < 0;
+            return !ended;
+        };
+        while (!ended && uring.wait(2000, handler, nullptr) >= 0) {
+        }
+    } else {
+        const uint8_t* data = nullptr;
+        for (;;) {
+            struct pollfd pfd;
+            pfd.fd = source->fd();
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 2000) < 0 && errno != EINTR) {
+                break;
+            }
+            int bytes = source->read(&data);
+            if (bytes > 0) {
+                sink.take(data, bytes);
+            } else if (bytes < 0) {
+                break;
+            }
+        }
+    }
+    server.join();
+    close(listener);
+
+    out.seconds = (mono_ns() - start) / 1e9;
+    out.cpu_ns = process_cpu_ns() - cpu_start - server_cpu_ns;
+    out.sent = sent.load();
+    out.received = sink.frames;
+    out.bad = sink.bad;
+    out.wire_bytes = source->stats().bytes;
+    const Rfc2217Source* rfc = dynamic_cast<const Rfc2217Source*>(source.get());
+    out.remote_baud = rfc ? rfc->remote_baud() : 0;
+    out.latency_us.swap(sink.latency_us);
+    source->close();
+    return true;
+}
+
+static void print_net_result(const char* mode, const NetResult& r) {
+    std::vector<int32_t> lat = r.latency_us;
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) {
+        return lat.empty() ? 0 : lat[std::min(lat.size() - 1, (size_t)(p / 100.0 * (double)lat.size()))];
+    };
+    double frames = r.received ? (double)r.received : 1.0;
+    printf("%-6s %10llu %8llu %6llu %10.1f %10.2f %8d %8d %8d %10u\n",
+           mode, (unsigned long long)r.received, (unsigned long long)(r.sent - std::min(r.sent, r.received)),
+           (unsigned long long)r.bad, r.wire_bytes / 1024.0 / (r.seconds > 0 ? r.seconds : 1.0),
+           r.cpu_ns / 1e3 / frames, pct(50), pct(99), lat.empty() ? 0 : lat.back(), r.remote_baud);
+}
+
+static int serve_forever(int port, bool rfc2217, double rate) {
+    int listener = listen_loopback(port);
+    if (listener < 0) {
+        return 1;
+    }
+    printf("Заменитель %s на 127.0.0.1:%d, %.0f кадров/с\n", rfc2217 ? "RFC 2217" : "raw TCP", port, rate);
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        StandIn st;
+        st.rfc2217 = rfc2217;
+        std::atomic<uint64_t> sent(0);
+        standin_serve(fd, st, rate, 0, sent, nullptr);
+        printf("Клиент отключился: отдано %llu кадров, скорость от клиента %u\n",
+               (unsigned long long)sent.load(), st.baud);
+        close(fd);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Конвейер разбора
+
+static const uint32_t BENCH_ID_BASE = 0x10000000;
+
+// Кадр датчика: ID, номер кадра устройства и время отправки (младшие 32
+// бита мкс) - в байтах, которые разбор не читает
+static void fill_device_frame(uint8_t* frame, uint32_t id, uint32_t seq, uint32_t sent_us) {
+    memset(frame, 0, FRAME_SIZE);
+    frame[2] = PACKET_TYPE_SENSOR;
+    memcpy(frame + 3, &id, sizeof(id));
+    frame[7] = (uint8_t)seq;
+    frame[8] = (uint8_t)(seq >> 8);
+    frame[13] = 220;
+    frame[14] = 80;
+    frame[19] = 3;
+    frame[24] = (uint8_t)(40 + seq % 50);
+    memcpy(frame + 15, &sent_us, sizeof(sent_us));
+    memcpy(frame + 20, &seq, sizeof(seq));
+}
+
+static uint32_t mono_us32() {
+    return (uint32_t)(mono_ns() / 1000);
+}
+
+// Агрегаты и проверка порядка. Кадры одного устройства обрабатывает
+// только его сегмент, поэтому next_seq и задержки сегмента пишутся без
+// блокировок.
+struct PipelineCheck {
+    DeviceStats stats;
+    PacketHistograms histograms;
+    LossEstimator losses;
+    LatestValues latest;
+    std::vector<uint32_t> next_seq;
+    std::vector<std::vector<int32_t>> latency_us;     // по сегментам
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> disorder{0};
+    bool timed = true;
+
+    PipelineCheck(uint32_t devices, unsigned shards) : next_seq(devices, 0), latency_us(shards ? shards : 1) {}
+
+    void aggregate(unsigned shard, const PipelineFrame& f) {
+        const DecodedPacket& d = f.decoded;
+        uint32_t seq, sent_us;
+        memcpy(&seq, f.raw + 20, sizeof(seq));
+        memcpy(&sent_us, f.raw + 15, sizeof(sent_us));
+
+        uint32_t& next = next_seq[d.id - BENCH_ID_BASE];
+        if (seq != next) {
+            disorder.fetch_add(1, std::memory_order_relaxed);
+        }
+        next = seq + 1;
+
+        float values[STAT_FIELD_COUNT];
+        values[STAT_PRESSURE] = d.pressure_bar;
+        values[STAT_TEMPERATURE] = (float)d.temperature_c;
+        values[STAT_VOLTAGE] = d.voltage_v;
+        values[STAT_RSSI] = (float)d.rssi;
+        stats.update(d.id, values);
+        histograms.record_device(d.id, (uint64_t)f.rx_us, d.rssi);
+        losses.update(d.id, (uint64_t)f.rx_us);
+
+        LatestPacket lp;
+        memset(&lp, 0, sizeof(lp));
+        lp.id = d.id;
+        lp.type = d.type;
+        lp.pressure_bar = d.pressure_bar;
+        lp.voltage_v = d.voltage_v;
+        lp.time_us = f.rx_us;
+        lp.sequence = f.sequence;
+        memcpy(lp.raw, f.raw, sizeof(lp.raw));
+        latest.publish(lp);
+
+        if (timed) {
+            latency_us[shard].push_back((int32_t)(mono_us32() - sent_us));
+        }
+        frames.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+struct PipelineResult {
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t disorder = 0;
+    uint64_t steals = 0;
+    int64_t cpu_ns = 0;
+    double peak_rate = 0;
+    std::vector<int32_t> latency_us;
+};
+
+// Агрегаты: в пуле, если он запущен, иначе здесь же (поток чтения)
+struct PipelineFeed {
+    DecodePipeline& pipeline;
+    PipelineCheck& check;
+    uint64_t sequence = 0;
+
+    void push(unsigned source, const uint8_t* frame, int64_t rx_us) {
+        if (pipeline.running()) {
+            pipeline.push(source, frame, rx_us);
+            return;
+        }
+        PipelineFrame f;
+        memcpy(f.raw, frame, FRAME_SIZE);
+        decode_packet(f.raw, f.decoded);
+        f.rx_us = rx_us;
+        f.source = source;
+        f.sequence = sequence++;
+        check.aggregate(0, f);
+    }
+
+    void flush(unsigned source) {
+        if (pipeline.running()) {
+            pipeline.flush(source);
+        }
+    }
+};
+
+static void start_pipeline(DecodePipeline& pipeline, unsigned workers, int ports, PipelineCheck& check) {
+    if (workers == 0) {
+        return;
+    }
+    // Нумерация и уровень порта - в очереди источника, по порядку приема
+    std::shared_ptr<std::vector<uint64_t>> sequence = std::make_shared<std::vector<uint64_t>>(ports, 0);
+    pipeline.start(workers, (unsigned)ports,
+                   [sequence](PipelineFrame& f) {
+                       f.sequence = (*sequence)[f.source]++;
+                       return true;
+                   },
+                   [&check](unsigned shard, const PipelineFrame* frames, size_t count) {
+                       for (size_t i = 0; i < count; i++) {
+                           check.aggregate(shard, frames[i]);
+                       }
+                   });
+}
+
+// Передатчик кадров датчиков: как transmit(), устройства порта по кругу
+static void transmit_devices(const std::vector<PtyPair>& ptys, int devices, double rate, double seconds,
+                             std::atomic<uint64_t>& sent, int64_t& cpu_ns) {
+    int64_t cpu_start = mono_ns(CLOCK_THREAD_CPUTIME_ID);
+    int64_t start = mono_ns();
+    int64_t end = start + (int64_t)(seconds * 1e9);
+    std::vector<uint64_t> done(ptys.size(), 0);
+    std::vector<uint8_t> batch;
+
+    for (int64_t now = start; now < end; now = mono_ns()) {
+        uint64_t due = (uint64_t)((double)(now - start) * rate / 1e9);
+        uint32_t sent_us = (uint32_t)(now / 1000);
+        for (size_t p = 0; p < ptys.size(); p++) {
+            uint64_t n = due - done[p];
+            if (n == 0) {
+                continue;
+            }
+            batch.resize(n * FRAME_SIZE);
+            for (uint64_t f = 0; f < n; f++) {
+                uint64_t k = done[p] + f;
+                uint32_t id = BENCH_ID_BASE + (uint32_t)(p * devices + k % devices);
+                fill_device_frame(&batch[f * FRAME_SIZE], id, (uint32_t)(k / devices), sent_us);
+            }
+            size_t off = 0;
+            while (off < batch.size()) {
+                ssize_t w = write(ptys[p].master, batch.data() + off, batch.size() - off);
+                if (w <= 0) {
+                    break;
+                }
+                off += (size_t)w;
+            }
+            // pty не теряет записанное: недописанный хвост - только при ошибке
+            done[p] += n;
+            sent.fetch_add(n, std::memory_order_relaxed);
+        }
+        struct timespec tick = {0, 1000000};
+        nanosleep(&tick, nullptr);
+    }
+    cpu_ns = mono_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+}
+
+// Один поток читает все порты: poll() на всех, затем read() готовых
+static void receive_ports(const std::vector<PtyPair>& ptys, int wake, PipelineFeed& feed) {
+    size_t ports = ptys.size();
+    std::vector<struct pollfd> fds(ports + 1);
+    for (size_t i = 0; i < ports; i++) {
+        fds[i].fd = ptys[i].device;
+        fds[i].events = POLLIN;
+    }
+    fds[ports].fd = wake;
+    fds[ports].events = POLLIN;
+    std::vector<std::vector<uint8_t>> partial(ports);
+    uint8_t buf[4096];
+
+    for (;;) {
+        for (struct pollfd& f : fds) {
+            f.revents = 0;
+        }
+        if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+            return;
+        }
+        if (fds[ports].revents) {
+            return;
+        }
+        for (size_t i = 0; i < ports; i++) {
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+            int64_t rx_us = mono_ns() / 1000;
+            std::vector<uint8_t>& frame = partial[i];
+            for (ssize_t k = 0; k < n; k++) {
+                frame.push_back(buf[k]);
+                if (frame.size() == (size_t)FRAME_SIZE) {
+                    feed.push((unsigned)i, frame.data(), rx_us);
+                    frame.clear();
+                }
+            }
+            feed.flush((unsigned)i);
+        }
+    }
+}
+
+static bool run_pipeline_ptys(unsigned workers, int ports, int devices, double rate, double seconds, PipelineResult& out) {
+    std::string error;
+    std::vector<PtyPair> ptys(ports);
+    for (int i = 0; i < ports; i++) {
+        if (!open_pty(ptys[i], &error)) {
+            fprintf(stderr, "PortBench: %s\n", error.c_str());
+            return false;
+        }
+    }
+    int wake = eventfd(0, EFD_CLOEXEC);
+    DecodePipeline pipeline;
+    PipelineCheck check((uint32_t)(ports * devices), DEVICE_SHARDS);
+    start_pipeline(pipeline, workers, ports, check);
+    PipelineFeed feed{pipeline, check};
+
+    int64_t cpu_start = process_cpu_ns();
+    std::thread reader([&]() { receive_ports(ptys, wake, feed); });
+
+    std::atomic<uint64_t> sent(0);
+    int64_t transmit_cpu_ns = 0;
+    transmit_devices(ptys, devices, rate, seconds, sent, transmit_cpu_ns);
+
+    int64_t grace_end = mono_ns() + 1000000000;
+    while (check.frames.load() < sent.load() && mono_ns() < grace_end) {
+        usleep(1000);
+    }
+    uint64_t one = 1;
+    if (write(wake, &one, sizeof(one)) < 0) {
+        perror("eventfd");
+    }
+    reader.join();
+    out.steals = pipeline.stats().steals;
+    pipeline.stop();
+
+    out.cpu_ns = process_cpu_ns() - cpu_start - transmit_cpu_ns;
+    out.sent = sent.load();
+    out.received = check.frames.load();
+    out.disorder = check.disorder.load();
+
+    // Сшитая из сегментов сводка должна сойтись с числом кадров
+    FieldSummary merged[STAT_FIELD_COUNT];
+    size_t devices_seen = 0;
+    check.stats.merged(merged, &devices_seen);
+    if (merged[STAT_PRESSURE].count != out.received) {
+        fprintf(stderr, "PortBench: сводка DeviceStats: %llu пакетов, %zu устройств, принято %llu\n",
+                (unsigned long long)merged[STAT_PRESSURE].count, devices_seen, (unsigned long long)out.received);
+    }
+    for (const std::vector<int32_t>& l : check.latency_us) {
+        out.latency_us.insert(out.latency_us.end(), l.begin(), l.end());
+    }
+    for (PtyPair& p : ptys) {
+        close(p.device);
+        close(p.master);
+    }
+    close(wake);
+    return true;
+}
+
+// Пиковая пропускная способность: кадры из памяти, по потоку на порт
+static double run_pipeline_peak(unsigned workers, int ports, int devices, uint64_t frames_per_port, uint64_t* disorder) {
+    DecodePipeline pipeline;
+    PipelineCheck check((uint32_t)(ports * devices), DEVICE_SHARDS);
+    check.timed = false;
+    start_pipeline(pipeline, workers, ports, check);
+
+    // Кадры готовятся заранее: поставщики только отдают их
+    std::vector<std::vector<uint8_t>> data(ports);
+    for (int p = 0; p < ports; p++) {
+        data[p].resize(frames_per_port * FRAME_SIZE);
+        for (uint64_t k = 0; k < frames_per_port; k++) {
+            uint32_t id = BENCH_ID_BASE + (uint32_t)(p * devices + k % devices);
+            fill_device_frame(&data[p][k * FRAME_SIZE], id, (uint32_t)(k / devices), 0);
+        }
+    }
+
+    int64_t start = mono_ns();
+    if (workers == 0) {
+        // Без конвейера все порты обрабатывает один поток чтения
+        PipelineFeed feed{pipeline, check};
+        for (uint64_t k = 0; k < frames_per_port; k++) {
+            for (int p = 0; p < ports; p++) {
+                feed.push((unsigned)p, &data[p][k * FRAME_SIZE], (int64_t)k);
+            }
+        }
+    } else {
+        std::vector<std::thread> producers;
+        for (int p = 0; p < ports; p++) {
+            producers.emplace_back([&, p]() {
+                const uint8_t* frames = data[p].data();
+                for (uint64_t k = 0; k < frames_per_port; k++) {
+                    pipeline.push((unsigned)p, frames + k * FRAME_SIZE, (int64_t)k);
+                }
+                pipeline.flush((unsigned)p);
+            });
+        }
+        for (std::thread& t : producers) {
+            t.join();
+        }
+        pipeline.drain();
+    }
+    double elapsed = (mono_ns() - start) / 1e9;
+    pipeline.stop();
+    *disorder = check.disorder.load();
+    return elapsed > 0 ? (double)check.frames.load() / elapsed : 0;
+}
+
+static void print_pipeline_result(unsigned workers, const PipelineResult& r) {
+    std::vector<int32_t> lat = r.latency_us;
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) {
+        return lat.empty() ? 0 : lat[std::min(lat.size() - 1, (size_t)(p / 100.0 * (double)lat.size()))];
+    };
+    double frames = r.received ? (double)r.received : 1.0;
+    printf("%7u %10llu %8llu %8llu %10.2f %8d %8d %8d %9llu %12.0f\n",
+           workers, (unsigned long long)r.received, (unsigned long long)(r.sent - std::min(r.sent, r.received)),
+           (unsigned long long)r.disorder, r.cpu_ns / 1e3 / frames,
+           pct(50), pct(99), lat.empty() ? 0 : lat.back(), (unsigned long long)r.steals, r.peak_rate);
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Использование: PortBench [-p портов] [-r кадров/с] [-t секунд] [--mode poll|uring|both]\n"
+            "               PortBench --loopback raw|rfc2217 [-b бод] [-t секунд] [--mode poll|uring|both]\n"
+            "               PortBench --serve ПОРТ [--rfc2217] [-b бод]\n"
+            "               PortBench --pipeline N[,N...] [-p портов] [-d устройств] [-r кадров/с] [-t секунд]\n"
+            "  -p N        число портов (по умолчанию 12)\n"
+            "  -r R        кадров в секунду на порт (по умолчанию 1000)\n"
+            "  -d D        устройств на порт для --pipeline (по умолчанию 64)\n"
+            "  -b B        скорость линии для сетевых режимов, кадры 8N1 (по умолчанию 921600)\n"
+            "  -t S        длительность передачи, с (по умолчанию 5)\n"
+            "  --mode M    путь чтения: poll, uring или оба (по умолчанию)\n"
+            "  --loopback  сетевой источник против заменителя сервера в этом же процессе\n"
+            "  --serve     только заменитель сервера последовательных портов\n"
+            "  --pipeline  конвейер разбора с N рабочими потоками (0 - в потоке чтения)\n");
+}
+
+int main(int argc, char* argv[]) {
+    int ports = 12;
+    double rate = 1000;
+    double seconds = 5;
+    std::string mode = "both";
+    std::string loopback;
+    int serve_port = 0;
+    bool serve_rfc2217 = false;
+    long baud = 921600;
+    int devices = 64;
+    std::vector<unsigned> pipeline_workers;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            ports = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            baud = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--loopback") == 0 && i + 1 < argc) {
+            loopback = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rfc2217") == 0) {
+            serve_rfc2217 = true;
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            devices = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            for (const char* w = argv[++i]; *w; ) {
+                char* end = nullptr;
+                long n = strtol(w, &end, 10);
+                if (end == w || n < 0 || n > (long)DecodePipeline::MAX_WORKERS) {
+                    usage();
+                    return 2;
+                }
+                pipeline_workers.push_back((unsigned)n);
+                w = *end == ',' ? end + 1 : end;
+            }
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (ports < 1 || devices < 1 || rate <= 0 || seconds <= 0 || (mode != "poll" && mode != "uring" && mode != "both")) {
+        usage();
+        return 2;
+    }
+
+    bool uring_ok = UringReader::available();
+    if (mode == "uring" && !uring_ok) {
+        fprintf(stderr, "PortBench: io_uring недоступен\n");
+        return 1;
+    }
+
+    // 8N1: 10 бит на байт
+    double line_rate = baud > 0 ? (double)baud / 10.0 / FRAME_SIZE : 0;
+    if (serve_port > 0) {
+        signal(SIGPIPE, SIG_IGN);
+        return serve_forever(serve_port, serve_rfc2217, line_rate);
+    }
+    if (!loopback.empty()) {
+        if ((loopback != "raw" && loopback != "rfc2217") || line_rate <= 0) {
+            usage();
+            return 2;
+        }
+        printf("Сетевой источник %s, линия %ld бод (%.0f кадров/с), %.1f с\n\n", loopback.c_str(), baud, line_rate, seconds);
+        printf("%-6s %10s %8s %6s %10s %10s %8s %8s %8s %10s\n",
+               "путь", "кадров", "потеряно", "битых", "КБ/с", "CPU мкс/к", "p50 мкс", "p99 мкс", "max мкс", "бод сервера");
+        const char* net_modes[] = {"poll", "uring"};
+        for (const char* m : net_modes) {
+            if ((mode != "both" && mode != m) || (strcmp(m, "uring") == 0 && !uring_ok)) {
+                continue;
+            }
+            NetResult r;
+            if (!run_loopback(loopback == "rfc2217", m, line_rate, seconds, (uint32_t)baud, r)) {
+                return 1;
+            }
+            print_net_result(m, r);
+        }
+        return 0;
+    }
+
+    if (!pipeline_workers.empty()) {
+        printf("Конвейер разбора: портов %d, устройств на порт %d, %.0f кадров/с на порт, %.1f с, ядер %u\n\n",
+               ports, devices, rate, seconds, std::thread::hardware_concurrency());
+        printf("%7s %10s %8s %8s %10s %8s %8s %8s %9s %12s\n",
+               "потоков", "кадров", "потеряно", "порядок", "CPU мкс/к", "p50 мкс", "p99 мкс", "max мкс", "перехв.", "пик, к/с");
+        for (unsigned w : pipeline_workers) {
+            PipelineResult r;
+            if (!run_pipeline_ptys(w, ports, devices, rate, seconds, r)) {
+                return 1;
+            }
+            uint64_t peak_disorder = 0;
+            r.peak_rate = run_pipeline_peak(w, ports, devices, 200000, &peak_disorder);
+            r.disorder += peak_disorder;
+            print_pipeline_result(w, r);
+        }
+        return 0;
+    }
+
+    printf("Портов: %d, %.0f кадров/с на порт, %.1f с\n\n", ports, rate, seconds);
+    printf("%-6s %10s %8s %9s %10s %10s %9s %8s %8s %8s\n",
+           "путь", "кадров", "потеряно", "CPU, мс", "CPU мкс/к", "вызовов", "выз./к", "p50 мкс", "p99 мкс", "max мкс");
+
+    const char* modes[] = {"poll", "uring"};
+    for (const char* m : modes) {
+        if (mode != "both" && mode != m) {
+            continue;
+        }
+        if (strcmp(m, "uring") == 0 && !uring_ok) {
+            printf("%-6s io_uring недоступен\n", m);
+            continue;
+        }
+        RunResult r;
+        if (!run(m, ports, rate, seconds, r)) {
+            return 1;
+        }
+        print_result(m, r);
+    }
+    return 0;
+}
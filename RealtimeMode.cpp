@@ -0,0 +1,254 @@
+#include "RealtimeMode.h"
+#include "PacketHistograms.h"
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Стек потока, который заранее отображается в память
+static const size_t PREFAULT_STACK = 256 * 1024;
+
+RealtimeMode::RealtimeMode() : port_requested(false), lock_requested(false), samples(0), max_us(0), sum_us(0) {
+    for (int i = 0; i < BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    current.active = current.fifo = current.affinity = false;
+    current.memory_locked = current.low_latency = false;
+}
+
+void RealtimeMode::configure(const RealtimeConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    requested = config;
+}
+
+RealtimeConfig RealtimeMode::config() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requested;
+}
+
+static void append_error(std::string& errors, const char* step, int err) {
+    if (!errors.empty()) {
+        errors += "; ";
+    }
+    errors += step;
+    errors += ": ";
+    if (err == EPERM) {
+        errors += "нет прав";
+    } else if (err == ENOMEM) {
+        errors += "не хватает RLIMIT_MEMLOCK";
+    } else {
+        errors += strerror(err);
+    }
+}
+
+#ifndef _WIN32
+// Отдельная функция, чтобы массив лежал на стеке ниже вызывающего
+static void __attribute__((noinline)) prefault_stack() {
+    volatile uint8_t stack[PREFAULT_STACK];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+#endif
+
+RealtimeConfig RealtimeMode::enter() {
+    RealtimeConfig config;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        config = requested;
+    }
+
+    RealtimeStatus status;
+    status.active = config.enabled;
+    status.fifo = status.affinity = status.memory_locked = false;
+    status.low_latency = false;
+
+    // Опоздания считаются заново для каждого запуска
+    samples.store(0, std::memory_order_relaxed);
+    max_us.store(0, std::memory_order_relaxed);
+    sum_us.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+
+    if (config.enabled) {
+#ifdef _WIN32
+        status.fifo = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+        if (!status.fifo) {
+            append_error(status.errors, "приоритет", GetLastError() == ERROR_ACCESS_DENIED ? EPERM : EINVAL);
+        }
+        if (config.cpu >= 0 && config.cpu < 64) {
+            status.affinity = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << config.cpu) != 0;
+            if (!status.affinity) {
+                append_error(status.errors, "ядро", EINVAL);
+            }
+        }
+#else
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        int lo = sched_get_priority_min(SCHED_FIFO), hi = sched_get_priority_max(SCHED_FIFO);
+        param.sched_priority = config.priority < lo ? lo : config.priority > hi ? hi : config.priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        status.fifo = err == 0;
+        if (err) {
+            append_error(status.errors, "SCHED_FIFO", err);
+        }
+
+#ifdef __linux__
+        if (config.cpu >= 0 && config.cpu < CPU_SETSIZE) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(config.cpu, &set);
+            err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            status.affinity = err == 0;
+            if (err) {
+                append_error(status.errors, "ядро", err);
+            }
+        }
+#endif
+
+        if (config.lock_memory) {
+            prefault_stack();
+        }
+#endif
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    current = status;
+    port_requested = false;
+    lock_requested = config.enabled && config.lock_memory;
+#ifndef _WIN32
+    if (lock_requested) {
+        // Стек на PREFAULT_STACK ниже текущего кадра - уже отображенный
+        // prefault_stack(); вверх - до конца текущей страницы
+        volatile uint8_t marker = 0;
+        uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t top = ((uintptr_t)&marker & ~(page - 1)) + page;
+        uintptr_t bottom = ((uintptr_t)&marker - PREFAULT_STACK) & ~(page - 1);
+        current.memory_locked = lock_range((void*)bottom, top - bottom);
+    }
+#endif
+    return config;
+}
+
+void RealtimeMode::lock_buffer(void* buffer, size_t size) {
+    prefault(buffer, size);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lock_requested && size) {
+        current.memory_locked = lock_range(buffer, size) && current.memory_locked;
+    }
+}
+
+bool RealtimeMode::lock_range(void* address, size_t size) {
+#ifdef _WIN32
+    (void)address;
+    (void)size;
+    return false;
+#else
+    if (mlock(address, size) != 0) {
+        append_error(current.errors, "mlock", errno);
+        return false;
+    }
+    LockedRange range;
+    range.address = address;
+    range.size = size;
+    locked.push_back(range);
+    return true;
+#endif
+}
+
+void RealtimeMode::leave() {
+    std::lock_guard<std::mutex> lock(mutex);
+#ifndef _WIN32
+    for (const LockedRange& range : locked) {
+        munlock(range.address, range.size);
+    }
+#endif
+    locked.clear();
+    lock_requested = false;
+    current.active = current.fifo = current.affinity = false;
+    current.memory_locked = current.low_latency = false;
+    current.errors.clear();
+    port_requested = false;
+}
+
+void RealtimeMode::set_port_status(bool requested_flag, bool port_low_latency) {
+    std::lock_guard<std::mutex> lock(mutex);
+    current.low_latency = port_low_latency;
+    port_requested = requested_flag;
+}
+
+void RealtimeMode::record_wakeup(int64_t late_us) {
+    if (late_us < 0) {
+        late_us = 0;
+    }
+    // Один писатель: чтение-запись без RMW
+    samples.store(samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum_us.store(sum_us.load(std::memory_order_relaxed) + late_us, std::memory_order_relaxed);
+    if (late_us > max_us.load(std::memory_order_relaxed)) {
+        max_us.store(late_us, std::memory_order_relaxed);
+    }
+    int b = late_us ? 64 - (int)clz64((uint64_t)late_us) : 0;
+    if (b >= BUCKETS) {
+        b = BUCKETS - 1;
+    }
+    buckets[b].store(buckets[b].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+RealtimeStatus RealtimeMode::status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    RealtimeStatus out = current;
+    if (port_requested && !current.low_latency) {
+        if (!out.errors.empty()) {
+            out.errors += "; ";
+        }
+        out.errors += "ASYNC_LOW_LATENCY: не поддерживается портом";
+    }
+    return out;
+}
+
+WakeupLatency RealtimeMode::latency() const {
+    WakeupLatency out;
+    out.samples = samples.load(std::memory_order_relaxed);
+    out.max_us = max_us.load(std::memory_order_relaxed);
+    out.mean_us = out.samples ? (double)sum_us.load(std::memory_order_relaxed) / out.samples : 0.0;
+    out.p99_us = 0;
+
+    uint64_t counts[BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    uint64_t rank = total - total / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS && total; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // Корзина i: [2^(i-1), 2^i)
+            out.p99_us = i ? ((int64_t)1 << i) - 1 : 0;
+            break;
+        }
+    }
+    if (out.p99_us > out.max_us) {
+        out.p99_us = out.max_us;
+    }
+    return out;
+}
+
+void RealtimeMode::prefault(void* buffer, size_t size) {
+    volatile uint8_t* p = (volatile uint8_t*)buffer;
+    for (size_t i = 0; i < size; i += 4096) {
+        p[i] = p[i];
+    }
+    if (size) {
+        p[size - 1] = p[size - 1];
+    }
+}
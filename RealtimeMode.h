@@ -0,0 +1,104 @@
+#ifndef REALTIMEMODE_H
+#define REALTIMEMODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Настройки режима реального времени для потока чтения
+struct RealtimeConfig {
+    bool enabled = false;
+    int priority = 80;          // SCHED_FIFO, 1..99
+    int cpu = -1;               // ядро для потока чтения; -1 - любое
+    bool lock_memory = true;    // mlock буферов чтения и стека
+    bool low_latency_port = true;   // ASYNC_LOW_LATENCY на порту
+};
+
+// Что из настроек удалось включить
+struct RealtimeStatus {
+    bool active;            // режим запрошен и поток чтения в нем
+    bool fifo;
+    bool affinity;
+    bool memory_locked;
+    bool low_latency;
+    std::string errors;     // отказы через "; ", пусто - все включилось
+};
+
+// Опоздание пробуждения потока чтения: насколько позже срока вернулся
+// poll() с таймаутом
+struct WakeupLatency {
+    uint64_t samples;
+    int64_t max_us;
+    double mean_us;
+    int64_t p99_us;         // верхняя граница корзины (степени двойки)
+};
+
+// Режим реального времени потока чтения.
+//
+// enter() вызывается самим потоком чтения: приоритет SCHED_FIFO, привязка
+// к ядру, предзагрузка и mlock стека потока, чтобы первый доступ к
+// странице не уходил в обработчик отказа. Буферы чтения поток закрепляет
+// сам через lock_buffer(). Закрепляется только то, что трогает поток
+// чтения: mlockall закрепил бы весь процесс с Qt, кучей GUI и будущими
+// отображениями файлов. Кольцо io_uring с зарегистрированными буферами
+// ядро закрепляет само. Каждый шаг
+// независим: без CAP_SYS_NICE или при малом RLIMIT_MEMLOCK шаг
+// пропускается, причина попадает в status(), остальное работает.
+// В Windows - THREAD_PRIORITY_TIME_CRITICAL и маска ядер, без блокировки
+// памяти.
+//
+// Опоздания пробуждения пишет поток чтения (без блокировок), читает GUI.
+class RealtimeMode {
+public:
+    RealtimeMode();
+
+    // GUI; действует со следующего запуска чтения
+    void configure(const RealtimeConfig& config);
+    RealtimeConfig config() const;
+
+    // Поток чтения; возвращает настройки, с которыми вошел
+    RealtimeConfig enter();
+    void leave();
+    // Порт открыт; port_low_latency - удалось ли установить его флаг
+    void set_port_status(bool requested, bool port_low_latency);
+    void record_wakeup(int64_t late_us);
+
+    // Любой поток
+    RealtimeStatus status() const;
+    WakeupLatency latency() const;
+
+    // Поток чтения после enter(): буфер заранее отображается в память и,
+    // если режим включен с lock_memory, закрепляется до leave()
+    void lock_buffer(void* buffer, size_t size);
+
+    // Касается каждой страницы буфера, чтобы она была в памяти заранее
+    static void prefault(void* buffer, size_t size);
+
+private:
+    static const int BUCKETS = 32;
+
+    struct LockedRange {
+        void* address;
+        size_t size;
+    };
+
+    // Под mutex
+    bool lock_range(void* address, size_t size);
+
+    mutable std::mutex mutex;
+    RealtimeConfig requested;
+    RealtimeStatus current;
+    bool port_requested;
+    bool lock_requested;                // enter() с lock_memory
+    std::vector<LockedRange> locked;    // снимается в leave()
+
+    std::atomic<uint64_t> samples;
+    std::atomic<int64_t> max_us;
+    std::atomic<int64_t> sum_us;
+    std::atomic<uint64_t> buckets[BUCKETS];
+};
+
+#endif
@@ -0,0 +1,527 @@
+#include "Rollups.h"
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const int64_t LEVEL_WIDTH_MS[Rollups::LEVEL_COUNT] = {
+        1000ll,
+        60ll * 1000,
+        3600ll * 1000,
+        86400ll * 1000
+};
+
+// Сколько хранится каждый уровень сводного ряда (сутки - без ограничения)
+static const int64_t FLEET_RETENTION_MS[Rollups::LEVEL_COUNT] = {
+        3600ll * 1000,
+        2ll * 86400 * 1000,
+        90ll * 86400 * 1000,
+        INT64_MAX
+};
+
+// Ряды устройств: 0 - уровень не ведется
+static const int64_t DEVICE_RETENTION_MS[Rollups::LEVEL_COUNT] = {
+        0,
+        0,
+        86400ll * 1000,
+        31ll * 86400 * 1000
+};
+
+static const char ROLLUP_MAGIC[4] = {'E', 'R', 'U', '1'};
+
+static bool sync_file(FILE* f) {
+    if (fflush(f) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+// Переименование переживает сбой питания, только когда синхронизирован
+// каталог (в Windows каталог так не открыть - NTFS журналирует его сама)
+static bool sync_parent_dir(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    std::string dir = fs::path(path).parent_path().string();
+    int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+double FieldAggregate::stddev(uint64_t count) const {
+    if (count < 2) {
+        return 0.0;
+    }
+    double m = sum / (double)count;
+    double var = (sum_sq - m * sum) / (double)(count - 1);
+    return var > 0.0 ? std::sqrt(var) : 0.0;
+}
+
+void RollupAggregate::reset(int64_t start, int64_t end) {
+    start_ms = start;
+    end_ms = end;
+    count = 0;
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        fields[f].min = 0.0f;
+        fields[f].max = 0.0f;
+        fields[f].sum = 0.0;
+        fields[f].sum_sq = 0.0;
+    }
+}
+
+void RollupAggregate::add(const float values[STAT_FIELD_COUNT]) {
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        FieldAggregate& a = fields[f];
+        float x = values[f];
+        if (count == 0 || x < a.min) a.min = x;
+        if (count == 0 || x > a.max) a.max = x;
+        a.sum += x;
+        a.sum_sq += (double)x * x;
+    }
+    count++;
+}
+
+void RollupAggregate::merge(const RollupAggregate& other) {
+    if (other.count == 0) {
+        return;
+    }
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        FieldAggregate& a = fields[f];
+        const FieldAggregate& b = other.fields[f];
+        if (count == 0 || b.min < a.min) a.min = b.min;
+        if (count == 0 || b.max > a.max) a.max = b.max;
+        a.sum += b.sum;
+        a.sum_sq += b.sum_sq;
+    }
+    count += other.count;
+}
+
+Rollups::Rollups() : latest_ms(INT64_MIN), snapshot_readers(0), pending(false), writing(false), stopping(false) {
+}
+
+Rollups::~Rollups() {
+    {
+        std::lock_guard<std::mutex> lock(save_mutex);
+        stopping = true;
+    }
+    save_wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+int64_t Rollups::level_width(Level level) {
+    return LEVEL_WIDTH_MS[level];
+}
+
+int64_t Rollups::align_down(int64_t t, int64_t width) {
+    int64_t r = t % width;
+    return r < 0 ? t - r - width : t - r;
+}
+
+const int64_t* Rollups::retention(uint32_t id) {
+    return id == ALL_DEVICES ? FLEET_RETENTION_MS : DEVICE_RETENTION_MS;
+}
+
+// Неведущийся уровень удален целиком
+int64_t Rollups::level_horizon(const int64_t* kept, int level) const {
+    if (kept[level] == 0) {
+        return INT64_MAX;
+    }
+    if (kept[level] == INT64_MAX || latest_ms == INT64_MIN) {
+        return INT64_MIN;
+    }
+    return latest_ms - kept[level];
+}
+
+const Rollups::Buckets& Rollups::level_buckets(const Series& series, int level) {
+    static const Buckets empty;
+    return series.levels[level] ? *series.levels[level] : empty;
+}
+
+// Под замком. Уровень, который держит еще не разобранный снимок,
+// копируется. Разобранный снимок может держать ссылки и дальше: его
+// чтение корзин упорядочено до нашей записи через snapshot_readers.
+Rollups::Buckets& Rollups::writable(std::shared_ptr<Buckets>& level) {
+    if (!level) {
+        level = std::make_shared<Buckets>();
+    } else if (snapshot_readers.load(std::memory_order_acquire) > 0 && level.use_count() > 1) {
+        level = std::make_shared<Buckets>(*level);
+    }
+    return *level;
+}
+
+void Rollups::add_to_level(Buckets& buckets, int64_t start, const float values[STAT_FIELD_COUNT]) {
+    Bucket* b = nullptr;
+
+    if (!buckets.empty() && buckets.back().start == start) {
+        b = &buckets.back();
+    } else if (buckets.empty() || buckets.back().start < start) {
+        buckets.push_back(Bucket());
+        b = &buckets.back();
+        b->start = start;
+        b->count = 0;
+    } else {
+        // Точка пришла не по порядку
+        auto it = std::lower_bound(buckets.begin(), buckets.end(), start,
+                                   [](const Bucket& x, int64_t t) { return x.start < t; });
+        if (it == buckets.end() || it->start != start) {
+            Bucket nb;
+            nb.start = start;
+            nb.count = 0;
+            it = buckets.insert(it, nb);
+        }
+        b = &*it;
+    }
+
+    for (int f = 0; f < STAT_FIELD_COUNT; f++) {
+        FieldAggregate& a = b->fields[f];
+        float x = values[f];
+        if (b->count == 0 || x < a.min) a.min = x;
+        if (b->count == 0 || x > a.max) a.max = x;
+        if (b->count == 0) {
+            a.sum = 0.0;
+            a.sum_sq = 0.0;
+        }
+        a.sum += x;
+        a.sum_sq += (double)x * x;
+    }
+    b->count++;
+}
+
+void Rollups::add_series(Series& series, const int64_t* kept, const HistorySample& s,
+                         const float values[STAT_FIELD_COUNT]) {
+    for (int l = 0; l < LEVEL_COUNT; l++) {
+        if (kept[l] == 0) {
+            continue;
+        }
+        Buckets& buckets = writable(series.levels[l]);
+        add_to_level(buckets, align_down(s.time_ms, LEVEL_WIDTH_MS[l]), values);
+
+        int64_t horizon = level_horizon(kept, l);
+        if (buckets.front().start + LEVEL_WIDTH_MS[l] <= horizon) {
+            auto keep = std::find_if(buckets.begin(), buckets.end(), [&](const Bucket& b) {
+                return b.start + LEVEL_WIDTH_MS[l] > horizon;
+            });
+            buckets.erase(buckets.begin(), keep);
+        }
+    }
+}
+
+void Rollups::add(const HistorySample& s) {
+    add(&s, 1);
+}
+
+void Rollups::add(const HistorySample* samples, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Series& all = devices[(uint32_t)ALL_DEVICES];
+
+    for (size_t i = 0; i < count; i++) {
+        const HistorySample& s = samples[i];
+        float values[STAT_FIELD_COUNT];
+        values[STAT_PRESSURE] = s.pressure_bar;
+        values[STAT_TEMPERATURE] = s.temperature_c;
+        values[STAT_VOLTAGE] = s.voltage_v;
+        values[STAT_RSSI] = s.rssi;
+
+        if (s.time_ms > latest_ms) {
+            latest_ms = s.time_ms;
+        }
+
+        add_series(devices[s.id], DEVICE_RETENTION_MS, s, values);
+        add_series(all, FLEET_RETENTION_MS, s, values);
+    }
+}
+
+void Rollups::merge_bucket(RollupAggregate& out, const Bucket& b) {
+    RollupAggregate a;
+    a.start_ms = b.start;
+    a.end_ms = b.start;
+    a.count = b.count;
+    memcpy(a.fields, b.fields, sizeof(a.fields));
+    out.merge(a);
+}
+
+// Запрос раскладывается сверху вниз: целые корзины уровня внутри
+// интервала, края - рекурсивно уровнем ниже. Секундный уровень и уровни,
+// уже удаленные для этого участка, берут все пересекающиеся корзины.
+void Rollups::cover(const Series& series, const int64_t* kept, int level, int64_t from_ms, int64_t to_ms,
+                    RollupAggregate& out) const {
+    if (from_ms >= to_ms) {
+        return;
+    }
+
+    // Уровень удален для этого участка: берем перекрывающие корзины
+    // ближайшего сохранившегося более крупного уровня
+    if (level == LEVEL_SECOND || from_ms < level_horizon(kept, level)) {
+        int l = level;
+        while (l < LEVEL_DAY && from_ms < level_horizon(kept, l)) {
+            l++;
+        }
+        const Buckets& buckets = level_buckets(series, l);
+        int64_t first = align_down(from_ms, LEVEL_WIDTH_MS[l]);
+        auto it = std::lower_bound(buckets.begin(), buckets.end(), first,
+                                   [](const Bucket& x, int64_t t) { return x.start < t; });
+        for (; it != buckets.end() && it->start < to_ms; ++it) {
+            merge_bucket(out, *it);
+        }
+        return;
+    }
+
+    int64_t width = LEVEL_WIDTH_MS[level];
+    int64_t inner_from = align_down(from_ms + width - 1, width);
+    int64_t inner_to = align_down(to_ms, width);
+
+    if (inner_from >= inner_to) {
+        cover(series, kept, level - 1, from_ms, to_ms, out);
+        return;
+    }
+
+    // Целые корзины этого уровня
+    const Buckets& buckets = level_buckets(series, level);
+    auto it = std::lower_bound(buckets.begin(), buckets.end(), inner_from,
+                               [](const Bucket& x, int64_t t) { return x.start < t; });
+    for (; it != buckets.end() && it->start < inner_to; ++it) {
+        merge_bucket(out, *it);
+    }
+
+    // Края - более мелким уровнем
+    cover(series, kept, level - 1, from_ms, inner_from, out);
+    cover(series, kept, level - 1, inner_to, to_ms, out);
+}
+
+RollupAggregate Rollups::query(uint32_t id, int64_t from_ms, int64_t to_ms) const {
+    RollupAggregate out;
+    out.reset(from_ms, to_ms);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = devices.find(id);
+    if (it != devices.end()) {
+        cover(it->second, retention(id), LEVEL_DAY, from_ms, to_ms, out);
+    }
+    return out;
+}
+
+std::vector<RollupAggregate> Rollups::series(uint32_t id, Level level, int64_t from_ms, int64_t to_ms) const {
+    std::vector<RollupAggregate> out;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = devices.find(id);
+    if (it == devices.end()) {
+        return out;
+    }
+
+    const Buckets& buckets = level_buckets(it->second, level);
+    auto b = std::lower_bound(buckets.begin(), buckets.end(), align_down(from_ms, LEVEL_WIDTH_MS[level]),
+                              [](const Bucket& x, int64_t t) { return x.start < t; });
+    for (; b != buckets.end() && b->start < to_ms; ++b) {
+        RollupAggregate a;
+        a.reset(b->start, b->start + LEVEL_WIDTH_MS[level]);
+        merge_bucket(a, *b);
+        out.push_back(a);
+    }
+    return out;
+}
+
+// Под замком - только указатели уровней
+void Rollups::snapshot(Snapshot& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot_readers.fetch_add(1, std::memory_order_relaxed);
+    out.latest_ms = latest_ms;
+    out.devices.assign(devices.begin(), devices.end());
+}
+
+void Rollups::serialize(const Snapshot& snap, std::vector<uint8_t>& out) {
+    size_t size = 4 + 4 + 8;
+    for (const auto& kv : snap.devices) {
+        size += 4;
+        for (int l = 0; l < LEVEL_COUNT; l++) {
+            size += 4 + level_buckets(kv.second, l).size() * sizeof(Bucket);
+        }
+    }
+    out.resize(size);
+
+    uint8_t* p = out.data();
+    uint32_t n = (uint32_t)snap.devices.size();
+    memcpy(p, ROLLUP_MAGIC, 4); p += 4;
+    memcpy(p, &n, 4); p += 4;
+    memcpy(p, &snap.latest_ms, 8); p += 8;
+    for (const auto& kv : snap.devices) {
+        memcpy(p, &kv.first, 4); p += 4;
+        for (int l = 0; l < LEVEL_COUNT; l++) {
+            const Buckets& buckets = level_buckets(kv.second, l);
+            uint32_t count = (uint32_t)buckets.size();
+            memcpy(p, &count, 4); p += 4;
+            if (count) {
+                memcpy(p, buckets.data(), count * sizeof(Bucket)); p += count * sizeof(Bucket);
+            }
+        }
+    }
+}
+
+bool Rollups::write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    // Данные должны попасть на диск до переименования
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size() && sync_file(f);
+    ok = fclose(f) == 0 && ok;
+
+    std::error_code ec;
+    if (ok) {
+        // Заменяет старый файл целиком, и в Windows тоже
+        fs::rename(tmp, path, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return sync_parent_dir(path);
+}
+
+bool Rollups::save(const std::string& path) const {
+    // Разбор и запись на диск - без замка: поток чтения не ждет
+    Snapshot snap;
+    snapshot(snap);
+    std::vector<uint8_t> data;
+    serialize(snap, data);
+    snapshot_readers.fetch_sub(1, std::memory_order_release);
+    return write_file(path, data);
+}
+
+void Rollups::save_async(const std::string& path) {
+    Snapshot snap;
+    snapshot(snap);
+
+    std::lock_guard<std::mutex> lock(save_mutex);
+    if (pending) {
+        // Заменяемый снимок так и не будет прочитан
+        snapshot_readers.fetch_sub(1, std::memory_order_release);
+    }
+    pending_path = path;
+    pending_snapshot.latest_ms = snap.latest_ms;
+    pending_snapshot.devices.swap(snap.devices);
+    pending = true;
+    if (!worker.joinable()) {
+        worker = std::thread(&Rollups::background, this);
+    }
+    save_wake.notify_one();
+}
+
+void Rollups::wait() {
+    std::unique_lock<std::mutex> lock(save_mutex);
+    save_done.wait(lock, [this] { return !pending && !writing; });
+}
+
+void Rollups::background() {
+    std::unique_lock<std::mutex> lock(save_mutex);
+
+    for (;;) {
+        save_wake.wait(lock, [this] { return pending || stopping; });
+        if (!pending) {
+            break;
+        }
+
+        std::string path;
+        Snapshot snap;
+        path.swap(pending_path);
+        snap.latest_ms = pending_snapshot.latest_ms;
+        snap.devices.swap(pending_snapshot.devices);
+        pending = false;
+        writing = true;
+
+        lock.unlock();
+        std::vector<uint8_t> data;
+        serialize(snap, data);
+        snapshot_readers.fetch_sub(1, std::memory_order_release);
+        snap.devices.clear();
+        write_file(path, data);
+        lock.lock();
+
+        writing = false;
+        save_done.notify_all();
+    }
+}
+
+bool Rollups::load(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+
+    std::unordered_map<uint32_t, Series> loaded;
+    char magic[4];
+    uint32_t n = 0;
+    int64_t latest = INT64_MIN;
+
+    bool ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, ROLLUP_MAGIC, 4) == 0 &&
+              fread(&n, 4, 1, f) == 1 && fread(&latest, 8, 1, f) == 1;
+
+    for (uint32_t i = 0; i < n && ok; i++) {
+        uint32_t id;
+        ok = fread(&id, 4, 1, f) == 1;
+        Series& series = loaded[id];
+        const int64_t* kept = retention(id);
+        for (int l = 0; l < LEVEL_COUNT && ok; l++) {
+            uint32_t count;
+            ok = fread(&count, 4, 1, f) == 1;
+            if (!ok || count == 0) {
+                continue;
+            }
+            // Уровни, которые ряд больше не ведет (старый файл), пропускаются
+            std::shared_ptr<Buckets> buckets = std::make_shared<Buckets>();
+            for (uint32_t k = 0; k < count && ok; k++) {
+                Bucket b;
+                ok = fread(&b, sizeof(Bucket), 1, f) == 1;
+                buckets->push_back(b);
+            }
+            if (kept[l] != 0) {
+                series.levels[l] = buckets;
+            }
+        }
+    }
+    fclose(f);
+
+    if (!ok) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.swap(loaded);
+    latest_ms = latest;
+    return true;
+}
+
+int64_t Rollups::latest() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return latest_ms;
+}
+
+void Rollups::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.clear();
+    latest_ms = INT64_MIN;
+}
@@ -0,0 +1,151 @@
+#ifndef ROLLUPS_H
+#define ROLLUPS_H
+
+#include "SeriesCodec.h"
+#include "DeviceStats.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+// Агрегат одного поля за интервал
+struct FieldAggregate {
+    float min;
+    float max;
+    double sum;
+    double sum_sq;
+
+    double mean(uint64_t count) const { return count ? sum / (double)count : 0.0; }
+    double stddev(uint64_t count) const;
+};
+
+// Агрегат всех полей за интервал
+struct RollupAggregate {
+    int64_t start_ms;
+    int64_t end_ms;
+    uint64_t count;
+    FieldAggregate fields[STAT_FIELD_COUNT];
+
+    void reset(int64_t start, int64_t end);
+    void add(const float values[STAT_FIELD_COUNT]);
+    void merge(const RollupAggregate& other);
+};
+
+// Предагрегированные ряды с разрешением 1 с, 1 мин, 1 ч и 1 сутки.
+// Обновляются при записи каждой точки; запрос за произвольный интервал
+// собирается из самых крупных корзин, целиком лежащих в нем, а края
+// добираются более мелкими. Корзины уровня хранятся по порядку времени,
+// поэтому поиск границ - двоичный, а число объединяемых корзин ограничено
+// (дни интервала плюс не более 2*(23+59+59) краевых корзин). Мелкие
+// уровни хранятся ограниченное время; если край интервала старше,
+// берется перекрывающая его корзина более крупного уровня.
+//
+// Все четыре уровня ведутся только для сводного ряда ALL_DEVICES. Ряд
+// устройства - часы за последние сутки и сутки за последний месяц
+// (около 60 корзин, ~7 КБ на устройство): на 100 тыс. устройств это
+// сотни мегабайт, а не десятки гигабайт. Запрос по устройству точен до
+// часа; series() мелких уровней для устройства пуст.
+//
+// Уровни ряда разделяются со снимком (shared_ptr): save_async() под
+// замком копирует только указатели, а add() копирует уровень, прежде
+// чем менять его, если снимок еще не разобран. Запись идет своим потоком.
+// Точки после последнего сохранения при открытии добираются из истории
+// (latest() - с какого времени).
+class Rollups {
+public:
+    enum Level {
+        LEVEL_SECOND = 0,
+        LEVEL_MINUTE,
+        LEVEL_HOUR,
+        LEVEL_DAY,
+        LEVEL_COUNT
+    };
+
+    // Сводный ряд по всем устройствам
+    static const uint32_t ALL_DEVICES = 0xFFFFFFFFu;
+
+    Rollups();
+    ~Rollups();
+
+    // Поток чтения порта: учитывает точку в ряду устройства и в общем ряду
+    void add(const HistorySample& s);
+    // Пачка точек под одной блокировкой
+    void add(const HistorySample* samples, size_t count);
+
+    // Любой поток: агрегат за [from_ms, to_ms)
+    RollupAggregate query(uint32_t id, int64_t from_ms, int64_t to_ms) const;
+    // Ряд корзин заданного уровня за [from_ms, to_ms); пустые пропускаются
+    std::vector<RollupAggregate> series(uint32_t id, Level level, int64_t from_ms, int64_t to_ms) const;
+
+    bool save(const std::string& path) const;
+    // Снимок под замком, разбор и запись в файл - фоновым потоком; более
+    // новый снимок заменяет еще не записанный
+    void save_async(const std::string& path);
+    // Ждет завершения фоновой записи
+    void wait();
+    bool load(const std::string& path);
+    void clear();
+    // Время самой поздней учтенной точки; INT64_MIN - пусто
+    int64_t latest() const;
+
+    static int64_t level_width(Level level);
+
+private:
+    struct Bucket {
+        int64_t start;
+        uint64_t count;
+        FieldAggregate fields[STAT_FIELD_COUNT];
+    };
+
+    typedef std::vector<Bucket> Buckets;
+
+    // Пустой уровень - nullptr
+    struct Series {
+        std::shared_ptr<Buckets> levels[LEVEL_COUNT];
+    };
+
+    struct Snapshot {
+        int64_t latest_ms;
+        std::vector<std::pair<uint32_t, Series>> devices;
+    };
+
+    static int64_t align_down(int64_t t, int64_t width);
+    static const int64_t* retention(uint32_t id);
+    static const Buckets& level_buckets(const Series& series, int level);
+    Buckets& writable(std::shared_ptr<Buckets>& level);
+    static void add_to_level(Buckets& buckets, int64_t start, const float values[STAT_FIELD_COUNT]);
+    static void merge_bucket(RollupAggregate& out, const Bucket& b);
+    void add_series(Series& series, const int64_t* kept, const HistorySample& s,
+                    const float values[STAT_FIELD_COUNT]);
+    void cover(const Series& series, const int64_t* kept, int level, int64_t from_ms, int64_t to_ms,
+               RollupAggregate& out) const;
+    int64_t level_horizon(const int64_t* kept, int level) const;
+    void snapshot(Snapshot& out) const;
+    static void serialize(const Snapshot& snap, std::vector<uint8_t>& out);
+    static bool write_file(const std::string& path, const std::vector<uint8_t>& data);
+    void background();
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint32_t, Series> devices;
+    int64_t latest_ms;
+    // Снимки, уровни которых еще читаются
+    mutable std::atomic<int> snapshot_readers;
+
+    // Фоновая запись
+    std::mutex save_mutex;
+    std::condition_variable save_wake;
+    std::condition_variable save_done;
+    std::thread worker;
+    std::string pending_path;
+    Snapshot pending_snapshot;
+    bool pending;
+    bool writing;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "RxClock.h"
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+RxClock::RxClock(bool raw) : raw(raw), anchor_mono_us(0), anchor_wall_us(0) {
+#ifdef _WIN32
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    frequency = f.QuadPart;
+    (void)this->raw;
+#endif
+    anchor();
+}
+
+int64_t RxClock::now_us() const {
+#ifdef _WIN32
+    LARGE_INTEGER c;
+    QueryPerformanceCounter(&c);
+    return (int64_t)(c.QuadPart / frequency * 1000000 + c.QuadPart % frequency * 1000000 / frequency);
+#else
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(raw ? CLOCK_MONOTONIC_RAW : CLOCK_MONOTONIC, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+void RxClock::anchor() {
+    // UTC между двумя монотонными отсчетами: ошибка привязки не больше
+    // половины окна, повторяем, пока окно не станет коротким
+    int64_t best_window = INT64_MAX;
+    for (int i = 0; i < 5; i++) {
+        int64_t before = now_us();
+        int64_t wall = (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        int64_t after = now_us();
+        if (after - before < best_window) {
+            best_window = after - before;
+            anchor_mono_us = before + (after - before) / 2;
+            anchor_wall_us = wall;
+        }
+        if (best_window <= 1) {
+            break;
+        }
+    }
+}
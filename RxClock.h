@@ -0,0 +1,38 @@
+#ifndef RXCLOCK_H
+#define RXCLOCK_H
+
+#include <stdint.h>
+
+// Часы приема кадров.
+//
+// Метки берутся монотонными часами (CLOCK_MONOTONIC, по выбору
+// CLOCK_MONOTONIC_RAW; в Windows - QueryPerformanceCounter): они не
+// прыгают при переводе системного времени и стоят десятки наносекунд.
+// Интервалы, скорости и таймауты считаются по ним. Для показа и записи
+// метка переводится в UTC через одну пару (монотонное, UTC), снятую
+// при anchor(), так что все кадры одного запуска согласованы между собой.
+//
+// RAW не подстраивается NTP и за часы расходится с UTC на десятки
+// миллисекунд; он полезен для точных коротких интервалов.
+class RxClock {
+public:
+    explicit RxClock(bool raw = false);
+
+    // Монотонное время, мкс
+    int64_t now_us() const;
+
+    // Новая привязка к UTC; только пока никто не переводит метки
+    void anchor();
+    int64_t wall_us(int64_t mono_us) const { return anchor_wall_us + (mono_us - anchor_mono_us); }
+    int64_t mono_us(int64_t wall_us) const { return anchor_mono_us + (wall_us - anchor_wall_us); }
+
+private:
+    bool raw;
+    int64_t anchor_mono_us;
+    int64_t anchor_wall_us;
+#ifdef _WIN32
+    int64_t frequency;
+#endif
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include "SeriesCodec.h"
+#include <string.h>
+
+// ========== Битовые потоки ==========
+
+void BitWriter::write(uint64_t value, unsigned nbits) {
+    // Старшие биты значения идут первыми
+    while (nbits > 0) {
+        if ((bits & 7) == 0) {
+            bytes.push_back(0);
+        }
+        unsigned free_bits = 8 - (unsigned)(bits & 7);
+        unsigned n = nbits < free_bits ? nbits : free_bits;
+        uint8_t chunk = (uint8_t)((value >> (nbits - n)) & ((1u << n) - 1));
+        bytes.back() |= (uint8_t)(chunk << (free_bits - n));
+        nbits -= n;
+        bits += n;
+    }
+}
+
+uint64_t BitReader::read(unsigned nbits) {
+    uint64_t value = 0;
+    while (nbits > 0) {
+        if (pos >= size_bits) {
+            pos += nbits;
+            return value << nbits;
+        }
+        unsigned avail = 8 - (unsigned)(pos & 7);
+        unsigned n = nbits < avail ? nbits : avail;
+        uint8_t byte = data[pos >> 3];
+        uint8_t chunk = (uint8_t)((byte >> (avail - n)) & ((1u << n) - 1));
+        value = (value << n) | chunk;
+        nbits -= n;
+        pos += n;
+    }
+    return value;
+}
+
+void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static unsigned clz32(uint32_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return v ? (unsigned)__builtin_clz(v) : 32;
+#else
+    unsigned n = 0;
+    if (!v) return 32;
+    while (!(v & 0x80000000u)) { v <<= 1; n++; }
+    return n;
+#endif
+}
+
+static unsigned ctz32(uint32_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return v ? (unsigned)__builtin_ctz(v) : 32;
+#else
+    unsigned n = 0;
+    if (!v) return 32;
+    while (!(v & 1)) { v >>= 1; n++; }
+    return n;
+#endif
+}
+
+static void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+    uint8_t b[4];
+    memcpy(b, &v, 4);
+    out.insert(out.end(), b, b + 4);
+}
+
+static void put_i64(std::vector<uint8_t>& out, int64_t v) {
+    uint8_t b[8];
+    memcpy(b, &v, 8);
+    out.insert(out.end(), b, b + 8);
+}
+
+// ========== Кодировщик ==========
+
+SeriesEncoder::SeriesEncoder(uint32_t id)
+    : device_id(id), samples(0), t_first(0), t_last(0), prev_delta(0) {
+    pressure.prev = voltage.prev = 0;
+    pressure.leading = voltage.leading = -1;
+    pressure.trailing = voltage.trailing = 0;
+    temperature.prev = rssi.prev = 0;
+}
+
+void SeriesEncoder::put_float(XorColumn& c, float value, bool first) {
+    uint32_t v;
+    memcpy(&v, &value, 4);
+
+    if (first) {
+        c.bits.write(v, 32);
+        c.prev = v;
+        return;
+    }
+
+    uint32_t x = v ^ c.prev;
+    c.prev = v;
+
+    if (x == 0) {
+        c.bits.write(0, 1);
+        return;
+    }
+
+    int leading = (int)clz32(x);
+    int trailing = (int)ctz32(x);
+    if (leading > 31) leading = 31;
+
+    if (c.leading >= 0 && leading >= c.leading && trailing >= c.trailing) {
+        // Значащие биты помещаются в прежнее окно
+        int meaningful = 32 - c.leading - c.trailing;
+        c.bits.write(0b10, 2);
+        c.bits.write(x >> c.trailing, (unsigned)meaningful);
+    } else {
+        int meaningful = 32 - leading - trailing;
+        c.bits.write(0b11, 2);
+        c.bits.write((uint64_t)leading, 5);
+        c.bits.write((uint64_t)(meaningful - 1), 5);
+        c.bits.write(x >> trailing, (unsigned)meaningful);
+        c.leading = leading;
+        c.trailing = trailing;
+    }
+}
+
+void SeriesEncoder::put_int(IntColumn& c, int value, bool first) {
+    if (first) {
+        c.bits.write((uint16_t)value, 16);
+        c.prev = value;
+        return;
+    }
+
+    int d = value - c.prev;
+    c.prev = value;
+
+    if (d == 0) {
+        c.bits.write(0, 1);
+    } else if (d >= -8 && d <= 7) {
+        c.bits.write(0b10, 2);
+        c.bits.write(zigzag_encode(d), 4);
+    } else {
+        c.bits.write(0b11, 2);
+        c.bits.write((uint16_t)value, 16);
+    }
+}
+
+void SeriesEncoder::append(const HistorySample& s) {
+    bool first = samples == 0;
+
+    if (first) {
+        t_first = s.time_ms;
+    } else if (samples == 1) {
+        prev_delta = s.time_ms - t_last;
+        put_varint(times, zigzag_encode(prev_delta));
+    } else {
+        int64_t delta = s.time_ms - t_last;
+        put_varint(times, zigzag_encode(delta - prev_delta));
+        prev_delta = delta;
+    }
+    t_last = s.time_ms;
+
+    put_float(pressure, s.pressure_bar, first);
+    put_float(voltage, s.voltage_v, first);
+    put_int(temperature, s.temperature_c, first);
+    put_int(rssi, s.rssi, first);
+
+    samples++;
+}
+
+size_t SeriesEncoder::encoded_size() const {
+    return BLOCK_HEADER_SIZE + times.size() + pressure.bits.data().size() + voltage.bits.data().size() +
+           temperature.bits.data().size() + rssi.bits.data().size();
+}
+
+void SeriesEncoder::serialize(std::vector<uint8_t>& out) const {
+    out.reserve(out.size() + encoded_size());
+
+    put_u32(out, device_id);
+    put_u32(out, samples);
+    put_i64(out, t_first);
+    put_i64(out, t_last);
+
+    const std::vector<uint8_t>* columns[5] = {
+            &times, &pressure.bits.data(), &voltage.bits.data(),
+            &temperature.bits.data(), &rssi.bits.data()
+    };
+    for (const std::vector<uint8_t>* c : columns) {
+        put_u32(out, (uint32_t)c->size());
+    }
+    for (const std::vector<uint8_t>* c : columns) {
+        out.insert(out.end(), c->begin(), c->end());
+    }
+}
+
+// ========== Декодировщик ==========
+
+bool SeriesDecoder::open(const uint8_t* data, size_t size, size_t* block_size) {
+    if (size < SeriesEncoder::BLOCK_HEADER_SIZE) {
+        return false;
+    }
+
+    memcpy(&device_id, data, 4);
+    memcpy(&samples, data + 4, 4);
+    memcpy(&t_first, data + 8, 8);
+    memcpy(&t_last, data + 16, 8);
+
+    uint32_t len[5];
+    size_t total = SeriesEncoder::BLOCK_HEADER_SIZE;
+    for (int i = 0; i < 5; i++) {
+        memcpy(&len[i], data + 24 + i * 4, 4);
+        total += len[i];
+    }
+    if (total > size) {
+        return false;
+    }
+
+    const uint8_t* p = data + SeriesEncoder::BLOCK_HEADER_SIZE;
+    times = p;
+    times_end = p + len[0];
+    p += len[0];
+    pressure = BitReader(p, len[1]);
+    p += len[1];
+    voltage = BitReader(p, len[2]);
+    p += len[2];
+    temperature = BitReader(p, len[3]);
+    p += len[3];
+    rssi = BitReader(p, len[4]);
+
+    decoded = 0;
+    prev_time = t_first;
+    prev_delta = 0;
+    pressure_state.prev = voltage_state.prev = 0;
+    pressure_state.leading = voltage_state.leading = 0;
+    pressure_state.trailing = voltage_state.trailing = 0;
+    prev_temperature = prev_rssi = 0;
+
+    if (block_size) *block_size = total;
+    return true;
+}
+
+float SeriesDecoder::get_float(BitReader& r, XorState& st, bool first) {
+    uint32_t v;
+
+    if (first) {
+        v = (uint32_t)r.read(32);
+    } else if (r.read(1) == 0) {
+        v = st.prev;
+    } else {
+        if (r.read(1) == 1) {
+            st.leading = (int)r.read(5);
+            int meaningful = (int)r.read(5) + 1;
+            st.trailing = 32 - st.leading - meaningful;
+        }
+        int meaningful = 32 - st.leading - st.trailing;
+        uint32_t x = (uint32_t)r.read((unsigned)meaningful) << st.trailing;
+        v = st.prev ^ x;
+    }
+
+    st.prev = v;
+    float f;
+    memcpy(&f, &v, 4);
+    return f;
+}
+
+int SeriesDecoder::get_int(BitReader& r, int& prev, bool first) {
+    if (first) {
+        prev = (int16_t)r.read(16);
+    } else if (r.read(1) == 1) {
+        if (r.read(1) == 0) {
+            prev += (int)zigzag_decode(r.read(4));
+        } else {
+            prev = (int16_t)r.read(16);
+        }
+    }
+    return prev;
+}
+
+bool SeriesDecoder::next(HistorySample& out) {
+    if (decoded >= samples) {
+        return false;
+    }
+
+    bool first = decoded == 0;
+    if (!first) {
+        uint64_t zz;
+        if (!get_varint(times, times_end, zz)) {
+            return false;
+        }
+        if (decoded == 1) {
+            prev_delta = zigzag_decode(zz);
+        } else {
+            prev_delta += zigzag_decode(zz);
+        }
+        prev_time += prev_delta;
+    }
+
+    out.id = device_id;
+    out.time_ms = prev_time;
+    out.pressure_bar = get_float(pressure, pressure_state, first);
+    out.voltage_v = get_float(voltage, voltage_state, first);
+    out.temperature_c = (int16_t)get_int(temperature, prev_temperature, first);
+    out.rssi = (int16_t)get_int(rssi, prev_rssi, first);
+
+    decoded++;
+    return pressure.ok() && voltage.ok() && temperature.ok() && rssi.ok();
+}
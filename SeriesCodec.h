@@ -0,0 +1,158 @@
+#ifndef SERIESCODEC_H
+#define SERIESCODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Одна точка истории устройства
+struct HistorySample {
+    uint32_t id;
+    int64_t time_ms;        // время UTC в миллисекундах
+    float pressure_bar;
+    float voltage_v;
+    int16_t temperature_c;
+    int16_t rssi;
+};
+
+// ========== Битовые потоки ==========
+
+class BitWriter {
+public:
+    BitWriter() : bits(0) {}
+
+    void write(uint64_t value, unsigned nbits);
+    void clear() { bytes.clear(); bits = 0; }
+
+    const std::vector<uint8_t>& data() const { return bytes; }
+    size_t bit_count() const { return bits; }
+
+private:
+    std::vector<uint8_t> bytes;
+    size_t bits;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data(data), size_bits(size * 8), pos(0) {}
+
+    // При выходе за конец возвращает нули; проверять через ok()
+    uint64_t read(unsigned nbits);
+    bool ok() const { return pos <= size_bits; }
+
+private:
+    const uint8_t* data;
+    size_t size_bits;
+    size_t pos;
+};
+
+void put_varint(std::vector<uint8_t>& out, uint64_t v);
+bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v);
+
+inline uint64_t zigzag_encode(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t zigzag_decode(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+// ========== Кодирование ряда одного устройства ==========
+//
+// Столбцы кодируются независимо:
+//   время         - delta-of-delta, zigzag, varint (байтовый поток);
+//   давление,
+//   напряжение    - XOR с предыдущим значением (как в Gorilla);
+//   температура,
+//   RSSI          - упакованные в биты разности: 0 - без изменений,
+//                   10 + 4 бита - малая разность, 11 + 16 бит - значение.
+//
+// Блок на диске (little-endian):
+//   u32 id, u32 count, i64 first_time, i64 last_time,
+//   u32 длины пяти столбцов в байтах, затем сами столбцы.
+
+class SeriesEncoder {
+public:
+    static const size_t BLOCK_HEADER_SIZE = 4 + 4 + 8 + 8 + 5 * 4;
+
+    explicit SeriesEncoder(uint32_t id = 0);
+
+    void append(const HistorySample& s);
+
+    uint32_t id() const { return device_id; }
+    uint32_t count() const { return samples; }
+    int64_t first_time() const { return t_first; }
+    int64_t last_time() const { return t_last; }
+    size_t encoded_size() const;
+
+    void serialize(std::vector<uint8_t>& out) const;
+
+private:
+    struct XorColumn {
+        BitWriter bits;
+        uint32_t prev;
+        int leading;
+        int trailing;
+    };
+
+    struct IntColumn {
+        BitWriter bits;
+        int prev;
+    };
+
+    static void put_float(XorColumn& c, float value, bool first);
+    static void put_int(IntColumn& c, int value, bool first);
+
+    uint32_t device_id;
+    uint32_t samples;
+    int64_t t_first;
+    int64_t t_last;
+    int64_t prev_delta;
+
+    std::vector<uint8_t> times;
+    XorColumn pressure;
+    XorColumn voltage;
+    IntColumn temperature;
+    IntColumn rssi;
+};
+
+// Последовательное чтение блока, записанного SeriesEncoder::serialize
+class SeriesDecoder {
+public:
+    // Разбирает заголовок блока; block_size - сколько байт занимает блок
+    bool open(const uint8_t* data, size_t size, size_t* block_size);
+
+    uint32_t id() const { return device_id; }
+    uint32_t count() const { return samples; }
+    int64_t first_time() const { return t_first; }
+    int64_t last_time() const { return t_last; }
+
+    bool next(HistorySample& out);
+
+private:
+    struct XorState {
+        uint32_t prev;
+        int leading;
+        int trailing;
+    };
+
+    static float get_float(BitReader& r, XorState& st, bool first);
+    static int get_int(BitReader& r, int& prev, bool first);
+
+    uint32_t device_id;
+    uint32_t samples;
+    uint32_t decoded;
+    int64_t t_first;
+    int64_t t_last;
+
+    int64_t prev_time;
+    int64_t prev_delta;
+    const uint8_t* times;
+    const uint8_t* times_end;
+
+    BitReader pressure{nullptr, 0};
+    BitReader voltage{nullptr, 0};
+    BitReader temperature{nullptr, 0};
+    BitReader rssi{nullptr, 0};
+    XorState pressure_state;
+    XorState voltage_state;
+    int prev_temperature;
+    int prev_rssi;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "SessionSnapshot.h"
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const char SNAPSHOT_MAGIC[4] = {'E', 'S', 'S', '1'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const size_t SNAPSHOT_HEADER_SIZE = 32;
+
+// Переименование переживает сбой питания, только когда синхронизирован
+// каталог (в Windows каталог так не открыть - NTFS журналирует его сама)
+static bool sync_parent_dir(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    std::string dir = fs::path(path).parent_path().string();
+    int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+SessionSnapshot::SessionSnapshot()
+    : view(nullptr), view_size(0),
+#ifdef _WIN32
+      file_handle(nullptr), mapping_handle(nullptr),
+#endif
+      mapped_records(nullptr), record_count(0), saved_time_ms(0),
+      stopping(false), pending(false), writing(false), pending_time_ms(0) {
+}
+
+SessionSnapshot::~SessionSnapshot() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    unmap();
+}
+
+bool SessionSnapshot::map(const std::string& path, std::string* error) {
+    unmap();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        if (error) *error = "нет файла снимка";
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)SNAPSHOT_HEADER_SIZE) {
+        CloseHandle(file);
+        if (error) *error = "поврежденный снимок";
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* p = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!p) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        if (error) *error = "не удалось отобразить снимок";
+        return false;
+    }
+    file_handle = file;
+    mapping_handle = mapping;
+    view = p;
+    view_size = (size_t)size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (error) *error = "нет файла снимка";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)SNAPSHOT_HEADER_SIZE) {
+        ::close(fd);
+        if (error) *error = "поврежденный снимок";
+        return false;
+    }
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    // Снимок читается целиком сразу после отображения
+    flags |= MAP_POPULATE;
+#endif
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        if (error) *error = "не удалось отобразить снимок";
+        return false;
+    }
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    view = p;
+    view_size = (size_t)st.st_size;
+#endif
+
+    // Проверяем заголовок
+    const uint8_t* data = (const uint8_t*)view;
+    uint32_t version, record_size, count;
+    memcpy(&version, data + 4, 4);
+    memcpy(&record_size, data + 8, 4);
+    memcpy(&count, data + 12, 4);
+
+    if (memcmp(data, SNAPSHOT_MAGIC, 4) != 0 || version != SNAPSHOT_VERSION ||
+        record_size != sizeof(SessionDeviceRecord) ||
+        SNAPSHOT_HEADER_SIZE + (uint64_t)count * record_size != view_size) {
+        unmap();
+        if (error) *error = "поврежденный или устаревший снимок";
+        return false;
+    }
+
+    memcpy(&saved_time_ms, data + 16, 8);
+    record_count = count;
+    mapped_records = (const SessionDeviceRecord*)(data + SNAPSHOT_HEADER_SIZE);
+    return true;
+}
+
+void SessionSnapshot::unmap() {
+    if (view) {
+#ifdef _WIN32
+        UnmapViewOfFile(view);
+        CloseHandle((HANDLE)mapping_handle);
+        CloseHandle((HANDLE)file_handle);
+        mapping_handle = nullptr;
+        file_handle = nullptr;
+#else
+        munmap(view, view_size);
+#endif
+    }
+    view = nullptr;
+    view_size = 0;
+    mapped_records = nullptr;
+    record_count = 0;
+    saved_time_ms = 0;
+}
+
+bool SessionSnapshot::write(const std::string& path, const std::vector<SessionDeviceRecord>& records,
+                            int64_t time_ms, std::string* error) {
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        if (error) *error = "не удалось создать " + tmp;
+        return false;
+    }
+
+    uint8_t header[SNAPSHOT_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    uint32_t record_size = sizeof(SessionDeviceRecord);
+    uint32_t count = (uint32_t)records.size();
+    memcpy(header, SNAPSHOT_MAGIC, 4);
+    memcpy(header + 4, &SNAPSHOT_VERSION, 4);
+    memcpy(header + 8, &record_size, 4);
+    memcpy(header + 12, &count, 4);
+    memcpy(header + 16, &time_ms, 8);
+
+    bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header);
+    if (ok && count > 0) {
+        ok = fwrite(records.data(), record_size, count, f) == count;
+    }
+
+    // Данные должны попасть на диск до переименования
+    ok = ok && fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = fclose(f) == 0 && ok;
+
+    std::error_code ec;
+    if (ok) {
+        fs::rename(tmp, path, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        fs::remove(tmp, ec);
+        if (error) *error = "ошибка записи снимка " + path;
+        return false;
+    }
+    if (!sync_parent_dir(path)) {
+        if (error) *error = "ошибка синхронизации каталога снимка " + path;
+        return false;
+    }
+    return true;
+}
+
+void SessionSnapshot::save_async(const std::string& path, std::vector<SessionDeviceRecord>&& records,
+                                 int64_t time_ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    pending_path = path;
+    pending_records.swap(records);
+    pending_time_ms = time_ms;
+    pending = true;
+
+    if (!worker.joinable()) {
+        worker = std::thread(&SessionSnapshot::background, this);
+    }
+    wake.notify_one();
+}
+
+void SessionSnapshot::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return !pending && !writing; });
+}
+
+void SessionSnapshot::background() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;) {
+        wake.wait(lock, [this] { return pending || stopping; });
+        if (!pending) {
+            break;
+        }
+
+        std::string path;
+        std::vector<SessionDeviceRecord> records;
+        path.swap(pending_path);
+        records.swap(pending_records);
+        int64_t time_ms = pending_time_ms;
+        pending = false;
+        writing = true;
+
+        lock.unlock();
+        write(path, records, time_ms, nullptr);
+        lock.lock();
+
+        writing = false;
+        done.notify_all();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef SESSIONSNAPSHOT_H
+#define SESSIONSNAPSHOT_H
+
+#include "DeviceStats.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// Запись реестра устройств в снимке сессии. Фиксированный размер:
+// файл отображается в память и читается без разбора.
+struct SessionDeviceRecord {
+    uint32_t id;
+    uint8_t type;           // байт типа пакета (0xF0 - датчик, 0xF1 - репитер)
+    uint8_t fw_version;
+    int16_t temperature_c;
+    int16_t rssi;
+    uint16_t reserved;
+    float pressure_bar;
+    float voltage_v;
+    uint32_t packet_count;
+    int64_t first_seen_ms;
+    int64_t last_seen_ms;
+    DeviceStatsState stats;
+};
+
+// Снимок реестра устройств для быстрого восстановления при запуске.
+//
+// Запись выполняется фоновым потоком: во временный файл, fsync, затем
+// атомарное переименование, поэтому на диске всегда лежит целый снимок.
+// Если новый снимок приходит, пока пишется предыдущий, промежуточные
+// пропускаются.
+//
+// Формат: заголовок SNAPSHOT_HEADER_SIZE байт ("ESS1", версия, размер
+// записи, число записей, время снимка), затем массив SessionDeviceRecord.
+class SessionSnapshot {
+public:
+    SessionSnapshot();
+    ~SessionSnapshot();
+
+    // Отображает файл снимка в память. Записи доступны до unmap().
+    bool map(const std::string& path, std::string* error);
+    void unmap();
+
+    uint32_t count() const { return record_count; }
+    const SessionDeviceRecord* records() const { return mapped_records; }
+    int64_t saved_ms() const { return saved_time_ms; }
+
+    // Ставит снимок в очередь фоновой записи
+    void save_async(const std::string& path, std::vector<SessionDeviceRecord>&& records, int64_t time_ms);
+    // Дожидается окончания фоновой записи
+    void wait();
+
+    static bool write(const std::string& path, const std::vector<SessionDeviceRecord>& records,
+                      int64_t time_ms, std::string* error);
+
+private:
+    void background();
+
+    // Отображение файла
+    void* view;
+    size_t view_size;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+    const SessionDeviceRecord* mapped_records;
+    uint32_t record_count;
+    int64_t saved_time_ms;
+
+    // Фоновая запись
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::thread worker;
+    bool stopping;
+    bool pending;
+    bool writing;
+    std::string pending_path;
+    std::vector<SessionDeviceRecord> pending_records;
+    int64_t pending_time_ms;
+};
+
+#endif
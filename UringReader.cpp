@@ -0,0 +1,327 @@
+#include "UringReader.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Метка завершения чтения дескриптора пробуждения
+static const uint64_t WAKE_TAG = UINT64_MAX;
+// Метка ожидания готовности перед повторным чтением
+static const uint64_t POLL_TAG = UINT64_MAX - 1;
+
+static int uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+#endif
+
+UringReader::UringReader()
+    : ring_fd(-1), ring_mem(nullptr), ring_size(0), sqe_mem(nullptr), sqe_size(0),
+      sq_head(nullptr), sq_tail(nullptr), sq_mask(nullptr), sq_array(nullptr),
+      cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr), sqes(nullptr), cqes(nullptr),
+      pending(0), buffers(nullptr), buffer_size(0), max_ports(0), wake_fd(-1), wake_value(0),
+      enters(0), completed(0) {
+}
+
+UringReader::~UringReader() {
+    close();
+}
+
+bool UringReader::available() {
+#ifdef HAVE_IO_URING
+    static int cached = -1;
+    if (cached < 0) {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = uring_setup(2, &p);
+        cached = fd >= 0 && (p.features & IORING_FEAT_EXT_ARG) && (p.features & IORING_FEAT_SINGLE_MMAP);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    return cached == 1;
+#else
+    return false;
+#endif
+}
+
+bool UringReader::open(unsigned ports, size_t size, std::string* error) {
+    close();
+#ifdef HAVE_IO_URING
+    if (!available()) {
+        if (error) *error = "io_uring недоступен (нужно ядро 5.11+)";
+        return false;
+    }
+
+    // Чтение (и, после -EAGAIN, ожидание перед ним) на порт и одно
+    // чтение пробуждения
+    unsigned entries = 2;
+    while (entries < 2 * ports + 1) {
+        entries *= 2;
+    }
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring_fd = uring_setup(entries, &p);
+    if (ring_fd < 0) {
+        if (error) *error = std::string("io_uring_setup: ") + strerror(errno);
+        return false;
+    }
+
+    // Кольца SQ и CQ в одном отображении (IORING_FEAT_SINGLE_MMAP)
+    size_t sq_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_bytes = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring_size = sq_bytes > cq_bytes ? sq_bytes : cq_bytes;
+    ring_mem = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    sqe_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqe_mem = mmap(nullptr, sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (ring_mem == MAP_FAILED || sqe_mem == MAP_FAILED) {
+        if (ring_mem == MAP_FAILED) ring_mem = nullptr;
+        if (sqe_mem == MAP_FAILED) sqe_mem = nullptr;
+        if (error) *error = std::string("mmap кольца: ") + strerror(errno);
+        close();
+        return false;
+    }
+
+    uint8_t* base = (uint8_t*)ring_mem;
+    sq_head = (unsigned*)(base + p.sq_off.head);
+    sq_tail = (unsigned*)(base + p.sq_off.tail);
+    sq_mask = (unsigned*)(base + p.sq_off.ring_mask);
+    sq_array = (unsigned*)(base + p.sq_off.array);
+    cq_head = (unsigned*)(base + p.cq_off.head);
+    cq_tail = (unsigned*)(base + p.cq_off.tail);
+    cq_mask = (unsigned*)(base + p.cq_off.ring_mask);
+    cqes = base + p.cq_off.cqes;
+    sqes = sqe_mem;
+
+    // Буферы портов подряд, каждый зарегистрирован отдельным iovec
+    buffer_size = size;
+    max_ports = ports;
+    if (posix_memalign((void**)&buffers, 4096, (size_t)ports * size) != 0) {
+        buffers = nullptr;
+        if (error) *error = "нет памяти под буферы";
+        close();
+        return false;
+    }
+    memset(buffers, 0, (size_t)ports * size);
+    std::vector<struct iovec> iov(ports);
+    for (unsigned i = 0; i < ports; i++) {
+        iov[i].iov_base = buffers + (size_t)i * size;
+        iov[i].iov_len = size;
+    }
+    if (uring_register(ring_fd, IORING_REGISTER_BUFFERS, iov.data(), ports) < 0) {
+        if (error) *error = std::string("регистрация буферов: ") + strerror(errno);
+        close();
+        return false;
+    }
+    return true;
+#else
+    (void)ports;
+    (void)size;
+    if (error) *error = "io_uring есть только в Linux";
+    return false;
+#endif
+}
+
+void UringReader::close() {
+#ifdef HAVE_IO_URING
+    // Закрытие кольца отменяет стоящие чтения
+    if (ring_fd >= 0) {
+        ::close(ring_fd);
+    }
+    if (ring_mem) {
+        munmap(ring_mem, ring_size);
+    }
+    if (sqe_mem) {
+        munmap(sqe_mem, sqe_size);
+    }
+#endif
+    free(buffers);
+    buffers = nullptr;
+    ring_fd = -1;
+    ring_mem = sqe_mem = nullptr;
+    fds.clear();
+    pending = 0;
+    wake_fd = -1;
+}
+
+#ifdef HAVE_IO_URING
+bool UringReader::queue_read(uint32_t port, bool poll_first) {
+    unsigned tail = *sq_tail;
+    unsigned used = tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (used + (poll_first ? 2 : 1) > *sq_mask + 1) {
+        return false;
+    }
+    unsigned idx;
+    struct io_uring_sqe* sqe;
+    if (poll_first) {
+        // Неблокирующий дескриптор на ядре без внутреннего poll вернул
+        // -EAGAIN: чтение ждет готовности в связке, а не крутится
+        idx = tail & *sq_mask;
+        sqe = (struct io_uring_sqe*)sqes + idx;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fds[port];
+        sqe->poll_events = POLLIN;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = POLL_TAG;
+        sq_array[idx] = idx;
+        tail++;
+        pending++;
+    }
+    idx = tail & *sq_mask;
+    sqe = (struct io_uring_sqe*)sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fds[port];
+    sqe->addr = (uint64_t)(uintptr_t)(buffers + (size_t)port * buffer_size);
+    sqe->len = (uint32_t)buffer_size;
+    sqe->off = (uint64_t)-1;        // текущая позиция: tty и pipe без смещений
+    sqe->buf_index = (uint16_t)port;
+    sqe->user_data = port;
+    sq_array[idx] = idx;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    pending++;
+    return true;
+}
+
+bool UringReader::queue_wake_read() {
+    unsigned tail = *sq_tail;
+    if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > *sq_mask) {
+        return false;
+    }
+    unsigned idx = tail & *sq_mask;
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&wake_value;
+    sqe->len = sizeof(wake_value);
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = WAKE_TAG;
+    sq_array[idx] = idx;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    pending++;
+    return true;
+}
+
+int UringReader::enter(unsigned to_submit, unsigned min_complete, int timeout_ms) {
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+
+    unsigned flags = IORING_ENTER_EXT_ARG | (min_complete ? IORING_ENTER_GETEVENTS : 0);
+    enters++;
+    return uring_enter(ring_fd, to_submit, min_complete, flags, &arg, sizeof(arg));
+}
+#endif
+
+int UringReader::add_port(int fd) {
+#ifdef HAVE_IO_URING
+    if (ring_fd < 0 || fds.size() >= max_ports) {
+        return -1;
+    }
+    fds.push_back(fd);
+    uint32_t port = (uint32_t)fds.size() - 1;
+    if (!queue_read(port)) {
+        fds.pop_back();
+        return -1;
+    }
+    return (int)port;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+
+void UringReader::set_wake_fd(int fd) {
+#ifdef HAVE_IO_URING
+    wake_fd = fd;
+    if (ring_fd >= 0 && fd >= 0) {
+        queue_wake_read();
+    }
+#else
+    (void)fd;
+#endif
+}
+
+int UringReader::wait(int timeout_ms, const Handler& handler, bool* woken) {
+    if (woken) *woken = false;
+#ifdef HAVE_IO_URING
+    if (ring_fd < 0) {
+        return -1;
+    }
+
+    // Готовых завершений нет - отправляем повторные чтения и ждем
+    // одним вызовом; есть - только отправляем, если есть что
+    bool ready = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE) != *cq_head;
+    if (!ready || pending) {
+        int r = enter(pending, ready ? 0 : 1, timeout_ms);
+        if (r < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+            return -1;
+        }
+        if (r > 0) {
+            pending -= (unsigned)r < pending ? (unsigned)r : pending;
+        }
+    }
+
+    int handled = 0;
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const struct io_uring_cqe* cqe = (const struct io_uring_cqe*)cqes + (head & *cq_mask);
+        uint64_t tag = cqe->user_data;
+        int res = cqe->res;
+        if (tag == WAKE_TAG) {
+            if (woken) *woken = true;
+            continue;
+        }
+        if (tag == POLL_TAG) {
+            continue;       // итог - в завершении связанного чтения
+        }
+
+        uint32_t port = (uint32_t)tag;
+        if (res == -EAGAIN) {
+            queue_read(port, true);
+            continue;
+        }
+        bool more = handler((int)port, buffers + (size_t)port * buffer_size, res);
+        handled++;
+
+        if (more) {
+            queue_read(port);
+        }
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    completed += (uint64_t)handled;
+    return handled;
+#else
+    (void)timeout_ms;
+    (void)handler;
+    return -1;
+#endif
+}
@@ -0,0 +1,89 @@
+#ifndef URINGREADER_H
+#define URINGREADER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Чтение нескольких портов через одно кольцо io_uring.
+//
+// На каждый порт в кольце всегда стоит одно чтение IORING_OP_READ_FIXED
+// в его зарегистрированный буфер (IORING_REGISTER_BUFFERS: страницы
+// закреплены один раз, а не при каждом чтении). wait() одним вызовом
+// io_uring_enter отправляет повторные чтения за прошлую пачку и ждет
+// новых завершений, затем раздает все готовые завершения обработчику.
+// Так один поток обслуживает десятки портов за один системный вызов на
+// пачку, а не poll() + read() на каждый порт.
+//
+// Дескриптор пробуждения (eventfd потока чтения) читается тем же
+// кольцом: stop() прерывает wait() без таймаута.
+//
+// Нужны Linux 5.11+ (IORING_FEAT_EXT_ARG для таймаута ожидания);
+// available() проверяет ядро и запрет через kernel.io_uring_disabled.
+// Без поддержки open() возвращает false, и вызывающий читает по-старому.
+class UringReader {
+public:
+    // port - номер из add_port(); result > 0 - байты в data, 0 - таймаут
+    // чтения tty (VTIME) или конец файла, < 0 - -errno. false - порт
+    // больше не читать. Данные можно менять на месте (разбор протокола
+    // поверх потока): буфер снова нужен кольцу только после возврата.
+    typedef std::function<bool(int port, uint8_t* data, int result)> Handler;
+
+    UringReader();
+    ~UringReader();
+
+    static bool available();
+
+    bool open(unsigned max_ports, size_t buffer_size, std::string* error = nullptr);
+    void close();
+    bool is_open() const { return ring_fd >= 0; }
+
+    // Номер порта или -1. Чтение встает в очередь до следующего wait().
+    int add_port(int fd);
+    void set_wake_fd(int fd);
+
+    // Завершений обработано; 0 - таймаут; -1 - ошибка кольца.
+    // *woken - сработал дескриптор пробуждения.
+    int wait(int timeout_ms, const Handler& handler, bool* woken);
+
+    // Для сравнения путей чтения
+    uint64_t enter_calls() const { return enters; }
+    uint64_t completions() const { return completed; }
+
+private:
+    bool queue_read(uint32_t port, bool poll_first = false);
+    bool queue_wake_read();
+    int enter(unsigned to_submit, unsigned min_complete, int timeout_ms);
+
+    int ring_fd;
+    void* ring_mem;
+    size_t ring_size;
+    void* sqe_mem;
+    size_t sqe_size;
+
+    // Указатели в отображенные кольца
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    void* sqes;
+    void* cqes;
+
+    unsigned pending;           // подготовлено, но не отправлено
+    std::vector<int> fds;
+    uint8_t* buffers;
+    size_t buffer_size;
+    unsigned max_ports;
+    int wake_fd;
+    uint64_t wake_value;
+
+    uint64_t enters;
+    uint64_t completed;
+};
+
+#endif